@@ -31,7 +31,9 @@ android {
                 arguments += listOf(
                     "-DANDROID_STL=c++_shared",
                     "-DANDROID_ARM_NEON=TRUE",
-                    "-DLLAMA_NATIVE=OFF"
+                    "-DLLAMA_NATIVE=OFF",
+                    // PGO stage for llama/llama_jni: OFF (default), GENERATE or USE (see build-pgo.sh)
+                    "-DLLAMA_JNI_PGO=${(project.findProperty("llamaPgo") as String? ?: "OFF").uppercase()}"
                 )
             }
         }
@@ -78,6 +80,26 @@ android {
             excludes += "/META-INF/{AL2.0,LGPL2.1}"
         }
     }
+    sourceSets {
+        getByName("main") {
+            assets.srcDir(layout.buildDirectory.dir("generated/knowledge"))
+        }
+    }
+    testOptions {
+        // JVM unit tests run the Kotlin fallbacks; android.util.Log calls return defaults
+        unitTests.isReturnDefaultValues = true
+    }
+}
+
+// Instruction corpus at the repository root, bundled as assets/knowledge/ for KnowledgeBase
+val copyKnowledgeAssets by tasks.registering(Copy::class) {
+    from(rootProject.file("../THE GOS INSRUCTIOS")) {
+        include("*.txt")
+    }
+    into(layout.buildDirectory.dir("generated/knowledge/knowledge"))
+}
+tasks.named("preBuild") {
+    dependsOn(copyKnowledgeAssets)
 }
 
 dependencies {
@@ -8,9 +8,10 @@
 # Keep AI assistant classes
 -keep class com.guildofsmiths.trademesh.ai.** { *; }
 
-# Keep native JNI methods for llama.cpp
+# Keep native JNI methods for llama.cpp, and the callbacks the worker thread invokes
 -keep class com.guildofsmiths.trademesh.ai.LlamaInference {
     native <methods>;
+    static void onNative*(...);
 }
 
 # Keep serialization classes
@@ -334,6 +334,16 @@ class AIFlowInstrumentedTest {
         assertTrue("Initialization should succeed", result)
     }
     
+    @Test
+    fun testLlamaInference_DeferredInitMetrics() {
+        assertTrue(LlamaInference.initialize())
+        
+        // Library load + backend init are measured when they happen lazily
+        val metrics = LlamaInference.initMetrics.value
+        assertNotNull("Deferred init should be measured", metrics)
+        assertTrue(metrics!!.totalMs >= 0)
+    }
+    
     @Test
     fun testLlamaInference_ModelState() {
         val state = LlamaInference.modelState.value
@@ -0,0 +1,298 @@
+/**
+ * batch_generate.cpp - Multi-sequence generation for queued work
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "LlamaBatch"
+
+#include "batch_generate.h"
+#include "native_log.h"
+
+#include <algorithm>
+
+#include "common.h"
+
+namespace smith {
+
+static int common_prefix(const std::vector<llama_token>& a, const std::vector<llama_token>& b) {
+    const size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return (int) i;
+}
+
+BatchGeneration::BatchGeneration(llama_model* model, std::vector<BatchItem> items)
+    : model_(model), items_(std::move(items)) {
+    tokens_.resize(items_.size());
+    results_.resize(items_.size());
+    stats_.n_items = (int) items_.size();
+}
+
+void BatchGeneration::start() {
+    for (size_t i = 0; i < items_.size(); i++) {
+        if (!tokenize(model_, items_[i].prompt, true, tokens_[i]) || tokens_[i].empty()) {
+            finish(i, GenerationStatus::TOKENIZE_FAILED);
+            continue;
+        }
+        results_[i].n_prompt_tokens = (int) tokens_[i].size();
+        if (items_[i].params.max_tokens <= 0) {
+            finish(i, GenerationStatus::OK);
+        }
+    }
+
+    // Lexicographic order puts prompts with long shared prefixes side by side
+    order_.resize(items_.size());
+    for (size_t i = 0; i < order_.size(); i++) {
+        order_[i] = i;
+    }
+    std::stable_sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+        return tokens_[a] < tokens_[b];
+    });
+}
+
+bool BatchGeneration::done() const {
+    for (const BatchItemResult& r : results_) {
+        if (!r.finished) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchGeneration::finish(size_t item, GenerationStatus status) {
+    BatchItemResult& r = results_[item];
+    r.status = status;
+    r.finished = true;
+    if (t_begin_us_ > 0) {
+        r.t_latency_us = now_us() - t_begin_us_;
+    }
+}
+
+std::vector<size_t> BatchGeneration::plan_wave(llama_context* ctx, int& n_prefix) {
+    const int n_ctx = (int) llama_n_ctx(ctx);
+    const size_t n_seq_max = std::max(1u, llama_n_seq_max(ctx));
+
+    std::vector<size_t> wave;
+    int n_cells = 0;   // suffix + budget of every member
+    n_prefix = 0;
+
+    for (size_t item : order_) {
+        if (results_[item].finished) {
+            continue;
+        }
+        const int n_prompt = (int) tokens_[item].size();
+        if (n_prompt >= n_ctx) {
+            LOGE("Batch item %zu: prompt of %d tokens does not fit n_ctx %d", item, n_prompt, n_ctx);
+            finish(item, GenerationStatus::DECODE_FAILED);
+            continue;
+        }
+        const int budget = std::min(budget_[item], n_ctx - n_prompt);
+
+        // Every member keeps at least one suffix token so it gets its own logits
+        int prefix = n_prompt - 1;
+        if (!wave.empty()) {
+            prefix = std::min(n_prefix, common_prefix(tokens_[wave.front()], tokens_[item]));
+        }
+        int cells = prefix;
+        for (size_t member : wave) {
+            cells += (int) tokens_[member].size() - prefix + budget_[member];
+        }
+        cells += n_prompt - prefix + budget;
+
+        if (!wave.empty() && (cells > n_ctx || wave.size() >= n_seq_max)) {
+            break;
+        }
+        budget_[item] = budget;
+        wave.push_back(item);
+        n_prefix = prefix;
+        n_cells = cells;
+    }
+
+    (void) n_cells;
+    return wave;
+}
+
+bool BatchGeneration::accept(Slot& slot, llama_token token) {
+    BatchItemResult& r = results_[slot.item];
+    if (llama_token_is_eog(model_, token)) {
+        finish(slot.item, GenerationStatus::OK);
+        slot.active = false;
+        return false;
+    }
+    append_piece(model_, token, r.text);
+    if (r.n_generated++ == 0) {
+        r.t_first_token_us = now_us() - t_begin_us_;
+    }
+    if (r.n_generated >= budget_[slot.item]) {
+        finish(slot.item, GenerationStatus::OK);
+        slot.active = false;
+        return false;
+    }
+    slot.next = token;
+    return true;
+}
+
+bool BatchGeneration::run_wave(llama_context* ctx, const std::vector<size_t>& wave, int n_prefix,
+                               const std::function<bool()>& should_stop) {
+    const int n_batch = (int) llama_n_batch(ctx);
+    const int n_vocab = llama_n_vocab(model_);
+    std::vector<llama_token_data> candidates;
+    candidates.reserve(n_vocab);
+
+    llama_kv_cache_clear(ctx);
+    llama_batch batch = llama_batch_init(std::max(n_batch, (int) wave.size()), 0, 1);
+
+    auto abandon = [&]() {
+        // Unfinished members rerun from scratch on the next run()
+        for (size_t item : wave) {
+            BatchItemResult& r = results_[item];
+            if (!r.finished) {
+                r.text.clear();
+                r.n_generated = 0;
+                r.t_first_token_us = 0;
+            }
+        }
+        llama_kv_cache_clear(ctx);
+        llama_batch_free(batch);
+        return false;
+    };
+    auto fail_all = [&]() {
+        LOGE("Batch decode failed");
+        for (size_t item : wave) {
+            if (!results_[item].finished) {
+                finish(item, GenerationStatus::DECODE_FAILED);
+            }
+        }
+        llama_kv_cache_clear(ctx);
+        llama_batch_free(batch);
+        return true;
+    };
+
+    // Shared prefix: decoded once on seq 0, then referenced by every other sequence
+    const std::vector<llama_token>& lead = tokens_[wave.front()];
+    for (int start = 0; start < n_prefix; start += n_batch) {
+        if (start > 0 && should_stop && should_stop()) {
+            return abandon();
+        }
+        const int end = std::min(start + n_batch, n_prefix);
+        llama_batch_clear(batch);
+        for (int i = start; i < end; i++) {
+            llama_batch_add(batch, lead[i], i, { 0 }, false);
+        }
+        stats_.n_decode_calls++;
+        if (llama_decode(ctx, batch) != 0) {
+            return fail_all();
+        }
+    }
+    std::vector<Slot> slots(wave.size());
+    for (size_t s = 0; s < wave.size(); s++) {
+        slots[s] = Slot{ wave[s], (llama_seq_id) s, (llama_pos) n_prefix, 0, -1, true };
+        results_[wave[s]].n_prefix_shared = n_prefix;
+        if (s > 0 && n_prefix > 0) {
+            llama_kv_cache_seq_cp(ctx, 0, (llama_seq_id) s, -1, -1);
+        }
+    }
+    if (wave.size() > 1) {
+        stats_.n_prefill_tokens_saved += n_prefix * (int) (wave.size() - 1);
+    }
+
+    // Suffixes, packed across sequences into n_batch slices
+    size_t s = 0;
+    while (s < slots.size()) {
+        if (should_stop && should_stop()) {
+            return abandon();
+        }
+        llama_batch_clear(batch);
+        std::vector<size_t> completed;
+        while (s < slots.size() && batch.n_tokens < n_batch) {
+            Slot& slot = slots[s];
+            const std::vector<llama_token>& toks = tokens_[slot.item];
+            const int n_prompt = (int) toks.size();
+            while (slot.pos < n_prompt && batch.n_tokens < n_batch) {
+                llama_batch_add(batch, toks[slot.pos], slot.pos, { slot.seq }, slot.pos == n_prompt - 1);
+                slot.pos++;
+            }
+            if (slot.pos == n_prompt) {
+                slot.logits_idx = batch.n_tokens - 1;
+                completed.push_back(s);
+                s++;
+            }
+        }
+        stats_.n_decode_calls++;
+        if (llama_decode(ctx, batch) != 0) {
+            return fail_all();
+        }
+        for (size_t c : completed) {
+            Slot& slot = slots[c];
+            accept(slot, sample_greedy(ctx, llama_get_logits_ith(ctx, slot.logits_idx), n_vocab, candidates));
+        }
+    }
+
+    // Lockstep decode: one token per active sequence per call
+    while (true) {
+        llama_batch_clear(batch);
+        for (Slot& slot : slots) {
+            if (!slot.active) {
+                continue;
+            }
+            llama_batch_add(batch, slot.next, slot.pos, { slot.seq }, true);
+            slot.logits_idx = batch.n_tokens - 1;
+            slot.pos++;
+        }
+        if (batch.n_tokens == 0) {
+            break;
+        }
+        if (should_stop && should_stop()) {
+            return abandon();
+        }
+        stats_.n_decode_calls++;
+        if (llama_decode(ctx, batch) != 0) {
+            return fail_all();
+        }
+        for (Slot& slot : slots) {
+            if (slot.active) {
+                accept(slot, sample_greedy(ctx, llama_get_logits_ith(ctx, slot.logits_idx), n_vocab, candidates));
+            }
+        }
+    }
+
+    llama_kv_cache_clear(ctx);
+    llama_batch_free(batch);
+    return true;
+}
+
+void BatchGeneration::run(llama_context* ctx, const std::function<bool()>& should_stop) {
+    const int64_t t0 = now_us();
+    if (t_begin_us_ == 0) {
+        t_begin_us_ = t0;
+    }
+    if (budget_.empty()) {
+        budget_.resize(items_.size());
+        for (size_t i = 0; i < items_.size(); i++) {
+            budget_[i] = items_[i].params.max_tokens;
+        }
+    }
+
+    while (!done()) {
+        int n_prefix = 0;
+        std::vector<size_t> wave = plan_wave(ctx, n_prefix);
+        if (wave.empty()) {
+            break;
+        }
+        stats_.n_waves++;
+        if (!run_wave(ctx, wave, n_prefix, should_stop)) {
+            break;
+        }
+    }
+
+    stats_.t_total_us += now_us() - t0;
+    if (done()) {
+        LOGI("Batch of %d items: %d waves, %d decode calls, %d prefill tokens shared, %lld ms",
+             stats_.n_items, stats_.n_waves, stats_.n_decode_calls,
+             stats_.n_prefill_tokens_saved, (long long) stats_.t_total_us / 1000);
+    }
+}
+
+} // namespace smith
@@ -0,0 +1,95 @@
+/**
+ * batch_generate.h - Multi-sequence generation for queued work
+ * Guild of Smiths - Offline AI Module
+ *
+ * Runs many prompts as parallel sequences of one context: every decode
+ * call carries one token per active sequence, so a backlog costs roughly
+ * one generation's worth of weight reads instead of one per item.
+ *
+ * Items are processed in waves that fit the context (sequences and KV
+ * cells). Within a wave, prompts are sorted so neighbours share the most
+ * leading tokens; the wave's common prefix is decoded once and copied to
+ * the other sequences with llama_kv_cache_seq_cp.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "inference_core.h"
+
+namespace smith {
+
+struct BatchItem {
+    std::string prompt;
+    GenerationParams params;
+};
+
+struct BatchItemResult {
+    GenerationStatus status = GenerationStatus::OK;
+    bool finished = false;
+    std::string text;
+    int n_prompt_tokens = 0;
+    int n_prefix_shared = 0;      // prompt tokens decoded once for the whole wave
+    int n_generated = 0;
+    int64_t t_first_token_us = 0; // from the first run()
+    int64_t t_latency_us = 0;     // from the first run() to the item's last token
+};
+
+struct BatchStats {
+    int n_items = 0;
+    int n_waves = 0;
+    int n_decode_calls = 0;
+    int n_prefill_tokens_saved = 0;
+    int64_t t_total_us = 0;
+};
+
+class BatchGeneration {
+public:
+    BatchGeneration(llama_model* model, std::vector<BatchItem> items);
+
+    /** Tokenize every prompt. Items that fail are finished with TOKENIZE_FAILED. */
+    void start();
+
+    /**
+     * Generate all unfinished items, wave by wave. Returns early when
+     * should_stop fires: the current wave is dropped (its items rerun on
+     * the next call) and the context is left empty. Finished items keep
+     * their results.
+     */
+    void run(llama_context* ctx, const std::function<bool()>& should_stop);
+
+    bool done() const;
+    const std::vector<BatchItemResult>& results() const { return results_; }
+    const BatchStats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        size_t item;
+        llama_seq_id seq;
+        llama_pos pos;
+        llama_token next;
+        int32_t logits_idx;
+        bool active;
+    };
+
+    std::vector<size_t> plan_wave(llama_context* ctx, int& n_prefix);
+    bool run_wave(llama_context* ctx, const std::vector<size_t>& wave, int n_prefix,
+                  const std::function<bool()>& should_stop);
+    bool accept(Slot& slot, llama_token token);
+    void finish(size_t item, GenerationStatus status);
+
+    llama_model* model_;
+    std::vector<BatchItem> items_;
+    std::vector<std::vector<llama_token>> tokens_;
+    std::vector<size_t> order_;  // items sorted by prompt tokens
+    std::vector<int> budget_;    // max_tokens capped to what fits the context
+    std::vector<BatchItemResult> results_;
+    BatchStats stats_;
+    int64_t t_begin_us_ = 0;
+};
+
+} // namespace smith
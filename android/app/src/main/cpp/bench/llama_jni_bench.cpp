@@ -0,0 +1,459 @@
+/**
+ * llama_jni_bench.cpp - Native benchmark harness for the inference core
+ * Guild of Smiths - Offline AI Module
+ *
+ * Drives smith::generate() with app-shaped prompts so timings (and PGO
+ * profiles) reflect the tokenizer, prefill, sampler and decode paths the
+ * JNI bridge uses. Runs on device via adb or on a Linux host.
+ *
+ * With --worker, the same prompts go through a WorkerClient to a spawned
+ * smith_worker process instead, exercising the shared-memory transport.
+ *
+ * In-process runs also round-trip mesh-sized messages through the
+ * predictive codec and report how many bytes each one took.
+ *
+ * Comparing two builds: run one with --record FILE, which saves the
+ * thread count, context size, seed and every generated token id. Run the
+ * other with --replay FILE: it uses the same settings and forces the
+ * recorded tokens through the sampler loop (teacher forcing). Both builds
+ * then time the same work even where their logits differ; "diverged"
+ * counts the tokens the replaying build would have picked differently.
+ *
+ * Usage:
+ *   llama_jni_bench [--model PATH | --synthetic PATH] [--threads N]
+ *                   [--ctx N] [--tokens N] [--iterations N] [--worker PATH]
+ *                   [--seed N] [--record FILE | --replay FILE]
+ */
+
+#define LOG_TAG "LlamaBench"
+
+#include "../inference_core.h"
+#include "../inference_worker.h"
+#include "../native_log.h"
+#include "../predictive_codec.h"
+#include "synthetic_model.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "llama.h"
+
+// Same shapes AIRouter, AgentInitializer and PlanAgent send
+static const char* const BENCH_PROMPTS[] = {
+    "<|im_start|>system\nYou are Smith, a helpful AI assistant for construction and trade workers. "
+    "Keep responses brief, practical, and professional.<|im_end|>\n"
+    "<|im_start|>user\nwhere is the ladder<|im_end|>\n<|im_start|>assistant\n",
+
+    "<|im_start|>system\nYou are Smith. You're helping with job management. Focus on tasks, "
+    "materials, and timelines. Current job: Panel upgrade.<|im_end|>\n"
+    "<|im_start|>user\nmake a checklist for the breaker panel inspection<|im_end|>\n"
+    "<|im_start|>assistant\n",
+
+    "Context: CHAT\nMessage: \"need more conduit and wire on site by noon\"\n"
+    "Base assistance: \"Material request noted.\"\n\n"
+    "Provide a brief, contextual enhancement (max 50 words) that adds value without being verbose.",
+
+    "<|im_start|>system\nThis is an offline message via BLE mesh. Keep response under 100 words."
+    "<|im_end|>\n<|im_start|>user\nclock out crew for lunch, back at 1<|im_end|>\n"
+    "<|im_start|>assistant\n",
+};
+
+// Crew chatter MeshService would otherwise truncate to a beacon
+static const char* const BENCH_MESSAGES[] = {
+    "need more conduit on site",
+    "clock out for lunch, back at 1",
+    "breaker panel passed inspection",
+    "where is the ladder",
+};
+
+struct BenchArgs {
+    std::string model_path;
+    std::string synthetic_path;
+    int threads = 4;
+    int n_ctx = 2048;
+    int max_tokens = 64;
+    int iterations = 3;
+    std::string worker_path;
+    uint32_t seed = 42;
+    std::string record_path;
+    std::string replay_path;
+};
+
+static const int N_PROMPTS = (int) (sizeof(BENCH_PROMPTS) / sizeof(BENCH_PROMPTS[0]));
+
+// ════════════════════════════════════════════════════════════════════
+// RECORDED SESSIONS
+// ════════════════════════════════════════════════════════════════════
+
+// Text file, one "key values..." line each:
+//   smith-session 1
+//   model_size BYTES | threads N | ctx N | seed N
+//   prompt INDEX COUNT TOKEN...
+struct Session {
+    uint64_t model_size = 0;
+    int threads = 0;
+    int n_ctx = 0;
+    uint32_t seed = 0;
+    std::vector<std::vector<llama_token>> tokens;   // per prompt
+};
+
+static bool write_session(const std::string& path, const Session& session) {
+    std::ofstream out(path);
+    out << "smith-session 1\n"
+        << "model_size " << session.model_size << "\n"
+        << "threads " << session.threads << "\n"
+        << "ctx " << session.n_ctx << "\n"
+        << "seed " << session.seed << "\n";
+    for (size_t p = 0; p < session.tokens.size(); p++) {
+        out << "prompt " << p << " " << session.tokens[p].size();
+        for (llama_token t : session.tokens[p]) {
+            out << " " << t;
+        }
+        out << "\n";
+    }
+    return (bool) out;
+}
+
+static bool read_session(const std::string& path, Session& session) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != "smith-session 1") {
+        LOGE("%s is not a recorded session", path.c_str());
+        return false;
+    }
+    session.tokens.assign(N_PROMPTS, std::vector<llama_token>());
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "model_size") {
+            fields >> session.model_size;
+        } else if (key == "threads") {
+            fields >> session.threads;
+        } else if (key == "ctx") {
+            fields >> session.n_ctx;
+        } else if (key == "seed") {
+            fields >> session.seed;
+        } else if (key == "prompt") {
+            int index = -1;
+            size_t count = 0;
+            fields >> index >> count;
+            if (index < 0 || index >= N_PROMPTS) {
+                LOGE("Session prompt %d is not one of this build's prompts", index);
+                return false;
+            }
+            std::vector<llama_token>& tokens = session.tokens[index];
+            tokens.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                fields >> tokens[i];
+            }
+        }
+        if (!key.empty() && fields.fail()) {
+            LOGE("Malformed session line: %s", line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (uint64_t) st.st_size : 0;
+}
+
+// Settings and forced tokens from a recorded session; false if unusable
+static bool apply_replay(BenchArgs& args, Session& session) {
+    if (!read_session(args.replay_path, session)) {
+        return false;
+    }
+    if (session.model_size != file_size(args.model_path)) {
+        LOGW("Session was recorded with a different model file; expect divergence");
+    }
+    args.threads = session.threads;
+    args.n_ctx = session.n_ctx;
+    args.seed = session.seed;
+    return true;
+}
+
+static void set_forced(const BenchArgs& args, const Session& session, int prompt,
+                       smith::GenerationParams& params) {
+    if (!args.replay_path.empty()) {
+        params.forced_tokens = session.tokens[prompt];
+        params.max_tokens = (int) params.forced_tokens.size();   // a recorded empty answer stays empty
+    }
+}
+
+// Collects one completion at a time from a WorkerClient
+class BenchListener : public smith::EngineListener {
+public:
+    void on_text(uint64_t, const std::string&) override {}
+    void on_complete(uint64_t, const std::string&, const smith::GenerationStats& stats) override {
+        finish(true, stats);
+    }
+    void on_error(uint64_t, const std::string& error) override {
+        LOGE("Worker request failed: %s", error.c_str());
+        finish(false, smith::GenerationStats());
+    }
+    void on_batch_complete(uint64_t, const std::vector<smith::BatchItemResult>&,
+                           const smith::BatchStats&) override {}
+    void on_embeddings(uint64_t, int, const std::vector<float>&) override {}
+
+    bool wait(smith::GenerationStats& stats) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return done_; });
+        done_ = false;
+        stats = stats_;
+        return ok_;
+    }
+
+private:
+    void finish(bool ok, const smith::GenerationStats& stats) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ok_ = ok;
+        stats_ = stats;
+        done_ = true;
+        cv_.notify_one();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool done_ = false;
+    bool ok_ = false;
+    smith::GenerationStats stats_;
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--model PATH | --synthetic PATH] [--threads N] [--ctx N]\n"
+            "          [--tokens N] [--iterations N] [--worker PATH]\n"
+            "          [--seed N] [--record FILE | --replay FILE]\n", argv0);
+}
+
+static bool parse_args(int argc, char** argv, BenchArgs& args) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (strcmp(a, "--model") == 0 && has_value) {
+            args.model_path = argv[++i];
+        } else if (strcmp(a, "--synthetic") == 0 && has_value) {
+            args.synthetic_path = argv[++i];
+        } else if (strcmp(a, "--threads") == 0 && has_value) {
+            args.threads = atoi(argv[++i]);
+        } else if (strcmp(a, "--ctx") == 0 && has_value) {
+            args.n_ctx = atoi(argv[++i]);
+        } else if (strcmp(a, "--tokens") == 0 && has_value) {
+            args.max_tokens = atoi(argv[++i]);
+        } else if (strcmp(a, "--iterations") == 0 && has_value) {
+            args.iterations = atoi(argv[++i]);
+        } else if (strcmp(a, "--worker") == 0 && has_value) {
+            args.worker_path = argv[++i];
+        } else if (strcmp(a, "--seed") == 0 && has_value) {
+            args.seed = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(a, "--record") == 0 && has_value) {
+            args.record_path = argv[++i];
+        } else if (strcmp(a, "--replay") == 0 && has_value) {
+            args.replay_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    // Recording needs the token ids, which only an in-process run sees
+    if (!args.record_path.empty() && (!args.replay_path.empty() || !args.worker_path.empty())) {
+        return false;
+    }
+    return !args.model_path.empty() || !args.synthetic_path.empty();
+}
+
+struct BenchTotals {
+    int64_t tokenize_us = 0;
+    int64_t prefill_us = 0;
+    int64_t decode_us = 0;
+    long long prompt_tokens = 0;
+    long long generated = 0;
+    long long diverged = 0;
+
+    void add(const smith::GenerationStats& stats) {
+        tokenize_us += stats.t_tokenize_us;
+        prefill_us += stats.t_prefill_us;
+        decode_us += stats.t_decode_us;
+        prompt_tokens += stats.n_prompt_tokens;
+        generated += stats.n_generated;
+        diverged += stats.n_forced_diverged;
+    }
+};
+
+static void print_summary(const BenchArgs& args, const BenchTotals& t) {
+    printf("model:      %s\n", args.model_path.c_str());
+    printf("threads:    %d\n", args.threads);
+    printf("runs:       %d\n", args.iterations * N_PROMPTS);
+    printf("tokenize:   %.1f us/prompt\n",
+           (double) t.tokenize_us / (args.iterations * N_PROMPTS));
+    printf("prefill:    %.1f tok/s (%lld tokens)\n",
+           t.prefill_us > 0 ? t.prompt_tokens * 1e6 / t.prefill_us : 0.0, t.prompt_tokens);
+    printf("decode:     %.1f tok/s (%lld tokens)\n",
+           t.decode_us > 0 ? t.generated * 1e6 / t.decode_us : 0.0, t.generated);
+    if (!args.replay_path.empty()) {
+        printf("replay:     %s, seed %u, %lld of %lld tokens diverged\n",
+               args.replay_path.c_str(), args.seed, t.diverged, t.generated);
+    }
+}
+
+static void run_codec(llama_model* model, llama_context* ctx, const std::string& path) {
+    const uint8_t fingerprint = smith::model_fingerprint(model, file_size(path));
+    smith::ModelPredictor predictor(model, ctx, 0);
+
+    const int n = (int) (sizeof(BENCH_MESSAGES) / sizeof(BENCH_MESSAGES[0]));
+    size_t text_bytes = 0;
+    size_t frame_bytes = 0;
+    int64_t codec_us = 0;
+    for (int i = 0; i < n; i++) {
+        std::vector<uint8_t> frame;
+        std::string text;
+        std::string error;
+        const int64_t t0 = smith::now_us();
+        if (!smith::codec_encode(predictor, fingerprint, BENCH_MESSAGES[i], 0, frame, error) ||
+            !smith::codec_decode(predictor, fingerprint, frame.data(), frame.size(), text, error)) {
+            LOGE("Codec failed on message %d: %s", i, error.c_str());
+            continue;
+        }
+        codec_us += smith::now_us() - t0;
+        if (text != BENCH_MESSAGES[i]) {
+            LOGE("Codec round trip mismatch on message %d", i);
+            continue;
+        }
+        text_bytes += text.size();
+        frame_bytes += frame.size();
+    }
+    printf("codec:      %zu -> %zu bytes, %.1f ms/message round trip\n",
+           text_bytes, frame_bytes, codec_us / 1000.0 / n);
+}
+
+// Same prompts through a spawned worker process; also reports round-trip time
+static int run_worker(const BenchArgs& args, const Session& session) {
+    BenchListener listener;
+    std::unique_ptr<smith::WorkerClient> client = smith::WorkerClient::spawn(args.worker_path, listener);
+    if (!client || !client->load_model(args.model_path, args.n_ctx, args.threads)) {
+        LOGE("Worker %s could not load %s", args.worker_path.c_str(), args.model_path.c_str());
+        return 1;
+    }
+
+    smith::GenerationParams params;
+    params.max_tokens = args.max_tokens;
+    BenchTotals totals;
+    int64_t overhead_us = 0;
+    uint64_t id = 0;
+    for (int it = 0; it < args.iterations; it++) {
+        for (int p = 0; p < N_PROMPTS; p++) {
+            smith::GenerationStats stats;
+            set_forced(args, session, p, params);
+            const int64_t t0 = smith::now_us();
+            if (!client->submit(++id, BENCH_PROMPTS[p], params, true) || !listener.wait(stats)) {
+                LOGE("Generation failed on prompt %d", p);
+                continue;
+            }
+            overhead_us += smith::now_us() - t0 - stats.t_tokenize_us - stats.t_prefill_us - stats.t_decode_us;
+            totals.add(stats);
+        }
+    }
+
+    print_summary(args, totals);
+    printf("worker:     %.1f us/request outside the engine\n",
+           (double) overhead_us / (args.iterations * N_PROMPTS));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchArgs args;
+    if (!parse_args(argc, argv, args)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (args.model_path.empty()) {
+        if (!smith::write_synthetic_model(args.synthetic_path, smith::SyntheticModelConfig())) {
+            return 1;
+        }
+        args.model_path = args.synthetic_path;
+    }
+    Session session;
+    if (!args.replay_path.empty() && !apply_replay(args, session)) {
+        return 1;
+    }
+    if (!args.worker_path.empty()) {
+        return run_worker(args, session);
+    }
+
+    llama_backend_init();
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0;
+    llama_model* model = llama_load_model_from_file(args.model_path.c_str(), model_params);
+    if (model == nullptr) {
+        LOGE("Failed to load model %s", args.model_path.c_str());
+        llama_backend_free();
+        return 1;
+    }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = args.n_ctx;
+    ctx_params.n_threads = args.threads;
+    ctx_params.n_threads_batch = args.threads;
+    ctx_params.seed = args.seed;
+    llama_context* ctx = llama_new_context_with_model(model, ctx_params);
+    if (ctx == nullptr) {
+        LOGE("Failed to create context");
+        llama_free_model(model);
+        llama_backend_free();
+        return 1;
+    }
+
+    smith::GenerationParams params;
+    params.max_tokens = args.max_tokens;
+    BenchTotals totals;
+    Session recorded;
+    recorded.model_size = file_size(args.model_path);
+    recorded.threads = args.threads;
+    recorded.n_ctx = args.n_ctx;
+    recorded.seed = args.seed;
+    recorded.tokens.resize(N_PROMPTS);
+
+    for (int it = 0; it < args.iterations; it++) {
+        for (int p = 0; p < N_PROMPTS; p++) {
+            set_forced(args, session, p, params);
+            smith::Generation gen(model, params, 0);
+            if (gen.start(BENCH_PROMPTS[p]) != smith::GenerationStatus::OK ||
+                gen.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK) {
+                LOGE("Generation failed on prompt %d", p);
+                continue;
+            }
+            totals.add(gen.stats());
+            if (it == 0) {
+                recorded.tokens[p] = gen.generated_tokens();
+            }
+        }
+    }
+
+    print_summary(args, totals);
+    if (!args.record_path.empty()) {
+        if (!write_session(args.record_path, recorded)) {
+            LOGE("Cannot write %s", args.record_path.c_str());
+        } else {
+            printf("recorded:   %s\n", args.record_path.c_str());
+        }
+    }
+    run_codec(model, ctx, args.model_path);
+
+    llama_free(ctx);
+    llama_free_model(model);
+    llama_backend_free();
+    return 0;
+}
@@ -0,0 +1,221 @@
+/**
+ * synthetic_model.cpp - Tiny random-weight GGUF models for benchmarks and tests
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "SyntheticModel"
+
+#include "synthetic_model.h"
+#include "../native_log.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ggml.h"
+
+namespace smith {
+
+// SPM token types (llama_token_type)
+static const int32_t TOKEN_NORMAL = 1;
+static const int32_t TOKEN_UNKNOWN = 2;
+static const int32_t TOKEN_CONTROL = 3;
+static const int32_t TOKEN_BYTE = 6;
+
+// Vocabulary the benchmark prompts are written in
+static const char* const TRADE_WORDS[] = {
+    "the", "a", "to", "and", "of", "is", "in", "on", "at", "for", "with", "we",
+    "need", "more", "where", "when", "what", "how", "can", "you", "check",
+    "job", "site", "crew", "clock", "in", "out", "break", "lunch", "noon",
+    "ladder", "wire", "pipe", "panel", "breaker", "outlet", "conduit", "drywall",
+    "stud", "joist", "beam", "nail", "screw", "drill", "saw", "paint", "primer",
+    "valve", "fitting", "duct", "vent", "permit", "inspection", "code", "safety",
+    "hour", "hours", "today", "tomorrow", "material", "materials", "order",
+    "done", "finished", "start", "plan", "task", "tasks", "list", "report",
+    "plumbing", "electrical", "hvac", "carpentry", "framing", "roof", "floor",
+    "Smith", "assistant", "system", "user", "answer", "question", "brief",
+};
+
+static void fill_vocab(std::vector<std::string>& tokens,
+                       std::vector<float>& scores,
+                       std::vector<int32_t>& types) {
+    tokens = { "<unk>", "<s>", "</s>" };
+    scores = { 0.0f, 0.0f, 0.0f };
+    types = { TOKEN_UNKNOWN, TOKEN_CONTROL, TOKEN_CONTROL };
+
+    char buf[8];
+    for (int b = 0; b < 256; b++) {
+        snprintf(buf, sizeof(buf), "<0x%02X>", b);
+        tokens.emplace_back(buf);
+        scores.push_back(0.0f);
+        types.push_back(TOKEN_BYTE);
+    }
+
+    // Word pieces with and without the SPM space marker, longer pieces score higher
+    float score = -1.0f;
+    for (const char* word : TRADE_WORDS) {
+        for (int spaced = 1; spaced >= 0; spaced--) {
+            std::string piece = spaced ? std::string("\xE2\x96\x81") + word : std::string(word);
+            bool dup = false;
+            for (const auto& t : tokens) {
+                if (t == piece) { dup = true; break; }
+            }
+            if (dup) continue;
+            tokens.push_back(piece);
+            scores.push_back(score);
+            types.push_back(TOKEN_NORMAL);
+            score -= 0.01f;
+        }
+    }
+
+    // Single characters so any ASCII text tokenizes without byte fallback
+    for (char c = ' '; c <= '~'; c++) {
+        std::string piece = c == ' ' ? std::string("\xE2\x96\x81") : std::string(1, c);
+        bool dup = false;
+        for (const auto& t : tokens) {
+            if (t == piece) { dup = true; break; }
+        }
+        if (dup) continue;
+        tokens.push_back(piece);
+        scores.push_back(-100.0f);
+        types.push_back(TOKEN_NORMAL);
+    }
+}
+
+struct TensorFactory {
+    ggml_context* ctx;
+    gguf_context* gguf;
+    std::mt19937 rng;
+    ggml_type weight_type;
+
+    ggml_tensor* add(const char* name, int64_t ne0, int64_t ne1, bool weight) {
+        const int64_t n = ne0 * ne1;
+        std::vector<float> values(n);
+        if (weight) {
+            std::normal_distribution<float> dist(0.0f, 0.02f);
+            for (auto& v : values) v = dist(rng);
+        } else {
+            std::fill(values.begin(), values.end(), 1.0f);
+        }
+
+        const bool quant = weight && weight_type != GGML_TYPE_F32 && ne1 > 1 && ne0 % 256 == 0;
+        const ggml_type type = quant ? weight_type : GGML_TYPE_F32;
+
+        ggml_tensor* t = ne1 > 1
+            ? ggml_new_tensor_2d(ctx, type, ne0, ne1)
+            : ggml_new_tensor_1d(ctx, type, ne0);
+        ggml_set_name(t, name);
+
+        if (quant) {
+            ggml_quantize_chunk(type, values.data(), t->data, 0, ne1, ne0, nullptr);
+        } else {
+            memcpy(t->data, values.data(), n * sizeof(float));
+        }
+        gguf_add_tensor(gguf, t);
+        return t;
+    }
+};
+
+// ggml type and general.file_type (llama_ftype) for each weight storage
+static void weight_format(SyntheticWeights weights, ggml_type& type, uint32_t& file_type) {
+    switch (weights) {
+        case SyntheticWeights::Q4_0: type = GGML_TYPE_Q4_0; file_type = 2;  return;  // MOSTLY_Q4_0
+        case SyntheticWeights::Q4_K: type = GGML_TYPE_Q4_K; file_type = 15; return;  // MOSTLY_Q4_K_M
+        case SyntheticWeights::F32:  break;
+    }
+    type = GGML_TYPE_F32;
+    file_type = 0;  // ALL_F32
+}
+
+bool write_synthetic_model(const std::string& path, const SyntheticModelConfig& config) {
+    std::vector<std::string> tokens;
+    std::vector<float> scores;
+    std::vector<int32_t> types;
+    fill_vocab(tokens, scores, types);
+    const int n_vocab = (int) tokens.size();
+
+    const int n_embd = config.n_embd;
+    const int n_embd_kv = n_embd / config.n_head * config.n_head_kv;
+
+    // F32 upper bound for every tensor plus per-tensor overhead
+    const int64_t n_params =
+        2LL * n_vocab * n_embd + n_embd +
+        (int64_t) config.n_layer * (2LL * n_embd + 2LL * n_embd * n_embd +
+                                    2LL * n_embd * n_embd_kv + 3LL * n_embd * config.n_ff);
+    ggml_init_params params = {
+        (size_t) n_params * sizeof(float) + (size_t) (16 + 9 * config.n_layer) * ggml_tensor_overhead(),
+        nullptr,
+        false,
+    };
+    ggml_context* ctx = ggml_init(params);
+    if (ctx == nullptr) {
+        LOGE("ggml_init failed for %lld params", (long long) n_params);
+        return false;
+    }
+
+    gguf_context* gguf = gguf_init_empty();
+    gguf_set_val_str(gguf, "general.architecture", "llama");
+    gguf_set_val_str(gguf, "general.name", "smith-synthetic");
+    ggml_type weight_type;
+    uint32_t file_type;
+    weight_format(config.weights, weight_type, file_type);
+    gguf_set_val_u32(gguf, "general.file_type", file_type);
+    gguf_set_val_u32(gguf, "llama.context_length", config.n_ctx_train);
+    gguf_set_val_u32(gguf, "llama.embedding_length", n_embd);
+    gguf_set_val_u32(gguf, "llama.block_count", config.n_layer);
+    gguf_set_val_u32(gguf, "llama.feed_forward_length", config.n_ff);
+    gguf_set_val_u32(gguf, "llama.attention.head_count", config.n_head);
+    gguf_set_val_u32(gguf, "llama.attention.head_count_kv", config.n_head_kv);
+    gguf_set_val_u32(gguf, "llama.rope.dimension_count", n_embd / config.n_head);
+    gguf_set_val_f32(gguf, "llama.attention.layer_norm_rms_epsilon", 1e-5f);
+    gguf_set_val_u32(gguf, "llama.vocab_size", n_vocab);
+
+    std::vector<const char*> token_ptrs;
+    token_ptrs.reserve(tokens.size());
+    for (const auto& t : tokens) token_ptrs.push_back(t.c_str());
+    gguf_set_val_str(gguf, "tokenizer.ggml.model", "llama");
+    gguf_set_arr_str(gguf, "tokenizer.ggml.tokens", token_ptrs.data(), n_vocab);
+    gguf_set_arr_data(gguf, "tokenizer.ggml.scores", GGUF_TYPE_FLOAT32, scores.data(), n_vocab);
+    gguf_set_arr_data(gguf, "tokenizer.ggml.token_type", GGUF_TYPE_INT32, types.data(), n_vocab);
+    gguf_set_val_u32(gguf, "tokenizer.ggml.unknown_token_id", 0);
+    gguf_set_val_u32(gguf, "tokenizer.ggml.bos_token_id", 1);
+    gguf_set_val_u32(gguf, "tokenizer.ggml.eos_token_id", 2);
+    gguf_set_val_bool(gguf, "tokenizer.ggml.add_bos_token", true);
+
+    TensorFactory f{ ctx, gguf, std::mt19937(config.seed), weight_type };
+    f.add("token_embd.weight", n_embd, n_vocab, true);
+    f.add("output_norm.weight", n_embd, 1, false);
+    f.add("output.weight", n_embd, n_vocab, true);
+
+    char name[64];
+    for (int il = 0; il < config.n_layer; il++) {
+        snprintf(name, sizeof(name), "blk.%d.attn_norm.weight", il);
+        f.add(name, n_embd, 1, false);
+        snprintf(name, sizeof(name), "blk.%d.attn_q.weight", il);
+        f.add(name, n_embd, n_embd, true);
+        snprintf(name, sizeof(name), "blk.%d.attn_k.weight", il);
+        f.add(name, n_embd, n_embd_kv, true);
+        snprintf(name, sizeof(name), "blk.%d.attn_v.weight", il);
+        f.add(name, n_embd, n_embd_kv, true);
+        snprintf(name, sizeof(name), "blk.%d.attn_output.weight", il);
+        f.add(name, n_embd, n_embd, true);
+        snprintf(name, sizeof(name), "blk.%d.ffn_norm.weight", il);
+        f.add(name, n_embd, 1, false);
+        snprintf(name, sizeof(name), "blk.%d.ffn_gate.weight", il);
+        f.add(name, n_embd, config.n_ff, true);
+        snprintf(name, sizeof(name), "blk.%d.ffn_up.weight", il);
+        f.add(name, n_embd, config.n_ff, true);
+        snprintf(name, sizeof(name), "blk.%d.ffn_down.weight", il);
+        f.add(name, config.n_ff, n_embd, true);
+    }
+
+    gguf_write_to_file(gguf, path.c_str(), false);
+    gguf_free(gguf);
+    ggml_free(ctx);
+
+    LOGI("Wrote synthetic model %s (vocab %d, embd %d, layers %d)",
+         path.c_str(), n_vocab, n_embd, config.n_layer);
+    return true;
+}
+
+} // namespace smith
@@ -0,0 +1,39 @@
+/**
+ * synthetic_model.h - Tiny random-weight GGUF models for benchmarks and tests
+ * Guild of Smiths - Offline AI Module
+ *
+ * Writes a llama-architecture GGUF with an SPM vocabulary (byte fallback plus
+ * trade words) so the real tokenizer, quantized matmul and sampler paths run
+ * without shipping a 1 GB model. Output quality is meaningless; the work
+ * per token is representative.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace smith {
+
+// Storage of the 2-D weight matrices; norms are always F32
+enum class SyntheticWeights {
+    F32,
+    Q4_0,   // like the catalog downloads, which model repacking converts
+    Q4_K,   // like q4_k_m files
+};
+
+struct SyntheticModelConfig {
+    int n_embd = 256;      // multiple of 256 so K-quants apply
+    int n_ff = 512;
+    int n_layer = 4;
+    int n_head = 4;
+    int n_head_kv = 4;
+    int n_ctx_train = 2048;
+    SyntheticWeights weights = SyntheticWeights::Q4_K;
+    uint32_t seed = 42;
+};
+
+/** Write the model to path. Returns false on failure. */
+bool write_synthetic_model(const std::string& path, const SyntheticModelConfig& config);
+
+} // namespace smith
@@ -0,0 +1,218 @@
+/**
+ * checkpoint.cpp - On-disk checkpoints of in-flight generations
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "Checkpoint"
+
+#include "checkpoint.h"
+#include "native_log.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smith {
+
+static const char CHECKPOINT_MAGIC[4] = { 'S', 'C', 'K', 'P' };
+static const uint32_t CHECKPOINT_VERSION = 1;
+static const char* const CHECKPOINT_SUFFIX = ".ckpt";
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    // Magic static: built once even when the prefix cache and checkpoints race to first use
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Streams fields to a file while keeping the running CRC
+class Writer {
+public:
+    explicit Writer(FILE* f) : f_(f) {}
+
+    void bytes(const void* data, size_t size) {
+        if (!ok_ || size == 0) return;
+        crc_ = crc32_update(crc_, static_cast<const uint8_t*>(data), size);
+        ok_ = fwrite(data, 1, size, f_) == size;
+    }
+    template <typename T> void pod(const T& v) { bytes(&v, sizeof(v)); }
+    void str(const std::string& s) {
+        pod((uint32_t) s.size());
+        bytes(s.data(), s.size());
+    }
+    bool finish() {
+        const uint32_t crc = crc_;
+        ok_ = ok_ && fwrite(&crc, sizeof(crc), 1, f_) == 1;
+        return ok_;
+    }
+
+private:
+    FILE* f_;
+    uint32_t crc_ = 0;
+    bool ok_ = true;
+};
+
+// Bounds-checked cursor over a whole file in memory
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    bool bytes(void* out, size_t size) {
+        if ((size_t) (end_ - p_) < size) return false;
+        memcpy(out, p_, size);
+        p_ += size;
+        return true;
+    }
+    template <typename T> bool pod(T& v) { return bytes(&v, sizeof(v)); }
+    bool str(std::string& s) {
+        uint32_t n = 0;
+        if (!pod(n) || (size_t) (end_ - p_) < n) return false;
+        s.assign(reinterpret_cast<const char*>(p_), n);
+        p_ += n;
+        return true;
+    }
+    bool at_end() const { return p_ == end_; }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+};
+
+bool write_checkpoint(const std::string& path, const GenerationCheckpoint& cp) {
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        LOGE("Cannot create %s", tmp.c_str());
+        return false;
+    }
+
+    Writer w(f);
+    w.bytes(CHECKPOINT_MAGIC, 4);
+    w.pod(CHECKPOINT_VERSION);
+    w.str(cp.key);
+    w.str(cp.model_path);
+    w.pod(cp.model_size);
+    w.pod((int32_t) cp.max_tokens);
+    w.pod(cp.temperature);
+    w.pod(cp.rng_state);
+    w.pod((int32_t) cp.n_prompt);
+    w.pod((uint32_t) cp.tokens.size());
+    w.bytes(cp.tokens.data(), cp.tokens.size() * sizeof(int32_t));
+    w.pod((uint64_t) cp.kv.size());
+    w.bytes(cp.kv.data(), cp.kv.size());
+
+    // The rename must not overtake the data, or a crash could leave a torn file under the real name
+    bool ok = w.finish() && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        LOGE("Writing checkpoint %s failed", path.c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_checkpoint(const std::string& path, GenerationCheckpoint& cp) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 && st.st_size > 8) {
+        data.resize((size_t) st.st_size);
+        if (fread(data.data(), 1, data.size(), f) != data.size()) {
+            data.clear();
+        }
+    }
+    fclose(f);
+    if (data.size() < 12) {
+        return false;
+    }
+
+    uint32_t stored_crc = 0;
+    memcpy(&stored_crc, data.data() + data.size() - 4, 4);
+    if (crc32_update(0, data.data(), data.size() - 4) != stored_crc) {
+        LOGW("Checkpoint %s is corrupt", path.c_str());
+        return false;
+    }
+
+    Reader r(data.data(), data.size() - 4);
+    char magic[4];
+    uint32_t version = 0;
+    int32_t max_tokens = 0;
+    int32_t n_prompt = 0;
+    uint32_t n_tokens = 0;
+    uint64_t kv_size = 0;
+    if (!r.bytes(magic, 4) || memcmp(magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        !r.pod(version) || version != CHECKPOINT_VERSION ||
+        !r.str(cp.key) || !r.str(cp.model_path) || !r.pod(cp.model_size) ||
+        !r.pod(max_tokens) || !r.pod(cp.temperature) || !r.pod(cp.rng_state) ||
+        !r.pod(n_prompt) || !r.pod(n_tokens)) {
+        return false;
+    }
+    cp.tokens.resize(n_tokens);
+    if (!r.bytes(cp.tokens.data(), (size_t) n_tokens * sizeof(int32_t)) || !r.pod(kv_size)) {
+        return false;
+    }
+    cp.kv.resize((size_t) kv_size);
+    if (!r.bytes(cp.kv.data(), cp.kv.size()) || !r.at_end()) {
+        return false;
+    }
+    cp.max_tokens = max_tokens;
+    cp.n_prompt = n_prompt;
+    return n_prompt > 0 && n_prompt <= (int32_t) n_tokens;
+}
+
+std::string checkpoint_path(const std::string& dir, const std::string& key) {
+    // FNV-1a keeps arbitrary keys out of the file system namespace
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : key) {
+        h = (h ^ c) * 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) h);
+    return dir + "/" + name + CHECKPOINT_SUFFIX;
+}
+
+std::vector<std::string> list_checkpoints(const std::string& dir) {
+    std::vector<std::string> keys;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return keys;
+    }
+    const size_t suffix_len = strlen(CHECKPOINT_SUFFIX);
+    while (struct dirent* e = readdir(d)) {
+        const std::string name = e->d_name;
+        if (name.size() <= suffix_len ||
+            name.compare(name.size() - suffix_len, suffix_len, CHECKPOINT_SUFFIX) != 0) {
+            continue;
+        }
+        GenerationCheckpoint cp;
+        if (read_checkpoint(dir + "/" + name, cp)) {
+            keys.push_back(cp.key);
+        }
+    }
+    closedir(d);
+    return keys;
+}
+
+} // namespace smith
@@ -0,0 +1,58 @@
+/**
+ * checkpoint.h - On-disk checkpoints of in-flight generations
+ * Guild of Smiths - Offline AI Module
+ *
+ * A checkpoint holds everything needed to continue a generation in a new
+ * process: the request (key, parameters, sampler state), every token so
+ * far and the sequence's KV cells. Resuming restores the cells and
+ * re-decodes only the last token for its logits, so neither the prompt
+ * nor any generated token is computed again.
+ *
+ * File layout (little-endian), written to "<path>.tmp" and renamed:
+ *   "SCKP" | u32 version
+ *   str key | str model_path | u64 model_size
+ *   i32 max_tokens | f32 temperature | u64 rng_state
+ *   i32 n_prompt | u32 n_tokens | i32 tokens[n_tokens]
+ *   u64 kv_size | kv bytes
+ *   u32 crc32 of everything before it
+ * where str is u32 length + bytes. A torn or foreign file fails the CRC
+ * and is ignored.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+struct GenerationCheckpoint {
+    std::string key;               // caller's stable name for the request
+    std::string model_path;        // checkpoint is only valid for this model file
+    uint64_t model_size = 0;
+    int max_tokens = 0;
+    float temperature = 0.0f;
+    uint64_t rng_state = 0;        // sampler state; 0 while sampling is greedy
+    int n_prompt = 0;
+    std::vector<int32_t> tokens;   // prompt then generated
+    std::vector<uint8_t> kv;       // llama_state_seq_get_data of the sequence
+};
+
+/** Write atomically (temp file, fsync, rename). */
+bool write_checkpoint(const std::string& path, const GenerationCheckpoint& cp);
+
+/** Read and validate; false if missing, torn or malformed. */
+bool read_checkpoint(const std::string& path, GenerationCheckpoint& cp);
+
+/** File name for a request key inside a checkpoint directory. */
+std::string checkpoint_path(const std::string& dir, const std::string& key);
+
+/** Keys of all readable checkpoints in dir. */
+std::vector<std::string> list_checkpoints(const std::string& dir);
+
+/** CRC-32 (IEEE) of data, continuing from crc; 0 to start. Safe from any thread. */
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size);
+
+} // namespace smith
@@ -0,0 +1,733 @@
+/**
+ * engine.cpp - Asynchronous generation engine
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "LlamaEngine"
+
+#include "engine.h"
+#include "checkpoint.h"
+#include "native_log.h"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace smith {
+
+// Parallel sequences per batch wave; KV cells are shared, so this only
+// bounds bookkeeping, not memory
+static const uint32_t MAX_BATCH_SEQUENCES = 8;
+
+// Host memory for warmed prompt prefixes (a few system prompts of a 1-2B model)
+static const size_t PREFIX_CACHE_BYTES = 64u * 1024 * 1024;
+
+// Messages are short; anything longer is represented by its start
+static const int EMBED_MAX_TOKENS = 256;
+
+// Decoding time between checkpoints; each one writes the sequence's KV cells
+static const int64_t CHECKPOINT_INTERVAL_US = 20 * 1000 * 1000;
+
+Engine::Engine(EngineListener& listener)
+    : listener_(listener), prefix_cache_(PREFIX_CACHE_BYTES) {
+    worker_ = std::thread(&Engine::worker_loop, this);
+}
+
+Engine::~Engine() {
+    cancel_all();
+    running_.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_cv_.notify_one();
+    worker_.join();
+    unload_model();
+}
+
+// ════════════════════════════════════════════════════════════════════
+// MODEL LIFETIME
+// ════════════════════════════════════════════════════════════════════
+
+bool Engine::load_model(const std::string& path, int n_ctx, int n_threads) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+
+    publish_status(ModelStatus());
+    model_serial_++;
+    prefix_cache_.clear();
+    if (ctx_ != nullptr) {
+        llama_free(ctx_);
+        ctx_ = nullptr;
+    }
+    if (model_ != nullptr) {
+        llama_free_model(model_);
+        model_ = nullptr;
+    }
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0; // CPU only for mobile
+
+    model_ = llama_load_model_from_file(path.c_str(), model_params);
+    if (model_ == nullptr) {
+        LOGE("Failed to load model from: %s", path.c_str());
+        return false;
+    }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = n_ctx > 0 ? n_ctx : 2048;
+    ctx_params.n_threads = n_threads > 0 ? n_threads : 4;
+    ctx_params.n_threads_batch = n_threads > 0 ? n_threads : 4;
+    ctx_params.n_seq_max = MAX_BATCH_SEQUENCES;
+
+    ctx_ = llama_new_context_with_model(model_, ctx_params);
+    if (ctx_ == nullptr) {
+        LOGE("Failed to create context");
+        llama_free_model(model_);
+        model_ = nullptr;
+        return false;
+    }
+
+    struct stat st;
+    model_path_ = path;
+    model_size_ = stat(path.c_str(), &st) == 0 ? (uint64_t) st.st_size : 0;
+    prefix_cache_.set_model(model_path_, model_size_);
+
+    ModelStatus status;
+    status.loaded = true;
+    status.n_vocab = llama_n_vocab(model_);
+    status.n_ctx = (int) llama_n_ctx(ctx_);
+    status.n_embd = llama_n_embd(model_);
+    publish_status(status);
+    LOGI("Model loaded. Context size: %d, Threads: %d", n_ctx, n_threads);
+    return true;
+}
+
+void Engine::unload_model() {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    publish_status(ModelStatus());
+    model_serial_++;
+    prefix_cache_.clear();
+    prefix_cache_.set_model(std::string(), 0);
+    if (ctx_ != nullptr) {
+        llama_free(ctx_);
+        ctx_ = nullptr;
+    }
+    if (model_ != nullptr) {
+        llama_free_model(model_);
+        model_ = nullptr;
+    }
+}
+
+void Engine::set_checkpoint_dir(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    checkpoint_dir_ = dir;
+}
+
+void Engine::set_prefix_cache_dir(const std::string& dir, size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    prefix_cache_.set_disk_dir(dir, max_bytes);
+}
+
+bool InferenceBackend::model_info(int& n_vocab, int& n_ctx, int& n_embd) const {
+    const std::shared_ptr<const ModelStatus> snapshot = status();
+    if (!snapshot->loaded) {
+        return false;
+    }
+    n_vocab = snapshot->n_vocab;
+    n_ctx = snapshot->n_ctx;
+    n_embd = snapshot->n_embd;
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// SUBMISSION (any thread)
+// ════════════════════════════════════════════════════════════════════
+
+void Engine::push(Command* cmd) {
+    Command* head = inbox_.load(std::memory_order_relaxed);
+    do {
+        cmd->next = head;
+    } while (!inbox_.compare_exchange_weak(head, cmd,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+    // Empty critical section orders the push before a worker that is about to sleep
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_cv_.notify_one();
+}
+
+bool Engine::push_new(Command* cmd) {
+    if (!running_.load(std::memory_order_acquire)) {
+        delete cmd;
+        return false;
+    }
+    cmd->epoch = cancel_epoch_.load(std::memory_order_acquire);
+    push(cmd);
+    return true;
+}
+
+bool Engine::submit(uint64_t id, const std::string& prompt, const GenerationParams& params,
+                    bool stream, Priority priority, const std::string& checkpoint_key) {
+    Command* cmd = new Command();
+    cmd->kind = Command::GENERATE;
+    cmd->id = id;
+    cmd->prompt = prompt;
+    cmd->params = params;
+    cmd->stream = stream;
+    cmd->priority = priority;
+    cmd->checkpoint_key = checkpoint_key;
+    return push_new(cmd);
+}
+
+bool Engine::submit_batch(uint64_t id, std::vector<BatchItem> items, Priority priority) {
+    Command* cmd = new Command();
+    cmd->kind = Command::BATCH;
+    cmd->id = id;
+    cmd->batch = std::move(items);
+    cmd->priority = priority;
+    return push_new(cmd);
+}
+
+bool Engine::submit_warm(uint64_t id, const std::string& prompt, Priority priority) {
+    Command* cmd = new Command();
+    cmd->kind = Command::WARM;
+    cmd->id = id;
+    cmd->prompt = prompt;
+    cmd->priority = priority;
+    return push_new(cmd);
+}
+
+bool Engine::submit_embed(uint64_t id, std::vector<std::string> texts, Priority priority) {
+    Command* cmd = new Command();
+    cmd->kind = Command::EMBED;
+    cmd->id = id;
+    cmd->texts = std::move(texts);
+    cmd->priority = priority;
+    return push_new(cmd);
+}
+
+bool Engine::submit_codec(uint64_t id, CodecOp op, const std::string& data, size_t max_bytes,
+                          Priority priority) {
+    Command* cmd = new Command();
+    cmd->kind = Command::CODEC;
+    cmd->id = id;
+    cmd->codec_op = op;
+    cmd->prompt = data;
+    cmd->max_bytes = max_bytes;
+    cmd->priority = priority;
+    return push_new(cmd);
+}
+
+void Engine::cancel(uint64_t id) {
+    Command* cmd = new Command();
+    cmd->kind = Command::CANCEL;
+    cmd->id = id;
+    push(cmd);
+}
+
+void Engine::cancel_all() {
+    cancel_epoch_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// WORKER
+// ════════════════════════════════════════════════════════════════════
+
+void Engine::drain_inbox() {
+    Command* list = inbox_.exchange(nullptr, std::memory_order_acquire);
+    if (list == nullptr) {
+        return;
+    }
+
+    // The stack is newest-first; restore submission order
+    Command* ordered = nullptr;
+    while (list != nullptr) {
+        Command* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered != nullptr) {
+        Command* cmd = ordered;
+        ordered = ordered->next;
+
+        if (cmd->kind != Command::CANCEL) {
+            pending_[(int) cmd->priority].push_back(cmd);
+            continue;
+        }
+
+        if (cmd->id == current_id_) {
+            current_cancelled_ = true;
+            delete cmd;
+            continue;
+        }
+        bool found = false;
+        for (auto& queue : pending_) {
+            auto it = std::find_if(queue.begin(), queue.end(),
+                                   [cmd](const Command* c) { return c->id == cmd->id; });
+            if (it != queue.end()) {
+                drop_checkpoint(**it);
+                listener_.on_error((*it)->id, "Cancelled");
+                delete *it;
+                queue.erase(it);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            // A preempted request keeps what it generated, as a running one would
+            auto it = std::find_if(suspended_.begin(), suspended_.end(),
+                                   [cmd](const Job& j) { return j.cmd->id == cmd->id; });
+            if (it != suspended_.end()) {
+                if (it->batch) {
+                    listener_.on_batch_complete(it->cmd->id, it->batch->results(), it->batch->stats());
+                } else {
+                    drop_checkpoint(*it->cmd);
+                    listener_.on_complete(it->cmd->id, it->gen->text(), it->gen->stats());
+                }
+                suspended_.erase(it);
+            }
+        }
+        delete cmd;
+    }
+}
+
+int Engine::highest_pending() const {
+    for (int p = PRIORITY_COUNT - 1; p >= 0; p--) {
+        if (!pending_[p].empty()) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+bool Engine::should_stop(const Command& req) {
+    // One relaxed load when nothing new has arrived
+    if (inbox_.load(std::memory_order_relaxed) != nullptr) {
+        drain_inbox();
+        if (highest_pending() > current_priority_) {
+            preempt_ = true;
+        }
+    }
+    return current_cancelled_ || preempt_ ||
+           req.epoch != cancel_epoch_.load(std::memory_order_acquire);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// CHECKPOINTS (worker, model_mutex_ held except for drop)
+// ════════════════════════════════════════════════════════════════════
+
+std::string Engine::checkpoint_file(const Command& req) const {
+    if (req.checkpoint_key.empty() || checkpoint_dir_.empty()) {
+        return std::string();
+    }
+    return checkpoint_path(checkpoint_dir_, req.checkpoint_key);
+}
+
+void Engine::restore_checkpoint(Job& job) {
+    const Command& req = *job.cmd;
+    const std::string path = checkpoint_file(req);
+    GenerationCheckpoint cp;
+    if (path.empty() || !read_checkpoint(path, cp)) {
+        return;
+    }
+    // Cells from another model or a request that has since changed are useless
+    if (cp.key != req.checkpoint_key || cp.model_path != model_path_ ||
+        cp.model_size != model_size_ || cp.max_tokens != req.params.max_tokens ||
+        !job.gen->restore_state(ctx_, cp)) {
+        LOGW("Discarding stale checkpoint for %s", req.checkpoint_key.c_str());
+        unlink(path.c_str());
+        return;
+    }
+    job.checkpoint_tokens = (int) cp.tokens.size();
+    LOGI("Request %llu resumed from checkpoint: %d tokens restored, %d already generated",
+         (unsigned long long) req.id, job.gen->stats().n_restored, job.gen->stats().n_generated);
+}
+
+void Engine::save_checkpoint(Job& job) {
+    const Command& req = *job.cmd;
+    if (req.checkpoint_key.empty() || now_us() - job.checkpoint_us < CHECKPOINT_INTERVAL_US) {
+        return;
+    }
+    const GenerationStats& stats = job.gen->stats();
+    const int n_tokens = stats.n_prompt_tokens + stats.n_generated;
+    const std::string path = checkpoint_file(req);
+    if (path.empty() || n_tokens == job.checkpoint_tokens) {
+        return;
+    }
+
+    GenerationCheckpoint cp;
+    cp.key = req.checkpoint_key;
+    cp.model_path = model_path_;
+    cp.model_size = model_size_;
+    cp.max_tokens = req.params.max_tokens;
+    cp.temperature = req.params.temperature;
+    cp.rng_state = 0;  // sampling is greedy
+    if (!job.gen->save_state(ctx_, cp)) {
+        return;  // still in prefill; try again on the next poll
+    }
+
+    const int64_t t0 = now_us();
+    job.checkpoint_us = t0;
+    if (write_checkpoint(path, cp)) {
+        job.checkpoint_tokens = n_tokens;
+        LOGI("Request %llu checkpointed at %d tokens (%zu KB in %lld us)",
+             (unsigned long long) req.id, n_tokens, cp.kv.size() / 1024,
+             (long long) (now_us() - t0));
+    }
+}
+
+void Engine::drop_checkpoint(const Command& req) {
+    const std::string path = checkpoint_file(req);
+    if (!path.empty()) {
+        unlink(path.c_str());
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// SCHEDULING
+// ════════════════════════════════════════════════════════════════════
+
+bool Engine::take_next(Job& job) {
+    // A preempted job goes before queued work of its own class: it arrived first
+    const int best = highest_pending();
+    if (!suspended_.empty() && (int) suspended_.back().cmd->priority >= best) {
+        job = std::move(suspended_.back());
+        suspended_.pop_back();
+        return true;
+    }
+    if (best < 0) {
+        return false;
+    }
+    job.cmd.reset(pending_[best].front());
+    pending_[best].pop_front();
+    return true;
+}
+
+bool Engine::begin(Command& req) {
+    if (req.epoch != cancel_epoch_.load(std::memory_order_acquire)) {
+        listener_.on_error(req.id, "Cancelled");
+        return false;
+    }
+    if (model_ == nullptr || ctx_ == nullptr) {
+        listener_.on_error(req.id, "Model not loaded");
+        return false;
+    }
+    current_id_ = req.id;
+    current_priority_ = (int) req.priority;
+    current_cancelled_ = false;
+    preempt_ = highest_pending() > current_priority_;
+    return true;
+}
+
+void Engine::execute_warm(Command& req) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (!begin(req)) {
+        return;
+    }
+
+    GenerationStats stats;
+    std::vector<llama_token> tokens;
+    const int64_t t0 = now_us();
+    if (!tokenize(model_, req.prompt, true, tokens) || tokens.empty()) {
+        current_id_ = 0;
+        listener_.on_error(req.id, "Tokenization failed");
+        return;
+    }
+    stats.n_prompt_tokens = (int) tokens.size();
+    if (prefix_cache_.contains(tokens)) {
+        current_id_ = 0;
+        stats.n_prefix_reused = stats.n_prompt_tokens;
+        listener_.on_complete(req.id, "", stats);
+        return;
+    }
+
+    // Start from whatever part of it is cached already (e.g. another job's system prompt)
+    const int n_prompt = (int) tokens.size();
+    const int n_batch = (int) llama_n_batch(ctx_);
+    int n_past = prefix_cache_.restore(ctx_, 0, tokens, n_prompt);
+    stats.n_prefix_reused = n_past;
+
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    bool ok = true;
+    bool yielded = false;
+    while (n_past < n_prompt) {
+        if (should_stop(req)) {
+            yielded = true;
+            break;
+        }
+        const int end = std::min(n_past + n_batch, n_prompt);
+        llama_batch_clear(batch);
+        for (int i = n_past; i < end; i++) {
+            llama_batch_add(batch, tokens[i], i, { 0 }, false);
+        }
+        if (llama_decode(ctx_, batch) != 0) {
+            ok = false;
+            break;
+        }
+        n_past = end;
+    }
+    llama_batch_free(batch);
+    stats.t_prefill_us = now_us() - t0;
+
+    if (ok && !yielded) {
+        ok = prefix_cache_.store(ctx_, 0, tokens);
+    }
+    llama_kv_cache_seq_rm(ctx_, 0, -1, -1);
+    current_id_ = 0;
+
+    if (yielded) {
+        listener_.on_error(req.id, current_cancelled_ ? "Cancelled" : "Yielded");
+    } else if (!ok) {
+        listener_.on_error(req.id, "Warm failed");
+    } else {
+        LOGI("Warmed %d prompt tokens (%d reused) in %lld us",
+             n_prompt, stats.n_prefix_reused, (long long) stats.t_prefill_us);
+        listener_.on_complete(req.id, "", stats);
+    }
+}
+
+void Engine::execute_embed(Command& req) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (!begin(req)) {
+        return;
+    }
+
+    const int n_embd = llama_n_embd(model_);
+    std::vector<float> vectors;
+    vectors.reserve(req.texts.size() * n_embd);
+    std::vector<float> v;
+    auto stop = [this, &req]() { return should_stop(req); };
+    bool yielded = false;
+    for (const std::string& text : req.texts) {
+        if (stop()) {
+            yielded = true;
+            break;
+        }
+        if (!embed(model_, ctx_, text, 0, EMBED_MAX_TOKENS, stop, v)) {
+            if (!current_cancelled_ && !preempt_) {
+                // Unembeddable text (e.g. empty after tokenizing) gets a zero vector
+                v.assign(n_embd, 0.0f);
+            } else {
+                yielded = true;
+                break;
+            }
+        }
+        vectors.insert(vectors.end(), v.begin(), v.end());
+    }
+    current_id_ = 0;
+
+    if (yielded) {
+        listener_.on_error(req.id, current_cancelled_ ? "Cancelled" : "Yielded");
+        return;
+    }
+    listener_.on_embeddings(req.id, n_embd, vectors);
+}
+
+void Engine::execute_codec(Command& req) {
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (!begin(req)) {
+        return;
+    }
+
+    // Seq 0 is free: a preempted generation's cells are parked in host memory
+    ModelPredictor predictor(model_, ctx_, 0);
+    const uint8_t fingerprint = model_fingerprint(model_, model_size_);
+    const int64_t t0 = now_us();
+    std::string result;
+    std::string error;
+    bool ok;
+    if (req.codec_op == CodecOp::ENCODE) {
+        std::vector<uint8_t> frame;
+        ok = codec_encode(predictor, fingerprint, req.prompt, req.max_bytes, frame, error);
+        result.assign(frame.begin(), frame.end());
+    } else {
+        ok = codec_decode(predictor, fingerprint, (const uint8_t*) req.prompt.data(),
+                          req.prompt.size(), result, error);
+    }
+    current_id_ = 0;
+
+    if (!ok) {
+        listener_.on_error(req.id, error);
+        return;
+    }
+    GenerationStats stats;
+    stats.t_decode_us = now_us() - t0;
+    LOGI("Codec %s: %zu -> %zu bytes in %lld us", req.codec_op == CodecOp::ENCODE ? "encode" : "decode",
+         req.prompt.size(), result.size(), (long long) stats.t_decode_us);
+    listener_.on_complete(req.id, result, stats);
+}
+
+void Engine::execute_batch(Job& job) {
+    Command& req = *job.cmd;
+    if (!job.batch && req.epoch != cancel_epoch_.load(std::memory_order_acquire)) {
+        listener_.on_error(req.id, "Cancelled");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (model_ == nullptr || ctx_ == nullptr) {
+        listener_.on_error(req.id, "Model not loaded");
+        return;
+    }
+
+    if (!job.batch) {
+        job.batch.reset(new BatchGeneration(model_, std::move(req.batch)));
+        job.model_serial = model_serial_;
+        job.batch->start();
+    } else if (job.model_serial != model_serial_) {
+        listener_.on_error(req.id, "Model changed while preempted");
+        return;
+    }
+
+    current_id_ = req.id;
+    current_priority_ = (int) req.priority;
+    current_cancelled_ = false;
+    preempt_ = highest_pending() > current_priority_;
+
+    job.batch->run(ctx_, [this, &req]() { return should_stop(req); });
+    current_id_ = 0;
+
+    // Nothing to snapshot: the dropped wave reruns when the batch comes back
+    if (!job.batch->done() && preempt_ && !current_cancelled_ &&
+        req.epoch == cancel_epoch_.load(std::memory_order_acquire)) {
+        LOGI("Batch %llu preempted", (unsigned long long) req.id);
+        suspended_.push_back(std::move(job));
+        return;
+    }
+    listener_.on_batch_complete(req.id, job.batch->results(), job.batch->stats());
+}
+
+void Engine::execute(Job& job) {
+    Command& req = *job.cmd;
+    if (req.kind == Command::BATCH) {
+        execute_batch(job);
+        return;
+    }
+    if (req.kind == Command::WARM) {
+        execute_warm(req);
+        return;
+    }
+    if (req.kind == Command::EMBED) {
+        execute_embed(req);
+        return;
+    }
+    if (req.kind == Command::CODEC) {
+        execute_codec(req);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(model_mutex_);
+    if (!job.gen && req.epoch != cancel_epoch_.load(std::memory_order_acquire)) {
+        drop_checkpoint(req);
+        listener_.on_error(req.id, "Cancelled");
+        return;
+    }
+    if (model_ == nullptr || ctx_ == nullptr) {
+        listener_.on_error(req.id, "Model not loaded");
+        return;
+    }
+
+    if (!job.gen) {
+        job.gen.reset(new Generation(model_, req.params, 0));
+        job.gen->set_prefix_cache(&prefix_cache_);
+        job.model_serial = model_serial_;
+        job.checkpoint_us = now_us();
+        if (job.gen->start(req.prompt) != GenerationStatus::OK) {
+            drop_checkpoint(req);
+            listener_.on_error(req.id, "Tokenization failed");
+            return;
+        }
+        restore_checkpoint(job);
+    } else if (job.model_serial != model_serial_) {
+        drop_checkpoint(req);
+        listener_.on_error(req.id, "Model changed while preempted");
+        return;
+    } else if (!job.gen->resume(ctx_)) {
+        drop_checkpoint(req);
+        listener_.on_error(req.id, "Resume failed");
+        return;
+    }
+
+    current_id_ = req.id;
+    current_priority_ = (int) req.priority;
+    current_cancelled_ = false;
+    preempt_ = highest_pending() > current_priority_;
+
+    GenerationHooks hooks;
+    hooks.should_stop = [this, &job, &req]() {
+        save_checkpoint(job);
+        return should_stop(req);
+    };
+    if (req.stream) {
+        hooks.on_text = [this, &req](const std::string& text) { listener_.on_text(req.id, text); };
+    }
+
+    GenerationStatus status = job.gen->run(ctx_, hooks);
+
+    // Preempted rather than cancelled: park the sequence in host memory and
+    // return to the loop, which picks the higher-priority request next
+    if (status == GenerationStatus::OK && !job.gen->done() && preempt_ &&
+        !current_cancelled_ && req.epoch == cancel_epoch_.load(std::memory_order_acquire)) {
+        if (job.gen->suspend(ctx_)) {
+            LOGI("Request %llu preempted after %d tokens (%zu KB parked)",
+                 (unsigned long long) req.id, job.gen->stats().n_generated,
+                 job.gen->snapshot_bytes() / 1024);
+            current_id_ = 0;
+            suspended_.push_back(std::move(job));
+            return;
+        }
+        // Without a snapshot there is no preemption: finish this one first
+        hooks.should_stop = [this, &job, &req]() {
+            save_checkpoint(job);
+            should_stop(req);
+            preempt_ = false;
+            return current_cancelled_ || req.epoch != cancel_epoch_.load(std::memory_order_acquire);
+        };
+        status = job.gen->run(ctx_, hooks);
+    }
+    current_id_ = 0;
+    drop_checkpoint(req);
+
+    if (status == GenerationStatus::DECODE_FAILED) {
+        listener_.on_error(req.id, "Decoding failed");
+        return;
+    }
+
+    const GenerationStats& stats = job.gen->stats();
+    LOGI("Request %llu: %d tokens (prompt %d, %d cached, prefill %lld us, decode %lld us)",
+         (unsigned long long) req.id, stats.n_generated, stats.n_prompt_tokens, stats.n_prefix_reused,
+         (long long) stats.t_prefill_us, (long long) stats.t_decode_us);
+    listener_.on_complete(req.id, job.gen->text(), stats);
+}
+
+void Engine::worker_loop() {
+    listener_.on_worker_start();
+    LOGI("Worker started");
+
+    while (true) {
+        drain_inbox();
+
+        Job job;
+        if (!take_next(job)) {
+            if (!running_.load(std::memory_order_acquire)) {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait(lock, [this]() {
+                return inbox_.load(std::memory_order_acquire) != nullptr ||
+                       !running_.load(std::memory_order_acquire);
+            });
+            continue;
+        }
+        execute(job);
+    }
+
+    LOGI("Worker stopped");
+    listener_.on_worker_stop();
+}
+
+} // namespace smith
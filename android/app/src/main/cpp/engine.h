@@ -0,0 +1,298 @@
+/**
+ * engine.h - Asynchronous generation engine
+ * Guild of Smiths - Offline AI Module
+ *
+ * Owns the model/context and a single worker thread. Callers submit
+ * requests into a lock-free inbox and return immediately; the worker runs
+ * them by priority and reports text, completion and errors through an
+ * EngineListener on the worker thread. No caller thread ever blocks for
+ * the length of a generation.
+ *
+ * Request ids are chosen by the caller, so a completion can never race
+ * the caller's own bookkeeping for that id.
+ *
+ * Requests carry a priority. A higher-priority arrival preempts the
+ * running generation at the next token (or prefill slice): its sequence
+ * is snapshotted to host memory, the newcomer runs to completion, and the
+ * preempted one resumes exactly where it stopped.
+ *
+ * A batch request runs many prompts as parallel sequences and completes
+ * once with every result. Preempting a batch drops its current wave only;
+ * finished items are kept and the rest rerun when it resumes.
+ *
+ * Idle work (prompt warming, embeddings, precomputed answers) runs below
+ * everything else. Warm and embed requests are not parked when preempted:
+ * they fail with "Yielded" at once and the caller retries in a later idle
+ * window. Warmed prompts land in a prefix cache that every generation
+ * consults before prefill.
+ *
+ * Codec requests compress or expand a short mesh message against the
+ * loaded model (see predictive_codec.h). They are a handful of tiny
+ * decodes and run to completion once started.
+ *
+ * A generation submitted with a checkpoint key is saved to the checkpoint
+ * directory every CHECKPOINT_INTERVAL of decoding. If the process dies,
+ * submitting the same key, prompt and parameters again in a new process
+ * picks up from the last checkpoint. The file is removed once the request
+ * completes, fails or is cancelled.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_generate.h"
+#include "inference_core.h"
+#include "predictive_codec.h"
+#include "prefix_cache.h"
+
+namespace smith {
+
+/** Scheduling class; higher values preempt lower ones. */
+enum class Priority : int {
+    IDLE = 0,         // precomputation while charging and idle
+    BACKGROUND = 1,   // ambient enhancement, proactive suggestions
+    NORMAL = 2,
+    INTERACTIVE = 3,  // a user is waiting on the answer
+};
+
+static const int PRIORITY_COUNT = 4;
+
+/**
+ * Receives engine events. Every method is called on the worker thread,
+ * between on_worker_start and on_worker_stop.
+ */
+class EngineListener {
+public:
+    virtual ~EngineListener() = default;
+
+    virtual void on_worker_start() {}
+    virtual void on_worker_stop() {}
+
+    /** Streamed output for requests submitted with stream = true. */
+    virtual void on_text(uint64_t id, const std::string& text) = 0;
+
+    /** Generation finished (possibly cut short by cancel). */
+    virtual void on_complete(uint64_t id, const std::string& text, const GenerationStats& stats) = 0;
+
+    /** Request failed or was cancelled before it started. */
+    virtual void on_error(uint64_t id, const std::string& error) = 0;
+
+    /** Batch finished; results are in submission order. */
+    virtual void on_batch_complete(uint64_t id, const std::vector<BatchItemResult>& results,
+                                   const BatchStats& stats) = 0;
+
+    /** Embeddings finished; one L2-normalized vector per text, in order. */
+    virtual void on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) = 0;
+
+    /** An out-of-process backend's worker died; its model is gone. */
+    virtual void on_backend_lost() {}
+};
+
+/** Model state as of the last load or unload. */
+struct ModelStatus {
+    bool loaded = false;
+    int n_vocab = 0;
+    int n_ctx = 0;
+    int n_embd = 0;
+};
+
+/**
+ * What the JNI bridge drives: the Engine itself in-process, or a
+ * WorkerClient forwarding to an Engine in a worker process.
+ *
+ * Status reads (is_loaded, model_info, status) go to an immutable snapshot
+ * that load and unload swap atomically, so they never wait for a
+ * generation or a model load.
+ */
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    /** Load a model, replacing any current one. Waits for a running generation. */
+    virtual bool load_model(const std::string& path, int n_ctx, int n_threads) = 0;
+
+    /** Free model and context. Waits for a running generation. */
+    virtual void unload_model() = 0;
+
+    /** Lock-free snapshot of the model state. */
+    std::shared_ptr<const ModelStatus> status() const { return std::atomic_load(&status_); }
+
+    bool is_loaded() const { return status()->loaded; }
+
+    /** Vocabulary, context and embedding size of the loaded model; false if none. */
+    bool model_info(int& n_vocab, int& n_ctx, int& n_embd) const;
+
+    /** Directory for generation checkpoints; empty disables them. Set before submitting. */
+    virtual void set_checkpoint_dir(const std::string& dir) = 0;
+
+    /**
+     * Directory the prefix cache also keeps its entries in, so warmed
+     * prefixes outlive eviction and restarts; empty disables it.
+     */
+    virtual void set_prefix_cache_dir(const std::string& dir, size_t max_bytes) = 0;
+
+    /**
+     * Queue a generation. Never waits for the worker.
+     * @param checkpoint_key Stable name to checkpoint and resume under; empty for none
+     * @return false if the engine is stopping
+     */
+    virtual bool submit(uint64_t id, const std::string& prompt, const GenerationParams& params,
+                        bool stream, Priority priority = Priority::NORMAL,
+                        const std::string& checkpoint_key = std::string()) = 0;
+
+    /**
+     * Queue a batch of independent prompts, generated together.
+     * @return false if the engine is stopping
+     */
+    virtual bool submit_batch(uint64_t id, std::vector<BatchItem> items,
+                              Priority priority = Priority::BACKGROUND) = 0;
+
+    /**
+     * Prefill prompt and keep its KV cells in the prefix cache, so later
+     * prompts starting the same way skip that part of prefill. Completes
+     * through on_complete with empty text.
+     */
+    virtual bool submit_warm(uint64_t id, const std::string& prompt, Priority priority = Priority::IDLE) = 0;
+
+    /** Embed texts for similarity search; completes through on_embeddings. */
+    virtual bool submit_embed(uint64_t id, std::vector<std::string> texts,
+                              Priority priority = Priority::IDLE) = 0;
+
+    /**
+     * Compress text into a mesh frame (ENCODE) or expand a frame back to
+     * text (DECODE). Completes through on_complete with the frame bytes or
+     * the UTF-8 text; on_error if it does not fit, or the frame is foreign
+     * or corrupt.
+     * @param max_bytes Largest acceptable frame for ENCODE; 0 for no limit
+     */
+    virtual bool submit_codec(uint64_t id, CodecOp op, const std::string& data, size_t max_bytes,
+                              Priority priority = Priority::INTERACTIVE) = 0;
+
+    /** Cancel one request, queued or running. */
+    virtual void cancel(uint64_t id) = 0;
+
+    /** Cancel the running request and everything queued before this call. */
+    virtual void cancel_all() = 0;
+
+protected:
+    /** Replace the snapshot; readers holding the old one keep it alive. */
+    void publish_status(const ModelStatus& status) {
+        std::atomic_store(&status_, std::make_shared<const ModelStatus>(status));
+    }
+
+private:
+    std::shared_ptr<const ModelStatus> status_ = std::make_shared<const ModelStatus>();
+};
+
+class Engine : public InferenceBackend {
+public:
+    explicit Engine(EngineListener& listener);
+    ~Engine() override;
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    bool load_model(const std::string& path, int n_ctx, int n_threads) override;
+    void unload_model() override;
+    void set_checkpoint_dir(const std::string& dir) override;
+    void set_prefix_cache_dir(const std::string& dir, size_t max_bytes) override;
+
+    /** Lock-free: pushes to the inbox. */
+    bool submit(uint64_t id, const std::string& prompt, const GenerationParams& params,
+                bool stream, Priority priority = Priority::NORMAL,
+                const std::string& checkpoint_key = std::string()) override;
+    bool submit_batch(uint64_t id, std::vector<BatchItem> items,
+                      Priority priority = Priority::BACKGROUND) override;
+    bool submit_warm(uint64_t id, const std::string& prompt, Priority priority = Priority::IDLE) override;
+    bool submit_embed(uint64_t id, std::vector<std::string> texts,
+                      Priority priority = Priority::IDLE) override;
+    bool submit_codec(uint64_t id, CodecOp op, const std::string& data, size_t max_bytes,
+                      Priority priority = Priority::INTERACTIVE) override;
+    void cancel(uint64_t id) override;
+    void cancel_all() override;
+
+private:
+    struct Command {
+        enum Kind { GENERATE, BATCH, WARM, EMBED, CODEC, CANCEL } kind = GENERATE;
+        uint64_t id = 0;
+        uint64_t epoch = 0;
+        std::string prompt;
+        GenerationParams params;
+        bool stream = false;
+        std::string checkpoint_key;
+        std::vector<BatchItem> batch;
+        std::vector<std::string> texts;
+        CodecOp codec_op = CodecOp::ENCODE;
+        size_t max_bytes = 0;
+        Priority priority = Priority::NORMAL;
+        Command* next = nullptr;
+    };
+
+    // A request the worker has started; gen/batch is null until it first runs
+    struct Job {
+        std::unique_ptr<Command> cmd;
+        std::unique_ptr<Generation> gen;
+        std::unique_ptr<BatchGeneration> batch;
+        uint64_t model_serial = 0;     // snapshot is only valid for this model
+        int64_t checkpoint_us = 0;     // last checkpoint (or start) time
+        int checkpoint_tokens = 0;     // tokens covered by the last checkpoint
+    };
+
+    void push(Command* cmd);
+    void drain_inbox();
+    void worker_loop();
+    bool take_next(Job& job);
+    int highest_pending() const;
+    void execute(Job& job);
+    void execute_batch(Job& job);
+    void execute_warm(Command& req);
+    void execute_embed(Command& req);
+    void execute_codec(Command& req);
+    bool begin(Command& req);
+    bool push_new(Command* cmd);
+    bool should_stop(const Command& req);
+    std::string checkpoint_file(const Command& req) const;
+    void restore_checkpoint(Job& job);
+    void save_checkpoint(Job& job);
+    void drop_checkpoint(const Command& req);
+
+    EngineListener& listener_;
+
+    // Multi-producer inbox: a Treiber stack the worker swaps out whole
+    std::atomic<Command*> inbox_{ nullptr };
+    std::atomic<uint64_t> cancel_epoch_{ 0 };
+    std::atomic<bool> running_{ true };
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+
+    // Worker-only state
+    std::deque<Command*> pending_[PRIORITY_COUNT];
+    std::vector<Job> suspended_;   // preempted, innermost last
+    uint64_t current_id_ = 0;
+    int current_priority_ = 0;
+    bool current_cancelled_ = false;
+    bool preempt_ = false;
+
+    // Held by the worker while it runs a job and by load/unload
+    std::mutex model_mutex_;
+    uint64_t model_serial_ = 0;
+    llama_model* model_ = nullptr;
+    llama_context* ctx_ = nullptr;
+    std::string model_path_;
+    uint64_t model_size_ = 0;
+    std::string checkpoint_dir_;
+    PrefixCache prefix_cache_;
+
+    std::thread worker_;
+};
+
+} // namespace smith
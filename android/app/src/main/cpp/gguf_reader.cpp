@@ -0,0 +1,306 @@
+/**
+ * gguf_reader.cpp - Bounds-checked GGUF header parser
+ * Guild of Smiths - Offline AI Module
+ */
+
+#include "gguf_reader.h"
+
+#include <cstring>
+
+namespace smith {
+
+// Sanity limits so a corrupt header cannot make us allocate gigabytes
+static const uint64_t MAX_KV = 1u << 16;
+static const uint64_t MAX_TENSORS = 1u << 20;
+static const uint64_t MAX_STRING = 1u << 20;
+static const uint32_t MAX_DIMS = 4;
+
+struct TypeTraits {
+    const char* label;
+    uint32_t block_size;
+    uint32_t type_size;
+};
+
+// Indexed by ggml_type; {nullptr, 0, 0} marks removed/unknown ids
+static const TypeTraits TYPE_TRAITS[] = {
+    { "f32",      1,   4   },  // 0
+    { "f16",      1,   2   },  // 1
+    { "q4_0",     32,  18  },  // 2
+    { "q4_1",     32,  20  },  // 3
+    { nullptr,    0,   0   },  // 4 (removed q4_2)
+    { nullptr,    0,   0   },  // 5 (removed q4_3)
+    { "q5_0",     32,  22  },  // 6
+    { "q5_1",     32,  24  },  // 7
+    { "q8_0",     32,  34  },  // 8
+    { "q8_1",     32,  36  },  // 9
+    { "q2_K",     256, 84  },  // 10
+    { "q3_K",     256, 110 },  // 11
+    { "q4_K",     256, 144 },  // 12
+    { "q5_K",     256, 176 },  // 13
+    { "q6_K",     256, 210 },  // 14
+    { "q8_K",     256, 292 },  // 15
+    { "iq2_xxs",  256, 66  },  // 16
+    { "iq2_xs",   256, 74  },  // 17
+    { "iq3_xxs",  256, 98  },  // 18
+    { "iq1_s",    256, 50  },  // 19
+    { "iq4_nl",   32,  18  },  // 20
+    { "iq3_s",    256, 110 },  // 21
+    { "iq2_s",    256, 82  },  // 22
+    { "iq4_xs",   256, 136 },  // 23
+    { "i8",       1,   1   },  // 24
+    { "i16",      1,   2   },  // 25
+    { "i32",      1,   4   },  // 26
+    { "i64",      1,   8   },  // 27
+    { "f64",      1,   8   },  // 28
+    { "iq1_m",    256, 56  },  // 29
+    { "bf16",     1,   2   },  // 30
+    { "q4_0_4_4", 32,  18  },  // 31
+    { "q4_0_4_8", 32,  18  },  // 32
+    { "q4_0_8_8", 32,  18  },  // 33
+    { "tq1_0",    256, 54  },  // 34
+    { "tq2_0",    256, 66  },  // 35
+};
+
+static const uint32_t N_TYPES = sizeof(TYPE_TRAITS) / sizeof(TYPE_TRAITS[0]);
+
+const char* ggml_type_label(uint32_t type) {
+    if (type < N_TYPES && TYPE_TRAITS[type].label != nullptr) {
+        return TYPE_TRAITS[type].label;
+    }
+    return "unknown";
+}
+
+uint64_t ggml_tensor_nbytes(uint32_t type, const uint64_t ne[4]) {
+    if (type >= N_TYPES || TYPE_TRAITS[type].block_size == 0) {
+        return 0;
+    }
+    const TypeTraits& t = TYPE_TRAITS[type];
+    if (ne[0] % t.block_size != 0) {
+        return 0;
+    }
+    // A corrupt shape must not wrap around to a small size that fits the file
+    uint64_t rows = 0, row_bytes = 0, nbytes = 0;
+    if (__builtin_mul_overflow(ne[1], ne[2], &rows) ||
+        __builtin_mul_overflow(rows, ne[3], &rows) ||
+        __builtin_mul_overflow(ne[0] / t.block_size, (uint64_t) t.type_size, &row_bytes) ||
+        __builtin_mul_overflow(row_bytes, rows, &nbytes)) {
+        return 0;
+    }
+    return nbytes;
+}
+
+const GgufKV* GgufFile::find(const char* key) const {
+    for (const auto& e : kv) {
+        if (e.key == key) return &e;
+    }
+    return nullptr;
+}
+
+namespace {
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return ok_; }
+    size_t pos() const { return pos_; }
+
+    template <typename T>
+    T read() {
+        T v{};
+        if (!need(sizeof(T))) return v;
+        memcpy(&v, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return v;
+    }
+
+    std::string read_string() {
+        uint64_t len = read<uint64_t>();
+        if (!ok_ || len > MAX_STRING || !need(len)) {
+            ok_ = false;
+            return std::string();
+        }
+        std::string s(reinterpret_cast<const char*>(data_ + pos_), len);
+        pos_ += len;
+        return s;
+    }
+
+    void skip_string() {
+        uint64_t len = read<uint64_t>();
+        if (ok_ && need(len)) pos_ += len;
+    }
+
+    void skip(uint64_t n) {
+        if (need(n)) pos_ += n;
+    }
+
+private:
+    bool need(uint64_t n) {
+        if (!ok_ || n > size_ - pos_) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+uint32_t scalar_size(uint32_t type) {
+    switch (type) {
+        case GGUF_VAL_UINT8: case GGUF_VAL_INT8: case GGUF_VAL_BOOL: return 1;
+        case GGUF_VAL_UINT16: case GGUF_VAL_INT16: return 2;
+        case GGUF_VAL_UINT32: case GGUF_VAL_INT32: case GGUF_VAL_FLOAT32: return 4;
+        case GGUF_VAL_UINT64: case GGUF_VAL_INT64: case GGUF_VAL_FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+bool read_scalar(Reader& r, uint32_t type, GgufKV& kv) {
+    switch (type) {
+        case GGUF_VAL_UINT8:   kv.u64 = r.read<uint8_t>(); break;
+        case GGUF_VAL_INT8:    kv.i64 = r.read<int8_t>(); break;
+        case GGUF_VAL_UINT16:  kv.u64 = r.read<uint16_t>(); break;
+        case GGUF_VAL_INT16:   kv.i64 = r.read<int16_t>(); break;
+        case GGUF_VAL_UINT32:  kv.u64 = r.read<uint32_t>(); break;
+        case GGUF_VAL_INT32:   kv.i64 = r.read<int32_t>(); break;
+        case GGUF_VAL_FLOAT32: kv.f64 = r.read<float>(); break;
+        case GGUF_VAL_BOOL:    kv.u64 = r.read<uint8_t>() != 0; break;
+        case GGUF_VAL_UINT64:  kv.u64 = r.read<uint64_t>(); break;
+        case GGUF_VAL_INT64:   kv.i64 = r.read<int64_t>(); break;
+        case GGUF_VAL_FLOAT64: kv.f64 = r.read<double>(); break;
+        case GGUF_VAL_STRING:  kv.str = r.read_string(); break;
+        default: return false;
+    }
+    // Mirror signed values into u64 so callers can read small ints either way
+    if (type == GGUF_VAL_INT8 || type == GGUF_VAL_INT16 ||
+        type == GGUF_VAL_INT32 || type == GGUF_VAL_INT64) {
+        kv.u64 = kv.i64 < 0 ? 0 : (uint64_t) kv.i64;
+    }
+    return r.ok();
+}
+
+} // namespace
+
+bool parse_gguf(const uint8_t* data, size_t size, GgufFile& out, std::string& error) {
+    Reader r(data, size);
+
+    uint32_t magic = r.read<uint32_t>();
+    if (!r.ok() || memcmp(&magic, "GGUF", 4) != 0) {
+        error = "not a GGUF file";
+        return false;
+    }
+    out.version = r.read<uint32_t>();
+    if (out.version < 2 || out.version > 3) {
+        error = "unsupported GGUF version " + std::to_string(out.version);
+        return false;
+    }
+
+    uint64_t n_tensors = r.read<uint64_t>();
+    uint64_t n_kv = r.read<uint64_t>();
+    if (!r.ok() || n_tensors > MAX_TENSORS || n_kv > MAX_KV) {
+        error = "implausible tensor/kv count";
+        return false;
+    }
+
+    out.kv.clear();
+    out.kv.reserve(n_kv);
+    for (uint64_t i = 0; i < n_kv; i++) {
+        GgufKV kv;
+        kv.key = r.read_string();
+        kv.type = r.read<uint32_t>();
+        if (!r.ok()) break;
+
+        if (kv.type == GGUF_VAL_ARRAY) {
+            kv.array_type = r.read<uint32_t>();
+            kv.array_len = r.read<uint64_t>();
+            if (kv.array_type == GGUF_VAL_STRING) {
+                for (uint64_t j = 0; j < kv.array_len && r.ok(); j++) {
+                    r.skip_string();
+                }
+            } else {
+                uint32_t es = scalar_size(kv.array_type);
+                if (es == 0 || kv.array_len > (uint64_t) size / es) {
+                    error = "bad array in " + kv.key;
+                    return false;
+                }
+                r.skip(kv.array_len * es);
+            }
+        } else if (!read_scalar(r, kv.type, kv)) {
+            error = "bad value for " + kv.key;
+            return false;
+        }
+        out.kv.push_back(std::move(kv));
+    }
+    if (!r.ok()) {
+        error = "truncated metadata";
+        return false;
+    }
+
+    if (const GgufKV* align = out.find("general.alignment")) {
+        if (align->u64 == 0 || (align->u64 & (align->u64 - 1)) != 0) {
+            error = "bad general.alignment";
+            return false;
+        }
+        out.alignment = (uint32_t) align->u64;
+    }
+
+    out.tensors.clear();
+    out.tensors.reserve(n_tensors);
+    for (uint64_t i = 0; i < n_tensors; i++) {
+        GgufTensorInfo t;
+        t.name = r.read_string();
+        t.n_dims = r.read<uint32_t>();
+        if (!r.ok() || t.n_dims == 0 || t.n_dims > MAX_DIMS) {
+            error = "bad tensor header";
+            return false;
+        }
+        for (uint32_t d = 0; d < t.n_dims; d++) {
+            t.ne[d] = r.read<uint64_t>();
+        }
+        t.type = r.read<uint32_t>();
+        t.offset = r.read<uint64_t>();
+        if (!r.ok()) break;
+        t.nbytes = ggml_tensor_nbytes(t.type, t.ne);
+        out.tensors.push_back(std::move(t));
+    }
+    if (!r.ok()) {
+        error = "truncated tensor directory";
+        return false;
+    }
+
+    const uint64_t a = out.alignment;
+    out.data_offset = (r.pos() + a - 1) / a * a;
+    return true;
+}
+
+bool validate_tensor_bounds(const GgufFile& file, uint64_t file_size, std::string& error) {
+    if (file.data_offset > file_size) {
+        error = "file ends before tensor data";
+        return false;
+    }
+    const uint64_t data_size = file_size - file.data_offset;
+
+    for (const auto& t : file.tensors) {
+        if (t.nbytes == 0) {
+            error = strcmp(ggml_type_label(t.type), "unknown") == 0
+                ? "tensor " + t.name + " has unsupported type " + std::to_string(t.type)
+                : "tensor " + t.name + " has an invalid shape";
+            return false;
+        }
+        if (t.offset % file.alignment != 0) {
+            error = "tensor " + t.name + " is misaligned";
+            return false;
+        }
+        if (t.offset > data_size || t.nbytes > data_size - t.offset) {
+            error = "tensor " + t.name + " extends past end of file (truncated?)";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace smith
@@ -0,0 +1,88 @@
+/**
+ * gguf_reader.h - Bounds-checked GGUF header parser
+ * Guild of Smiths - Offline AI Module
+ *
+ * Parses the header, key/value metadata and tensor directory of a GGUF file
+ * from memory (normally an mmap of the file) without touching tensor data.
+ * Independent of llama.cpp so it can run before any model is loaded.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+// GGUF value types (gguf_type)
+enum GgufValueType : uint32_t {
+    GGUF_VAL_UINT8 = 0,
+    GGUF_VAL_INT8 = 1,
+    GGUF_VAL_UINT16 = 2,
+    GGUF_VAL_INT16 = 3,
+    GGUF_VAL_UINT32 = 4,
+    GGUF_VAL_INT32 = 5,
+    GGUF_VAL_FLOAT32 = 6,
+    GGUF_VAL_BOOL = 7,
+    GGUF_VAL_STRING = 8,
+    GGUF_VAL_ARRAY = 9,
+    GGUF_VAL_UINT64 = 10,
+    GGUF_VAL_INT64 = 11,
+    GGUF_VAL_FLOAT64 = 12,
+};
+
+/** One metadata entry. Scalars are widened; arrays keep only type and length. */
+struct GgufKV {
+    std::string key;
+    uint32_t type = 0;
+    uint64_t u64 = 0;         // unsigned ints and bool
+    int64_t i64 = 0;          // signed ints
+    double f64 = 0.0;         // floats
+    std::string str;          // strings
+    uint32_t array_type = 0;  // arrays
+    uint64_t array_len = 0;
+};
+
+struct GgufTensorInfo {
+    std::string name;
+    uint32_t type = 0;        // ggml_type
+    uint32_t n_dims = 0;
+    uint64_t ne[4] = { 1, 1, 1, 1 };
+    uint64_t offset = 0;      // relative to data_offset
+    uint64_t nbytes = 0;      // 0 if the type is unknown
+};
+
+struct GgufFile {
+    uint32_t version = 0;
+    uint32_t alignment = 32;
+    uint64_t data_offset = 0; // absolute offset of the tensor data section
+    std::vector<GgufKV> kv;
+    std::vector<GgufTensorInfo> tensors;
+
+    const GgufKV* find(const char* key) const;
+};
+
+/** Name of a ggml tensor type ("q4_K", "f16", ...) or "unknown". */
+const char* ggml_type_label(uint32_t type);
+
+/**
+ * Bytes used by a tensor of the given type and shape; 0 if the type is
+ * unknown, ne0 is misaligned or the size does not fit in 64 bits.
+ */
+uint64_t ggml_tensor_nbytes(uint32_t type, const uint64_t ne[4]);
+
+/**
+ * Parse header, metadata and tensor directory from data[0..size).
+ * Fails on bad magic, unsupported version, or any read past size.
+ */
+bool parse_gguf(const uint8_t* data, size_t size, GgufFile& out, std::string& error);
+
+/**
+ * Check that every tensor has a known type, an aligned offset and lies
+ * entirely inside a file of file_size bytes (catches truncated downloads).
+ */
+bool validate_tensor_bounds(const GgufFile& file, uint64_t file_size, std::string& error);
+
+} // namespace smith
@@ -0,0 +1,430 @@
+/**
+ * inference_core.cpp - Generation loop shared by the JNI bridge and native tools
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "LlamaCore"
+
+#include "inference_core.h"
+#include "checkpoint.h"
+#include "native_log.h"
+#include "prefix_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "common.h"
+
+namespace smith {
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool tokenize(const llama_model* model, const std::string& text,
+              bool add_special, std::vector<llama_token>& out) {
+    // One token per byte plus BOS/EOS is always enough
+    out.resize(text.size() + 2);
+    int n = llama_tokenize(model, text.data(), (int32_t) text.size(),
+                           out.data(), (int32_t) out.size(), add_special, false);
+    if (n < 0) {
+        out.resize(-n);
+        n = llama_tokenize(model, text.data(), (int32_t) text.size(),
+                           out.data(), (int32_t) out.size(), add_special, false);
+        if (n < 0) {
+            out.clear();
+            return false;
+        }
+    }
+    out.resize(n);
+    return true;
+}
+
+void append_piece(const llama_model* model, llama_token token, std::string& out) {
+    char buf[128];
+    int n = llama_token_to_piece(model, token, buf, sizeof(buf), false);
+    if (n > 0) {
+        out.append(buf, n);
+    }
+}
+
+size_t utf8_complete_length(const std::string& s) {
+    // Walk back over at most 3 continuation bytes to the last lead byte
+    size_t n = s.size();
+    size_t i = n;
+    while (i > 0 && n - i < 4 && (static_cast<unsigned char>(s[i - 1]) & 0xC0) == 0x80) {
+        i--;
+    }
+    if (i == 0) {
+        return n;
+    }
+    const unsigned char lead = static_cast<unsigned char>(s[i - 1]);
+    size_t need = 1;
+    if ((lead & 0xE0) == 0xC0) need = 2;
+    else if ((lead & 0xF0) == 0xE0) need = 3;
+    else if ((lead & 0xF8) == 0xF0) need = 4;
+    return n - (i - 1) >= need ? n : i - 1;
+}
+
+llama_token sample_greedy(llama_context* ctx, const float* logits, int n_vocab,
+                          std::vector<llama_token_data>& candidates) {
+    candidates.resize(n_vocab);
+    for (llama_token id = 0; id < n_vocab; id++) {
+        candidates[id] = llama_token_data{ id, logits[id], 0.0f };
+    }
+    llama_token_data_array arr = { candidates.data(), candidates.size(), false };
+    return llama_sample_token_greedy(ctx, &arr);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// GENERATION
+// ════════════════════════════════════════════════════════════════════
+
+Generation::Generation(llama_model* model, const GenerationParams& params, llama_seq_id seq)
+    : model_(model), params_(params), seq_(seq) {
+}
+
+Generation::~Generation() {
+    if (batch_capacity_ > 0) {
+        llama_batch_free(batch_);
+    }
+}
+
+void Generation::ensure_batch(int n_tokens) {
+    if (batch_capacity_ >= n_tokens) {
+        return;
+    }
+    if (batch_capacity_ > 0) {
+        llama_batch_free(batch_);
+    }
+    batch_ = llama_batch_init(n_tokens, 0, 1);
+    batch_capacity_ = n_tokens;
+}
+
+GenerationStatus Generation::start(const std::string& prompt) {
+    const int64_t t0 = now_us();
+    if (!tokenize(model_, prompt, true, tokens_) || tokens_.empty()) {
+        LOGE("Tokenization failed");
+        done_ = true;
+        return GenerationStatus::TOKENIZE_FAILED;
+    }
+    n_prompt_ = (int) tokens_.size();
+    stats_.n_prompt_tokens = n_prompt_;
+    stats_.t_tokenize_us = now_us() - t0;
+    return GenerationStatus::OK;
+}
+
+GenerationStatus Generation::run(llama_context* ctx, const GenerationHooks& hooks) {
+    if (done_) {
+        return GenerationStatus::OK;
+    }
+
+    // Prefill in n_batch slices so long prompts never overrun the batch,
+    // and so a stop request is honoured within one slice
+    if (n_past_ < n_prompt_) {
+        const int n_batch = (int) llama_n_batch(ctx);
+        ensure_batch(n_batch);
+        if (n_past_ == 0) {
+            // Keep at least the last prompt token to decode: it produces the first logits
+            if (prefix_cache_ != nullptr) {
+                n_past_ = prefix_cache_->restore(ctx, seq_, tokens_, n_prompt_ - 1);
+                stats_.n_prefix_reused = n_past_;
+            } else {
+                llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+            }
+        }
+
+        const int64_t t0 = now_us();
+        while (n_past_ < n_prompt_) {
+            if (n_past_ > 0 && hooks.should_stop && hooks.should_stop()) {
+                stats_.t_prefill_us += now_us() - t0;
+                return GenerationStatus::OK;
+            }
+            const int end = std::min(n_past_ + n_batch, n_prompt_);
+            llama_batch_clear(batch_);
+            for (int i = n_past_; i < end; i++) {
+                llama_batch_add(batch_, tokens_[i], i, { seq_ }, false);
+            }
+            if (end == n_prompt_) {
+                batch_.logits[batch_.n_tokens - 1] = true;
+            }
+            if (llama_decode(ctx, batch_) != 0) {
+                LOGE("Prompt decoding failed");
+                done_ = true;
+                return GenerationStatus::DECODE_FAILED;
+            }
+            n_past_ = end;
+        }
+        logits_idx_ = batch_.n_tokens - 1;
+        stats_.t_prefill_us += now_us() - t0;
+    }
+
+    const int n_vocab = llama_n_vocab(model_);
+    std::vector<llama_token_data> candidates;
+    candidates.reserve(n_vocab);
+    ensure_batch(1);
+
+    const int64_t t0 = now_us();
+    const bool forced = !params_.forced_tokens.empty();
+    while (!done_) {
+        const int limit = forced ? (int) params_.forced_tokens.size() : params_.max_tokens;
+        if (stats_.n_generated >= limit) {
+            done_ = true;
+            break;
+        }
+        if (hooks.should_stop && hooks.should_stop()) {
+            break;
+        }
+
+        // After a resume the logits come from the snapshot, not the context
+        const float* logits = saved_logits_.empty()
+            ? llama_get_logits_ith(ctx, logits_idx_)
+            : saved_logits_.data();
+        llama_token new_token = sample_greedy(ctx, logits, n_vocab, candidates);
+        saved_logits_.clear();
+
+        if (forced) {
+            const llama_token replayed = params_.forced_tokens[stats_.n_generated];
+            if (replayed != new_token) {
+                stats_.n_forced_diverged++;
+            }
+            new_token = replayed;
+        } else if (llama_token_is_eog(model_, new_token)) {
+            done_ = true;
+            break;
+        }
+
+        append_piece(model_, new_token, text_);
+        tokens_.push_back(new_token);
+        if (hooks.on_text) {
+            const size_t complete = utf8_complete_length(text_);
+            if (complete > n_emitted_) {
+                hooks.on_text(text_.substr(n_emitted_, complete - n_emitted_));
+                n_emitted_ = complete;
+            }
+        }
+
+        llama_batch_clear(batch_);
+        llama_batch_add(batch_, new_token, n_past_, { seq_ }, true);
+        if (llama_decode(ctx, batch_) != 0) {
+            LOGE("Token decoding failed");
+            done_ = true;
+            break;
+        }
+
+        logits_idx_ = 0;
+        n_past_++;
+        stats_.n_generated++;
+    }
+    stats_.t_decode_us += now_us() - t0;
+
+    if (done_ && hooks.on_text && text_.size() > n_emitted_) {
+        hooks.on_text(text_.substr(n_emitted_));
+        n_emitted_ = text_.size();
+    }
+    return GenerationStatus::OK;
+}
+
+bool Generation::suspend(llama_context* ctx) {
+    if (suspended_ || n_past_ == 0) {
+        suspended_ = true;
+        return true;
+    }
+    // Logits exist once the prompt is in; keep the snapshot's own if nothing was sampled since resume()
+    if (n_past_ >= n_prompt_ && saved_logits_.empty()) {
+        const int n_vocab = llama_n_vocab(model_);
+        const float* logits = llama_get_logits_ith(ctx, logits_idx_);
+        saved_logits_.assign(logits, logits + n_vocab);
+    }
+
+    saved_kv_.resize(llama_state_seq_get_size(ctx, seq_));
+    if (llama_state_seq_get_data(ctx, saved_kv_.data(), seq_) != saved_kv_.size()) {
+        // saved_logits_ still match the live sequence, so run() can carry on
+        LOGE("Failed to snapshot sequence %d", seq_);
+        saved_kv_.clear();
+        return false;
+    }
+    llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+    suspended_ = true;
+    return true;
+}
+
+bool Generation::resume(llama_context* ctx) {
+    if (!suspended_) {
+        return true;
+    }
+    suspended_ = false;
+    if (n_past_ == 0) {
+        return true;
+    }
+    llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+    if (llama_state_seq_set_data(ctx, saved_kv_.data(), seq_) == 0) {
+        LOGE("Failed to restore sequence %d", seq_);
+        done_ = true;
+        return false;
+    }
+    std::vector<uint8_t>().swap(saved_kv_);
+    return true;
+}
+
+bool Generation::save_state(llama_context* ctx, GenerationCheckpoint& cp) const {
+    // Between tokens every token is decoded; mid-prefill or parked there is nothing consistent to save
+    if (done_ || suspended_ || n_past_ < n_prompt_ || n_past_ != (int) tokens_.size()) {
+        return false;
+    }
+    cp.n_prompt = n_prompt_;
+    cp.tokens.assign(tokens_.begin(), tokens_.end());
+    cp.kv.resize(llama_state_seq_get_size(ctx, seq_));
+    if (llama_state_seq_get_data(ctx, cp.kv.data(), seq_) != cp.kv.size()) {
+        LOGE("Failed to snapshot sequence %d", seq_);
+        cp.kv.clear();
+        return false;
+    }
+    return true;
+}
+
+bool Generation::restore_state(llama_context* ctx, const GenerationCheckpoint& cp) {
+    const int n_tokens = (int) cp.tokens.size();
+    if (done_ || n_past_ != 0 || cp.n_prompt != n_prompt_ || n_tokens < n_prompt_ ||
+        n_tokens >= (int) llama_n_ctx(ctx) ||
+        !std::equal(tokens_.begin(), tokens_.end(), cp.tokens.begin())) {
+        return false;
+    }
+
+    llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+    if (llama_state_seq_set_data(ctx, cp.kv.data(), seq_) == 0) {
+        LOGE("Failed to restore sequence %d from checkpoint", seq_);
+        llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+        return false;
+    }
+
+    // Logits are not part of the sequence state: drop the last cell and
+    // decode that one token again to get them back
+    const int64_t t0 = now_us();
+    llama_kv_cache_seq_rm(ctx, seq_, n_tokens - 1, -1);
+    ensure_batch(1);
+    llama_batch_clear(batch_);
+    llama_batch_add(batch_, cp.tokens[n_tokens - 1], n_tokens - 1, { seq_ }, true);
+    if (llama_decode(ctx, batch_) != 0) {
+        LOGE("Checkpoint decode failed");
+        llama_kv_cache_seq_rm(ctx, seq_, -1, -1);
+        return false;
+    }
+    stats_.t_prefill_us += now_us() - t0;
+
+    tokens_.assign(cp.tokens.begin(), cp.tokens.end());
+    n_past_ = n_tokens;
+    logits_idx_ = 0;
+    text_.clear();
+    for (int i = n_prompt_; i < n_tokens; i++) {
+        append_piece(model_, tokens_[i], text_);
+    }
+    // A resumed request streams what it had so far with its next token
+    n_emitted_ = 0;
+    stats_.n_generated = n_tokens - n_prompt_;
+    stats_.n_restored = n_tokens - 1;
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// EMBEDDING
+// ════════════════════════════════════════════════════════════════════
+
+bool embed(llama_model* model, llama_context* ctx, const std::string& text, llama_seq_id seq,
+           int max_tokens, const std::function<bool()>& should_stop, std::vector<float>& out) {
+    std::vector<llama_token> tokens;
+    if (!tokenize(model, text, true, tokens) || tokens.empty()) {
+        return false;
+    }
+    if (max_tokens > 0 && (int) tokens.size() > max_tokens) {
+        tokens.resize(max_tokens);
+    }
+
+    const int n_embd = llama_n_embd(model);
+    const int n_batch = (int) llama_n_batch(ctx);
+    std::vector<double> sum(n_embd, 0.0);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    bool ok = true;
+
+    // Hidden states instead of logits while this runs
+    llama_set_embeddings(ctx, true);
+    llama_kv_cache_seq_rm(ctx, seq, -1, -1);
+    for (int start = 0; ok && start < (int) tokens.size(); start += n_batch) {
+        if (start > 0 && should_stop && should_stop()) {
+            ok = false;
+            break;
+        }
+        const int end = std::min(start + n_batch, (int) tokens.size());
+        llama_batch_clear(batch);
+        for (int i = start; i < end; i++) {
+            llama_batch_add(batch, tokens[i], i, { seq }, true);
+        }
+        if (llama_decode(ctx, batch) != 0) {
+            LOGE("Embedding decode failed");
+            ok = false;
+            break;
+        }
+        for (int i = 0; i < batch.n_tokens; i++) {
+            const float* e = llama_get_embeddings_ith(ctx, i);
+            if (e == nullptr) {
+                ok = false;
+                break;
+            }
+            for (int d = 0; d < n_embd; d++) {
+                sum[d] += e[d];
+            }
+        }
+    }
+    llama_set_embeddings(ctx, false);
+    llama_kv_cache_seq_rm(ctx, seq, -1, -1);
+    llama_batch_free(batch);
+    if (!ok) {
+        return false;
+    }
+
+    double norm = 0.0;
+    for (double v : sum) {
+        norm += v * v;
+    }
+    norm = norm > 0.0 ? std::sqrt(norm) : 1.0;
+    out.resize(n_embd);
+    for (int d = 0; d < n_embd; d++) {
+        out[d] = (float) (sum[d] / norm);
+    }
+    return true;
+}
+
+GenerationStatus generate(llama_model* model,
+                          llama_context* ctx,
+                          const std::string& prompt,
+                          const GenerationParams& params,
+                          const std::atomic<bool>& cancel,
+                          std::string& result,
+                          GenerationStats* stats) {
+    GenerationHooks hooks;
+    hooks.should_stop = [&cancel]() { return cancel.load(std::memory_order_relaxed); };
+    return generate(model, ctx, prompt, params, hooks, result, stats);
+}
+
+GenerationStatus generate(llama_model* model,
+                          llama_context* ctx,
+                          const std::string& prompt,
+                          const GenerationParams& params,
+                          const GenerationHooks& hooks,
+                          std::string& result,
+                          GenerationStats* stats) {
+    Generation gen(model, params, 0);
+    GenerationStatus status = gen.start(prompt);
+    if (status == GenerationStatus::OK) {
+        status = gen.run(ctx, hooks);
+        result += gen.text();
+    }
+    if (stats != nullptr) {
+        *stats = gen.stats();
+    }
+    return status;
+}
+
+} // namespace smith
@@ -0,0 +1,193 @@
+/**
+ * inference_core.h - Generation loop shared by the JNI bridge and native tools
+ * Guild of Smiths - Offline AI Module
+ *
+ * The JNI layer owns model/context lifetime and locking; this module only
+ * runs tokenize -> prefill -> sample/decode on whatever it is handed, so the
+ * benchmark harness exercises (and PGO profiles) exactly the shipped path.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace smith {
+
+class PrefixCache;
+struct GenerationCheckpoint;
+
+enum class GenerationStatus {
+    OK,
+    TOKENIZE_FAILED,
+    DECODE_FAILED,
+};
+
+struct GenerationParams {
+    int max_tokens = 256;
+    float temperature = 0.7f;
+    // Replay (teacher forcing): emit exactly these tokens instead of the
+    // sampled ones. Sampling still runs so timings match a live run;
+    // max_tokens and end-of-generation are ignored.
+    std::vector<llama_token> forced_tokens;
+};
+
+struct GenerationStats {
+    int n_prompt_tokens = 0;
+    int n_prefix_reused = 0;   // prompt tokens restored from the prefix cache
+    int n_restored = 0;        // prompt and generated tokens restored from a checkpoint
+    int n_generated = 0;
+    int n_forced_diverged = 0; // forced tokens the sampler would not have picked
+    int64_t t_tokenize_us = 0;
+    int64_t t_prefill_us = 0;
+    int64_t t_decode_us = 0;
+};
+
+/**
+ * Optional callbacks for one generation; either may be empty.
+ * should_stop is polled before every sampled token. on_text receives each
+ * newly produced chunk of output, cut on UTF-8 character boundaries.
+ */
+struct GenerationHooks {
+    std::function<bool()> should_stop;
+    std::function<void(const std::string& text)> on_text;
+};
+
+/** Tokenize text with the model vocabulary. Returns false on failure. */
+bool tokenize(const llama_model* model, const std::string& text,
+              bool add_special, std::vector<llama_token>& out);
+
+/** Greedy pick from a logits row; candidates is scratch space reused across calls. */
+llama_token sample_greedy(llama_context* ctx, const float* logits, int n_vocab,
+                          std::vector<llama_token_data>& candidates);
+
+/** Append the text piece for a token to out. */
+void append_piece(const llama_model* model, llama_token token, std::string& out);
+
+/**
+ * One resumable greedy generation on a single sequence of a context.
+ *
+ * start() tokenizes, then run() prefills and decodes until done().
+ * run() returns early when hooks.should_stop fires (checked between
+ * prefill slices and before each token); the generation can then be
+ * continued with another run(), or suspend()ed to hand the context to
+ * someone else: the sequence's KV cells and pending logits move to host
+ * memory and resume() restores them, so nothing is recomputed.
+ *
+ * save_state()/restore_state() do the same across processes: a checkpoint
+ * taken between tokens lets a new Generation carry on after start() with
+ * only the last token decoded again.
+ */
+class Generation {
+public:
+    Generation(llama_model* model, const GenerationParams& params, llama_seq_id seq);
+    ~Generation();
+
+    Generation(const Generation&) = delete;
+    Generation& operator=(const Generation&) = delete;
+
+    /** Tokenize the prompt. Does not touch the context. */
+    GenerationStatus start(const std::string& prompt);
+
+    /** Restore a cached prompt prefix before prefill instead of decoding it. */
+    void set_prefix_cache(PrefixCache* cache) { prefix_cache_ = cache; }
+
+    /** Prefill (replacing this sequence's cells), then sample and decode until done or stopped. */
+    GenerationStatus run(llama_context* ctx, const GenerationHooks& hooks);
+
+    /** Snapshot this sequence and remove it from ctx. */
+    bool suspend(llama_context* ctx);
+
+    /** Put a suspended sequence back into ctx. */
+    bool resume(llama_context* ctx);
+
+    /**
+     * Copy tokens and this sequence's KV cells into cp (request fields are
+     * left to the caller). Only possible between tokens, once the prompt is
+     * in; the sequence stays live.
+     */
+    bool save_state(llama_context* ctx, GenerationCheckpoint& cp) const;
+
+    /**
+     * Continue from cp instead of prefilling. Call after start(); fails if
+     * cp was taken for a different prompt, and the generation is then
+     * untouched and can run() from scratch.
+     */
+    bool restore_state(llama_context* ctx, const GenerationCheckpoint& cp);
+
+    bool done() const { return done_; }
+    bool suspended() const { return suspended_; }
+    size_t snapshot_bytes() const { return saved_kv_.size() + saved_logits_.size() * sizeof(float); }
+    const std::string& text() const { return text_; }
+    std::vector<llama_token> generated_tokens() const {
+        return std::vector<llama_token>(tokens_.begin() + n_prompt_, tokens_.end());
+    }
+    const GenerationStats& stats() const { return stats_; }
+
+private:
+    void ensure_batch(int n_tokens);
+
+    llama_model* model_;
+    GenerationParams params_;
+    llama_seq_id seq_;
+    PrefixCache* prefix_cache_ = nullptr;
+
+    llama_batch batch_ = {};
+    int batch_capacity_ = 0;
+
+    std::vector<llama_token> tokens_;  // prompt then generated
+    int n_prompt_ = 0;
+    int n_past_ = 0;                   // tokens decoded into the sequence
+    int logits_idx_ = 0;
+    std::string text_;
+    size_t n_emitted_ = 0;
+    bool done_ = false;
+    GenerationStats stats_;
+
+    bool suspended_ = false;
+    std::vector<uint8_t> saved_kv_;
+    std::vector<float> saved_logits_;
+};
+
+/**
+ * Run a full generation on seq 0 of ctx, replacing that sequence's cells.
+ * Checks cancel between tokens. stats may be null.
+ */
+GenerationStatus generate(llama_model* model,
+                          llama_context* ctx,
+                          const std::string& prompt,
+                          const GenerationParams& params,
+                          const std::atomic<bool>& cancel,
+                          std::string& result,
+                          GenerationStats* stats);
+
+/** As above, with hooks for stop polling and streaming output. */
+GenerationStatus generate(llama_model* model,
+                          llama_context* ctx,
+                          const std::string& prompt,
+                          const GenerationParams& params,
+                          const GenerationHooks& hooks,
+                          std::string& result,
+                          GenerationStats* stats);
+
+/**
+ * Embedding of text for similarity search: the model's last hidden state,
+ * mean-pooled over tokens and L2-normalized (llama_n_embd floats). Uses
+ * seq of ctx and leaves it empty. Long texts are cut at max_tokens.
+ * @return false if tokenizing or decoding fails, or should_stop fires
+ */
+bool embed(llama_model* model, llama_context* ctx, const std::string& text, llama_seq_id seq,
+           int max_tokens, const std::function<bool()>& should_stop, std::vector<float>& out);
+
+/** Length of the longest prefix of s that does not end inside a UTF-8 sequence. */
+size_t utf8_complete_length(const std::string& s);
+
+/** Microseconds on a monotonic clock. */
+int64_t now_us();
+
+} // namespace smith
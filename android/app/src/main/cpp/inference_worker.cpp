@@ -0,0 +1,668 @@
+/**
+ * inference_worker.cpp - Running the engine in a separate process
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "InferenceWorker"
+
+#include "inference_worker.h"
+#include "native_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace smith {
+
+// How long a caller waits for room in a full ring before giving up
+static const int SEND_TIMEOUT_MS = 5000;
+
+enum class WorkerMessage : uint32_t {
+    // app -> worker; LOAD, UNLOAD, CHECKPOINT_DIR and PREFIX_CACHE_DIR are answered with REPLY
+    LOAD = 1,
+    UNLOAD = 2,
+    CHECKPOINT_DIR = 3,
+    GENERATE = 4,
+    BATCH = 5,
+    WARM = 6,
+    EMBED = 7,
+    CODEC = 8,
+    PREFIX_CACHE_DIR = 9,
+    // worker -> app
+    REPLY = 64,
+    TEXT = 65,
+    COMPLETE = 66,
+    ERROR = 67,
+    BATCH_COMPLETE = 68,
+    EMBEDDINGS = 69,
+};
+
+static uint32_t wire(WorkerMessage type) {
+    return (uint32_t) type;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// WIRE FORMAT (little-endian fields, u32-length strings)
+// ════════════════════════════════════════════════════════════════════
+
+class WireWriter {
+public:
+    template <typename T> WireWriter& pod(const T& v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        buf_.insert(buf_.end(), p, p + sizeof(v));
+        return *this;
+    }
+    WireWriter& str(const std::string& s) {
+        pod((uint32_t) s.size());
+        buf_.insert(buf_.end(), s.begin(), s.end());
+        return *this;
+    }
+    WireWriter& floats(const std::vector<float>& v) {
+        return array(v);
+    }
+    WireWriter& tokens(const std::vector<llama_token>& v) {
+        return array(v);
+    }
+    const std::vector<uint8_t>& data() const { return buf_; }
+
+private:
+    template <typename T> WireWriter& array(const std::vector<T>& v) {
+        pod((uint32_t) v.size());
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(v.data());
+        buf_.insert(buf_.end(), p, p + v.size() * sizeof(T));
+        return *this;
+    }
+
+    std::vector<uint8_t> buf_;
+};
+
+class WireReader {
+public:
+    explicit WireReader(const std::vector<uint8_t>& buf) : p_(buf.data()), end_(buf.data() + buf.size()) {}
+
+    template <typename T> T pod() {
+        T v{};
+        if ((size_t) (end_ - p_) < sizeof(T)) {
+            ok_ = false;
+            return v;
+        }
+        memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return v;
+    }
+    std::string str() {
+        const uint32_t n = pod<uint32_t>();
+        if (!ok_ || (size_t) (end_ - p_) < n) {
+            ok_ = false;
+            return std::string();
+        }
+        std::string s(reinterpret_cast<const char*>(p_), n);
+        p_ += n;
+        return s;
+    }
+    std::vector<float> floats() {
+        return array<float>();
+    }
+    std::vector<llama_token> tokens() {
+        return array<llama_token>();
+    }
+    bool ok() const { return ok_; }
+
+private:
+    template <typename T> std::vector<T> array() {
+        const uint32_t n = pod<uint32_t>();
+        std::vector<T> v;
+        if (!ok_ || (size_t) (end_ - p_) / sizeof(T) < n) {
+            ok_ = false;
+            return v;
+        }
+        v.resize(n);
+        memcpy(v.data(), p_, n * sizeof(T));
+        p_ += n * sizeof(T);
+        return v;
+    }
+
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
+
+static Priority read_priority(WireReader& r) {
+    const uint8_t p = r.pod<uint8_t>();
+    return static_cast<Priority>(p < PRIORITY_COUNT ? p : (uint8_t) Priority::NORMAL);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// WORKER SIDE
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * Submissions go straight to the engine's lock-free inbox from the reader
+ * thread. Calls that wait for the model (load, unload, checkpoint dir) run
+ * in order on their own thread so cancellation is never stuck behind them.
+ */
+class WorkerServer : public EngineListener {
+public:
+    explicit WorkerServer(std::unique_ptr<IpcChannel> channel) : channel_(std::move(channel)) {}
+
+    void run() {
+        engine_.reset(new Engine(*this));
+        std::thread calls(&WorkerServer::calls_loop, this);
+
+        RingMessage message;
+        ControlFrame control;
+        bool is_control = false;
+        while (channel_->receive(message, control, is_control)) {
+            if (!is_control) {
+                handle(message);
+            } else if (control.type == ControlType::CANCEL) {
+                engine_->cancel(control.id);
+            } else if (control.type == ControlType::CANCEL_ALL) {
+                engine_->cancel_all();
+            }
+        }
+        LOGI("Client closed the channel");
+
+        {
+            std::lock_guard<std::mutex> lock(calls_mutex_);
+            calls_stop_ = true;
+        }
+        calls_cv_.notify_one();
+        calls.join();
+        engine_.reset();
+    }
+
+    void on_text(uint64_t id, const std::string& text) override {
+        WireWriter w;
+        w.str(text);
+        channel_->send(wire(WorkerMessage::TEXT), id, w.data());
+    }
+
+    void on_complete(uint64_t id, const std::string& text, const GenerationStats& stats) override {
+        WireWriter w;
+        w.str(text)
+         .pod((int32_t) stats.n_prompt_tokens)
+         .pod((int32_t) stats.n_prefix_reused)
+         .pod((int32_t) stats.n_restored)
+         .pod((int32_t) stats.n_generated)
+         .pod((int32_t) stats.n_forced_diverged)
+         .pod(stats.t_tokenize_us)
+         .pod(stats.t_prefill_us)
+         .pod(stats.t_decode_us);
+        channel_->send(wire(WorkerMessage::COMPLETE), id, w.data());
+    }
+
+    void on_error(uint64_t id, const std::string& error) override {
+        WireWriter w;
+        w.str(error);
+        channel_->send(wire(WorkerMessage::ERROR), id, w.data());
+    }
+
+    void on_batch_complete(uint64_t id, const std::vector<BatchItemResult>& results,
+                           const BatchStats& stats) override {
+        WireWriter w;
+        w.pod((uint32_t) results.size());
+        for (const BatchItemResult& r : results) {
+            w.pod((uint8_t) r.status)
+             .pod((uint8_t) r.finished)
+             .str(r.text)
+             .pod((int32_t) r.n_prompt_tokens)
+             .pod((int32_t) r.n_prefix_shared)
+             .pod((int32_t) r.n_generated)
+             .pod(r.t_first_token_us)
+             .pod(r.t_latency_us);
+        }
+        w.pod((int32_t) stats.n_items)
+         .pod((int32_t) stats.n_waves)
+         .pod((int32_t) stats.n_decode_calls)
+         .pod((int32_t) stats.n_prefill_tokens_saved)
+         .pod(stats.t_total_us);
+        channel_->send(wire(WorkerMessage::BATCH_COMPLETE), id, w.data());
+    }
+
+    void on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) override {
+        WireWriter w;
+        w.pod((int32_t) n_embd).floats(vectors);
+        channel_->send(wire(WorkerMessage::EMBEDDINGS), id, w.data());
+    }
+
+private:
+    void handle(RingMessage& message) {
+        WireReader r(message.payload);
+        bool queued = true;
+        switch (static_cast<WorkerMessage>(message.type)) {
+        case WorkerMessage::LOAD:
+        case WorkerMessage::UNLOAD:
+        case WorkerMessage::CHECKPOINT_DIR:
+        case WorkerMessage::PREFIX_CACHE_DIR: {
+            std::lock_guard<std::mutex> lock(calls_mutex_);
+            calls_.push_back(std::move(message));
+            calls_cv_.notify_one();
+            return;
+        }
+        case WorkerMessage::GENERATE: {
+            const std::string prompt = r.str();
+            GenerationParams params;
+            params.max_tokens = r.pod<int32_t>();
+            params.temperature = r.pod<float>();
+            const bool stream = r.pod<uint8_t>() != 0;
+            const Priority priority = read_priority(r);
+            const std::string key = r.str();
+            params.forced_tokens = r.tokens();
+            queued = r.ok() && engine_->submit(message.id, prompt, params, stream, priority, key);
+            break;
+        }
+        case WorkerMessage::BATCH: {
+            const Priority priority = read_priority(r);
+            const uint32_t n = r.pod<uint32_t>();
+            std::vector<BatchItem> items;
+            for (uint32_t i = 0; i < n && r.ok(); i++) {
+                BatchItem item;
+                item.prompt = r.str();
+                item.params.max_tokens = r.pod<int32_t>();
+                item.params.temperature = r.pod<float>();
+                items.push_back(std::move(item));
+            }
+            queued = r.ok() && engine_->submit_batch(message.id, std::move(items), priority);
+            break;
+        }
+        case WorkerMessage::WARM: {
+            const Priority priority = read_priority(r);
+            const std::string prompt = r.str();
+            queued = r.ok() && engine_->submit_warm(message.id, prompt, priority);
+            break;
+        }
+        case WorkerMessage::EMBED: {
+            const Priority priority = read_priority(r);
+            const uint32_t n = r.pod<uint32_t>();
+            std::vector<std::string> texts;
+            for (uint32_t i = 0; i < n && r.ok(); i++) {
+                texts.push_back(r.str());
+            }
+            queued = r.ok() && engine_->submit_embed(message.id, std::move(texts), priority);
+            break;
+        }
+        case WorkerMessage::CODEC: {
+            const Priority priority = read_priority(r);
+            const CodecOp op = r.pod<uint8_t>() == 0 ? CodecOp::ENCODE : CodecOp::DECODE;
+            const uint32_t max_bytes = r.pod<uint32_t>();
+            const std::string data = r.str();
+            queued = r.ok() && engine_->submit_codec(message.id, op, data, max_bytes, priority);
+            break;
+        }
+        default:
+            LOGW("Unknown message type %u", message.type);
+            return;
+        }
+        if (!queued) {
+            on_error(message.id, r.ok() ? "Engine stopping" : "Malformed request");
+        }
+    }
+
+    void calls_loop() {
+        while (true) {
+            RingMessage message;
+            {
+                std::unique_lock<std::mutex> lock(calls_mutex_);
+                calls_cv_.wait(lock, [this]() { return calls_stop_ || !calls_.empty(); });
+                if (calls_.empty()) {
+                    return;
+                }
+                message = std::move(calls_.front());
+                calls_.pop_front();
+            }
+
+            WireReader r(message.payload);
+            bool ok = true;
+            switch (static_cast<WorkerMessage>(message.type)) {
+            case WorkerMessage::LOAD: {
+                const std::string path = r.str();
+                const int n_ctx = r.pod<int32_t>();
+                const int n_threads = r.pod<int32_t>();
+                ok = r.ok() && engine_->load_model(path, n_ctx, n_threads);
+                break;
+            }
+            case WorkerMessage::UNLOAD:
+                engine_->unload_model();
+                break;
+            case WorkerMessage::PREFIX_CACHE_DIR: {
+                const std::string dir = r.str();
+                const uint64_t max_bytes = r.pod<uint64_t>();
+                if (r.ok()) {
+                    engine_->set_prefix_cache_dir(dir, (size_t) max_bytes);
+                }
+                break;
+            }
+            default:
+                engine_->set_checkpoint_dir(r.str());
+                break;
+            }
+
+            int n_vocab = 0, n_ctx = 0, n_embd = 0;
+            if (ok && !engine_->model_info(n_vocab, n_ctx, n_embd)) {
+                n_vocab = n_ctx = n_embd = 0;
+            }
+            WireWriter w;
+            w.pod((uint8_t) ok).pod((int32_t) n_vocab).pod((int32_t) n_ctx).pod((int32_t) n_embd);
+            channel_->send(wire(WorkerMessage::REPLY), message.id, w.data());
+        }
+    }
+
+    std::unique_ptr<IpcChannel> channel_;
+    std::unique_ptr<Engine> engine_;
+
+    std::mutex calls_mutex_;
+    std::condition_variable calls_cv_;
+    std::deque<RingMessage> calls_;
+    bool calls_stop_ = false;
+};
+
+int serve_worker(int control_fd, int shm_fd) {
+    std::unique_ptr<IpcChannel> channel = IpcChannel::attach(control_fd, shm_fd);
+    if (!channel) {
+        LOGE("Cannot attach to the client's channel");
+        return 1;
+    }
+    llama_backend_init();
+    LOGI("Inference worker %d serving", (int) getpid());
+    WorkerServer server(std::move(channel));
+    server.run();
+    return 0;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// APP SIDE
+// ════════════════════════════════════════════════════════════════════
+
+WorkerClient::WorkerClient(std::unique_ptr<IpcChannel> channel, EngineListener& listener)
+    : channel_(std::move(channel)), listener_(listener) {
+    reader_ = std::thread(&WorkerClient::reader_loop, this);
+}
+
+WorkerClient::~WorkerClient() {
+    stopping_.store(true, std::memory_order_release);
+    channel_->close();
+    reader_.join();
+    if (child_pid_ > 0) {
+        waitpid(child_pid_, nullptr, 0);
+    }
+}
+
+std::unique_ptr<WorkerClient> WorkerClient::create(EngineListener& listener,
+                                                   int& worker_control_fd, int& worker_shm_fd) {
+    std::unique_ptr<IpcChannel> channel = IpcChannel::create(WORKER_RING_BYTES, worker_control_fd, worker_shm_fd);
+    if (!channel) {
+        return nullptr;
+    }
+    return std::unique_ptr<WorkerClient>(new WorkerClient(std::move(channel), listener));
+}
+
+std::unique_ptr<WorkerClient> WorkerClient::spawn(const std::string& worker_path, EngineListener& listener) {
+    int control_fd = -1;
+    int shm_fd = -1;
+    std::unique_ptr<WorkerClient> client = create(listener, control_fd, shm_fd);
+    if (!client) {
+        return nullptr;
+    }
+
+    // Formatted before fork: the child may only make async-signal-safe calls
+    char control_arg[16];
+    char shm_arg[16];
+    snprintf(control_arg, sizeof(control_arg), "%d", control_fd);
+    snprintf(shm_arg, sizeof(shm_arg), "%d", shm_fd);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // The client's own ends are close-on-exec; the worker's must survive exec
+        fcntl(control_fd, F_SETFD, 0);
+        fcntl(shm_fd, F_SETFD, 0);
+        execl(worker_path.c_str(), worker_path.c_str(),
+              "--control-fd", control_arg, "--shm-fd", shm_arg, (char*) nullptr);
+        _exit(127);
+    }
+    close(control_fd);
+    close(shm_fd);
+    if (pid < 0) {
+        LOGE("fork failed");
+        return nullptr;
+    }
+    client->child_pid_ = pid;
+    return client;
+}
+
+bool WorkerClient::post(uint32_t type, uint64_t id, const std::vector<uint8_t>& payload) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_.insert(id);
+    }
+    if (channel_->send(type, id, payload, SEND_TIMEOUT_MS)) {
+        return true;
+    }
+    finish(id);
+    return false;
+}
+
+void WorkerClient::finish(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outstanding_.erase(id);
+}
+
+bool WorkerClient::call(uint32_t type, const std::vector<uint8_t>& payload, Reply& reply) {
+    const uint64_t call_id = next_call_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replies_[call_id] = Reply();
+    }
+    bool sent = channel_->send(type, call_id, payload, SEND_TIMEOUT_MS);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (sent) {
+        reply_cv_.wait(lock, [this, call_id]() { return replies_[call_id].done || !alive(); });
+    }
+    reply = replies_[call_id];
+    replies_.erase(call_id);
+    return reply.done && reply.ok;
+}
+
+bool WorkerClient::load_model(const std::string& path, int n_ctx, int n_threads) {
+    publish_status(ModelStatus());
+    WireWriter w;
+    w.str(path).pod((int32_t) n_ctx).pod((int32_t) n_threads);
+    Reply reply;
+    if (!call(wire(WorkerMessage::LOAD), w.data(), reply)) {
+        return false;
+    }
+    ModelStatus status;
+    status.loaded = true;
+    status.n_vocab = reply.n_vocab;
+    status.n_ctx = reply.n_ctx;
+    status.n_embd = reply.n_embd;
+    publish_status(status);
+    return true;
+}
+
+void WorkerClient::unload_model() {
+    publish_status(ModelStatus());
+    Reply reply;
+    call(wire(WorkerMessage::UNLOAD), std::vector<uint8_t>(), reply);
+}
+
+void WorkerClient::set_checkpoint_dir(const std::string& dir) {
+    WireWriter w;
+    w.str(dir);
+    Reply reply;
+    call(wire(WorkerMessage::CHECKPOINT_DIR), w.data(), reply);
+}
+
+void WorkerClient::set_prefix_cache_dir(const std::string& dir, size_t max_bytes) {
+    WireWriter w;
+    w.str(dir).pod((uint64_t) max_bytes);
+    Reply reply;
+    call(wire(WorkerMessage::PREFIX_CACHE_DIR), w.data(), reply);
+}
+
+bool WorkerClient::submit(uint64_t id, const std::string& prompt, const GenerationParams& params,
+                          bool stream, Priority priority, const std::string& checkpoint_key) {
+    WireWriter w;
+    w.str(prompt)
+     .pod((int32_t) params.max_tokens)
+     .pod(params.temperature)
+     .pod((uint8_t) stream)
+     .pod((uint8_t) priority)
+     .str(checkpoint_key)
+     .tokens(params.forced_tokens);
+    return post(wire(WorkerMessage::GENERATE), id, w.data());
+}
+
+bool WorkerClient::submit_batch(uint64_t id, std::vector<BatchItem> items, Priority priority) {
+    WireWriter w;
+    w.pod((uint8_t) priority).pod((uint32_t) items.size());
+    for (const BatchItem& item : items) {
+        w.str(item.prompt).pod((int32_t) item.params.max_tokens).pod(item.params.temperature);
+    }
+    return post(wire(WorkerMessage::BATCH), id, w.data());
+}
+
+bool WorkerClient::submit_warm(uint64_t id, const std::string& prompt, Priority priority) {
+    WireWriter w;
+    w.pod((uint8_t) priority).str(prompt);
+    return post(wire(WorkerMessage::WARM), id, w.data());
+}
+
+bool WorkerClient::submit_embed(uint64_t id, std::vector<std::string> texts, Priority priority) {
+    WireWriter w;
+    w.pod((uint8_t) priority).pod((uint32_t) texts.size());
+    for (const std::string& text : texts) {
+        w.str(text);
+    }
+    return post(wire(WorkerMessage::EMBED), id, w.data());
+}
+
+bool WorkerClient::submit_codec(uint64_t id, CodecOp op, const std::string& data, size_t max_bytes,
+                                Priority priority) {
+    WireWriter w;
+    w.pod((uint8_t) priority).pod((uint8_t) op).pod((uint32_t) max_bytes).str(data);
+    return post(wire(WorkerMessage::CODEC), id, w.data());
+}
+
+void WorkerClient::cancel(uint64_t id) {
+    channel_->send_control(ControlType::CANCEL, id);
+}
+
+void WorkerClient::cancel_all() {
+    channel_->send_control(ControlType::CANCEL_ALL);
+}
+
+void WorkerClient::reader_loop() {
+    listener_.on_worker_start();
+
+    RingMessage message;
+    ControlFrame control;
+    bool is_control = false;
+    while (channel_->receive(message, control, is_control)) {
+        if (is_control) {
+            continue;
+        }
+        WireReader r(message.payload);
+        const uint64_t id = message.id;
+        switch (static_cast<WorkerMessage>(message.type)) {
+        case WorkerMessage::REPLY: {
+            Reply reply;
+            reply.ok = r.pod<uint8_t>() != 0;
+            reply.n_vocab = r.pod<int32_t>();
+            reply.n_ctx = r.pod<int32_t>();
+            reply.n_embd = r.pod<int32_t>();
+            reply.done = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = replies_.find(id);
+                if (it != replies_.end()) {
+                    it->second = reply;
+                }
+            }
+            reply_cv_.notify_all();
+            break;
+        }
+        case WorkerMessage::TEXT:
+            listener_.on_text(id, r.str());
+            break;
+        case WorkerMessage::COMPLETE: {
+            const std::string text = r.str();
+            GenerationStats stats;
+            stats.n_prompt_tokens = r.pod<int32_t>();
+            stats.n_prefix_reused = r.pod<int32_t>();
+            stats.n_restored = r.pod<int32_t>();
+            stats.n_generated = r.pod<int32_t>();
+            stats.n_forced_diverged = r.pod<int32_t>();
+            stats.t_tokenize_us = r.pod<int64_t>();
+            stats.t_prefill_us = r.pod<int64_t>();
+            stats.t_decode_us = r.pod<int64_t>();
+            finish(id);
+            listener_.on_complete(id, text, stats);
+            break;
+        }
+        case WorkerMessage::ERROR: {
+            const std::string error = r.str();
+            finish(id);
+            listener_.on_error(id, error);
+            break;
+        }
+        case WorkerMessage::BATCH_COMPLETE: {
+            std::vector<BatchItemResult> results(r.pod<uint32_t>());
+            for (size_t i = 0; i < results.size() && r.ok(); i++) {
+                BatchItemResult& item = results[i];
+                item.status = static_cast<GenerationStatus>(r.pod<uint8_t>());
+                item.finished = r.pod<uint8_t>() != 0;
+                item.text = r.str();
+                item.n_prompt_tokens = r.pod<int32_t>();
+                item.n_prefix_shared = r.pod<int32_t>();
+                item.n_generated = r.pod<int32_t>();
+                item.t_first_token_us = r.pod<int64_t>();
+                item.t_latency_us = r.pod<int64_t>();
+            }
+            BatchStats stats;
+            stats.n_items = r.pod<int32_t>();
+            stats.n_waves = r.pod<int32_t>();
+            stats.n_decode_calls = r.pod<int32_t>();
+            stats.n_prefill_tokens_saved = r.pod<int32_t>();
+            stats.t_total_us = r.pod<int64_t>();
+            finish(id);
+            listener_.on_batch_complete(id, results, stats);
+            break;
+        }
+        case WorkerMessage::EMBEDDINGS: {
+            const int n_embd = r.pod<int32_t>();
+            const std::vector<float> vectors = r.floats();
+            finish(id);
+            listener_.on_embeddings(id, n_embd, vectors);
+            break;
+        }
+        default:
+            LOGW("Unknown event type %u", message.type);
+            break;
+        }
+    }
+
+    // The worker is gone: nothing outstanding will ever complete
+    publish_status(ModelStatus());
+    std::set<uint64_t> lost;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lost.swap(outstanding_);
+    }
+    reply_cv_.notify_all();
+    if (!stopping_.load(std::memory_order_acquire)) {
+        LOGE("Inference worker exited with %zu requests outstanding", lost.size());
+        for (uint64_t id : lost) {
+            listener_.on_error(id, "Inference worker exited");
+        }
+        listener_.on_backend_lost();
+    }
+    listener_.on_worker_stop();
+}
+
+} // namespace smith
@@ -0,0 +1,119 @@
+/**
+ * inference_worker.h - Running the engine in a separate process
+ * Guild of Smiths - Offline AI Module
+ *
+ * A 1-2 GB model in the app process means an OOM kill during inference
+ * takes messaging down with it. Instead, the engine can live in a worker
+ * process (an Android service in its own process, or a child process on
+ * Linux) and the app talks to it over an IpcChannel:
+ *
+ *   serve_worker()  - worker side: owns an Engine, runs commands read from
+ *                     the channel and sends engine events back
+ *   WorkerClient    - app side: an InferenceBackend that turns each call
+ *                     into a message and each event back into an
+ *                     EngineListener callback on its reader thread
+ *
+ * The JNI bridge drives either backend the same way. If the worker dies,
+ * every outstanding request fails with "Inference worker exited" and
+ * listener.on_backend_lost() fires; the app can then start a new worker.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.h"
+#include "ipc_channel.h"
+
+namespace smith {
+
+// Per direction; holds a few hundred streamed chunks or one large batch result
+static const size_t WORKER_RING_BYTES = 4u * 1024 * 1024;
+
+/**
+ * Serve an engine over the channel ends from WorkerClient::create until
+ * the client closes its end or dies. Blocks; initializes the llama backend.
+ * @return 0 on a clean shutdown, 1 if the channel could not be attached
+ */
+int serve_worker(int control_fd, int shm_fd);
+
+class WorkerClient : public InferenceBackend {
+public:
+    /**
+     * Make a channel for a worker that will be started separately (e.g. an
+     * Android service). The worker's ends are returned for passing to
+     * serve_worker() in that process; close them here once passed.
+     */
+    static std::unique_ptr<WorkerClient> create(EngineListener& listener,
+                                                int& worker_control_fd, int& worker_shm_fd);
+
+    /** Start worker_path as a child process serving this client (host builds and tools). */
+    static std::unique_ptr<WorkerClient> spawn(const std::string& worker_path, EngineListener& listener);
+
+    ~WorkerClient() override;
+
+    WorkerClient(const WorkerClient&) = delete;
+    WorkerClient& operator=(const WorkerClient&) = delete;
+
+    /** False once the worker has exited. */
+    bool alive() const { return !channel_->closed(); }
+
+    bool load_model(const std::string& path, int n_ctx, int n_threads) override;
+    void unload_model() override;
+    void set_checkpoint_dir(const std::string& dir) override;
+    void set_prefix_cache_dir(const std::string& dir, size_t max_bytes) override;
+
+    bool submit(uint64_t id, const std::string& prompt, const GenerationParams& params,
+                bool stream, Priority priority = Priority::NORMAL,
+                const std::string& checkpoint_key = std::string()) override;
+    bool submit_batch(uint64_t id, std::vector<BatchItem> items,
+                      Priority priority = Priority::BACKGROUND) override;
+    bool submit_warm(uint64_t id, const std::string& prompt, Priority priority = Priority::IDLE) override;
+    bool submit_embed(uint64_t id, std::vector<std::string> texts,
+                      Priority priority = Priority::IDLE) override;
+    bool submit_codec(uint64_t id, CodecOp op, const std::string& data, size_t max_bytes,
+                      Priority priority = Priority::INTERACTIVE) override;
+    void cancel(uint64_t id) override;
+    void cancel_all() override;
+
+private:
+    struct Reply {
+        bool done = false;
+        bool ok = false;
+        int n_vocab = 0;
+        int n_ctx = 0;
+        int n_embd = 0;
+    };
+
+    WorkerClient(std::unique_ptr<IpcChannel> channel, EngineListener& listener);
+
+    void reader_loop();
+    bool call(uint32_t type, const std::vector<uint8_t>& payload, Reply& reply);
+    bool post(uint32_t type, uint64_t id, const std::vector<uint8_t>& payload);
+    void finish(uint64_t id);
+
+    std::unique_ptr<IpcChannel> channel_;
+    EngineListener& listener_;
+    int child_pid_ = -1;
+
+    std::atomic<bool> stopping_{ false };
+    std::atomic<uint64_t> next_call_{ 1 };
+
+    std::mutex mutex_;                 // guards everything below
+    std::condition_variable reply_cv_;
+    std::map<uint64_t, Reply> replies_;
+    std::set<uint64_t> outstanding_;   // requests not yet completed or failed
+
+    std::thread reader_;
+};
+
+} // namespace smith
@@ -0,0 +1,324 @@
+/**
+ * ipc_channel.cpp - Shared-memory transport between the app and the inference worker
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "IpcChannel"
+
+#include "ipc_channel.h"
+#include "native_log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/sharedmem.h>
+#endif
+
+namespace smith {
+
+static const uint32_t REGION_MAGIC = 0x43504953;  // "SIPC"
+static const uint32_t REGION_VERSION = 1;
+static const size_t RING_OFFSET = 64;
+static const uint32_t MIN_RING_BYTES = 4096;
+
+// Per-message header inside a ring; frames are padded to 8 bytes
+struct FrameHeader {
+    uint32_t size;
+    uint32_t type;
+    uint64_t id;
+};
+
+struct RegionHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_capacity;
+    uint32_t reserved;
+};
+
+static uint32_t frame_bytes(uint32_t payload) {
+    return (uint32_t) ((sizeof(FrameHeader) + payload + 7) & ~(size_t) 7);
+}
+
+static size_t region_bytes(uint32_t capacity) {
+    return RING_OFFSET + 2 * (sizeof(RingControl) + capacity);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// RING
+// ════════════════════════════════════════════════════════════════════
+
+void ShmRing::copy_in(uint32_t pos, const void* src, uint32_t size) {
+    const uint32_t cap = control_->capacity;
+    const uint32_t at = pos & (cap - 1);
+    const uint32_t first = size < cap - at ? size : cap - at;
+    memcpy(data_ + at, src, first);
+    memcpy(data_, static_cast<const uint8_t*>(src) + first, size - first);
+}
+
+void ShmRing::copy_out(uint32_t pos, void* dst, uint32_t size) const {
+    const uint32_t cap = control_->capacity;
+    const uint32_t at = pos & (cap - 1);
+    const uint32_t first = size < cap - at ? size : cap - at;
+    memcpy(dst, data_ + at, first);
+    memcpy(static_cast<uint8_t*>(dst) + first, data_, size - first);
+}
+
+uint32_t ShmRing::max_payload() const {
+    return control_->capacity - (uint32_t) sizeof(FrameHeader);
+}
+
+bool ShmRing::try_write(uint32_t type, uint64_t id, const uint8_t* payload, uint32_t size, bool& was_empty) {
+    const uint32_t frame = frame_bytes(size);
+    if (size > max_payload()) {
+        return false;
+    }
+    const uint32_t head = control_->head.load(std::memory_order_relaxed);
+    const uint32_t tail = control_->tail.load(std::memory_order_seq_cst);
+    if (control_->capacity - (head - tail) < frame) {
+        return false;
+    }
+
+    const FrameHeader header = { size, type, id };
+    copy_in(head, &header, sizeof(header));
+    copy_in(head + sizeof(header), payload, size);
+    control_->head.store(head + frame, std::memory_order_seq_cst);
+
+    // Reloaded after publishing: pairs with the consumer's tail store then
+    // head load, so at least one side sees the other and no doorbell is lost
+    was_empty = control_->tail.load(std::memory_order_seq_cst) == head;
+    return true;
+}
+
+bool ShmRing::try_read(RingMessage& out) {
+    const uint32_t tail = control_->tail.load(std::memory_order_relaxed);
+    const uint32_t head = control_->head.load(std::memory_order_seq_cst);
+    if (head == tail) {
+        return false;
+    }
+
+    FrameHeader header;
+    copy_out(tail, &header, sizeof(header));
+    if (header.size > max_payload() || frame_bytes(header.size) > head - tail) {
+        // Only a broken peer writes this; drop everything rather than read garbage
+        LOGE("Corrupt ring frame (%u bytes)", header.size);
+        control_->tail.store(head, std::memory_order_seq_cst);
+        return false;
+    }
+    out.type = header.type;
+    out.id = header.id;
+    out.payload.resize(header.size);
+    copy_out(tail + sizeof(header), out.payload.data(), header.size);
+    control_->tail.store(tail + frame_bytes(header.size), std::memory_order_seq_cst);
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// CHANNEL
+// ════════════════════════════════════════════════════════════════════
+
+static int create_shared_fd(size_t size) {
+#ifdef __ANDROID__
+    return ASharedMemory_create("smith-ipc", size);
+#else
+    int fd = (int) syscall(SYS_memfd_create, "smith-ipc", 0);
+    if (fd >= 0 && ftruncate(fd, (off_t) size) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+#endif
+}
+
+static size_t shared_fd_size(int fd) {
+#ifdef __ANDROID__
+    return ASharedMemory_getSize(fd);
+#else
+    struct stat st;
+    return fstat(fd, &st) == 0 ? (size_t) st.st_size : 0;
+#endif
+}
+
+IpcChannel::~IpcChannel() {
+    if (control_fd_ >= 0) {
+        ::close(control_fd_);
+    }
+    if (region_ != nullptr) {
+        munmap(region_, region_size_);
+    }
+}
+
+bool IpcChannel::map(int shm_fd, size_t size, bool creator) {
+    region_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (region_ == MAP_FAILED) {
+        region_ = nullptr;
+        LOGE("mmap of %zu bytes failed: %s", size, strerror(errno));
+        return false;
+    }
+    region_size_ = size;
+
+    uint8_t* base = static_cast<uint8_t*>(region_);
+    RegionHeader* header = reinterpret_cast<RegionHeader*>(base);
+    if (!creator && (header->magic != REGION_MAGIC || header->version != REGION_VERSION ||
+                     region_bytes(header->ring_capacity) > size)) {
+        LOGE("Not a channel region");
+        return false;
+    }
+    const uint32_t capacity = header->ring_capacity;
+    uint8_t* ring_a = base + RING_OFFSET;
+    uint8_t* ring_b = ring_a + sizeof(RingControl) + capacity;
+    RingControl* control_a = reinterpret_cast<RingControl*>(ring_a);
+    RingControl* control_b = reinterpret_cast<RingControl*>(ring_b);
+    if (creator) {
+        for (RingControl* c : { control_a, control_b }) {
+            new (c) RingControl();
+            c->head.store(0, std::memory_order_relaxed);
+            c->tail.store(0, std::memory_order_relaxed);
+            c->capacity = capacity;
+        }
+    }
+
+    ShmRing a(control_a, ring_a + sizeof(RingControl));
+    ShmRing b(control_b, ring_b + sizeof(RingControl));
+    tx_ = creator ? a : b;
+    rx_ = creator ? b : a;
+    return true;
+}
+
+std::unique_ptr<IpcChannel> IpcChannel::create(size_t ring_bytes, int& peer_control_fd, int& peer_shm_fd) {
+    uint32_t capacity = MIN_RING_BYTES;
+    while (capacity < ring_bytes && capacity < (1u << 30)) {
+        capacity <<= 1;
+    }
+    const size_t size = region_bytes(capacity);
+
+    std::unique_ptr<IpcChannel> channel(new IpcChannel());
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+        LOGE("socketpair failed: %s", strerror(errno));
+        return nullptr;
+    }
+    const int shm_fd = create_shared_fd(size);
+    if (shm_fd < 0) {
+        LOGE("Cannot create %zu bytes of shared memory", size);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return nullptr;
+    }
+
+    // The header must be in place before map() reads the capacity back
+    void* head = mmap(nullptr, sizeof(RegionHeader), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (head != MAP_FAILED) {
+        const RegionHeader header = { REGION_MAGIC, REGION_VERSION, capacity, 0 };
+        memcpy(head, &header, sizeof(header));
+        munmap(head, sizeof(RegionHeader));
+    }
+    channel->control_fd_ = fds[0];
+    if (head == MAP_FAILED || !channel->map(shm_fd, size, true)) {
+        ::close(fds[1]);
+        ::close(shm_fd);
+        return nullptr;
+    }
+    peer_control_fd = fds[1];
+    peer_shm_fd = shm_fd;
+    return channel;
+}
+
+std::unique_ptr<IpcChannel> IpcChannel::attach(int control_fd, int shm_fd) {
+    std::unique_ptr<IpcChannel> channel(new IpcChannel());
+    channel->control_fd_ = control_fd;
+    const size_t size = shared_fd_size(shm_fd);
+    const bool ok = size > RING_OFFSET && channel->map(shm_fd, size, false);
+    ::close(shm_fd);  // the mapping keeps the memory alive
+    return ok ? std::move(channel) : nullptr;
+}
+
+bool IpcChannel::send_control(ControlType type, uint64_t id) {
+    const ControlFrame frame = { type, 0, id };
+    // Doorbells can be dropped when the peer already has some pending
+    const int flags = MSG_NOSIGNAL | (type == ControlType::DOORBELL ? MSG_DONTWAIT : 0);
+    while (true) {
+        const ssize_t n = ::send(control_fd_, &frame, sizeof(frame), flags);
+        if (n == (ssize_t) sizeof(frame)) {
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        closed_.store(true, std::memory_order_release);
+        return false;
+    }
+}
+
+bool IpcChannel::send(uint32_t type, uint64_t id, const std::vector<uint8_t>& payload, int timeout_ms) {
+    std::lock_guard<std::mutex> lock(tx_mutex_);
+    if (payload.size() > tx_.max_payload()) {
+        LOGE("Message of %zu bytes exceeds the ring", payload.size());
+        return false;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool was_empty = false;
+    while (!tx_.try_write(type, id, payload.data(), (uint32_t) payload.size(), was_empty)) {
+        // Full: the consumer is behind, which only lasts a moment unless it is gone
+        if (closed() || (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return !was_empty || send_control(ControlType::DOORBELL);
+}
+
+bool IpcChannel::receive(RingMessage& message, ControlFrame& control, bool& is_control) {
+    while (true) {
+        if (rx_.try_read(message)) {
+            is_control = false;
+            return true;
+        }
+        if (closed()) {
+            return false;
+        }
+
+        struct pollfd pfd = { control_fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            closed_.store(true, std::memory_order_release);
+            continue;
+        }
+        const ssize_t n = recv(control_fd_, &control, sizeof(control), MSG_DONTWAIT);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (n != (ssize_t) sizeof(control)) {
+            // EOF: the peer closed or died; anything it queued is still read first
+            closed_.store(true, std::memory_order_release);
+            continue;
+        }
+        if (control.type != ControlType::DOORBELL) {
+            is_control = true;
+            return true;
+        }
+    }
+}
+
+void IpcChannel::close() {
+    closed_.store(true, std::memory_order_release);
+    if (control_fd_ >= 0) {
+        shutdown(control_fd_, SHUT_RDWR);
+    }
+}
+
+} // namespace smith
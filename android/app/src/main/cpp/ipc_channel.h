@@ -0,0 +1,141 @@
+/**
+ * ipc_channel.h - Shared-memory transport between the app and the inference worker
+ * Guild of Smiths - Offline AI Module
+ *
+ * One shared region holds two single-producer/single-consumer byte rings,
+ * one per direction, for everything with a payload (prompts, streamed
+ * text, results). A SOCK_SEQPACKET socket pair is the control channel:
+ * doorbells when a ring goes from empty to non-empty, cancellation that
+ * must not queue behind payloads, and liveness, since the peer's socket
+ * end closes when its process dies, however it dies.
+ *
+ * Both ends are plain file descriptors, so they can be handed to an
+ * Android service process through Binder or to a child process on Linux.
+ *
+ * Region layout:
+ *   RegionHeader | RingControl a | data a | RingControl b | data b
+ * The creator writes to ring a and reads ring b; the attacher the reverse.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace smith {
+
+/** Control channel frames. */
+enum class ControlType : uint32_t {
+    DOORBELL = 1,    // the sender's ring has new messages
+    CANCEL = 2,      // id = request to cancel
+    CANCEL_ALL = 3,
+};
+
+struct ControlFrame {
+    ControlType type;
+    uint32_t reserved;
+    uint64_t id;
+};
+
+/** One message taken from a ring. */
+struct RingMessage {
+    uint32_t type = 0;
+    uint64_t id = 0;
+    std::vector<uint8_t> payload;
+};
+
+/** Lives in shared memory; indices run freely and are masked by capacity. */
+struct RingControl {
+    alignas(64) std::atomic<uint32_t> head;   // written by the producer
+    alignas(64) std::atomic<uint32_t> tail;   // written by the consumer
+    alignas(64) uint32_t capacity;            // power of two
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "ring indices must be lock-free to be shared between processes");
+
+/** One direction of the region. Not thread-safe on either side. */
+class ShmRing {
+public:
+    ShmRing() = default;
+    ShmRing(RingControl* control, uint8_t* data) : control_(control), data_(data) {}
+
+    /**
+     * Append a message.
+     * @param was_empty Set if the consumer may be waiting for a doorbell
+     * @return false if there is no room right now
+     */
+    bool try_write(uint32_t type, uint64_t id, const uint8_t* payload, uint32_t size, bool& was_empty);
+
+    /** Take the oldest message; false if the ring is empty. */
+    bool try_read(RingMessage& out);
+
+    /** Largest payload that can ever fit. */
+    uint32_t max_payload() const;
+
+private:
+    void copy_in(uint32_t pos, const void* src, uint32_t size);
+    void copy_out(uint32_t pos, void* dst, uint32_t size) const;
+
+    RingControl* control_ = nullptr;
+    uint8_t* data_ = nullptr;
+};
+
+class IpcChannel {
+public:
+    ~IpcChannel();
+
+    IpcChannel(const IpcChannel&) = delete;
+    IpcChannel& operator=(const IpcChannel&) = delete;
+
+    /**
+     * Create a region with two rings of ring_bytes each (rounded up to a
+     * power of two) and a control socket pair. The peer's ends are
+     * returned for the caller to pass on and then close.
+     */
+    static std::unique_ptr<IpcChannel> create(size_t ring_bytes, int& peer_control_fd, int& peer_shm_fd);
+
+    /** Take over the peer's ends of a channel made by create(). */
+    static std::unique_ptr<IpcChannel> attach(int control_fd, int shm_fd);
+
+    /**
+     * Queue a message for the peer, waiting up to timeout_ms (-1 forever)
+     * while the ring is full. Safe from any thread.
+     * @return false if the peer is gone, the message can never fit, or the wait timed out
+     */
+    bool send(uint32_t type, uint64_t id, const std::vector<uint8_t>& payload, int timeout_ms = -1);
+
+    /** Send a control frame; safe from any thread. */
+    bool send_control(ControlType type, uint64_t id = 0);
+
+    /**
+     * Wait for the next event from the peer. Messages already in the ring
+     * come first; otherwise blocks until a doorbell or control frame.
+     * Call from one thread only.
+     * @return false once the peer has closed its end
+     */
+    bool receive(RingMessage& message, ControlFrame& control, bool& is_control);
+
+    /** Close the control socket; the peer's receive() then returns false. */
+    void close();
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    IpcChannel() = default;
+    bool map(int shm_fd, size_t size, bool creator);
+
+    int control_fd_ = -1;
+    void* region_ = nullptr;
+    size_t region_size_ = 0;
+    ShmRing tx_;
+    ShmRing rx_;
+    std::mutex tx_mutex_;
+    std::atomic<bool> closed_{ false };
+};
+
+} // namespace smith
@@ -0,0 +1,36 @@
+/**
+ * json_util.h - Minimal JSON string escaping for JNI result payloads
+ * Guild of Smiths - Offline AI Module
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace smith {
+
+/** Append s to out as a quoted JSON string. */
+inline void json_append_string(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char) c;
+                }
+        }
+    }
+    out += '"';
+}
+
+} // namespace smith
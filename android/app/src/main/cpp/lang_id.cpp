@@ -0,0 +1,323 @@
+/**
+ * lang_id.cpp - Character n-gram language identification
+ * Guild of Smiths - Offline AI Module
+ */
+
+#include "lang_id.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace smith {
+
+// ════════════════════════════════════════════════════════════════════
+// MODEL
+// ════════════════════════════════════════════════════════════════════
+
+static const int N_BUCKETS = 4096;   // hashed feature space
+static const int N_LANES = 8;        // padded row width: one NEON/SSE pair per row add
+static const int N_LATIN = 5;
+
+static const char* const LATIN_CODES[N_LATIN] = { "en", "es", "fr", "pt", "de" };
+
+// Frequent words and job-site phrases per language; the model learns
+// their character n-grams, so unseen words of the language still score
+static const char* const LATIN_SEED[N_LATIN] = {
+    // English
+    "the be to of and a in that have i it for not on with he as you do at this but his by from "
+    "they we say her she or an will my one all would there their what so up out if about who get "
+    "which go me when make can like time no just him know take people into year your good some "
+    "could them see other than then now look only come its over think also back after use two how "
+    "our work first well way even new want because any these give day most us is are was were been "
+    "has had did does doing done where why here should need needs more very much many still today "
+    "tomorrow tonight morning afternoon thanks thank please yes okay sorry help check site job crew "
+    "wire panel pipe floor roof wall door window truck tools material materials ready finished "
+    "running late on my way almost there break lunch clock in out the inspector is coming "
+    "we need more conduit what time do we start can you bring the ladder where is the drill "
+    "is this right the outlet box goes here how many hours did you work the delivery is late "
+    "let me know when you are done i will be there in ten minutes don't can't it's i'm we're "
+    "that's there's won't didn't isn't aren't wasn't haven't through those without before "
+    "again under never always something nothing everything thing things right left next step",
+    // Spanish
+    "de la que el en y a los se del las un por con no una su para es al lo como más o pero sus "
+    "le ha me si sin sobre este ya entre cuando todo esta ser son dos también fue había era muy "
+    "años hasta desde está mi porque qué sólo han yo hay vez puede todos así nos ni parte tiene "
+    "él uno donde bien tiempo mismo ese ahora cada e vida otro después te otros aunque esa eso "
+    "hace otra gobierno tan durante siempre día tanto ella tres sí dijo sido gran país según "
+    "menos año antes estado contra sino forma caso nada hacer general estaba poco estos presidente "
+    "mayor ante unos les algo hacia casa ellos ayer hecho primera mucho mientras además quien "
+    "hola gracias por favor necesito dónde cómo buenos días buenas tardes noches mañana hoy "
+    "trabajo obra cuadrilla herramientas material materiales cable tubo tubería piso techo pared "
+    "puerta ventana camión escalera taladro listo terminado llego tarde voy en camino almuerzo "
+    "descanso entrada salida el inspector viene necesitamos más conducto a qué hora empezamos "
+    "puedes traer la escalera dónde está el taladro esto está bien la caja va aquí cuántas horas "
+    "trabajaste avísame cuando termines estaré ahí en diez minutos ayuda ayúdame por qué vamos",
+    // French
+    "de la le et les des en un du une que est pour qui dans par plus pas au sur ne se ce il sont "
+    "avec ou son mais nous comme été elle fait aux tout on ses deux peut leur même cette ont "
+    "sans entre aussi je très y bien lui avait encore alors depuis ans avant où après fait faire "
+    "autre était ces sous contre peu elles non donc temps chez ils sa quand leurs tous moins "
+    "vous tu mon ma mes ton ta tes votre vos notre nos être avoir aller venir voir savoir pouvoir "
+    "vouloir falloir dire prendre donner rien quelque chose jour jours aujourd'hui demain hier "
+    "bonjour merci s'il vous plaît comment quoi pourquoi combien oui d'accord désolé aide "
+    "travail chantier équipe outils matériel matériaux câble tuyau plancher toit mur porte "
+    "fenêtre camion échelle perceuse prêt terminé je suis en retard j'arrive en route déjeuner "
+    "pause pointer l'inspecteur arrive il nous faut plus de gaine à quelle heure on commence "
+    "peux-tu apporter l'échelle où est la perceuse est-ce que c'est bon la boîte va ici combien "
+    "d'heures as-tu travaillé dis-moi quand tu as fini je serai là dans dix minutes c'est qu'il "
+    "n'est j'ai l'équipe allez-vous ça va",
+    // Portuguese
+    "de a o que e do da em um para é com não uma os no se na por mais as dos como mas foi ao ele "
+    "das tem à seu sua ou ser quando muito há nos já está eu também só pelo pela até isso ela "
+    "entre era depois sem mesmo aos ter seus quem nas me esse eles estão você tinha foram essa "
+    "num nem suas meu às minha têm numa pelos elas havia seja qual será nós tenho lhe deles "
+    "essas esses pelas este fosse dele tu te vocês vos lhes meus minhas teu tua teus tuas nosso "
+    "nossa nossos nossas dela delas esta estes estas aquele aquela aqueles aquelas isto aquilo "
+    "olá obrigado obrigada por favor preciso onde como bom dia boa tarde boa noite amanhã hoje "
+    "ontem trabalho obra equipe ferramentas material materiais cabo fio cano tubulação piso "
+    "telhado parede porta janela caminhão escada furadeira pronto terminado estou atrasado "
+    "estou a caminho almoço intervalo entrada saída o inspetor está vindo precisamos de mais "
+    "conduíte que horas começamos você pode trazer a escada onde está a furadeira isso está "
+    "certo a caixa vai aqui quantas horas você trabalhou me avise quando terminar chego em dez "
+    "minutos ajuda não sei então porque coisa vamos tudo bem",
+    // German
+    "der die und in den von zu das mit sich des auf für ist im dem nicht ein eine als auch es an "
+    "werden aus er hat dass sie nach wird bei einer um am sind noch wie einem über einen so zum "
+    "war haben nur oder aber vor zur bis mehr durch man sein wurde sei prozent hatte kann gegen "
+    "vom können schon wenn habe seine ihre dann unter wir soll ich eines jahr zwei jahren diese "
+    "dieser wieder keine seiner worden will zwischen immer millionen was sagte gibt alle seit "
+    "muss doch jetzt drei neue damit bereits da ab ihr ihren heute morgen gestern hier dort "
+    "guten tag guten morgen danke bitte wo warum wann wieviel ja nein entschuldigung hilfe "
+    "arbeit baustelle kolonne werkzeug material kabel rohr leitung boden dach wand tür fenster "
+    "lastwagen leiter bohrmaschine fertig erledigt ich bin spät dran ich bin unterwegs "
+    "mittagessen pause einstempeln ausstempeln der prüfer kommt wir brauchen mehr leerrohr "
+    "um wie viel uhr fangen wir an kannst du die leiter bringen wo ist die bohrmaschine ist das "
+    "richtig die dose kommt hierher wie viele stunden hast du gearbeitet sag mir bescheid wenn "
+    "du fertig bist ich bin in zehn minuten da nicht gut schön möchte müssen gehen machen"
+};
+
+struct LatinModel {
+    float weights[N_BUCKETS][N_LANES];
+};
+
+// ════════════════════════════════════════════════════════════════════
+// TEXT
+// ════════════════════════════════════════════════════════════════════
+
+// Next code point; invalid bytes come back as U+FFFD one at a time
+static uint32_t next_code_point(const uint8_t* s, size_t size, size_t& i) {
+    const uint8_t b = s[i++];
+    if (b < 0x80) return b;
+    int extra;
+    uint32_t cp;
+    if ((b & 0xE0) == 0xC0) { extra = 1; cp = b & 0x1F; }
+    else if ((b & 0xF0) == 0xE0) { extra = 2; cp = b & 0x0F; }
+    else if ((b & 0xF8) == 0xF0) { extra = 3; cp = b & 0x07; }
+    else return 0xFFFD;
+    if (i + extra > size) return 0xFFFD;
+    for (int k = 0; k < extra; k++) {
+        if ((s[i + k] & 0xC0) != 0x80) return 0xFFFD;
+        cp = (cp << 6) | (s[i + k] & 0x3F);
+    }
+    i += extra;
+    return cp;
+}
+
+static bool is_latin_letter(uint32_t cp) {
+    return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') ||
+           (cp >= 0xC0 && cp <= 0x24F && cp != 0xD7 && cp != 0xF7);
+}
+
+static uint32_t to_lower(uint32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') return cp + 32;
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 32;
+    return cp;
+}
+
+enum Script { SCRIPT_NONE, SCRIPT_LATIN, SCRIPT_CYRILLIC, SCRIPT_ARABIC, SCRIPT_DEVANAGARI,
+              SCRIPT_HAN, SCRIPT_KANA, SCRIPT_HANGUL, SCRIPT_COUNT };
+
+static Script script_of(uint32_t cp) {
+    if (is_latin_letter(cp)) return SCRIPT_LATIN;
+    if (cp >= 0x400 && cp <= 0x52F) return SCRIPT_CYRILLIC;
+    if (cp >= 0x600 && cp <= 0x6FF) return SCRIPT_ARABIC;
+    if (cp >= 0x900 && cp <= 0x97F) return SCRIPT_DEVANAGARI;
+    if ((cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF)) return SCRIPT_HAN;
+    if (cp >= 0x3040 && cp <= 0x30FF) return SCRIPT_KANA;
+    if (cp >= 0xAC00 && cp <= 0xD7AF) return SCRIPT_HANGUL;
+    return SCRIPT_NONE;
+}
+
+static const char* const SCRIPT_LANG[SCRIPT_COUNT] = {
+    nullptr, nullptr, "ru", "ar", "hi", "zh", "ja", "ko"
+};
+
+// ════════════════════════════════════════════════════════════════════
+// FEATURES
+// ════════════════════════════════════════════════════════════════════
+
+static uint32_t hash_codes(const uint32_t* cps, size_t n, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ cps[i]) * 16777619u;
+    }
+    return h % N_BUCKETS;
+}
+
+/**
+ * Feature buckets of the Latin words in text: 1-3-grams of each word
+ * padded with spaces, plus the whole word. Apostrophes and hyphens stay
+ * inside words ("s'il", "est-ce").
+ */
+template <typename Emit>
+static void for_each_feature(const uint8_t* s, size_t size, Emit emit) {
+    std::vector<uint32_t> word;
+    word.reserve(32);
+    auto flush = [&]() {
+        if (word.empty()) return;
+        std::vector<uint32_t> padded;
+        padded.reserve(word.size() + 2);
+        padded.push_back(' ');
+        padded.insert(padded.end(), word.begin(), word.end());
+        padded.push_back(' ');
+        for (size_t n = 1; n <= 3; n++) {
+            for (size_t i = 0; i + n <= padded.size(); i++) {
+                if (n == 1 && padded[i] == ' ') continue;
+                emit(hash_codes(&padded[i], n, (uint32_t) n));
+            }
+        }
+        emit(hash_codes(word.data(), word.size(), 7));
+        word.clear();
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        const uint32_t cp = next_code_point(s, size, i);
+        if (is_latin_letter(cp)) {
+            if (word.size() < 32) word.push_back(to_lower(cp));
+        } else if ((cp == '\'' || cp == 0x2019 || cp == '-') && !word.empty()) {
+            word.push_back('\'');
+        } else {
+            flush();
+        }
+    }
+    flush();
+}
+
+static const LatinModel& latin_model() {
+    static const LatinModel* model = [] {
+        LatinModel* m = new LatinModel();
+        std::vector<float> counts((size_t) N_BUCKETS * N_LATIN, 0.0f);
+        float totals[N_LATIN] = {};
+        for (int l = 0; l < N_LATIN; l++) {
+            const std::string seed = LATIN_SEED[l];
+            for_each_feature(reinterpret_cast<const uint8_t*>(seed.data()), seed.size(),
+                             [&](uint32_t bucket) {
+                counts[(size_t) bucket * N_LATIN + l] += 1.0f;
+                totals[l] += 1.0f;
+            });
+        }
+        // Laplace-smoothed log likelihood; padding lanes stay 0
+        const float alpha = 0.5f;
+        for (int b = 0; b < N_BUCKETS; b++) {
+            for (int l = 0; l < N_LANES; l++) {
+                m->weights[b][l] = l < N_LATIN
+                    ? std::log((counts[(size_t) b * N_LATIN + l] + alpha) / (totals[l] + alpha * N_BUCKETS))
+                    : 0.0f;
+            }
+        }
+        return m;
+    }();
+    return *model;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// IDENTIFICATION
+// ════════════════════════════════════════════════════════════════════
+
+// Softmax sharpness over the mean per-feature log likelihood
+static const float CONFIDENCE_SCALE = 6.0f;
+
+// Fewer Latin letters than this ("ok", "Bob", "plan") say nothing about
+// the language; that share of the text is reported as undetermined
+static const size_t MIN_LATIN_LETTERS = 8;
+
+// Per-feature log-likelihood bonus for English. Most messages are English
+// and short ones borrow words from the others ("pour", "grab"), so a
+// foreign guess has to beat English by this much. Text without accented
+// letters gets the larger bonus: es/fr/pt/de nearly always have some.
+static const float ENGLISH_PRIOR = 0.15f;
+static const float ENGLISH_ASCII_PRIOR = 0.4f;
+
+std::vector<LangGuess> identify_language(const char* text, size_t size, size_t top_k) {
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(text);
+    std::vector<LangGuess> guesses;
+    if (top_k == 0) top_k = 1;
+
+    size_t script_letters[SCRIPT_COUNT] = {};
+    size_t letters = 0;
+    bool accented = false;
+    for (size_t i = 0; i < size;) {
+        const uint32_t cp = next_code_point(s, size, i);
+        const Script script = script_of(cp);
+        if (script == SCRIPT_LATIN && cp >= 0x80) accented = true;
+        if (script != SCRIPT_NONE) {
+            script_letters[script]++;
+            letters++;
+        }
+    }
+    if (letters == 0) return guesses;
+
+    // Non-Latin scripts each map to one language
+    for (int sc = SCRIPT_CYRILLIC; sc < SCRIPT_COUNT; sc++) {
+        if (script_letters[sc] > 0) {
+            guesses.push_back({ SCRIPT_LANG[sc], (float) script_letters[sc] / letters });
+        }
+    }
+    // Japanese mixes kanji with kana; count the kanji towards it
+    if (script_letters[SCRIPT_KANA] > 0 && script_letters[SCRIPT_HAN] > 0) {
+        for (LangGuess& g : guesses) {
+            if (g.lang == "ja") g.confidence += (float) script_letters[SCRIPT_HAN] / letters;
+        }
+        guesses.erase(std::remove_if(guesses.begin(), guesses.end(),
+                                     [](const LangGuess& g) { return g.lang == "zh"; }),
+                      guesses.end());
+    }
+
+    const float latin_share = (float) script_letters[SCRIPT_LATIN] / letters;
+    if (script_letters[SCRIPT_LATIN] > 0 && script_letters[SCRIPT_LATIN] < MIN_LATIN_LETTERS) {
+        guesses.push_back({ "und", latin_share });
+    } else if (script_letters[SCRIPT_LATIN] > 0) {
+        const LatinModel& model = latin_model();
+        alignas(32) float score[N_LANES] = {};
+        size_t n_features = 0;
+        for_each_feature(s, size, [&](uint32_t bucket) {
+            const float* row = model.weights[bucket];
+            for (int l = 0; l < N_LANES; l++) {   // vectorizes to two 4-lane adds
+                score[l] += row[l];
+            }
+            n_features++;
+        });
+        score[0] += (float) n_features * (accented ? ENGLISH_PRIOR : ENGLISH_ASCII_PRIOR);
+
+        float best = score[0];
+        for (int l = 1; l < N_LATIN; l++) best = std::max(best, score[l]);
+        float prob[N_LATIN];
+        float sum = 0.0f;
+        for (int l = 0; l < N_LATIN; l++) {
+            prob[l] = std::exp((score[l] - best) / (float) n_features * CONFIDENCE_SCALE);
+            sum += prob[l];
+        }
+        for (int l = 0; l < N_LATIN; l++) {
+            guesses.push_back({ LATIN_CODES[l], prob[l] / sum * latin_share });
+        }
+    }
+
+    std::sort(guesses.begin(), guesses.end(),
+              [](const LangGuess& a, const LangGuess& b) { return a.confidence > b.confidence; });
+    if (guesses.size() > top_k) guesses.resize(top_k);
+    return guesses;
+}
+
+} // namespace smith
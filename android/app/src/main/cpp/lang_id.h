@@ -0,0 +1,40 @@
+/**
+ * lang_id.h - Character n-gram language identification
+ * Guild of Smiths - Offline AI Module
+ *
+ * Decides which language a crew message is in, so only text that really
+ * is foreign goes to the LLM for translation. Non-Latin scripts (Cyrillic,
+ * Arabic, Devanagari, CJK, kana, Hangul) are decided by counting code
+ * points. Latin-script text is scored by a naive Bayes model over hashed
+ * character 1-3-grams and whole words against English, Spanish, French,
+ * Portuguese and German, with a prior towards English. Latin text too
+ * short to tell (under 8 letters) is "und" (undetermined).
+ *
+ * The model is a 4096 x 8 float table built on first use from frequent
+ * words of each language compiled into the library; scoring a message is
+ * one row add per feature and takes a few microseconds.
+ *
+ * Thread-safe.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+struct LangGuess {
+    std::string lang;     // ISO 639-1 code ("en", "es", "ru", ...), or "und"
+    float confidence;     // 0..1; guesses of one call sum to at most 1
+};
+
+/**
+ * Most likely languages of UTF-8 text, best first.
+ * @param top_k Guesses to return (at least 1)
+ * @return empty if the text has no letters
+ */
+std::vector<LangGuess> identify_language(const char* text, size_t size, size_t top_k);
+
+} // namespace smith
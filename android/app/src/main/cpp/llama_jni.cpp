@@ -6,39 +6,310 @@
  * for on-device LLM inference.
  */
 
+#define LOG_TAG "LlamaJNI"
+
 #include <jni.h>
 #include <string>
-#include <android/log.h>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <vector>
 
-#define LOG_TAG "LlamaJNI"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#include <unistd.h>
+
+#include "json_util.h"
+#include "native_log.h"
+
+// Kotlin callbacks (LlamaInference @JvmStatic), resolved once in JNI_OnLoad
+static JavaVM* g_vm = nullptr;
+static jclass g_inference_class = nullptr;
+static jmethodID g_on_text = nullptr;
+static jmethodID g_on_complete = nullptr;
+static jmethodID g_on_error = nullptr;
+static jmethodID g_on_batch_complete = nullptr;
+static jmethodID g_on_embeddings = nullptr;
+static jmethodID g_on_worker_lost = nullptr;
+
+static jbyteArray to_byte_array(JNIEnv* env, const std::string& s) {
+    jbyteArray bytes = env->NewByteArray((jsize) s.size());
+    if (bytes != nullptr) {
+        env->SetByteArrayRegion(bytes, 0, (jsize) s.size(), reinterpret_cast<const jbyte*>(s.data()));
+    }
+    return bytes;
+}
+
+static void clear_exception(JNIEnv* env) {
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+}
+
+static void post_complete(JNIEnv* env, jlong id, const std::string& text,
+                          int n_prompt, int n_generated, int64_t prefill_us, int64_t decode_us) {
+    jbyteArray bytes = to_byte_array(env, text);
+    env->CallStaticVoidMethod(g_inference_class, g_on_complete, id, bytes,
+                              (jint) n_prompt, (jint) n_generated,
+                              (jlong) prefill_us, (jlong) decode_us);
+    clear_exception(env);
+    env->DeleteLocalRef(bytes);
+}
+
+static void post_error(JNIEnv* env, jlong id, const std::string& error) {
+    jstring message = env->NewStringUTF(error.c_str());
+    env->CallStaticVoidMethod(g_inference_class, g_on_error, id, message);
+    clear_exception(env);
+    env->DeleteLocalRef(message);
+}
+
+// Batch results go over as UTF-8 JSON bytes: generated text may hold
+// characters that modified UTF-8 (NewStringUTF) cannot carry
+static void post_batch_complete(JNIEnv* env, jlong id, const std::string& json) {
+    jbyteArray bytes = to_byte_array(env, json);
+    env->CallStaticVoidMethod(g_inference_class, g_on_batch_complete, id, bytes);
+    clear_exception(env);
+    env->DeleteLocalRef(bytes);
+}
 
 #ifndef LLAMA_STUB
 // Real llama.cpp implementation
 #include "llama.h"
 #include "common.h"
+#include "engine.h"
+#include "inference_core.h"
+#include "inference_worker.h"
+#include "model_repack.h"
+#include "prompt_assembler.h"
+
+/**
+ * Forwards engine events to Kotlin. The worker thread is attached to the
+ * VM once for its whole life, so callbacks cost a method call, not an attach.
+ */
+class JniListener : public smith::EngineListener {
+public:
+    void on_worker_start() override {
+        if (g_vm->AttachCurrentThread(&env_, nullptr) != JNI_OK) {
+            LOGE("Failed to attach worker thread");
+            env_ = nullptr;
+        }
+    }
+
+    void on_worker_stop() override {
+        if (env_ != nullptr) {
+            g_vm->DetachCurrentThread();
+            env_ = nullptr;
+        }
+    }
+
+    void on_text(uint64_t id, const std::string& text) override {
+        if (env_ == nullptr) return;
+        jbyteArray bytes = to_byte_array(env_, text);
+        env_->CallStaticVoidMethod(g_inference_class, g_on_text, (jlong) id, bytes);
+        clear_exception(env_);
+        env_->DeleteLocalRef(bytes);
+    }
+
+    void on_complete(uint64_t id, const std::string& text, const smith::GenerationStats& stats) override {
+        if (env_ == nullptr) return;
+        post_complete(env_, (jlong) id, text, stats.n_prompt_tokens, stats.n_generated,
+                      stats.t_prefill_us, stats.t_decode_us);
+    }
+
+    void on_error(uint64_t id, const std::string& error) override {
+        if (env_ == nullptr) return;
+        post_error(env_, (jlong) id, error);
+    }
+
+    void on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) override {
+        if (env_ == nullptr) return;
+        jfloatArray array = env_->NewFloatArray((jsize) vectors.size());
+        if (array != nullptr) {
+            env_->SetFloatArrayRegion(array, 0, (jsize) vectors.size(), vectors.data());
+        }
+        env_->CallStaticVoidMethod(g_inference_class, g_on_embeddings, (jlong) id, (jint) n_embd, array);
+        clear_exception(env_);
+        env_->DeleteLocalRef(array);
+    }
+
+    void on_batch_complete(uint64_t id, const std::vector<smith::BatchItemResult>& results,
+                           const smith::BatchStats& stats) override {
+        if (env_ == nullptr) return;
+        std::string json = "{\"items\":[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const smith::BatchItemResult& r = results[i];
+            const bool ok = r.finished && r.status == smith::GenerationStatus::OK;
+            if (i > 0) json += ",";
+            json += "{\"ok\":";
+            json += ok ? "true" : "false";
+            json += ",\"text\":";
+            smith::json_append_string(json, r.text);
+            json += ",\"error\":";
+            smith::json_append_string(json, ok ? "" : !r.finished ? "Cancelled" :
+                                      r.status == smith::GenerationStatus::TOKENIZE_FAILED
+                                          ? "Tokenization failed" : "Decoding failed");
+            json += ",\"prompt_tokens\":" + std::to_string(r.n_prompt_tokens);
+            json += ",\"prefix_tokens\":" + std::to_string(r.n_prefix_shared);
+            json += ",\"generated_tokens\":" + std::to_string(r.n_generated);
+            json += ",\"first_token_us\":" + std::to_string(r.t_first_token_us);
+            json += ",\"latency_us\":" + std::to_string(r.t_latency_us);
+            json += "}";
+        }
+        json += "],\"waves\":" + std::to_string(stats.n_waves);
+        json += ",\"decode_calls\":" + std::to_string(stats.n_decode_calls);
+        json += ",\"prefill_saved\":" + std::to_string(stats.n_prefill_tokens_saved);
+        json += ",\"total_us\":" + std::to_string(stats.t_total_us);
+        json += "}";
+        post_batch_complete(env_, (jlong) id, json);
+    }
+
+    void on_backend_lost() override {
+        if (env_ == nullptr) return;
+        env_->CallStaticVoidMethod(g_inference_class, g_on_worker_lost);
+        clear_exception(env_);
+    }
+
+private:
+    JNIEnv* env_ = nullptr;
+};
+
+static JniListener g_listener;
+// The in-process Engine, or a WorkerClient once inference moves to a worker process.
+// Each call holds a reference while it runs, so replacing the backend never
+// frees it under a status query or a submit on another thread.
+static std::shared_ptr<smith::InferenceBackend> g_backend;
+static bool g_backend_is_worker = false;
+static std::mutex g_mutex; // serializes replacing g_backend
+
+// How long replace_backend waits for calls into the old backend to return
+static const std::chrono::seconds DRAIN_TIMEOUT(5);
+
+/**
+ * Owner of the installed backend. g_backend and the references calls take
+ * from it share a control block whose deleter only reports that the last
+ * of them is gone; the backend itself lives here until replace_backend
+ * (or, if it stopped waiting, that last call) destroys it.
+ */
+struct BackendDrain {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::shared_ptr<smith::InferenceBackend> owner;
+    bool drained = false;
+    bool abandoned = false;   // replace_backend timed out; the last reference frees it
+};
+static std::shared_ptr<BackendDrain> g_drain; // for the backend in g_backend; guarded by g_mutex
+
+static std::shared_ptr<smith::InferenceBackend> current_backend() {
+    return std::atomic_load(&g_backend);
+}
+
+static std::shared_ptr<smith::InferenceBackend> share_backend(std::shared_ptr<smith::InferenceBackend> backend,
+                                                              const std::shared_ptr<BackendDrain>& drain) {
+    smith::InferenceBackend* raw = backend.get();
+    drain->owner = std::move(backend);
+    return std::shared_ptr<smith::InferenceBackend>(raw, [drain](smith::InferenceBackend*) {
+        std::shared_ptr<smith::InferenceBackend> orphan;
+        {
+            std::lock_guard<std::mutex> lock(drain->mutex);
+            drain->drained = true;
+            if (drain->abandoned) orphan = std::move(drain->owner);
+        }
+        drain->cv.notify_all();
+    });
+}
+
+/**
+ * Swap in next (or nothing) and destroy the old backend on this thread
+ * once the calls still using it have returned. A call that outlasts
+ * DRAIN_TIMEOUT (a long model load) is logged and frees the backend itself
+ * when it returns. Call with g_mutex held.
+ */
+static void replace_backend(std::shared_ptr<smith::InferenceBackend> next) {
+    std::shared_ptr<BackendDrain> drain = std::move(g_drain);
+    if (next) {
+        g_drain = std::make_shared<BackendDrain>();
+        next = share_backend(std::move(next), g_drain);
+    }
+    std::atomic_exchange(&g_backend, std::move(next)).reset();
+    if (!drain) return;
+
+    std::shared_ptr<smith::InferenceBackend> old;
+    {
+        std::unique_lock<std::mutex> lock(drain->mutex);
+        if (drain->cv.wait_for(lock, DRAIN_TIMEOUT, [&]() { return drain->drained; })) {
+            old = std::move(drain->owner);
+        } else {
+            drain->abandoned = true;
+            LOGW("Old backend still in use after %lld s; the last call into it will free it",
+                 (long long) DRAIN_TIMEOUT.count());
+        }
+    }
+    old.reset();
+}
+
+// Tokenizer-only copy of the loaded model for prompt assembly. The weights
+// may be in the worker process; the vocabulary alone is a few MB.
+static std::shared_ptr<llama_model> g_vocab;
+
+static void load_vocab(const char* path) {
+    std::shared_ptr<llama_model> vocab;
+    if (path != nullptr) {
+        llama_model_params params = llama_model_default_params();
+        params.vocab_only = true;
+        if (llama_model* model = llama_load_model_from_file(path, params)) {
+            vocab.reset(model, llama_free_model);
+        } else {
+            LOGW("Cannot load the vocabulary of %s; prompts go unassembled", path);
+        }
+    }
+    std::atomic_store(&g_vocab, vocab);
+}
 
-static llama_model* g_model = nullptr;
-static llama_context* g_ctx = nullptr;
-static std::mutex g_mutex;
-static std::atomic<bool> g_model_loaded(false);
-static std::atomic<bool> g_cancel_generation(false);
+static smith::Priority to_priority(jint priority) {
+    const int clamped = priority < 0 ? 0 : (priority >= smith::PRIORITY_COUNT ? smith::PRIORITY_COUNT - 1 : priority);
+    return static_cast<smith::Priority>(clamped);
+}
 
 #else
 // Stub implementation when llama.cpp is not available
-static bool g_model_loaded = false;
-static std::mutex g_mutex;
-static bool g_cancel_generation = false;
+static std::atomic<bool> g_model_loaded{ false };
 #endif
 
 extern "C" {
 
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM* vm, void* /* reserved */) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    g_vm = vm;
+    
+    jclass cls = env->FindClass("com/guildofsmiths/trademesh/ai/LlamaInference");
+    if (cls == nullptr) {
+        LOGE("LlamaInference class not found");
+        return JNI_ERR;
+    }
+    g_inference_class = static_cast<jclass>(env->NewGlobalRef(cls));
+    env->DeleteLocalRef(cls);
+    
+    g_on_text = env->GetStaticMethodID(g_inference_class, "onNativeText", "(J[B)V");
+    g_on_complete = env->GetStaticMethodID(g_inference_class, "onNativeComplete", "(J[BIIJJ)V");
+    g_on_error = env->GetStaticMethodID(g_inference_class, "onNativeError", "(JLjava/lang/String;)V");
+    g_on_batch_complete = env->GetStaticMethodID(g_inference_class, "onNativeBatchComplete", "(J[B)V");
+    g_on_embeddings = env->GetStaticMethodID(g_inference_class, "onNativeEmbeddings", "(JI[F)V");
+    g_on_worker_lost = env->GetStaticMethodID(g_inference_class, "onNativeWorkerLost", "()V");
+    if (g_on_text == nullptr || g_on_complete == nullptr || g_on_error == nullptr ||
+        g_on_batch_complete == nullptr || g_on_embeddings == nullptr || g_on_worker_lost == nullptr) {
+        LOGE("LlamaInference callbacks not found");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
 /**
- * Initialize llama backend (call once at app start)
+ * Initialize llama backend and start the generation worker
  */
 JNIEXPORT jboolean JNICALL
 Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeInit(
@@ -48,7 +319,14 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeInit(
     LOGI("Initializing llama backend");
     
 #ifndef LLAMA_STUB
+    std::lock_guard<std::mutex> lock(g_mutex);
     llama_backend_init();
+    // Also the way back from a worker process that could not be started
+    if (!current_backend() || g_backend_is_worker) {
+        replace_backend(nullptr);
+        replace_backend(std::make_shared<smith::Engine>(g_listener));
+        g_backend_is_worker = false;
+    }
     LOGI("llama backend initialized successfully");
     return JNI_TRUE;
 #else
@@ -57,6 +335,120 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeInit(
 #endif
 }
 
+/**
+ * Run inference in a worker process from now on. Replaces the current
+ * backend (and its model) with a client of a new channel whose far ends
+ * are returned for InferenceWorkerService. Must not be called from
+ * onNativeWorkerLost, which runs on the old client's thread.
+ * 
+ * @return [controlFd, shmFd] for the worker (close after passing on), or
+ *         null if the channel could not be created
+ */
+JNIEXPORT jintArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeConnectWorker(
+    JNIEnv* env,
+    jobject /* this */
+) {
+#ifndef LLAMA_STUB
+    std::lock_guard<std::mutex> lock(g_mutex);
+    replace_backend(nullptr);
+
+    int control_fd = -1;
+    int shm_fd = -1;
+    std::unique_ptr<smith::WorkerClient> client = smith::WorkerClient::create(g_listener, control_fd, shm_fd);
+    if (!client) {
+        LOGE("Cannot create worker channel");
+        return nullptr;
+    }
+    replace_backend(std::shared_ptr<smith::InferenceBackend>(std::move(client)));
+    g_backend_is_worker = true;
+
+    const jint fds[2] = { control_fd, shm_fd };
+    jintArray result = env->NewIntArray(2);
+    if (result != nullptr) {
+        env->SetIntArrayRegion(result, 0, 2, fds);
+    }
+    return result;
+#else
+    LOGW("Stub: no worker process");
+    return nullptr;
+#endif
+}
+
+/**
+ * Worker process entry (InferenceWorkerService): serve the engine over
+ * the channel ends from nativeConnectWorker until the app closes it or dies.
+ * Blocks for the life of the connection; takes ownership of both fds.
+ * 
+ * @return 0 after a clean shutdown, 1 if the channel was unusable
+ */
+JNIEXPORT jint JNICALL
+Java_com_guildofsmiths_trademesh_ai_InferenceWorkerService_nativeServe(
+    JNIEnv* env,
+    jobject /* this */,
+    jint controlFd,
+    jint shmFd
+) {
+#ifndef LLAMA_STUB
+    return smith::serve_worker(controlFd, shmFd);
+#else
+    close(controlFd);
+    close(shmFd);
+    return 1;
+#endif
+}
+
+/**
+ * Set the directory generation checkpoints are written to. Call after
+ * nativeInit and before submitting checkpointed requests.
+ * 
+ * @param dir Existing writable directory
+ */
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSetCheckpointDir(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring dir
+) {
+#ifndef LLAMA_STUB
+    const char* dir_cstr = env->GetStringUTFChars(dir, nullptr);
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    if (backend) {
+        backend->set_checkpoint_dir(dir_cstr);
+    }
+    env->ReleaseStringUTFChars(dir, dir_cstr);
+#else
+    LOGW("Stub: checkpoints disabled");
+#endif
+}
+
+/**
+ * Set the directory warmed prompt prefixes are kept in, so they are
+ * computed once per model instead of once per process. Call after
+ * nativeInit; takes effect for the loaded model and every later one.
+ * 
+ * @param dir Existing writable directory
+ * @param maxBytes Disk budget; least recently used entries go first
+ */
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSetPrefixCacheDir(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring dir,
+    jlong maxBytes
+) {
+#ifndef LLAMA_STUB
+    const char* dir_cstr = env->GetStringUTFChars(dir, nullptr);
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    if (backend) {
+        backend->set_prefix_cache_dir(dir_cstr, maxBytes > 0 ? (size_t) maxBytes : 0);
+    }
+    env->ReleaseStringUTFChars(dir, dir_cstr);
+#else
+    LOGW("Stub: prefix cache directory ignored");
+#endif
+}
+
 /**
  * Load a GGUF model from the given path
  * 
@@ -73,175 +465,278 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeLoadModel(
     jint nCtx,
     jint nThreads
 ) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
     const char* path = env->GetStringUTFChars(modelPath, nullptr);
     LOGI("Loading model from: %s", path);
     
 #ifndef LLAMA_STUB
-    // Unload existing model if any
-    if (g_ctx != nullptr) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-    if (g_model != nullptr) {
-        llama_free_model(g_model);
-        g_model = nullptr;
-    }
-    
-    // Model parameters
-    llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = 0; // CPU only for mobile
-    
-    // Load model
-    g_model = llama_load_model_from_file(path, model_params);
-    if (g_model == nullptr) {
-        LOGE("Failed to load model from: %s", path);
-        env->ReleaseStringUTFChars(modelPath, path);
-        return JNI_FALSE;
-    }
-    
-    // Context parameters
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = nCtx > 0 ? nCtx : 2048;
-    ctx_params.n_threads = nThreads > 0 ? nThreads : 4;
-    ctx_params.n_threads_batch = nThreads > 0 ? nThreads : 4;
-    
-    // Create context
-    g_ctx = llama_new_context_with_model(g_model, ctx_params);
-    if (g_ctx == nullptr) {
-        LOGE("Failed to create context");
-        llama_free_model(g_model);
-        g_model = nullptr;
-        env->ReleaseStringUTFChars(modelPath, path);
-        return JNI_FALSE;
-    }
-    
-    g_model_loaded = true;
-    LOGI("Model loaded successfully. Context size: %d, Threads: %d", nCtx, nThreads);
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool ok = backend && backend->load_model(path, nCtx, nThreads);
+    load_vocab(ok ? path : nullptr);
+    env->ReleaseStringUTFChars(modelPath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
 #else
     g_model_loaded = true;
     LOGW("Stub: Model would be loaded from %s", path);
-#endif
-    
     env->ReleaseStringUTFChars(modelPath, path);
     return JNI_TRUE;
+#endif
 }
 
 /**
- * Generate text from a prompt
+ * Queue a generation and return immediately. The result arrives on the
+ * worker thread via LlamaInference.onNativeComplete / onNativeError, and
+ * streamed text via onNativeText.
  * 
+ * @param requestId Caller-chosen id echoed in the callbacks
  * @param prompt Input prompt string
  * @param maxTokens Maximum tokens to generate
  * @param temperature Sampling temperature (0.0 - 1.0)
- * @return Generated text
+ * @param stream Deliver text through onNativeText as it is generated
+ * @param priority 0 idle, 1 background, 2 normal, 3 interactive; a higher
+ *                 class preempts a running lower one, which resumes afterwards
+ * @param checkpointKey Stable name to checkpoint under (null for none); a
+ *                      request resubmitted with the same key after process
+ *                      death continues from its last checkpoint
+ * @return true if queued
  */
-JNIEXPORT jstring JNICALL
-Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeGenerate(
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSubmit(
     JNIEnv* env,
     jobject /* this */,
+    jlong requestId,
     jstring prompt,
     jint maxTokens,
-    jfloat temperature
+    jfloat temperature,
+    jboolean stream,
+    jint priority,
+    jstring checkpointKey
 ) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    if (!g_model_loaded) {
-        LOGE("Model not loaded");
-        return env->NewStringUTF("[Error: Model not loaded]");
-    }
-    
     const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
-    std::string result;
-    
-    g_cancel_generation = false;
     
 #ifndef LLAMA_STUB
-    if (g_ctx == nullptr || g_model == nullptr) {
-        env->ReleaseStringUTFChars(prompt, prompt_cstr);
-        return env->NewStringUTF("[Error: Context not initialized]");
+    smith::GenerationParams params;
+    params.max_tokens = maxTokens;
+    params.temperature = temperature;
+    std::string key;
+    if (checkpointKey != nullptr) {
+        const char* key_cstr = env->GetStringUTFChars(checkpointKey, nullptr);
+        key = key_cstr;
+        env->ReleaseStringUTFChars(checkpointKey, key_cstr);
     }
-    
-    LOGI("Generating response for prompt: %.50s...", prompt_cstr);
-    
-    // Tokenize the prompt
-    std::vector<llama_token> tokens(strlen(prompt_cstr) + 1);
-    int n_tokens = llama_tokenize(g_model, prompt_cstr, strlen(prompt_cstr), 
-                                   tokens.data(), tokens.size(), true, false);
-    if (n_tokens < 0) {
-        LOGE("Tokenization failed");
-        env->ReleaseStringUTFChars(prompt, prompt_cstr);
-        return env->NewStringUTF("[Error: Tokenization failed]");
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool queued = backend &&
+                  backend->submit((uint64_t) requestId, prompt_cstr, params, stream == JNI_TRUE,
+                                   to_priority(priority), key);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+    return queued ? JNI_TRUE : JNI_FALSE;
+#else
+    // Stub response for testing, delivered synchronously on the caller's thread
+    std::string result = "[Stub Response] Model not compiled. Your prompt was: ";
+    result += std::string(prompt_cstr).substr(0, 50);
+    result += "...";
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+    LOGW("Stub: Would generate response for prompt");
+    if (!g_model_loaded) {
+        post_error(env, requestId, "Model not loaded");
+    } else {
+        post_complete(env, requestId, result, 0, 0, 0, 0);
     }
-    tokens.resize(n_tokens);
-    
-    // Clear KV cache
-    llama_kv_cache_clear(g_ctx);
-    
-    // Decode prompt
-    llama_batch batch = llama_batch_init(512, 0, 1);
-    for (int i = 0; i < n_tokens; i++) {
-        llama_batch_add(batch, tokens[i], i, { 0 }, false);
+    return JNI_TRUE;
+#endif
+}
+
+/**
+ * Queue a batch of independent prompts, generated together as parallel
+ * sequences. Completes once via LlamaInference.onNativeBatchComplete with
+ * per-item results in submission order, or onNativeError.
+ * 
+ * @param requestId Caller-chosen id echoed in the callback
+ * @param prompts Input prompts
+ * @param maxTokens Maximum tokens per prompt (same length as prompts)
+ * @param temperatures Sampling temperature per prompt (batches decode greedily)
+ * @param priority As for nativeSubmit; batches are normally background work
+ * @return true if queued
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSubmitBatch(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong requestId,
+    jobjectArray prompts,
+    jintArray maxTokens,
+    jfloatArray temperatures,
+    jint priority
+) {
+    const jsize n = env->GetArrayLength(prompts);
+    if (env->GetArrayLength(maxTokens) != n || env->GetArrayLength(temperatures) != n) {
+        LOGE("Batch arrays differ in length");
+        return JNI_FALSE;
     }
-    batch.logits[batch.n_tokens - 1] = true;
+    std::vector<jint> max_tokens(n);
+    std::vector<jfloat> temps(n);
+    env->GetIntArrayRegion(maxTokens, 0, n, max_tokens.data());
+    env->GetFloatArrayRegion(temperatures, 0, n, temps.data());
     
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("Prompt decoding failed");
-        llama_batch_free(batch);
+#ifndef LLAMA_STUB
+    std::vector<smith::BatchItem> items(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring prompt = static_cast<jstring>(env->GetObjectArrayElement(prompts, i));
+        const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+        items[i].prompt = prompt_cstr;
+        items[i].params.max_tokens = max_tokens[i];
+        items[i].params.temperature = temps[i];
         env->ReleaseStringUTFChars(prompt, prompt_cstr);
-        return env->NewStringUTF("[Error: Decoding failed]");
+        env->DeleteLocalRef(prompt);
     }
-    
-    // Generate tokens
-    int n_cur = batch.n_tokens;
-    int n_gen = 0;
-    
-    while (n_gen < maxTokens && !g_cancel_generation) {
-        // Sample next token
-        llama_token new_token = llama_sample_token_greedy(g_ctx, 
-            llama_get_logits_ith(g_ctx, batch.n_tokens - 1));
-        
-        // Check for end of generation
-        if (llama_token_is_eog(g_model, new_token)) {
-            break;
-        }
-        
-        // Convert token to string
-        char buf[128];
-        int n = llama_token_to_piece(g_model, new_token, buf, sizeof(buf), false);
-        if (n > 0) {
-            result.append(buf, n);
-        }
-        
-        // Prepare next batch
-        llama_batch_clear(batch);
-        llama_batch_add(batch, new_token, n_cur, { 0 }, true);
-        
-        if (llama_decode(g_ctx, batch) != 0) {
-            LOGE("Token decoding failed");
-            break;
-        }
-        
-        n_cur++;
-        n_gen++;
-    }
-    
-    llama_batch_free(batch);
-    LOGI("Generated %d tokens", n_gen);
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool queued = backend &&
+                  backend->submit_batch((uint64_t) requestId, std::move(items), to_priority(priority));
+    return queued ? JNI_TRUE : JNI_FALSE;
 #else
-    // Stub response for testing
-    result = "[Stub Response] Model not compiled. Your prompt was: ";
-    result += std::string(prompt_cstr).substr(0, 50);
-    result += "...";
-    LOGW("Stub: Would generate response for prompt");
+    if (!g_model_loaded) {
+        post_error(env, requestId, "Model not loaded");
+        return JNI_TRUE;
+    }
+    std::string json = "{\"items\":[";
+    for (jsize i = 0; i < n; i++) {
+        if (i > 0) json += ",";
+        json += "{\"ok\":true,\"text\":";
+        smith::json_append_string(json, "[Stub Response] Model not compiled.");
+        json += "}";
+    }
+    json += "],\"stub\":true}";
+    post_batch_complete(env, requestId, json);
+    return JNI_TRUE;
 #endif
-    
+}
+
+/**
+ * Prefill a prompt at low priority and keep its KV cells in the engine's
+ * prefix cache; later prompts that start the same way skip that prefill.
+ * Completes via onNativeComplete (empty text; promptTokens = prompt length)
+ * or onNativeError ("Yielded" if other work arrived first).
+ * 
+ * @param requestId Caller-chosen id echoed in the callback
+ * @param prompt Prompt prefix to warm, e.g. a system prompt block
+ * @param priority As for nativeSubmit; normally idle
+ * @return true if queued
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSubmitWarm(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong requestId,
+    jstring prompt,
+    jint priority
+) {
+#ifndef LLAMA_STUB
+    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool queued = backend &&
+                  backend->submit_warm((uint64_t) requestId, prompt_cstr, to_priority(priority));
     env->ReleaseStringUTFChars(prompt, prompt_cstr);
-    return env->NewStringUTF(result.c_str());
+    return queued ? JNI_TRUE : JNI_FALSE;
+#else
+    post_complete(env, requestId, "", 0, 0, 0, 0);
+    return JNI_TRUE;
+#endif
+}
+
+/**
+ * Embed texts for similarity search at low priority. Completes via
+ * onNativeEmbeddings with texts.size * nEmbd floats (one L2-normalized
+ * vector per text, in order) or onNativeError.
+ * 
+ * @param requestId Caller-chosen id echoed in the callback
+ * @param texts Texts to embed
+ * @param priority As for nativeSubmit; normally idle
+ * @return true if queued
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSubmitEmbed(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong requestId,
+    jobjectArray texts,
+    jint priority
+) {
+#ifndef LLAMA_STUB
+    const jsize n = env->GetArrayLength(texts);
+    std::vector<std::string> items(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring text = static_cast<jstring>(env->GetObjectArrayElement(texts, i));
+        const char* text_cstr = env->GetStringUTFChars(text, nullptr);
+        items[i] = text_cstr;
+        env->ReleaseStringUTFChars(text, text_cstr);
+        env->DeleteLocalRef(text);
+    }
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool queued = backend &&
+                  backend->submit_embed((uint64_t) requestId, std::move(items), to_priority(priority));
+    return queued ? JNI_TRUE : JNI_FALSE;
+#else
+    post_error(env, requestId, "Embeddings need llama.cpp");
+    return JNI_TRUE;
+#endif
+}
+
+/**
+ * Compress a mesh message with the loaded model, or expand a received
+ * frame. Completes via onNativeComplete (frame bytes, or UTF-8 text) or
+ * onNativeError when the text does not fit or the frame cannot be read.
+ *
+ * @param requestId Caller-chosen id echoed in the callback
+ * @param decode false to compress data (UTF-8 text), true to expand data (a frame)
+ * @param data Input bytes
+ * @param maxBytes Largest acceptable frame when compressing; 0 for no limit
+ * @param priority As for nativeSubmit; normally interactive
+ * @return true if queued
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeSubmitCodec(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong requestId,
+    jboolean decode,
+    jbyteArray data,
+    jint maxBytes,
+    jint priority
+) {
+#ifndef LLAMA_STUB
+    const jsize n = env->GetArrayLength(data);
+    std::string bytes((size_t) n, '\0');
+    env->GetByteArrayRegion(data, 0, n, reinterpret_cast<jbyte*>(&bytes[0]));
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    bool queued = backend &&
+                  backend->submit_codec((uint64_t) requestId,
+                                          decode ? smith::CodecOp::DECODE : smith::CodecOp::ENCODE,
+                                          bytes, maxBytes > 0 ? (size_t) maxBytes : 0,
+                                          to_priority(priority));
+    return queued ? JNI_TRUE : JNI_FALSE;
+#else
+    post_error(env, requestId, "Compression needs llama.cpp");
+    return JNI_TRUE;
+#endif
 }
 
 /**
- * Cancel ongoing generation
+ * Cancel one queued or running request
+ */
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeCancelRequest(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong requestId
+) {
+#ifndef LLAMA_STUB
+    if (std::shared_ptr<smith::InferenceBackend> backend = current_backend()) {
+        backend->cancel((uint64_t) requestId);
+    }
+#endif
+}
+
+/**
+ * Cancel the running generation and everything queued
  */
 JNIEXPORT void JNICALL
 Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeCancelGeneration(
@@ -250,7 +745,9 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeCancelGeneration(
 ) {
     LOGI("Cancelling generation");
 #ifndef LLAMA_STUB
-    g_cancel_generation = true;
+    if (std::shared_ptr<smith::InferenceBackend> backend = current_backend()) {
+        backend->cancel_all();
+    }
 #endif
 }
 
@@ -262,22 +759,17 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeUnloadModel(
     JNIEnv* env,
     jobject /* this */
 ) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
     LOGI("Unloading model");
     
 #ifndef LLAMA_STUB
-    if (g_ctx != nullptr) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-    if (g_model != nullptr) {
-        llama_free_model(g_model);
-        g_model = nullptr;
+    if (std::shared_ptr<smith::InferenceBackend> backend = current_backend()) {
+        backend->unload_model();
     }
+    load_vocab(nullptr);
+#else
+    g_model_loaded = false;
 #endif
     
-    g_model_loaded = false;
     LOGI("Model unloaded");
 }
 
@@ -289,11 +781,17 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeIsModelLoaded(
     JNIEnv* env,
     jobject /* this */
 ) {
+#ifndef LLAMA_STUB
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    return backend && backend->is_loaded() ? JNI_TRUE : JNI_FALSE;
+#else
     return g_model_loaded ? JNI_TRUE : JNI_FALSE;
+#endif
 }
 
 /**
- * Free llama backend resources (call at app shutdown)
+ * Free llama backend resources (call at app shutdown).
+ * Pending requests are cancelled and the worker thread joined.
  */
 JNIEXPORT void JNICALL
 Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeFree(
@@ -303,8 +801,9 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeFree(
     LOGI("Freeing llama backend");
     
 #ifndef LLAMA_STUB
-    // Unload model first
-    Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeUnloadModel(env, nullptr);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    replace_backend(nullptr);
+    load_vocab(nullptr);
     llama_backend_free();
 #endif
     
@@ -320,21 +819,155 @@ Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeGetModelInfo(
     jobject /* this */
 ) {
 #ifndef LLAMA_STUB
-    if (g_model == nullptr) {
+    int n_vocab = 0;
+    int n_ctx = 0;
+    int n_embd = 0;
+    std::shared_ptr<smith::InferenceBackend> backend = current_backend();
+    if (!backend || !backend->model_info(n_vocab, n_ctx, n_embd)) {
         return env->NewStringUTF("{}");
     }
     
-    int n_vocab = llama_n_vocab(g_model);
-    int n_ctx = g_ctx != nullptr ? llama_n_ctx(g_ctx) : 0;
-    
     char info[256];
     snprintf(info, sizeof(info), 
-             "{\"vocab_size\":%d,\"context_size\":%d,\"loaded\":true}",
-             n_vocab, n_ctx);
+             "{\"vocab_size\":%d,\"context_size\":%d,\"embedding_size\":%d,\"loaded\":true}",
+             n_vocab, n_ctx, n_embd);
     return env->NewStringUTF(info);
 #else
     return env->NewStringUTF("{\"stub\":true,\"loaded\":false}");
 #endif
 }
 
+/**
+ * Fit prompt segments into a token budget, counted with the loaded
+ * model's tokenizer. Required segments are kept whole; the others are
+ * cut at token boundaries or dropped, lowest priority first.
+ * 
+ * @param texts Segments in prompt order
+ * @param priorities Higher keeps its tokens longer
+ * @param minTokens Shortest useful cut of each segment
+ * @param maxTokens Cap per segment (0 = none)
+ * @param required Never cut or dropped (template markers, the query)
+ * @param keepTail Cut from the front instead of the back
+ * @param budget Tokens the whole prompt may take
+ * @return UTF-8 JSON {"text":str,"n_tokens":int,"kept":[int]}, or null if
+ *         no model is loaded or the required segments alone do not fit
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeAssemblePrompt(
+    JNIEnv* env,
+    jobject /* this */,
+    jobjectArray texts,
+    jintArray priorities,
+    jintArray minTokens,
+    jintArray maxTokens,
+    jbooleanArray required,
+    jbooleanArray keepTail,
+    jint budget
+) {
+#ifndef LLAMA_STUB
+    const jsize n = env->GetArrayLength(texts);
+    if (env->GetArrayLength(priorities) != n || env->GetArrayLength(minTokens) != n ||
+        env->GetArrayLength(maxTokens) != n || env->GetArrayLength(required) != n ||
+        env->GetArrayLength(keepTail) != n) {
+        LOGE("Prompt segment arrays differ in length");
+        return nullptr;
+    }
+    std::shared_ptr<llama_model> vocab = std::atomic_load(&g_vocab);
+    if (!vocab) {
+        return nullptr;
+    }
+    
+    std::vector<jint> prio(n), min_tokens(n), max_tokens(n);
+    std::vector<jboolean> req(n), tail(n);
+    env->GetIntArrayRegion(priorities, 0, n, prio.data());
+    env->GetIntArrayRegion(minTokens, 0, n, min_tokens.data());
+    env->GetIntArrayRegion(maxTokens, 0, n, max_tokens.data());
+    env->GetBooleanArrayRegion(required, 0, n, req.data());
+    env->GetBooleanArrayRegion(keepTail, 0, n, tail.data());
+    
+    std::vector<smith::PromptSegment> segments(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring text = static_cast<jstring>(env->GetObjectArrayElement(texts, i));
+        const char* text_cstr = env->GetStringUTFChars(text, nullptr);
+        segments[i].text = text_cstr;
+        env->ReleaseStringUTFChars(text, text_cstr);
+        env->DeleteLocalRef(text);
+        segments[i].priority = prio[i];
+        segments[i].min_tokens = min_tokens[i];
+        segments[i].max_tokens = max_tokens[i];
+        segments[i].required = req[i] == JNI_TRUE;
+        segments[i].keep_tail = tail[i] == JNI_TRUE;
+    }
+    
+    smith::AssembledPrompt prompt;
+    if (!smith::assemble_prompt(vocab.get(), segments, budget, prompt)) {
+        return nullptr;
+    }
+    std::string json = "{\"text\":";
+    smith::json_append_string(json, prompt.text);
+    json += ",\"n_tokens\":" + std::to_string(prompt.n_tokens) + ",\"kept\":[";
+    for (size_t i = 0; i < prompt.kept_tokens.size(); i++) {
+        if (i > 0) json += ",";
+        json += std::to_string(prompt.kept_tokens[i]);
+    }
+    json += "]}";
+    return to_byte_array(env, json);
+#else
+    return nullptr;
+#endif
+}
+
+/**
+ * Get the repack layout that runs fastest on this CPU ("" = keep original)
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeGetOptimalLayout(
+    JNIEnv* env,
+    jobject /* this */
+) {
+#ifndef LLAMA_STUB
+    return env->NewStringUTF(smith::layout_name(smith::detect_optimal_layout()));
+#else
+    return env->NewStringUTF("");
+#endif
+}
+
+/**
+ * Requantize a downloaded model into this device's optimal layout.
+ * Independent of the loaded model; runs for tens of seconds.
+ *
+ * @param srcPath Downloaded .gguf
+ * @param dstPath Cached fast file (written atomically after verification)
+ * @param nThreads Threads for quantization and the verification probe
+ * @return JSON {"ok":bool,"layout":str,"agreement":float,"error":str}
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_LlamaInference_nativeRepackModel(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring srcPath,
+    jstring dstPath,
+    jint nThreads
+) {
+#ifndef LLAMA_STUB
+    const char* src = env->GetStringUTFChars(srcPath, nullptr);
+    const char* dst = env->GetStringUTFChars(dstPath, nullptr);
+    
+    smith::RepackLayout layout = smith::detect_optimal_layout();
+    smith::RepackResult r = smith::repack_model(src, dst, layout, nThreads > 0 ? nThreads : 4);
+    
+    env->ReleaseStringUTFChars(srcPath, src);
+    env->ReleaseStringUTFChars(dstPath, dst);
+    
+    char info[256];
+    snprintf(info, sizeof(info),
+             "{\"ok\":%s,\"layout\":\"%s\",\"agreement\":%.3f,\"error\":\"%s\"}",
+             r.ok ? "true" : "false", smith::layout_name(layout),
+             r.top1_agreement, r.error.c_str());
+    return env->NewStringUTF(info);
+#else
+    return env->NewStringUTF("{\"ok\":false,\"stub\":true,\"error\":\"stub\"}");
+#endif
+}
+
 } // extern "C"
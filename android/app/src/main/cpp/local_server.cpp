@@ -0,0 +1,1062 @@
+/**
+ * local_server.cpp - OpenAI-compatible HTTP server over the inference engine
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "LocalServer"
+
+#include "local_server.h"
+#include "inference_worker.h"
+#include "json_util.h"
+#include "native_log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <thread>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace smith {
+
+static const size_t MAX_HEADER_BYTES = 16 * 1024;
+static const size_t MAX_BODY_BYTES = 4 * 1024 * 1024;
+static const int MAX_JSON_DEPTH = 32;
+static const size_t MAX_BATCH_PROMPTS = 64;
+static const size_t MAX_WARMED_PROMPTS = 256;
+
+// Shorter system prompts are cheap enough to prefill every time
+static const size_t MIN_WARM_PREFIX_CHARS = 256;
+
+// Idle or slow clients give their thread back after this long
+static const int SOCKET_TIMEOUT_S = 30;
+
+// How often a waiting request checks whether its client hung up
+static const std::chrono::milliseconds HANGUP_POLL_INTERVAL(200);
+
+// Embeddings yield to any generation; retry instead of failing the client
+static const int EMBED_ATTEMPTS = 3;
+
+// ════════════════════════════════════════════════════════════════════
+// JSON
+// ════════════════════════════════════════════════════════════════════
+
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> fields;
+
+    const JsonValue* get(const char* key) const {
+        for (const auto& field : fields) {
+            if (field.first == key) return &field.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : p_(text.c_str()), end_(text.c_str() + text.size()) {}
+
+    bool parse(JsonValue& out) {
+        if (!value(out, 0)) return false;
+        skip_space();
+        return p_ == end_;
+    }
+
+private:
+    void skip_space() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+    }
+
+    bool literal(const char* word) {
+        const size_t n = strlen(word);
+        if ((size_t) (end_ - p_) < n || strncmp(p_, word, n) != 0) return false;
+        p_ += n;
+        return true;
+    }
+
+    bool value(JsonValue& out, int depth) {
+        if (depth > MAX_JSON_DEPTH) return false;
+        skip_space();
+        if (p_ >= end_) return false;
+        switch (*p_) {
+        case '{': return object(out, depth);
+        case '[': return array(out, depth);
+        case '"': out.type = JsonValue::STRING; return string(out.string);
+        case 't': out.type = JsonValue::BOOL; out.boolean = true; return literal("true");
+        case 'f': out.type = JsonValue::BOOL; out.boolean = false; return literal("false");
+        case 'n': out.type = JsonValue::NUL; return literal("null");
+        default: return number(out);
+        }
+    }
+
+    bool object(JsonValue& out, int depth) {
+        out.type = JsonValue::OBJECT;
+        ++p_;
+        skip_space();
+        if (p_ < end_ && *p_ == '}') { ++p_; return true; }
+        while (true) {
+            skip_space();
+            std::string key;
+            if (!string(key)) return false;
+            skip_space();
+            if (p_ >= end_ || *p_++ != ':') return false;
+            out.fields.emplace_back(std::move(key), JsonValue());
+            if (!value(out.fields.back().second, depth + 1)) return false;
+            skip_space();
+            if (p_ >= end_) return false;
+            const char c = *p_++;
+            if (c == '}') return true;
+            if (c != ',') return false;
+        }
+    }
+
+    bool array(JsonValue& out, int depth) {
+        out.type = JsonValue::ARRAY;
+        ++p_;
+        skip_space();
+        if (p_ < end_ && *p_ == ']') { ++p_; return true; }
+        while (true) {
+            out.items.emplace_back();
+            if (!value(out.items.back(), depth + 1)) return false;
+            skip_space();
+            if (p_ >= end_) return false;
+            const char c = *p_++;
+            if (c == ']') return true;
+            if (c != ',') return false;
+        }
+    }
+
+    bool number(JsonValue& out) {
+        if (*p_ != '-' && (*p_ < '0' || *p_ > '9')) return false;
+        // The body is NUL-terminated, so strtod cannot run off the end
+        char* stop = nullptr;
+        out.type = JsonValue::NUMBER;
+        out.number = strtod(p_, &stop);
+        if (stop == p_ || stop > end_) return false;
+        p_ = stop;
+        return true;
+    }
+
+    bool hex4(uint32_t& out) {
+        if (end_ - p_ < 4) return false;
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            const char c = *p_++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= (uint32_t) (c - '0');
+            else if (c >= 'a' && c <= 'f') out |= (uint32_t) (c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') out |= (uint32_t) (c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += (char) cp;
+        } else if (cp < 0x800) {
+            out += (char) (0xC0 | (cp >> 6));
+            out += (char) (0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char) (0xE0 | (cp >> 12));
+            out += (char) (0x80 | ((cp >> 6) & 0x3F));
+            out += (char) (0x80 | (cp & 0x3F));
+        } else {
+            out += (char) (0xF0 | (cp >> 18));
+            out += (char) (0x80 | ((cp >> 12) & 0x3F));
+            out += (char) (0x80 | ((cp >> 6) & 0x3F));
+            out += (char) (0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool string(std::string& out) {
+        if (p_ >= end_ || *p_ != '"') return false;
+        ++p_;
+        while (p_ < end_) {
+            const char c = *p_++;
+            if (c == '"') return true;
+            if ((unsigned char) c < 0x20) return false;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (p_ >= end_) return false;
+            const char e = *p_++;
+            switch (e) {
+            case '"': case '\\': case '/': out += e; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                if (!hex4(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    uint32_t low = 0;
+                    if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') return false;
+                    p_ += 2;
+                    if (!hex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return false;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+static std::string string_field(const JsonValue& body, const char* key) {
+    const JsonValue* v = body.get(key);
+    return v != nullptr && v->type == JsonValue::STRING ? v->string : std::string();
+}
+
+static void json_append_number(std::string& out, double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.7g", v);
+    out += buf;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// HTTP
+// ════════════════════════════════════════════════════════════════════
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string body;
+};
+
+static const char* status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+    }
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t) n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const std::string& data) {
+    return write_all(fd, data.data(), data.size());
+}
+
+static void send_response(int fd, int status, const char* content_type, const std::string& body) {
+    char head[256];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+             status, status_text(status), content_type, body.size());
+    if (write_all(fd, head, strlen(head))) {
+        write_all(fd, body);
+    }
+}
+
+static std::string error_json(const std::string& message, const char* type) {
+    std::string out = "{\"error\":{\"message\":";
+    json_append_string(out, message);
+    out += ",\"type\":\"";
+    out += type;
+    out += "\"}}";
+    return out;
+}
+
+static void send_error(int fd, int status, const std::string& message,
+                       const char* type = "invalid_request_error") {
+    send_response(fd, status, "application/json", error_json(message, type));
+}
+
+static bool send_event(int fd, const std::string& data) {
+    return write_all(fd, "data: " + data + "\n\n");
+}
+
+static std::string lowercase(std::string s) {
+    for (char& c : s) {
+        if (c >= 'A' && c <= 'Z') c = (char) (c - 'A' + 'a');
+    }
+    return s;
+}
+
+/**
+ * Read one request. On failure status is the HTTP error to answer with,
+ * or 0 if the client went away.
+ */
+static bool read_request(int fd, HttpRequest& request, int& status) {
+    std::string data;
+    size_t header_end = std::string::npos;
+    char buf[4096];
+    status = 0;
+    while (header_end == std::string::npos) {
+        if (data.size() > MAX_HEADER_BYTES) {
+            status = 413;
+            return false;
+        }
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            status = 408;
+            return false;
+        }
+        if (n <= 0) return false;
+        data.append(buf, (size_t) n);
+        header_end = data.find("\r\n\r\n");
+    }
+
+    // Request line: METHOD SP target SP version
+    const size_t line_end = data.find("\r\n");
+    const std::string line = data.substr(0, line_end);
+    const size_t sp1 = line.find(' ');
+    const size_t sp2 = sp1 == std::string::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp2 == std::string::npos) {
+        status = 400;
+        return false;
+    }
+    request.method = line.substr(0, sp1);
+    request.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    request.path = request.path.substr(0, request.path.find('?'));
+
+    size_t content_length = 0;
+    size_t pos = line_end + 2;
+    while (pos < header_end) {
+        const size_t eol = data.find("\r\n", pos);
+        const std::string header = data.substr(pos, eol - pos);
+        pos = eol + 2;
+        const size_t colon = header.find(':');
+        if (colon == std::string::npos) continue;
+        const std::string name = lowercase(header.substr(0, colon));
+        const char* value = header.c_str() + colon + 1;
+        if (name == "content-length") {
+            content_length = (size_t) strtoull(value, nullptr, 10);
+        } else if (name == "transfer-encoding") {
+            // Every client we serve sends a length; chunked bodies are not worth a parser
+            status = 411;
+            return false;
+        }
+    }
+    if (content_length > MAX_BODY_BYTES) {
+        status = 413;
+        return false;
+    }
+
+    request.body = data.substr(header_end + 4);
+    while (request.body.size() < content_length) {
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            status = 408;
+            return false;
+        }
+        if (n <= 0) return false;
+        request.body.append(buf, (size_t) n);
+    }
+    request.body.resize(content_length);
+    return true;
+}
+
+static bool peer_closed(int fd) {
+    struct pollfd pfd = { fd, POLLRDHUP, 0 };
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// REQUEST HELPERS
+// ════════════════════════════════════════════════════════════════════
+
+/** Engine events for one request, handed from the worker to its connection thread. */
+struct PendingRequest {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> chunks;
+    bool done = false;
+    std::string error;
+    std::string text;
+    GenerationStats stats;
+    std::vector<BatchItemResult> results;
+    int n_embd = 0;
+    std::vector<float> vectors;
+};
+
+static std::string message_content(const JsonValue& message) {
+    const JsonValue* content = message.get("content");
+    if (content == nullptr) return std::string();
+    if (content->type == JsonValue::STRING) return content->string;
+    // Content parts: only text is meaningful to this model
+    std::string text;
+    if (content->type == JsonValue::ARRAY) {
+        for (const JsonValue& part : content->items) {
+            if (string_field(part, "type") == "text") text += string_field(part, "text");
+        }
+    }
+    return text;
+}
+
+/**
+ * Build the ChatML prompt the app's models are tuned for. system_prefix
+ * receives the leading system turn, which clients tend to repeat verbatim.
+ */
+static bool chatml_prompt(const JsonValue& body, std::string& prompt, std::string& system_prefix) {
+    const JsonValue* messages = body.get("messages");
+    if (messages == nullptr || messages->type != JsonValue::ARRAY || messages->items.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i < messages->items.size(); i++) {
+        const JsonValue& message = messages->items[i];
+        std::string role = string_field(message, "role");
+        if (role == "developer") role = "system";
+        if (role != "system" && role != "user" && role != "assistant") {
+            return false;
+        }
+        prompt += "<|im_start|>" + role + "\n" + message_content(message) + "<|im_end|>\n";
+        if (i == 0 && role == "system") {
+            system_prefix = prompt;
+        }
+    }
+    prompt += "<|im_start|>assistant\n";
+    return true;
+}
+
+static GenerationParams read_params(const JsonValue& body, int max_tokens_limit) {
+    GenerationParams params;
+    const JsonValue* max_tokens = body.get("max_completion_tokens");
+    if (max_tokens == nullptr) max_tokens = body.get("max_tokens");
+    if (max_tokens != nullptr && max_tokens->type == JsonValue::NUMBER) {
+        const double n = max_tokens->number;
+        params.max_tokens = n < 1 ? 1 : n > max_tokens_limit ? max_tokens_limit : (int) n;
+    }
+    const JsonValue* temperature = body.get("temperature");
+    if (temperature != nullptr && temperature->type == JsonValue::NUMBER) {
+        const double t = temperature->number;
+        params.temperature = t < 0 ? 0.0f : t > 2 ? 2.0f : (float) t;
+    }
+    return params;
+}
+
+static const char* finish_reason(int n_generated, const GenerationParams& params) {
+    return n_generated >= params.max_tokens ? "length" : "stop";
+}
+
+static std::string usage_json(int prompt_tokens, int completion_tokens) {
+    return "\"usage\":{\"prompt_tokens\":" + std::to_string(prompt_tokens) +
+           ",\"completion_tokens\":" + std::to_string(completion_tokens) +
+           ",\"total_tokens\":" + std::to_string(prompt_tokens + completion_tokens) + "}";
+}
+
+/** Fields every completion object and chunk starts with. */
+static std::string response_head(const std::string& id, const char* object, const std::string& model) {
+    std::string out = "{\"id\":\"" + id + "\",\"object\":\"" + object + "\",\"created\":" +
+                      std::to_string((long long) time(nullptr)) + ",\"model\":";
+    json_append_string(out, model);
+    return out;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// SERVER
+// ════════════════════════════════════════════════════════════════════
+
+LocalServer::LocalServer(const ServerConfig& config) : config_(config) {
+    if (!config_.worker_path.empty()) {
+        backend_ = WorkerClient::spawn(config_.worker_path, *this);
+        if (!backend_) {
+            LOGW("Cannot start %s; running the engine in-process", config_.worker_path.c_str());
+        }
+    }
+    if (!backend_) {
+        backend_.reset(new Engine(*this));
+    }
+}
+
+LocalServer::~LocalServer() {
+    // The engine's worker calls back into this object until it is joined
+    backend_.reset();
+}
+
+bool LocalServer::load_model(const std::string& path, int n_ctx, int n_threads) {
+    if (config_.model_name.empty()) {
+        const size_t slash = path.find_last_of('/');
+        config_.model_name = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+    return backend_->load_model(path, n_ctx, n_threads);
+}
+
+int LocalServer::open_socket() {
+    int fd = -1;
+    if (!config_.unix_path.empty()) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (config_.unix_path.size() >= sizeof(addr.sun_path)) {
+            LOGE("Socket path too long: %s", config_.unix_path.c_str());
+            return -1;
+        }
+        memcpy(addr.sun_path, config_.unix_path.c_str(), config_.unix_path.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(config_.unix_path.c_str());  // left behind by an earlier run
+        if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+            LOGE("Cannot bind %s: %s", config_.unix_path.c_str(), strerror(errno));
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+        // Same user and group only; anyone who can connect can use the model
+        chmod(config_.unix_path.c_str(), 0660);
+    } else {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+        struct addrinfo* addrs = nullptr;
+        const std::string port = std::to_string(config_.port);
+        if (getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addrs) != 0) {
+            LOGE("Cannot resolve %s", config_.host.c_str());
+            return -1;
+        }
+        for (struct addrinfo* a = addrs; a != nullptr && fd < 0; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if (fd < 0) continue;
+            const int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addrs);
+        if (fd < 0) {
+            LOGE("Cannot bind %s:%d: %s", config_.host.c_str(), config_.port, strerror(errno));
+            return -1;
+        }
+    }
+    if (listen(fd, 64) != 0) {
+        LOGE("listen failed: %s", strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int LocalServer::run() {
+    const int fd = open_socket();
+    if (fd < 0) {
+        return 1;
+    }
+    listen_fd_.store(fd, std::memory_order_release);
+    if (config_.unix_path.empty()) {
+        LOGI("Serving %s on http://%s:%d", config_.model_name.c_str(), config_.host.c_str(), config_.port);
+    } else {
+        LOGI("Serving %s on unix:%s", config_.model_name.c_str(), config_.unix_path.c_str());
+    }
+
+    while (!stopping_.load(std::memory_order_acquire)) {
+        const int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (stopping_.load(std::memory_order_acquire)) break;
+            if (errno != EINTR && errno != ECONNABORTED) {
+                // Usually out of descriptors; give connections a moment to close
+                LOGW("accept failed: %s", strerror(errno));
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            continue;
+        }
+        bool admitted = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (n_clients_ < config_.max_clients) {
+                n_clients_++;
+                admitted = true;
+            }
+        }
+        if (!admitted) {
+            send_error(client, 503, "Too many open connections", "server_error");
+            ::close(client);
+            continue;
+        }
+        std::thread(&LocalServer::serve_connection, this, client).detach();
+    }
+
+    backend_->cancel_all();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this] { return n_clients_ == 0; });
+    }
+    listen_fd_.store(-1, std::memory_order_release);
+    ::close(fd);
+    if (!config_.unix_path.empty()) {
+        unlink(config_.unix_path.c_str());
+    }
+    return backend_lost_.load(std::memory_order_acquire) ? 1 : 0;
+}
+
+void LocalServer::stop() {
+    stopping_.store(true, std::memory_order_release);
+    const int fd = listen_fd_.load(std::memory_order_acquire);
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);  // wakes accept()
+    }
+}
+
+void LocalServer::serve_connection(int fd) {
+    const struct timeval timeout = { SOCKET_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    HttpRequest request;
+    int status = 0;
+    if (read_request(fd, request, status)) {
+        handle(fd, request);
+    } else if (status != 0) {
+        send_error(fd, status, status_text(status));
+    }
+    ::close(fd);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    n_clients_--;
+    idle_cv_.notify_all();
+}
+
+void LocalServer::handle(int fd, const HttpRequest& request) {
+    const bool get = request.method == "GET";
+    const bool post = request.method == "POST";
+
+    if (request.path == "/health") {
+        if (!get) return send_error(fd, 405, "Use GET");
+        if (backend_->is_loaded()) {
+            send_response(fd, 200, "text/plain", "ok\n");
+        } else {
+            send_response(fd, 503, "text/plain", "no model\n");
+        }
+        return;
+    }
+    if (request.path == "/v1/models") {
+        if (!get) return send_error(fd, 405, "Use GET");
+        std::string out = "{\"object\":\"list\",\"data\":[{\"id\":";
+        json_append_string(out, config_.model_name);
+        out += ",\"object\":\"model\",\"created\":0,\"owned_by\":\"smith\"}]}";
+        send_response(fd, 200, "application/json", out);
+        return;
+    }
+
+    const bool chat = request.path == "/v1/chat/completions";
+    const bool completion = request.path == "/v1/completions";
+    const bool embeddings = request.path == "/v1/embeddings";
+    if (!chat && !completion && !embeddings) {
+        return send_error(fd, 404, "Unknown path " + request.path);
+    }
+    if (!post) {
+        return send_error(fd, 405, "Use POST");
+    }
+    if (!backend_->is_loaded()) {
+        return send_error(fd, 503, "No model loaded", "server_error");
+    }
+
+    JsonValue body;
+    if (!JsonParser(request.body).parse(body) || body.type != JsonValue::OBJECT) {
+        return send_error(fd, 400, "Body must be a JSON object");
+    }
+    if (embeddings) {
+        handle_embeddings(fd, body);
+    } else if (completion && body.get("prompt") != nullptr && body.get("prompt")->type == JsonValue::ARRAY) {
+        handle_batch(fd, body);
+    } else {
+        handle_generate(fd, body, chat);
+    }
+}
+
+void LocalServer::handle_generate(int fd, const JsonValue& body, bool chat) {
+    std::string prompt;
+    std::string system_prefix;
+    if (chat) {
+        if (!chatml_prompt(body, prompt, system_prefix)) {
+            return send_error(fd, 400, "messages must be a non-empty array of system, user and assistant turns");
+        }
+    } else {
+        const JsonValue* p = body.get("prompt");
+        if (p == nullptr || p->type != JsonValue::STRING) {
+            return send_error(fd, 400, "prompt must be a string or an array of strings");
+        }
+        prompt = p->string;
+    }
+    const GenerationParams params = read_params(body, config_.max_tokens_limit);
+    const JsonValue* stream_field = body.get("stream");
+    const bool stream = stream_field != nullptr && stream_field->type == JsonValue::BOOL && stream_field->boolean;
+    const Priority priority = stream ? Priority::INTERACTIVE : Priority::NORMAL;
+
+    if (system_prefix.size() >= MIN_WARM_PREFIX_CHARS) {
+        warm_system_prompt(system_prefix, priority);
+    }
+
+    const uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<PendingRequest> pending = track(id);
+    if (!backend_->submit(id, prompt, params, stream, priority)) {
+        untrack(id);
+        return send_error(fd, 503, "Engine is stopping", "server_error");
+    }
+
+    const std::string response_id = (chat ? "chatcmpl-" : "cmpl-") + std::to_string(id);
+    const char* object = chat ? (stream ? "chat.completion.chunk" : "chat.completion") : "text_completion";
+    const std::string head = response_head(response_id, object, config_.model_name);
+
+    // One streamed choice: a delta for chat, plain text for completions
+    auto chunk = [&](const std::string* text, const char* finish) {
+        std::string out = head + ",\"choices\":[{\"index\":0,";
+        if (chat) {
+            out += "\"delta\":{";
+            if (text != nullptr) {
+                out += "\"content\":";
+                json_append_string(out, *text);
+            }
+            out += "},";
+        } else {
+            out += "\"text\":";
+            json_append_string(out, text != nullptr ? *text : std::string());
+            out += ",";
+        }
+        out += "\"finish_reason\":";
+        out += finish != nullptr ? "\"" + std::string(finish) + "\"" : "null";
+        out += "}]}";
+        return out;
+    };
+
+    if (stream) {
+        static const char SSE_HEAD[] =
+            "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+            "Connection: close\r\n\r\n";
+        bool open = write_all(fd, SSE_HEAD, sizeof(SSE_HEAD) - 1);
+        if (open && chat) {
+            std::string first = head + ",\"choices\":[{\"index\":0,\"delta\":{\"role\":\"assistant\"},\"finish_reason\":null}]}";
+            open = send_event(fd, first);
+        }
+
+        bool done = false;
+        while (open && !done) {
+            std::deque<std::string> chunks;
+            if (!next_event(fd, id, *pending, done)) {
+                untrack(id);  // hung up; already cancelled
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                chunks.swap(pending->chunks);
+            }
+            for (const std::string& text : chunks) {
+                if (!send_event(fd, chunk(&text, nullptr))) {
+                    open = false;
+                    break;
+                }
+            }
+        }
+        if (!open) {
+            backend_->cancel(id);
+        } else {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            if (!pending->error.empty()) {
+                send_event(fd, error_json(pending->error, "server_error"));
+            } else {
+                send_event(fd, chunk(nullptr, finish_reason(pending->stats.n_generated, params)));
+            }
+            send_event(fd, "[DONE]");
+        }
+        untrack(id);
+        return;
+    }
+
+    bool done = false;
+    while (!done) {
+        if (!next_event(fd, id, *pending, done)) {
+            untrack(id);
+            return;
+        }
+    }
+    untrack(id);
+
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    if (!pending->error.empty()) {
+        return send_error(fd, 500, pending->error, "server_error");
+    }
+    std::string out = head + ",\"choices\":[{\"index\":0,";
+    if (chat) {
+        out += "\"message\":{\"role\":\"assistant\",\"content\":";
+        json_append_string(out, pending->text);
+        out += "},";
+    } else {
+        out += "\"text\":";
+        json_append_string(out, pending->text);
+        out += ",";
+    }
+    out += "\"finish_reason\":\"";
+    out += finish_reason(pending->stats.n_generated, params);
+    out += "\"}],";
+    out += usage_json(pending->stats.n_prompt_tokens, pending->stats.n_generated);
+    out += "}";
+    send_response(fd, 200, "application/json", out);
+}
+
+void LocalServer::handle_batch(int fd, const JsonValue& body) {
+    const JsonValue* prompts = body.get("prompt");
+    if (prompts->items.empty() || prompts->items.size() > MAX_BATCH_PROMPTS) {
+        return send_error(fd, 400, "prompt array must hold 1 to " + std::to_string(MAX_BATCH_PROMPTS) + " strings");
+    }
+    const JsonValue* stream_field = body.get("stream");
+    if (stream_field != nullptr && stream_field->type == JsonValue::BOOL && stream_field->boolean) {
+        return send_error(fd, 400, "An array of prompts cannot be streamed");
+    }
+    const GenerationParams params = read_params(body, config_.max_tokens_limit);
+    std::vector<BatchItem> items;
+    for (const JsonValue& p : prompts->items) {
+        if (p.type != JsonValue::STRING) {
+            return send_error(fd, 400, "prompt array must hold only strings");
+        }
+        items.push_back({ p.string, params });
+    }
+
+    const uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<PendingRequest> pending = track(id);
+    if (!backend_->submit_batch(id, std::move(items))) {
+        untrack(id);
+        return send_error(fd, 503, "Engine is stopping", "server_error");
+    }
+    bool done = false;
+    while (!done) {
+        if (!next_event(fd, id, *pending, done)) {
+            untrack(id);
+            return;
+        }
+    }
+    untrack(id);
+
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    if (!pending->error.empty()) {
+        return send_error(fd, 500, pending->error, "server_error");
+    }
+    std::string out = response_head("cmpl-" + std::to_string(id), "text_completion", config_.model_name);
+    out += ",\"choices\":[";
+    int prompt_tokens = 0;
+    int completion_tokens = 0;
+    for (size_t i = 0; i < pending->results.size(); i++) {
+        const BatchItemResult& r = pending->results[i];
+        prompt_tokens += r.n_prompt_tokens;
+        completion_tokens += r.n_generated;
+        if (i > 0) out += ",";
+        out += "{\"index\":" + std::to_string(i) + ",\"text\":";
+        json_append_string(out, r.text);
+        out += ",\"finish_reason\":";
+        if (r.status != GenerationStatus::OK) {
+            out += "\"error\"";  // the other prompts still have their results
+        } else {
+            out += "\"";
+            out += finish_reason(r.n_generated, params);
+            out += "\"";
+        }
+        out += "}";
+    }
+    out += "],";
+    out += usage_json(prompt_tokens, completion_tokens);
+    out += "}";
+    send_response(fd, 200, "application/json", out);
+}
+
+void LocalServer::handle_embeddings(int fd, const JsonValue& body) {
+    const JsonValue* input = body.get("input");
+    std::vector<std::string> texts;
+    if (input != nullptr && input->type == JsonValue::STRING) {
+        texts.push_back(input->string);
+    } else if (input != nullptr && input->type == JsonValue::ARRAY) {
+        for (const JsonValue& t : input->items) {
+            if (t.type != JsonValue::STRING) {
+                texts.clear();
+                break;
+            }
+            texts.push_back(t.string);
+        }
+    }
+    if (texts.empty() || texts.size() > MAX_BATCH_PROMPTS) {
+        return send_error(fd, 400, "input must be a string or an array of 1 to " +
+                                   std::to_string(MAX_BATCH_PROMPTS) + " strings");
+    }
+
+    std::shared_ptr<PendingRequest> pending;
+    uint64_t id = 0;
+    for (int attempt = 0; attempt < EMBED_ATTEMPTS; attempt++) {
+        id = next_id_.fetch_add(1, std::memory_order_relaxed);
+        pending = track(id);
+        if (!backend_->submit_embed(id, texts, Priority::NORMAL)) {
+            untrack(id);
+            return send_error(fd, 503, "Engine is stopping", "server_error");
+        }
+        bool done = false;
+        while (!done) {
+            if (!next_event(fd, id, *pending, done)) {
+                untrack(id);
+                return;
+            }
+        }
+        untrack(id);
+        std::lock_guard<std::mutex> lock(pending->mutex);
+        if (pending->error != "Yielded") break;
+    }
+
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    if (!pending->error.empty()) {
+        return send_error(fd, 500, pending->error, "server_error");
+    }
+    const int n_embd = pending->n_embd;
+    if (n_embd <= 0 || pending->vectors.size() < texts.size() * (size_t) n_embd) {
+        return send_error(fd, 500, "Embedding result is incomplete", "server_error");
+    }
+    std::string out = "{\"object\":\"list\",\"data\":[";
+    for (size_t i = 0; i < texts.size(); i++) {
+        if (i > 0) out += ",";
+        out += "{\"object\":\"embedding\",\"index\":" + std::to_string(i) + ",\"embedding\":[";
+        for (int j = 0; j < n_embd; j++) {
+            if (j > 0) out += ",";
+            json_append_number(out, pending->vectors[i * n_embd + j]);
+        }
+        out += "]}";
+    }
+    out += "],\"model\":";
+    json_append_string(out, config_.model_name);
+    out += ",\"usage\":{\"prompt_tokens\":0,\"total_tokens\":0}}";
+    send_response(fd, 200, "application/json", out);
+}
+
+void LocalServer::warm_system_prompt(const std::string& prefix, Priority priority) {
+    const size_t hash = std::hash<std::string>()(prefix);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (warmed_.count(hash) != 0) return;
+        if (warmed_.size() >= MAX_WARMED_PROMPTS) warmed_.clear();
+        warmed_.insert(hash);
+    }
+    // Queued ahead of the request at its priority, so the request itself and
+    // every concurrent client with the same system turn restore it from cache
+    backend_->submit_warm(next_id_.fetch_add(1, std::memory_order_relaxed), prefix, priority);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// ENGINE EVENTS
+// ════════════════════════════════════════════════════════════════════
+
+std::shared_ptr<PendingRequest> LocalServer::track(uint64_t id) {
+    std::shared_ptr<PendingRequest> pending = std::make_shared<PendingRequest>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[id] = pending;
+    return pending;
+}
+
+std::shared_ptr<PendingRequest> LocalServer::find(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(id);
+    return it == pending_.end() ? nullptr : it->second;
+}
+
+void LocalServer::untrack(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.erase(id);
+}
+
+bool LocalServer::next_event(int fd, uint64_t id, PendingRequest& pending, bool& done) {
+    std::unique_lock<std::mutex> lock(pending.mutex);
+    while (!pending.done && pending.chunks.empty()) {
+        if (pending.cv.wait_for(lock, HANGUP_POLL_INTERVAL) == std::cv_status::timeout && peer_closed(fd)) {
+            lock.unlock();
+            backend_->cancel(id);
+            return false;
+        }
+    }
+    done = pending.done;
+    return true;
+}
+
+void LocalServer::on_text(uint64_t id, const std::string& text) {
+    std::shared_ptr<PendingRequest> pending = find(id);
+    if (!pending) return;
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->chunks.push_back(text);
+    pending->cv.notify_one();
+}
+
+void LocalServer::on_complete(uint64_t id, const std::string& text, const GenerationStats& stats) {
+    std::shared_ptr<PendingRequest> pending = find(id);
+    if (!pending) return;  // a warm request, or the client hung up
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->text = text;
+    pending->stats = stats;
+    pending->done = true;
+    pending->cv.notify_one();
+}
+
+void LocalServer::on_error(uint64_t id, const std::string& error) {
+    std::shared_ptr<PendingRequest> pending = find(id);
+    if (!pending) return;
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->error = error;
+    pending->done = true;
+    pending->cv.notify_one();
+}
+
+void LocalServer::on_batch_complete(uint64_t id, const std::vector<BatchItemResult>& results,
+                                    const BatchStats& stats) {
+    std::shared_ptr<PendingRequest> pending = find(id);
+    if (!pending) return;
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->results = results;
+    pending->done = true;
+    pending->cv.notify_one();
+}
+
+void LocalServer::on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) {
+    std::shared_ptr<PendingRequest> pending = find(id);
+    if (!pending) return;
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->n_embd = n_embd;
+    pending->vectors = vectors;
+    pending->done = true;
+    pending->cv.notify_one();
+}
+
+void LocalServer::on_backend_lost() {
+    // Outstanding requests have already failed; a supervisor restarts the server
+    LOGE("Inference worker exited; shutting down");
+    backend_lost_.store(true, std::memory_order_release);
+    stop();
+}
+
+} // namespace smith
@@ -0,0 +1,110 @@
+/**
+ * local_server.h - OpenAI-compatible HTTP server over the inference engine
+ * Guild of Smiths - Offline AI Module
+ *
+ * Job-site laptops and gateway boxes have no vendor API to call, so the
+ * same engine the app uses can serve local clients instead (the backend's
+ * LocalProvider, scripts, the desktop portal). One model instance serves
+ * every connection: requests go into the engine's priority scheduler,
+ * concurrent chats that share a system prompt reuse its KV cells through
+ * the prefix cache, and an array of prompts runs as one batch request.
+ *
+ * Endpoints (HTTP/1.1, one request per connection, TCP or a Unix socket):
+ *   GET  /health               - "ok" once the model is loaded
+ *   GET  /v1/models            - the one served model
+ *   POST /v1/chat/completions  - ChatML prompt; "stream": true sends SSE
+ *   POST /v1/completions       - raw prompt, or an array of prompts (batch)
+ *   POST /v1/embeddings        - one vector per input string
+ *
+ * Streaming requests run at INTERACTIVE priority, single completions at
+ * NORMAL and batches at BACKGROUND. A client that hangs up has its
+ * request cancelled.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "engine.h"
+
+namespace smith {
+
+// Defined in local_server.cpp
+struct HttpRequest;
+struct JsonValue;
+struct PendingRequest;
+
+struct ServerConfig {
+    std::string host = "127.0.0.1";  // TCP bind address
+    int port = 8080;
+    std::string unix_path;           // listen on this socket instead of TCP
+    std::string model_name;          // reported in responses; defaults to the file name
+    std::string worker_path;         // run the engine in this smith_worker binary
+    int max_clients = 32;            // open connections; later ones get 503
+    int max_tokens_limit = 2048;     // upper bound on a request's max_tokens
+};
+
+class LocalServer : public EngineListener {
+public:
+    explicit LocalServer(const ServerConfig& config);
+    ~LocalServer() override;
+
+    LocalServer(const LocalServer&) = delete;
+    LocalServer& operator=(const LocalServer&) = delete;
+
+    bool load_model(const std::string& path, int n_ctx, int n_threads);
+
+    /**
+     * Accept and serve connections until stop(). Each connection gets its
+     * own thread, which waits on the engine rather than running it.
+     * @return 0 after stop(), 1 if the socket could not be opened or the worker died
+     */
+    int run();
+
+    /** Stop accepting, cancel everything and let run() return. Async-signal-safe. */
+    void stop();
+
+    void on_text(uint64_t id, const std::string& text) override;
+    void on_complete(uint64_t id, const std::string& text, const GenerationStats& stats) override;
+    void on_error(uint64_t id, const std::string& error) override;
+    void on_batch_complete(uint64_t id, const std::vector<BatchItemResult>& results,
+                           const BatchStats& stats) override;
+    void on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) override;
+    void on_backend_lost() override;
+
+private:
+    int open_socket();
+    void serve_connection(int fd);
+    void handle(int fd, const HttpRequest& request);
+    void handle_generate(int fd, const JsonValue& body, bool chat);
+    void handle_batch(int fd, const JsonValue& body);
+    void handle_embeddings(int fd, const JsonValue& body);
+    void warm_system_prompt(const std::string& prefix, Priority priority);
+
+    std::shared_ptr<PendingRequest> track(uint64_t id);
+    std::shared_ptr<PendingRequest> find(uint64_t id);
+    void untrack(uint64_t id);
+    bool next_event(int fd, uint64_t id, PendingRequest& pending, bool& done);
+
+    ServerConfig config_;
+    std::unique_ptr<InferenceBackend> backend_;
+    std::atomic<uint64_t> next_id_{ 1 };
+    std::atomic<int> listen_fd_{ -1 };
+    std::atomic<bool> stopping_{ false };
+    std::atomic<bool> backend_lost_{ false };
+
+    std::mutex mutex_;                 // guards everything below
+    std::condition_variable idle_cv_;
+    std::map<uint64_t, std::shared_ptr<PendingRequest>> pending_;
+    std::set<size_t> warmed_;          // hashes of system prompts already in the prefix cache
+    int n_clients_ = 0;
+};
+
+} // namespace smith
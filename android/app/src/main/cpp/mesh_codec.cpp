@@ -0,0 +1,303 @@
+/**
+ * mesh_codec.cpp - Static-dictionary compression for mesh payloads
+ * Guild of Smiths - Offline AI Module
+ */
+
+#include "mesh_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <utility>
+
+namespace smith {
+
+// ════════════════════════════════════════════════════════════════════
+// DICTIONARY (wire format: append only under a new MESH_CODEC_TAG)
+// ════════════════════════════════════════════════════════════════════
+
+struct DictWord {
+    const char* text;
+    uint32_t weight;   // relative frequency in crew chat; the " word" form gets 3x
+};
+
+// Words and fragments from job-site messages, rough frequency order
+static const DictWord DICT_WORDS[] = {
+    { "the", 400 }, { "to", 260 }, { "on", 200 }, { "at", 180 }, { "and", 180 },
+    { "is", 160 }, { "in", 160 }, { "for", 150 }, { "need", 150 }, { "a", 140 },
+    { "i", 130 }, { "we", 120 }, { "it", 120 }, { "of", 110 }, { "you", 110 },
+    { "site", 100 }, { "up", 100 }, { "out", 100 }, { "done", 90 }, { "ok", 90 },
+    { "be", 90 }, { "are", 90 }, { "can", 90 }, { "where", 80 }, { "more", 80 },
+    { "here", 80 }, { "there", 80 }, { "with", 80 }, { "get", 80 }, { "have", 80 },
+    { "wire", 70 }, { "panel", 70 }, { "job", 70 }, { "crew", 70 }, { "back", 70 },
+    { "lunch", 60 }, { "now", 60 }, { "today", 60 }, { "tomorrow", 50 }, { "am", 50 },
+    { "pm", 50 }, { "noon", 40 }, { "by", 60 }, { "from", 50 }, { "this", 60 },
+    { "that", 60 }, { "what", 50 }, { "when", 50 }, { "who", 40 }, { "has", 50 },
+    { "my", 50 }, { "your", 40 }, { "all", 50 }, { "no", 50 }, { "yes", 50 },
+    { "not", 50 }, { "don't", 30 }, { "can't", 30 }, { "it's", 30 }, { "i'm", 30 },
+    { "please", 40 }, { "thanks", 40 }, { "help", 40 }, { "call", 40 }, { "check", 50 },
+    { "clock", 40 }, { "inspection", 40 }, { "inspector", 30 }, { "passed", 30 }, { "failed", 20 },
+    { "breaker", 40 }, { "conduit", 40 }, { "outlet", 30 }, { "switch", 30 }, { "box", 30 },
+    { "circuit", 30 }, { "ground", 30 }, { "neutral", 20 }, { "volt", 20 }, { "amp", 20 },
+    { "pipe", 40 }, { "valve", 30 }, { "leak", 30 }, { "water", 40 }, { "drain", 30 },
+    { "gas", 30 }, { "line", 40 }, { "fitting", 20 }, { "copper", 20 }, { "pvc", 20 },
+    { "duct", 20 }, { "vent", 20 }, { "roof", 30 }, { "floor", 30 }, { "wall", 40 },
+    { "ceiling", 20 }, { "door", 30 }, { "window", 20 }, { "stud", 20 }, { "frame", 20 },
+    { "drywall", 20 }, { "concrete", 30 }, { "pour", 20 }, { "rebar", 20 }, { "form", 20 },
+    { "lumber", 20 }, { "beam", 20 }, { "joist", 20 }, { "truss", 10 }, { "nail", 20 },
+    { "screw", 20 }, { "bolt", 20 }, { "ladder", 30 }, { "drill", 30 }, { "saw", 20 },
+    { "tool", 30 }, { "tools", 30 }, { "truck", 40 }, { "trailer", 20 }, { "gate", 20 },
+    { "material", 30 }, { "materials", 30 }, { "delivery", 30 }, { "order", 30 }, { "supply", 20 },
+    { "parts", 20 }, { "less", 20 }, { "ready", 40 }, { "start", 40 },
+    { "stop", 30 }, { "finish", 30 }, { "finished", 20 }, { "working", 30 }, { "work", 40 },
+    { "fix", 30 }, { "install", 30 }, { "installed", 20 }, { "move", 30 }, { "bring", 30 },
+    { "send", 30 }, { "meet", 30 }, { "coming", 30 }, { "going", 30 }, { "left", 30 },
+    { "right", 30 }, { "down", 40 }, { "over", 30 }, { "off", 30 }, { "open", 30 },
+    { "shut", 20 }, { "power", 40 }, { "safety", 30 }, { "permit", 20 }, { "plan", 30 },
+    { "plans", 20 }, { "level", 20 }, { "room", 30 }, { "kitchen", 20 },
+    { "bathroom", 20 }, { "garage", 20 }, { "basement", 20 }, { "upstairs", 20 }, { "outside", 20 },
+    { "boss", 20 }, { "foreman", 20 }, { "customer", 20 }, { "owner", 20 }, { "office", 20 },
+    { "min", 30 }, { "hour", 30 }, { "hours", 20 }, { "break", 30 }, { "late", 20 },
+    { "early", 20 }, { "asap", 30 }, { "copy", 20 }, { "roger", 10 }, { "eta", 20 },
+    { "ing", 60 }, { "ed", 50 }, { "er", 40 }, { "tion", 30 }, { "ly", 20 },
+};
+
+static const int N_WORDS = (int) (sizeof(DICT_WORDS) / sizeof(DICT_WORDS[0]));
+
+// Rough English letter frequencies per mille, a..z
+static const uint32_t LETTER_WEIGHTS[26] = {
+    82, 15, 28, 43, 127, 22, 20, 61, 70, 2, 8, 40, 24,
+    67, 75, 19, 1, 60, 63, 91, 28, 10, 24, 2, 20, 1,
+};
+
+// Symbols: bytes 0..255, then each word bare and with a leading space, then END
+static const int N_BYTE_SYMBOLS = 256;
+static const int N_SYMBOLS = N_BYTE_SYMBOLS + 2 * N_WORDS + 1;
+static const int END_SYMBOL = N_SYMBOLS - 1;
+static const int MAX_CODE_BITS = 32;
+
+namespace {
+
+struct Codebook {
+    std::vector<std::string> text;       // bytes each symbol stands for (empty for END)
+    std::vector<uint32_t> code;
+    std::vector<uint8_t> length;
+
+    // Canonical decoding: symbols sorted by (length, symbol)
+    std::vector<int> sorted;
+    uint32_t first[MAX_CODE_BITS + 1] = {};
+    uint32_t count[MAX_CODE_BITS + 1] = {};
+    uint32_t offset[MAX_CODE_BITS + 1] = {};
+
+    // Word symbols by first byte, longest first
+    std::vector<int> by_first[256];
+
+    Codebook() {
+        text.resize(N_SYMBOLS);
+        std::vector<uint32_t> weight(N_SYMBOLS, 1);
+        for (int b = 0; b < N_BYTE_SYMBOLS; b++) {
+            text[b] = std::string(1, (char) b);
+            if (b >= 'a' && b <= 'z') {
+                weight[b] = LETTER_WEIGHTS[b - 'a'] * 4;
+            } else if (b >= 'A' && b <= 'Z') {
+                weight[b] = LETTER_WEIGHTS[b - 'A'] / 2 + 2;
+            } else if (b >= '0' && b <= '9') {
+                weight[b] = 30;
+            } else if (b == ' ') {
+                weight[b] = 400;
+            } else if (b > ' ' && b < 0x7F) {
+                weight[b] = strchr(".,?!'-:/", b) != nullptr ? 24 : 4;
+            } else if (b >= 0x80) {
+                weight[b] = 2;
+            }
+        }
+        for (int w = 0; w < N_WORDS; w++) {
+            const int bare = N_BYTE_SYMBOLS + 2 * w;
+            text[bare] = DICT_WORDS[w].text;
+            weight[bare] = DICT_WORDS[w].weight;
+            text[bare + 1] = std::string(" ") + DICT_WORDS[w].text;
+            weight[bare + 1] = DICT_WORDS[w].weight * 3;
+        }
+        weight[END_SYMBOL] = 300;
+
+        build_lengths(weight);
+        build_codes();
+
+        for (int s = N_BYTE_SYMBOLS; s < END_SYMBOL; s++) {
+            by_first[(uint8_t) text[s][0]].push_back(s);
+        }
+        for (std::vector<int>& list : by_first) {
+            std::stable_sort(list.begin(), list.end(), [this](int a, int b) {
+                return text[a].size() > text[b].size();
+            });
+        }
+    }
+
+    // Huffman code lengths; ties broken by node index so every build agrees
+    void build_lengths(const std::vector<uint32_t>& weight) {
+        typedef std::pair<uint64_t, int> Node;   // (weight, index)
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+        std::vector<int> parent(2 * N_SYMBOLS - 1, -1);
+        for (int s = 0; s < N_SYMBOLS; s++) {
+            heap.push(Node(weight[s], s));
+        }
+        int next = N_SYMBOLS;
+        while (heap.size() > 1) {
+            const Node a = heap.top();
+            heap.pop();
+            const Node b = heap.top();
+            heap.pop();
+            parent[a.second] = next;
+            parent[b.second] = next;
+            heap.push(Node(a.first + b.first, next));
+            next++;
+        }
+        length.assign(N_SYMBOLS, 0);
+        for (int s = 0; s < N_SYMBOLS; s++) {
+            int depth = 0;
+            for (int n = s; parent[n] >= 0; n = parent[n]) {
+                depth++;
+            }
+            length[s] = (uint8_t) std::min(depth, MAX_CODE_BITS);
+        }
+    }
+
+    void build_codes() {
+        sorted.resize(N_SYMBOLS);
+        for (int s = 0; s < N_SYMBOLS; s++) {
+            sorted[s] = s;
+            count[length[s]]++;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [this](int a, int b) {
+            return length[a] < length[b];
+        });
+
+        code.assign(N_SYMBOLS, 0);
+        uint32_t c = 0;
+        uint32_t index = 0;
+        for (int len = 1; len <= MAX_CODE_BITS; len++) {
+            c <<= 1;
+            first[len] = c;
+            offset[len] = index;
+            index += count[len];
+            c += count[len];
+        }
+        uint32_t next[MAX_CODE_BITS + 1];
+        memcpy(next, first, sizeof(next));
+        for (int s : sorted) {
+            code[s] = next[length[s]]++;
+        }
+    }
+};
+
+const Codebook& codebook() {
+    static const Codebook book;
+    return book;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(uint32_t code, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            cur_ = (uint8_t) (cur_ | (((code >> i) & 1) << (7 - n_)));
+            if (++n_ == 8) {
+                out_.push_back(cur_);
+                cur_ = 0;
+                n_ = 0;
+            }
+        }
+    }
+
+    void flush() {
+        if (n_ > 0) {
+            out_.push_back(cur_);
+            cur_ = 0;
+            n_ = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint8_t cur_ = 0;
+    int n_ = 0;
+};
+
+} // namespace
+
+// ════════════════════════════════════════════════════════════════════
+// ENCODE / DECODE
+// ════════════════════════════════════════════════════════════════════
+
+bool mesh_encode(const std::string& text, size_t max_bytes, std::vector<uint8_t>& out) {
+    const Codebook& book = codebook();
+    const size_t n = text.size();
+
+    // Cheapest parse from each position to the end (cost in bits)
+    std::vector<uint64_t> cost(n + 1, 0);
+    std::vector<int> choice(n, 0);
+    cost[n] = book.length[END_SYMBOL];
+    for (size_t i = n; i-- > 0;) {
+        const uint8_t b = (uint8_t) text[i];
+        choice[i] = b;
+        cost[i] = book.length[b] + cost[i + 1];
+        for (int s : book.by_first[b]) {
+            const std::string& w = book.text[s];
+            if (w.size() <= n - i && text.compare(i, w.size(), w) == 0 &&
+                book.length[s] + cost[i + w.size()] < cost[i]) {
+                cost[i] = book.length[s] + cost[i + w.size()];
+                choice[i] = s;
+            }
+        }
+    }
+
+    out.clear();
+    if (max_bytes > 0 && 1 + (cost[0] + 7) / 8 > max_bytes) {
+        return false;
+    }
+    out.reserve(1 + (size_t) (cost[0] + 7) / 8);
+    out.push_back(MESH_CODEC_TAG);
+    BitWriter writer(out);
+    for (size_t i = 0; i < n; i += book.text[choice[i]].size()) {
+        writer.put(book.code[choice[i]], book.length[choice[i]]);
+    }
+    writer.put(book.code[END_SYMBOL], book.length[END_SYMBOL]);
+    writer.flush();
+    return true;
+}
+
+bool mesh_decode(const uint8_t* data, size_t size, std::string& out) {
+    if (!is_mesh_frame(data, size)) {
+        return false;
+    }
+    const Codebook& book = codebook();
+    const size_t n_bits = (size - 1) * 8;
+    size_t pos = 0;
+    std::string text;
+    while (true) {
+        uint32_t c = 0;
+        int len = 0;
+        int symbol = -1;
+        while (symbol < 0) {
+            if (pos == n_bits || len == MAX_CODE_BITS) {
+                return false;
+            }
+            const uint8_t byte = data[1 + (pos >> 3)];
+            c = (c << 1) | ((byte >> (7 - (pos & 7))) & 1);
+            pos++;
+            len++;
+            if (c - book.first[len] < book.count[len]) {
+                symbol = book.sorted[book.offset[len] + (c - book.first[len])];
+            }
+        }
+        if (symbol == END_SYMBOL) {
+            break;
+        }
+        text += book.text[symbol];
+    }
+    out.swap(text);
+    return true;
+}
+
+} // namespace smith
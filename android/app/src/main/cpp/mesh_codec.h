@@ -0,0 +1,47 @@
+/**
+ * mesh_codec.h - Static-dictionary compression for mesh payloads
+ * Guild of Smiths - Offline AI Module
+ *
+ * Works on every device, model or not. Text is parsed into symbols from a
+ * fixed table (the 256 byte values plus a few hundred trade words, each
+ * with and without a leading space) and Huffman-coded with code lengths
+ * derived from built-in weights. The parse is optimal for those code
+ * lengths, so "need more wire on site" costs a handful of bits per word.
+ *
+ * Frame: [MESH_CODEC_TAG][coded bits, END symbol, zero padding]. 0xC0 can
+ * never start UTF-8 (or a predictive_codec frame), so receivers tell the
+ * three apart by the first byte. The table is part of the wire format:
+ * changing it means a new tag.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+// First byte of a dictionary-coded frame (table version 1)
+static const uint8_t MESH_CODEC_TAG = 0xC0;
+
+/** True if data is a frame this codec can expand. */
+inline bool is_mesh_frame(const uint8_t* data, size_t size) {
+    return size >= 1 && data[0] == MESH_CODEC_TAG;
+}
+
+/**
+ * Compress text into a frame.
+ * @param max_bytes Give up as soon as the frame would exceed this; 0 for no limit
+ * @return false if the frame would not fit (out is then empty)
+ */
+bool mesh_encode(const std::string& text, size_t max_bytes, std::vector<uint8_t>& out);
+
+/**
+ * Expand a frame made by mesh_encode.
+ * @return false if data is not a frame or is truncated/corrupt
+ */
+bool mesh_decode(const uint8_t* data, size_t size, std::string& out);
+
+} // namespace smith
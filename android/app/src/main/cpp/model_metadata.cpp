@@ -0,0 +1,148 @@
+/**
+ * model_metadata.cpp - Model details straight from the GGUF header
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "ModelMetadata"
+
+#include "model_metadata.h"
+#include "gguf_reader.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smith {
+
+static uint64_t kv_uint(const GgufFile& file, const std::string& key, uint64_t fallback) {
+    const GgufKV* kv = file.find(key.c_str());
+    if (kv == nullptr) {
+        return fallback;
+    }
+    switch (kv->type) {
+        case GGUF_VAL_UINT8:
+        case GGUF_VAL_UINT16:
+        case GGUF_VAL_UINT32:
+        case GGUF_VAL_UINT64:
+            return kv->u64;
+        case GGUF_VAL_INT8:
+        case GGUF_VAL_INT16:
+        case GGUF_VAL_INT32:
+        case GGUF_VAL_INT64:
+            return kv->i64 >= 0 ? (uint64_t) kv->i64 : fallback;
+        default:
+            // Per-layer arrays (e.g. head_count_kv in some models) are not summarized
+            return fallback;
+    }
+}
+
+static std::string kv_string(const GgufFile& file, const char* key) {
+    const GgufKV* kv = file.find(key);
+    return kv != nullptr && kv->type == GGUF_VAL_STRING ? kv->str : std::string();
+}
+
+static void extract(const GgufFile& file, ModelMetadata& meta) {
+    meta.gguf_version = file.version;
+    meta.architecture = kv_string(file, "general.architecture");
+    meta.name = kv_string(file, "general.name");
+    if (file.find("general.file_type") != nullptr) {
+        meta.file_type = (int64_t) kv_uint(file, "general.file_type", 0);
+    }
+
+    const std::string arch = meta.architecture;
+    meta.context_length = kv_uint(file, arch + ".context_length", 0);
+    meta.embedding_length = kv_uint(file, arch + ".embedding_length", 0);
+    meta.block_count = kv_uint(file, arch + ".block_count", 0);
+    meta.head_count = kv_uint(file, arch + ".attention.head_count", 0);
+    meta.head_count_kv = kv_uint(file, arch + ".attention.head_count_kv", meta.head_count);
+    meta.chat_template = kv_string(file, "tokenizer.chat_template");
+
+    const GgufKV* tokens = file.find("tokenizer.ggml.tokens");
+    if (tokens != nullptr && tokens->type == GGUF_VAL_ARRAY) {
+        meta.vocab_size = tokens->array_len;
+    }
+
+    std::map<uint32_t, TensorTypeStats> by_type;
+    for (const GgufTensorInfo& t : file.tensors) {
+        meta.n_params += t.ne[0] * t.ne[1] * t.ne[2] * t.ne[3];
+        meta.tensor_bytes += t.nbytes;
+        TensorTypeStats& s = by_type[t.type];
+        s.type = ggml_type_label(t.type);
+        s.n_tensors++;
+        s.nbytes += t.nbytes;
+    }
+    meta.n_tensors = file.tensors.size();
+    for (auto& entry : by_type) {
+        meta.types.push_back(entry.second);
+    }
+    std::sort(meta.types.begin(), meta.types.end(),
+              [](const TensorTypeStats& a, const TensorTypeStats& b) { return a.nbytes > b.nbytes; });
+    if (!meta.types.empty()) {
+        meta.dominant_type = meta.types.front().type;
+    }
+
+    // K and V, f16, one row of n_embd_k_gqa per layer (what llama.cpp allocates by default)
+    if (meta.head_count > 0) {
+        const uint64_t n_embd_kv = meta.embedding_length / meta.head_count * meta.head_count_kv;
+        meta.kv_bytes_per_token = 2 * meta.block_count * n_embd_kv * 2;
+    }
+}
+
+ModelMetadata read_model_metadata(const std::string& path) {
+    const auto t0 = std::chrono::steady_clock::now();
+    ModelMetadata meta;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        meta.error = "file not found";
+        return meta;
+    }
+    meta.file_size = (uint64_t) st.st_size;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        meta.error = "cannot open file";
+        return meta;
+    }
+    void* map = meta.file_size > 0
+        ? mmap(nullptr, (size_t) meta.file_size, PROT_READ, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        meta.error = "cannot map file";
+        return meta;
+    }
+    // No readahead: only the header pages should ever be faulted in
+    madvise(map, (size_t) meta.file_size, MADV_RANDOM);
+
+    GgufFile gguf;
+    std::string error;
+    if (!parse_gguf(static_cast<const uint8_t*>(map), (size_t) meta.file_size, gguf, error) ||
+        !validate_tensor_bounds(gguf, meta.file_size, error)) {
+        meta.error = error;
+    } else {
+        extract(gguf, meta);
+        meta.ok = true;
+    }
+    munmap(map, (size_t) meta.file_size);
+
+    meta.elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    if (meta.ok) {
+        LOGI("Read metadata of %s in %lld us (%s, %s, %llu tensors)",
+             path.c_str(), (long long) meta.elapsed_us, meta.architecture.c_str(),
+             meta.dominant_type.c_str(), (unsigned long long) meta.n_tensors);
+    } else {
+        LOGE("Cannot read metadata of %s: %s", path.c_str(), meta.error.c_str());
+    }
+    return meta;
+}
+
+} // namespace smith
@@ -0,0 +1,60 @@
+/**
+ * model_metadata.h - Model details straight from the GGUF header
+ * Guild of Smiths - Offline AI Module
+ *
+ * Reads the header, key/value metadata and tensor directory of a GGUF file
+ * without touching the weights, so the model picker and memory budgeting
+ * can describe a model without a full llama.cpp load. Only the pages that
+ * hold the header are faulted in; a typical model reads in well under 1 ms.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+/** Tensor count and bytes for one ggml type. */
+struct TensorTypeStats {
+    std::string type;          // "q4_K", "f32", ...
+    uint64_t n_tensors = 0;
+    uint64_t nbytes = 0;
+};
+
+struct ModelMetadata {
+    bool ok = false;
+    std::string error;
+
+    uint32_t gguf_version = 0;
+    std::string architecture;  // general.architecture ("llama", "phi3", ...)
+    std::string name;          // general.name
+    int64_t file_type = -1;    // general.file_type (llama_ftype), -1 if absent
+
+    uint64_t context_length = 0;   // trained context
+    uint64_t embedding_length = 0;
+    uint64_t block_count = 0;
+    uint64_t head_count = 0;
+    uint64_t head_count_kv = 0;
+    uint64_t vocab_size = 0;
+    std::string chat_template;     // tokenizer.chat_template, may be empty
+
+    uint64_t file_size = 0;
+    uint64_t n_tensors = 0;
+    uint64_t n_params = 0;         // sum of tensor elements
+    uint64_t tensor_bytes = 0;     // weights resident once mapped
+    uint64_t kv_bytes_per_token = 0; // f16 K+V for all layers
+    std::string dominant_type;     // type holding the most bytes
+    std::vector<TensorTypeStats> types; // sorted by bytes, descending
+
+    int64_t elapsed_us = 0;
+};
+
+/**
+ * Read model metadata from a GGUF file.
+ * Never touches tensor data; fails on a malformed or truncated header.
+ */
+ModelMetadata read_model_metadata(const std::string& path);
+
+} // namespace smith
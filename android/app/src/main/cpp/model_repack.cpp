@@ -0,0 +1,236 @@
+/**
+ * model_repack.cpp - One-time conversion of downloaded GGUFs to a device-optimal layout
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "ModelRepack"
+
+#include "model_repack.h"
+#include "inference_core.h"
+#include "native_log.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <sys/prctl.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "llama.h"
+#include "common.h"
+
+namespace smith {
+
+// Minimum greedy agreement with the original model for the converted file to be kept
+static const float MIN_TOP1_AGREEMENT = 0.6f;
+
+static const char* const PROBE_PROMPT =
+    "<|im_start|>system\nYou are Smith, a helpful AI assistant for construction and "
+    "trade workers.<|im_end|>\n<|im_start|>user\nWhat do I need to check before the "
+    "electrical rough-in inspection on this job?<|im_end|>\n<|im_start|>assistant\n";
+
+RepackLayout detect_optimal_layout() {
+    // ggml picks its aarch64 gemv/gemm kernels at compile time: a layout whose
+    // kernel was not built in asserts or falls back to the slow path. Only
+    // libllama_jni_dotprod.so is compiled with dotprod (LLAMA_JNI_ARM_DOTPROD);
+    // the i8mm and SVE layouts would need further per-feature builds.
+#if defined(SMITH_GGML_AARCH64) && defined(__aarch64__) && defined(__linux__) && defined(__ARM_FEATURE_DOTPROD)
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) {
+        return RepackLayout::Q4_0_4_4;
+    }
+#endif
+    return RepackLayout::NONE;
+}
+
+const char* layout_name(RepackLayout layout) {
+    switch (layout) {
+        case RepackLayout::Q4_0_4_4: return "q4_0_4_4";
+        case RepackLayout::Q4_0_4_8: return "q4_0_4_8";
+        case RepackLayout::Q4_0_8_8: return "q4_0_8_8";
+        case RepackLayout::NONE:     break;
+    }
+    return "";
+}
+
+// The Q4_0_4_x ftypes exist only in llama.cpp trees that ship ggml-aarch64.c
+static bool layout_ftype(RepackLayout layout, llama_ftype& ftype) {
+    switch (layout) {
+#if defined(SMITH_GGML_AARCH64)
+        case RepackLayout::Q4_0_4_4: ftype = LLAMA_FTYPE_MOSTLY_Q4_0_4_4; return true;
+        case RepackLayout::Q4_0_4_8: ftype = LLAMA_FTYPE_MOSTLY_Q4_0_4_8; return true;
+        case RepackLayout::Q4_0_8_8: ftype = LLAMA_FTYPE_MOSTLY_Q4_0_8_8; return true;
+#endif
+        default: break;
+    }
+    return false;
+}
+
+// general.file_type values (llama_ftype) that hold the weights at Q4_0 or
+// better, so the interleaved Q4_0 copy loses nothing a fresh quantization
+// would not. K-quants are refused: requantizing them compounds the error.
+static bool is_repackable_ftype(long ftype) {
+    switch (ftype) {
+        case LLAMA_FTYPE_ALL_F32:
+        case LLAMA_FTYPE_MOSTLY_F16:
+        case LLAMA_FTYPE_MOSTLY_BF16:
+        case LLAMA_FTYPE_MOSTLY_Q8_0:
+        case LLAMA_FTYPE_MOSTLY_Q4_0:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/** general.file_type of a GGUF, read with a vocabulary-only load; -1 if unknown. */
+static long source_ftype(const std::string& path) {
+    llama_model_params mparams = llama_model_default_params();
+    mparams.vocab_only = true;
+    llama_model* model = llama_load_model_from_file(path.c_str(), mparams);
+    if (model == nullptr) {
+        return -1;
+    }
+    char value[32];
+    long ftype = -1;
+    if (llama_model_meta_val_str(model, "general.file_type", value, sizeof(value)) > 0) {
+        char* end = nullptr;
+        ftype = std::strtol(value, &end, 10);
+        if (end == value) ftype = -1;
+    }
+    llama_free_model(model);
+    return ftype;
+}
+
+/**
+ * Teacher-force the probe prompt and record the argmax at every position.
+ * Returns false if the model fails to load/decode or produces non-finite logits.
+ */
+static bool probe_predictions(const std::string& path, int n_threads,
+                              std::vector<llama_token>& argmax, int& n_vocab) {
+    llama_model_params mparams = llama_model_default_params();
+    mparams.n_gpu_layers = 0;
+    llama_model* model = llama_load_model_from_file(path.c_str(), mparams);
+    if (model == nullptr) {
+        return false;
+    }
+
+    std::vector<llama_token> tokens;
+    if (!tokenize(model, PROBE_PROMPT, true, tokens) || tokens.empty()) {
+        llama_free_model(model);
+        return false;
+    }
+
+    llama_context_params cparams = llama_context_default_params();
+    cparams.n_ctx = (uint32_t) tokens.size() + 8;
+    cparams.n_batch = (uint32_t) tokens.size();
+    cparams.n_threads = n_threads;
+    cparams.n_threads_batch = n_threads;
+    llama_context* ctx = llama_new_context_with_model(model, cparams);
+    if (ctx == nullptr) {
+        llama_free_model(model);
+        return false;
+    }
+
+    llama_batch batch = llama_batch_init((int32_t) tokens.size(), 0, 1);
+    for (size_t i = 0; i < tokens.size(); i++) {
+        llama_batch_add(batch, tokens[i], (llama_pos) i, { 0 }, true);
+    }
+
+    bool ok = llama_decode(ctx, batch) == 0;
+    n_vocab = llama_n_vocab(model);
+    argmax.clear();
+    for (int i = 0; ok && i < batch.n_tokens; i++) {
+        const float* logits = llama_get_logits_ith(ctx, i);
+        llama_token best = 0;
+        for (llama_token t = 0; t < n_vocab; t++) {
+            if (!std::isfinite(logits[t])) {
+                ok = false;
+                break;
+            }
+            if (logits[t] > logits[best]) best = t;
+        }
+        argmax.push_back(best);
+    }
+
+    llama_batch_free(batch);
+    llama_free(ctx);
+    llama_free_model(model);
+    return ok;
+}
+
+RepackResult repack_model(const std::string& src, const std::string& dst,
+                          RepackLayout layout, int n_threads) {
+    RepackResult result;
+    llama_ftype target = LLAMA_FTYPE_MOSTLY_Q4_0;
+    if (!layout_ftype(layout, target)) {
+        result.error = layout == RepackLayout::NONE
+            ? "no faster layout for this CPU"
+            : "this build has no kernels for that layout";
+        return result;
+    }
+
+    const long ftype = source_ftype(src);
+    if (!is_repackable_ftype(ftype)) {
+        LOGW("Not repacking %s: file type %ld would be requantized", src.c_str(), ftype);
+        result.error = "source is k-quantized or unknown; repacking would requantize it";
+        return result;
+    }
+
+    const std::string tmp = dst + ".tmp";
+    std::remove(tmp.c_str());
+
+    llama_model_quantize_params qparams = llama_model_quantize_default_params();
+    qparams.nthread = n_threads;
+    qparams.ftype = target;
+    qparams.allow_requantize = true;
+
+    const int64_t t0 = now_us();
+    LOGI("Repacking %s -> %s (%s)", src.c_str(), dst.c_str(), layout_name(layout));
+    if (llama_model_quantize(src.c_str(), tmp.c_str(), &qparams) != 0) {
+        std::remove(tmp.c_str());
+        result.error = "quantize failed";
+        return result;
+    }
+    LOGI("Repack took %lld ms", (long long) (now_us() - t0) / 1000);
+
+    std::vector<llama_token> ref, got;
+    int ref_vocab = 0, got_vocab = 0;
+    if (!probe_predictions(src, n_threads, ref, ref_vocab)) {
+        std::remove(tmp.c_str());
+        result.error = "original model failed probe";
+        return result;
+    }
+    if (!probe_predictions(tmp, n_threads, got, got_vocab)
+            || got_vocab != ref_vocab || got.size() != ref.size()) {
+        std::remove(tmp.c_str());
+        result.error = "converted model failed probe";
+        return result;
+    }
+
+    size_t agree = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        if (ref[i] == got[i]) agree++;
+    }
+    result.top1_agreement = ref.empty() ? 0.0f : (float) agree / (float) ref.size();
+    LOGI("Probe agreement %.2f over %zu positions", result.top1_agreement, ref.size());
+
+    if (result.top1_agreement < MIN_TOP1_AGREEMENT) {
+        std::remove(tmp.c_str());
+        result.error = "converted model diverges from original";
+        return result;
+    }
+
+    if (std::rename(tmp.c_str(), dst.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        result.error = "rename failed";
+        return result;
+    }
+
+    result.ok = true;
+    return result;
+}
+
+} // namespace smith
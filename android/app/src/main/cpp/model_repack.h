@@ -0,0 +1,48 @@
+/**
+ * model_repack.h - One-time conversion of downloaded GGUFs to a device-optimal layout
+ * Guild of Smiths - Offline AI Module
+ *
+ * On ARM cores with dotprod the interleaved Q4_0_4_4 layout runs the
+ * matmul kernels considerably faster, so after download (and while
+ * charging) a Q4_0, Q8_0 or float model is converted once, verified
+ * against the original, and cached next to it. The catalog downloads are
+ * Q4_0 for this reason; K-quantized files are left alone, since
+ * requantizing them loses quality. Layouts are offered only when ggml was
+ * built with their kernels (SMITH_GGML_AARCH64, plus dotprod for Q4_0_4_4).
+ */
+
+#pragma once
+
+#include <string>
+
+namespace smith {
+
+enum class RepackLayout {
+    NONE,       // keep the downloaded file
+    Q4_0_4_4,   // NEON + dotprod
+    Q4_0_4_8,   // NEON + i8mm (needs a ggml build with i8mm kernels; not offered)
+    Q4_0_8_8,   // SVE with 256-bit vectors (likewise)
+};
+
+/** Best layout for this CPU among those whose kernels this build contains. */
+RepackLayout detect_optimal_layout();
+
+/** Lowercase layout name used in cached file names ("q4_0_4_8"), "" for NONE. */
+const char* layout_name(RepackLayout layout);
+
+struct RepackResult {
+    bool ok = false;
+    float top1_agreement = 0.0f;   // greedy agreement with the original on the probe prompt
+    std::string error;
+};
+
+/**
+ * Requantize src into dst using layout. Refuses k-quantized sources and
+ * layouts this build has no kernels for.
+ * Writes dst.tmp, verifies it loads and tracks the original's
+ * predictions, then renames into place.
+ */
+RepackResult repack_model(const std::string& src, const std::string& dst,
+                          RepackLayout layout, int n_threads);
+
+} // namespace smith
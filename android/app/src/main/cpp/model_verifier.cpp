@@ -0,0 +1,178 @@
+/**
+ * model_verifier.cpp - Parallel integrity check for downloaded GGUF files
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "ModelVerifier"
+
+#include "model_verifier.h"
+#include "gguf_reader.h"
+#include "native_log.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smith {
+
+static const uint64_t CHUNK_SIZE = 16ull << 20;
+static const uint64_t READAHEAD_CHUNKS = 4;
+// v1 sidecars hold tree hashes, which no longer compare equal
+static const char* const CACHE_MAGIC = "smith-verify-v2";
+
+static int64_t elapsed_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+static int64_t mtime_ns(const struct stat& st) {
+#if defined(__APPLE__)
+    return (int64_t) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+// Sidecar format (one line): magic size mtime_ns ok n_tensors digest error...
+static bool read_cache(const std::string& cache_path, uint64_t size, int64_t mtime,
+                       VerifyResult& out) {
+    FILE* f = fopen(cache_path.c_str(), "r");
+    if (f == nullptr) return false;
+
+    char magic[32] = {0}, digest[80] = {0}, error[256] = {0};
+    uint64_t c_size = 0, c_tensors = 0;
+    int64_t c_mtime = 0;
+    int c_ok = 0;
+    int n = fscanf(f, "%31s %" SCNu64 " %" SCNd64 " %d %" SCNu64 " %79s %255[^\n]",
+                   magic, &c_size, &c_mtime, &c_ok, &c_tensors, digest, error);
+    fclose(f);
+
+    if (n < 6 || strcmp(magic, CACHE_MAGIC) != 0 || c_size != size || c_mtime != mtime) {
+        return false;
+    }
+    out.ok = c_ok != 0;
+    out.cached = true;
+    out.file_size = c_size;
+    out.n_tensors = c_tensors;
+    out.digest = strcmp(digest, "-") == 0 ? "" : digest;
+    out.error = n == 7 ? error : "";
+    return true;
+}
+
+static void write_cache(const std::string& cache_path, int64_t mtime, const VerifyResult& r) {
+    const std::string tmp = cache_path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (f == nullptr) return;
+    fprintf(f, "%s %" PRIu64 " %" PRId64 " %d %" PRIu64 " %s %s\n",
+            CACHE_MAGIC, r.file_size, mtime, r.ok ? 1 : 0, r.n_tensors,
+            r.digest.empty() ? "-" : r.digest.c_str(), r.error.c_str());
+    // Durable before it is visible: a crash leaves the old sidecar or the new one
+    bool written = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    written = fclose(f) == 0 && written;
+    if (!written || rename(tmp.c_str(), cache_path.c_str()) != 0) {
+        unlink(tmp.c_str());
+    }
+}
+
+static bool same_digest(const std::string& a, const std::string& b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(),
+                      [](char x, char y) { return tolower((unsigned char) x) == tolower((unsigned char) y); });
+}
+
+static std::string file_hash(const uint8_t* base, uint64_t size) {
+    Sha256 sha;
+    for (uint64_t off = 0; off < size; off += CHUNK_SIZE) {
+        // Keep storage busy a few chunks ahead while this one is hashed
+        const uint64_t ahead = off + CHUNK_SIZE * READAHEAD_CHUNKS;
+        if (ahead < size) {
+            madvise((void*) (base + ahead), (size_t) std::min(CHUNK_SIZE, size - ahead), MADV_WILLNEED);
+        }
+        sha.update(base + off, (size_t) std::min(CHUNK_SIZE, size - off));
+    }
+    uint8_t digest[32];
+    sha.finish(digest);
+    return digest_hex(digest);
+}
+
+VerifyResult verify_model(const std::string& path,
+                          const std::string& expected_digest,
+                          bool use_cache) {
+    const auto t0 = std::chrono::steady_clock::now();
+    VerifyResult result;
+    const std::string cache_path = path + ".verify";
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        result.error = "file not found";
+        return result;
+    }
+    result.file_size = (uint64_t) st.st_size;
+    const int64_t mtime = mtime_ns(st);
+
+    if (use_cache && read_cache(cache_path, result.file_size, mtime, result)) {
+        if (result.ok && !expected_digest.empty() && !same_digest(result.digest, expected_digest)) {
+            result.ok = false;
+            result.error = "digest mismatch";
+        }
+        result.elapsed_us = elapsed_since(t0);
+        return result;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        result.error = "cannot open file";
+        return result;
+    }
+    void* map = result.file_size > 0
+        ? mmap(nullptr, (size_t) result.file_size, PROT_READ, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        result.error = "cannot map file";
+        return result;
+    }
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    madvise(map, (size_t) result.file_size, MADV_SEQUENTIAL);
+
+    // Structure first: a truncated file fails here without hashing a GB
+    GgufFile gguf;
+    std::string error;
+    if (!parse_gguf(base, (size_t) result.file_size, gguf, error) ||
+        !validate_tensor_bounds(gguf, result.file_size, error)) {
+        result.error = error;
+    } else {
+        result.n_tensors = gguf.tensors.size();
+        result.digest = file_hash(base, result.file_size);
+        if (!expected_digest.empty() && !same_digest(result.digest, expected_digest)) {
+            result.error = "digest mismatch";
+        } else {
+            result.ok = true;
+        }
+    }
+
+    munmap(map, (size_t) result.file_size);
+    result.elapsed_us = elapsed_since(t0);
+
+    LOGI("Verified %s: %s in %lld ms (%s, %" PRIu64 " tensors, sha2 %s)",
+         path.c_str(), result.ok ? "OK" : result.error.c_str(),
+         (long long) result.elapsed_us / 1000, result.digest.c_str(), result.n_tensors,
+         Sha256::hardware_accelerated() ? "hw" : "sw");
+
+    // A digest mismatch against a caller's expectation is not a property of the file
+    if (use_cache && result.error != "digest mismatch") {
+        write_cache(cache_path, mtime, result);
+    }
+    return result;
+}
+
+} // namespace smith
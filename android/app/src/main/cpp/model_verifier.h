@@ -0,0 +1,44 @@
+/**
+ * model_verifier.h - Parallel integrity check for downloaded GGUF files
+ * Guild of Smiths - Offline AI Module
+ *
+ * mmaps the model, validates the GGUF header and that every tensor lies
+ * inside the file, then hashes it. The digest is the plain SHA-256 of the
+ * file, the same value Hugging Face publishes as the LFS object id, so a
+ * download can be checked against its catalog entry. Hashing streams the
+ * mapping with kernel readahead a window ahead of the SHA2 instructions.
+ *
+ * Results are cached in "<path>.verify" keyed by size and mtime, so a
+ * repeat check of an unchanged file costs one stat(). The sidecar is
+ * replaced atomically (temp file, fsync, rename).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace smith {
+
+struct VerifyResult {
+    bool ok = false;
+    bool cached = false;       // served from the .verify sidecar
+    std::string digest;        // SHA-256 hex, empty if hashing did not run
+    std::string error;
+    uint64_t file_size = 0;
+    uint64_t n_tensors = 0;
+    int64_t elapsed_us = 0;
+};
+
+/**
+ * Verify a GGUF file.
+ *
+ * @param path            Model file
+ * @param expected_digest SHA-256 hex to compare against (case ignored), or "" to accept any
+ * @param use_cache       Read/write the .verify sidecar
+ */
+VerifyResult verify_model(const std::string& path,
+                          const std::string& expected_digest,
+                          bool use_cache);
+
+} // namespace smith
@@ -0,0 +1,25 @@
+/**
+ * native_log.h - Logging macros shared by the native sources
+ * Guild of Smiths - Offline AI Module
+ *
+ * Routes to logcat on Android and to stderr on host builds (bench, tests).
+ * Each translation unit defines LOG_TAG before including this header.
+ */
+
+#pragma once
+
+#ifndef LOG_TAG
+#define LOG_TAG "LlamaJNI"
+#endif
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+#define LOGI(...) do { fprintf(stderr, "I/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGE(...) do { fprintf(stderr, "E/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGW(...) do { fprintf(stderr, "W/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#endif
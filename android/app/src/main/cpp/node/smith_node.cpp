@@ -0,0 +1,618 @@
+/**
+ * smith_node.cpp - Node-API addon over the inference engine
+ * Guild of Smiths - Offline AI Module
+ *
+ * Lets the backend on a gateway host run the same Engine (scheduler,
+ * prefix cache, batching, checkpoints) that libllama_jni.so runs on the
+ * phone, in-process and without a network hop. backend/src/nativeInference.ts
+ * wraps it in promises; this file only moves data across the boundary:
+ *
+ *   - Model load and unload run as async work on the libuv pool, since
+ *     they wait for the engine and read gigabytes from disk.
+ *   - Requests are submitted with caller-chosen ids and return at once.
+ *   - Engine events (streamed text, completions, errors, batch results,
+ *     embeddings) cross from the engine thread to the JS thread through
+ *     one thread-safe function and reach the handler given to open().
+ *     It holds the event loop open only while requests are outstanding.
+ *
+ * Exports:
+ *   open(onEvent)                         start the engine
+ *   close()                               cancel everything, stop the engine
+ *   loadModel(path, nCtx, nThreads)       Promise<boolean>
+ *   unloadModel()                         Promise<void>
+ *   isLoaded(), modelInfo()
+ *   setCheckpointDir(dir)
+ *   generate(id, prompt, maxTokens, temperature, stream, priority, checkpointKey)
+ *   generateBatch(id, prompts, maxTokens, temperature, priority)
+ *   warm(id, prompt, priority), embed(id, texts, priority)
+ *   cancel(id), cancelAll()
+ * Submissions return false if the engine is not open or is stopping.
+ */
+
+#define NAPI_VERSION 6
+#define LOG_TAG "SmithNode"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <node_api.h>
+
+#include "../engine.h"
+#include "../native_log.h"
+
+namespace {
+
+// ════════════════════════════════════════════════════════════════════
+// ENGINE EVENTS
+// ════════════════════════════════════════════════════════════════════
+
+struct NodeEvent {
+    enum Kind { TEXT, COMPLETE, ERROR, BATCH, EMBEDDINGS } kind = TEXT;
+    uint64_t id = 0;
+    std::string text;
+    smith::GenerationStats stats;
+    std::vector<smith::BatchItemResult> results;
+    smith::BatchStats batch_stats;
+    int n_embd = 0;
+    std::vector<float> vectors;
+};
+
+
+/**
+ * Forwards engine events to the JS thread; runs on the engine's worker.
+ * Can outlive close() while load/unload work holds the engine, so it
+ * drops events once detached from the released function.
+ */
+class NodeListener : public smith::EngineListener {
+public:
+    explicit NodeListener(napi_threadsafe_function tsfn) : tsfn_(tsfn) {}
+
+    /** Drop all further events; call before the function is released. */
+    void detach() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tsfn_ = nullptr;
+    }
+
+    void on_text(uint64_t id, const std::string& text) override {
+        NodeEvent* event = new NodeEvent();
+        event->kind = NodeEvent::TEXT;
+        event->id = id;
+        event->text = text;
+        post(event);
+    }
+
+    void on_complete(uint64_t id, const std::string& text, const smith::GenerationStats& stats) override {
+        NodeEvent* event = new NodeEvent();
+        event->kind = NodeEvent::COMPLETE;
+        event->id = id;
+        event->text = text;
+        event->stats = stats;
+        post(event);
+    }
+
+    void on_error(uint64_t id, const std::string& error) override {
+        NodeEvent* event = new NodeEvent();
+        event->kind = NodeEvent::ERROR;
+        event->id = id;
+        event->text = error;
+        post(event);
+    }
+
+    void on_batch_complete(uint64_t id, const std::vector<smith::BatchItemResult>& results,
+                           const smith::BatchStats& stats) override {
+        NodeEvent* event = new NodeEvent();
+        event->kind = NodeEvent::BATCH;
+        event->id = id;
+        event->results = results;
+        event->batch_stats = stats;
+        post(event);
+    }
+
+    void on_embeddings(uint64_t id, int n_embd, const std::vector<float>& vectors) override {
+        NodeEvent* event = new NodeEvent();
+        event->kind = NodeEvent::EMBEDDINGS;
+        event->id = id;
+        event->n_embd = n_embd;
+        event->vectors = vectors;
+        post(event);
+    }
+
+private:
+    void post(NodeEvent* event) {
+        // Unbounded queue: blocking mode never waits, it only fails once closing
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tsfn_ == nullptr || napi_call_threadsafe_function(tsfn_, event, napi_tsfn_blocking) != napi_ok) {
+            delete event;
+        }
+    }
+
+    std::mutex mutex_;
+    napi_threadsafe_function tsfn_;
+};
+
+struct AddonState {
+    napi_threadsafe_function tsfn = nullptr;
+    std::shared_ptr<NodeListener> listener;
+    std::shared_ptr<smith::Engine> engine;   // also held by pending load/unload work
+    int outstanding = 0;   // JS thread only; the event loop is held while > 0
+};
+
+static AddonState* state_of(napi_env env) {
+    void* data = nullptr;
+    napi_get_instance_data(env, &data);
+    return static_cast<AddonState*>(data);
+}
+
+/**
+ * Stop the engine and detach its listener so nothing posts to the
+ * thread-safe function once it is gone. A load or unload still running
+ * on the libuv pool keeps the engine alive until it completes.
+ */
+static void shut_down(AddonState* state, bool release) {
+    if (state->engine) {
+        state->engine->cancel_all();
+        state->engine.reset();
+    }
+    if (state->listener) {
+        state->listener->detach();
+        state->listener.reset();
+    }
+    if (state->tsfn != nullptr && release) {
+        napi_release_threadsafe_function(state->tsfn, napi_tsfn_abort);
+    }
+    state->tsfn = nullptr;
+    state->outstanding = 0;
+}
+
+static void finalize_state(napi_env env, void* data, void* hint) {
+    AddonState* state = static_cast<AddonState*>(data);
+    // The environment is going away and finalizes the function itself
+    shut_down(state, false);
+    delete state;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// VALUE HELPERS
+// ════════════════════════════════════════════════════════════════════
+
+static napi_value make_int(napi_env env, int64_t v) {
+    napi_value out;
+    napi_create_int64(env, v, &out);
+    return out;
+}
+
+static napi_value make_bool(napi_env env, bool v) {
+    napi_value out;
+    napi_get_boolean(env, v, &out);
+    return out;
+}
+
+static napi_value make_string(napi_env env, const std::string& s) {
+    napi_value out;
+    napi_create_string_utf8(env, s.data(), s.size(), &out);
+    return out;
+}
+
+static napi_value undefined(napi_env env) {
+    napi_value out;
+    napi_get_undefined(env, &out);
+    return out;
+}
+
+static void set(napi_env env, napi_value object, const char* key, napi_value value) {
+    napi_set_named_property(env, object, key, value);
+}
+
+static std::string get_string(napi_env env, napi_value value) {
+    size_t size = 0;
+    if (napi_get_value_string_utf8(env, value, nullptr, 0, &size) != napi_ok) {
+        return std::string();
+    }
+    std::string out(size, '\0');
+    napi_get_value_string_utf8(env, value, &out[0], size + 1, &size);
+    return out;
+}
+
+static int64_t get_int(napi_env env, napi_value value, int64_t fallback) {
+    int64_t out = fallback;
+    return napi_get_value_int64(env, value, &out) == napi_ok ? out : fallback;
+}
+
+static double get_double(napi_env env, napi_value value, double fallback) {
+    double out = fallback;
+    return napi_get_value_double(env, value, &out) == napi_ok ? out : fallback;
+}
+
+static bool get_bool(napi_env env, napi_value value) {
+    bool out = false;
+    napi_get_value_bool(env, value, &out);
+    return out;
+}
+
+static std::vector<std::string> get_strings(napi_env env, napi_value array) {
+    std::vector<std::string> out;
+    uint32_t length = 0;
+    if (napi_get_array_length(env, array, &length) != napi_ok) {
+        return out;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        napi_value item;
+        napi_get_element(env, array, i, &item);
+        out.push_back(get_string(env, item));
+    }
+    return out;
+}
+
+static smith::Priority to_priority(int64_t value) {
+    if (value < 0) value = 0;
+    if (value >= smith::PRIORITY_COUNT) value = smith::PRIORITY_COUNT - 1;
+    return static_cast<smith::Priority>(value);
+}
+
+static void throw_error(napi_env env, const char* message) {
+    napi_throw_error(env, nullptr, message);
+}
+
+/** Fetch up to max arguments; missing ones are undefined. */
+static size_t get_args(napi_env env, napi_callback_info info, napi_value* args, size_t max) {
+    size_t argc = max;
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    for (size_t i = argc; i < max; i++) {
+        args[i] = undefined(env);
+    }
+    return argc;
+}
+
+static napi_value stats_object(napi_env env, const smith::GenerationStats& stats) {
+    napi_value out;
+    napi_create_object(env, &out);
+    set(env, out, "promptTokens", make_int(env, stats.n_prompt_tokens));
+    set(env, out, "prefixReused", make_int(env, stats.n_prefix_reused));
+    set(env, out, "restored", make_int(env, stats.n_restored));
+    set(env, out, "generated", make_int(env, stats.n_generated));
+    set(env, out, "tokenizeUs", make_int(env, stats.t_tokenize_us));
+    set(env, out, "prefillUs", make_int(env, stats.t_prefill_us));
+    set(env, out, "decodeUs", make_int(env, stats.t_decode_us));
+    return out;
+}
+
+static napi_value batch_items(napi_env env, const std::vector<smith::BatchItemResult>& results) {
+    napi_value items;
+    napi_create_array_with_length(env, results.size(), &items);
+    for (size_t i = 0; i < results.size(); i++) {
+        const smith::BatchItemResult& r = results[i];
+        const bool ok = r.finished && r.status == smith::GenerationStatus::OK;
+        napi_value item;
+        napi_create_object(env, &item);
+        set(env, item, "ok", make_bool(env, ok));
+        set(env, item, "text", make_string(env, r.text));
+        set(env, item, "error", make_string(env, ok ? "" : !r.finished ? "Cancelled" :
+                                            r.status == smith::GenerationStatus::TOKENIZE_FAILED
+                                                ? "Tokenization failed" : "Decoding failed"));
+        set(env, item, "promptTokens", make_int(env, r.n_prompt_tokens));
+        set(env, item, "prefixTokens", make_int(env, r.n_prefix_shared));
+        set(env, item, "generatedTokens", make_int(env, r.n_generated));
+        set(env, item, "firstTokenUs", make_int(env, r.t_first_token_us));
+        set(env, item, "latencyUs", make_int(env, r.t_latency_us));
+        napi_set_element(env, items, (uint32_t) i, item);
+    }
+    return items;
+}
+
+// Runs on the JS thread for every posted event
+static void call_js(napi_env env, napi_value js_callback, void* context, void* data) {
+    std::unique_ptr<NodeEvent> event(static_cast<NodeEvent*>(data));
+    if (env == nullptr) {
+        return;  // closing; the event is dropped
+    }
+    AddonState* state = static_cast<AddonState*>(context);
+
+    napi_value object;
+    napi_create_object(env, &object);
+    set(env, object, "id", make_int(env, (int64_t) event->id));
+    const char* type = "text";
+    switch (event->kind) {
+    case NodeEvent::TEXT:
+        set(env, object, "text", make_string(env, event->text));
+        break;
+    case NodeEvent::COMPLETE:
+        type = "complete";
+        set(env, object, "text", make_string(env, event->text));
+        set(env, object, "stats", stats_object(env, event->stats));
+        break;
+    case NodeEvent::ERROR:
+        type = "error";
+        set(env, object, "error", make_string(env, event->text));
+        break;
+    case NodeEvent::BATCH:
+        type = "batch";
+        set(env, object, "items", batch_items(env, event->results));
+        set(env, object, "waves", make_int(env, event->batch_stats.n_waves));
+        set(env, object, "prefillSaved", make_int(env, event->batch_stats.n_prefill_tokens_saved));
+        set(env, object, "totalUs", make_int(env, event->batch_stats.t_total_us));
+        break;
+    case NodeEvent::EMBEDDINGS: {
+        type = "embeddings";
+        napi_value buffer;
+        void* bytes = nullptr;
+        const size_t size = event->vectors.size() * sizeof(float);
+        napi_create_arraybuffer(env, size, &bytes, &buffer);
+        if (size > 0) {
+            memcpy(bytes, event->vectors.data(), size);
+        }
+        napi_value vectors;
+        napi_create_typedarray(env, napi_float32_array, event->vectors.size(), buffer, 0, &vectors);
+        set(env, object, "dim", make_int(env, event->n_embd));
+        set(env, object, "vectors", vectors);
+        break;
+    }
+    }
+    set(env, object, "type", make_string(env, type));
+
+    if (event->kind != NodeEvent::TEXT && state->tsfn != nullptr && --state->outstanding == 0) {
+        napi_unref_threadsafe_function(env, state->tsfn);
+    }
+
+    napi_value global;
+    napi_get_global(env, &global);
+    napi_call_function(env, global, js_callback, 1, &object, nullptr);
+}
+
+/** Count a submitted request; undoes the count if the engine refused it. */
+static bool track(napi_env env, AddonState* state, bool submitted) {
+    if (submitted && state->outstanding++ == 0) {
+        napi_ref_threadsafe_function(env, state->tsfn);
+    }
+    return submitted;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// EXPORTS
+// ════════════════════════════════════════════════════════════════════
+
+static napi_value js_open(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    get_args(env, info, args, 1);
+    AddonState* state = state_of(env);
+    if (state->engine) {
+        throw_error(env, "Engine already open");
+        return nullptr;
+    }
+    napi_valuetype type;
+    napi_typeof(env, args[0], &type);
+    if (type != napi_function) {
+        throw_error(env, "open() takes an event handler");
+        return nullptr;
+    }
+
+    napi_value name = make_string(env, "smith_engine_events");
+    if (napi_create_threadsafe_function(env, args[0], nullptr, name, 0, 1, nullptr, nullptr,
+                                        state, call_js, &state->tsfn) != napi_ok) {
+        throw_error(env, "Cannot create the event channel");
+        return nullptr;
+    }
+    napi_unref_threadsafe_function(env, state->tsfn);  // idle engine does not keep Node alive
+
+    // The engine keeps its listener alive for as long as it may report
+    std::shared_ptr<NodeListener> listener = std::make_shared<NodeListener>(state->tsfn);
+    state->listener = listener;
+    state->engine = std::shared_ptr<smith::Engine>(new smith::Engine(*listener),
+                                                   [listener](smith::Engine* engine) { delete engine; });
+    return undefined(env);
+}
+
+static napi_value js_close(napi_env env, napi_callback_info info) {
+    shut_down(state_of(env), true);
+    return undefined(env);
+}
+
+// Load and unload block on the engine, so they run on the libuv pool
+struct ModelWork {
+    napi_async_work work = nullptr;
+    napi_deferred deferred = nullptr;
+    std::shared_ptr<smith::Engine> engine;   // survives close() until the work completes
+    bool load = true;
+    std::string path;
+    int n_ctx = 0;
+    int n_threads = 0;
+    bool ok = false;
+};
+
+static void execute_model_work(napi_env env, void* data) {
+    ModelWork* work = static_cast<ModelWork*>(data);
+    if (work->load) {
+        work->ok = work->engine->load_model(work->path, work->n_ctx, work->n_threads);
+    } else {
+        work->engine->unload_model();
+        work->ok = true;
+    }
+}
+
+static void complete_model_work(napi_env env, napi_status status, void* data) {
+    std::unique_ptr<ModelWork> work(static_cast<ModelWork*>(data));
+    if (status != napi_ok) {
+        napi_reject_deferred(env, work->deferred, make_string(env, "Model work cancelled"));
+    } else {
+        napi_resolve_deferred(env, work->deferred, work->load ? make_bool(env, work->ok) : undefined(env));
+    }
+    napi_delete_async_work(env, work->work);
+}
+
+static napi_value queue_model_work(napi_env env, ModelWork* work) {
+    AddonState* state = state_of(env);
+    napi_value promise;
+    napi_create_promise(env, &work->deferred, &promise);
+    if (!state->engine) {
+        napi_reject_deferred(env, work->deferred, make_string(env, "Engine not open"));
+        delete work;
+        return promise;
+    }
+    work->engine = state->engine;
+    napi_value name = make_string(env, work->load ? "smith_load_model" : "smith_unload_model");
+    napi_create_async_work(env, nullptr, name, execute_model_work, complete_model_work, work, &work->work);
+    napi_queue_async_work(env, work->work);
+    return promise;
+}
+
+static napi_value js_load_model(napi_env env, napi_callback_info info) {
+    napi_value args[3];
+    get_args(env, info, args, 3);
+    ModelWork* work = new ModelWork();
+    work->path = get_string(env, args[0]);
+    work->n_ctx = (int) get_int(env, args[1], 2048);
+    work->n_threads = (int) get_int(env, args[2], 4);
+    return queue_model_work(env, work);
+}
+
+static napi_value js_unload_model(napi_env env, napi_callback_info info) {
+    ModelWork* work = new ModelWork();
+    work->load = false;
+    return queue_model_work(env, work);
+}
+
+static napi_value js_is_loaded(napi_env env, napi_callback_info info) {
+    AddonState* state = state_of(env);
+    return make_bool(env, state->engine && state->engine->is_loaded());
+}
+
+static napi_value js_model_info(napi_env env, napi_callback_info info) {
+    AddonState* state = state_of(env);
+    int n_vocab = 0, n_ctx = 0, n_embd = 0;
+    if (!state->engine || !state->engine->model_info(n_vocab, n_ctx, n_embd)) {
+        napi_value null_value;
+        napi_get_null(env, &null_value);
+        return null_value;
+    }
+    napi_value out;
+    napi_create_object(env, &out);
+    set(env, out, "vocab", make_int(env, n_vocab));
+    set(env, out, "ctx", make_int(env, n_ctx));
+    set(env, out, "embd", make_int(env, n_embd));
+    return out;
+}
+
+static napi_value js_set_checkpoint_dir(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    get_args(env, info, args, 1);
+    AddonState* state = state_of(env);
+    if (state->engine) {
+        state->engine->set_checkpoint_dir(get_string(env, args[0]));
+    }
+    return undefined(env);
+}
+
+static napi_value js_generate(napi_env env, napi_callback_info info) {
+    napi_value args[7];
+    get_args(env, info, args, 7);
+    AddonState* state = state_of(env);
+    if (!state->engine) {
+        return make_bool(env, false);
+    }
+    smith::GenerationParams params;
+    params.max_tokens = (int) get_int(env, args[2], params.max_tokens);
+    params.temperature = (float) get_double(env, args[3], params.temperature);
+    napi_valuetype key_type;
+    napi_typeof(env, args[6], &key_type);
+    const std::string checkpoint_key = key_type == napi_string ? get_string(env, args[6]) : std::string();
+    const bool ok = state->engine->submit((uint64_t) get_int(env, args[0], 0), get_string(env, args[1]),
+                                          params, get_bool(env, args[4]),
+                                          to_priority(get_int(env, args[5], (int) smith::Priority::NORMAL)),
+                                          checkpoint_key);
+    return make_bool(env, track(env, state, ok));
+}
+
+static napi_value js_generate_batch(napi_env env, napi_callback_info info) {
+    napi_value args[5];
+    get_args(env, info, args, 5);
+    AddonState* state = state_of(env);
+    if (!state->engine) {
+        return make_bool(env, false);
+    }
+    smith::GenerationParams params;
+    params.max_tokens = (int) get_int(env, args[2], params.max_tokens);
+    params.temperature = (float) get_double(env, args[3], params.temperature);
+    std::vector<smith::BatchItem> items;
+    for (std::string& prompt : get_strings(env, args[1])) {
+        items.push_back({ std::move(prompt), params });
+    }
+    const bool ok = state->engine->submit_batch((uint64_t) get_int(env, args[0], 0), std::move(items),
+                                                to_priority(get_int(env, args[4], (int) smith::Priority::BACKGROUND)));
+    return make_bool(env, track(env, state, ok));
+}
+
+static napi_value js_warm(napi_env env, napi_callback_info info) {
+    napi_value args[3];
+    get_args(env, info, args, 3);
+    AddonState* state = state_of(env);
+    if (!state->engine) {
+        return make_bool(env, false);
+    }
+    const bool ok = state->engine->submit_warm((uint64_t) get_int(env, args[0], 0), get_string(env, args[1]),
+                                               to_priority(get_int(env, args[2], (int) smith::Priority::IDLE)));
+    return make_bool(env, track(env, state, ok));
+}
+
+static napi_value js_embed(napi_env env, napi_callback_info info) {
+    napi_value args[3];
+    get_args(env, info, args, 3);
+    AddonState* state = state_of(env);
+    if (!state->engine) {
+        return make_bool(env, false);
+    }
+    const bool ok = state->engine->submit_embed((uint64_t) get_int(env, args[0], 0), get_strings(env, args[1]),
+                                                to_priority(get_int(env, args[2], (int) smith::Priority::IDLE)));
+    return make_bool(env, track(env, state, ok));
+}
+
+static napi_value js_cancel(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    get_args(env, info, args, 1);
+    AddonState* state = state_of(env);
+    if (state->engine) {
+        state->engine->cancel((uint64_t) get_int(env, args[0], 0));
+    }
+    return undefined(env);
+}
+
+static napi_value js_cancel_all(napi_env env, napi_callback_info info) {
+    AddonState* state = state_of(env);
+    if (state->engine) {
+        state->engine->cancel_all();
+    }
+    return undefined(env);
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+    static bool backend_ready = false;
+    if (!backend_ready) {
+        llama_backend_init();
+        backend_ready = true;
+    }
+    napi_set_instance_data(env, new AddonState(), finalize_state, nullptr);
+
+    const napi_property_descriptor methods[] = {
+        { "open", nullptr, js_open, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "close", nullptr, js_close, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "loadModel", nullptr, js_load_model, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "unloadModel", nullptr, js_unload_model, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "isLoaded", nullptr, js_is_loaded, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "modelInfo", nullptr, js_model_info, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "setCheckpointDir", nullptr, js_set_checkpoint_dir, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "generate", nullptr, js_generate, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "generateBatch", nullptr, js_generate_batch, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "warm", nullptr, js_warm, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "embed", nullptr, js_embed, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "cancel", nullptr, js_cancel, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "cancelAll", nullptr, js_cancel_all, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_properties(env, exports, sizeof(methods) / sizeof(methods[0]), methods);
+    return exports;
+}
+
+} // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
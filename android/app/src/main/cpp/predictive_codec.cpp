@@ -0,0 +1,474 @@
+/**
+ * predictive_codec.cpp - Model-predictive compression for mesh messages
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "PredictiveCodec"
+
+#include "predictive_codec.h"
+#include "inference_core.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "common.h"
+
+namespace smith {
+
+// Tokens of history the model sees per step; fixed so both ends agree
+static const int CODEC_WINDOW = 8;
+
+// Tokens that get their own symbol each step; the rest are escaped
+static const int TOP_K = 64;
+
+// Logit quantization: quarter nats
+static const float LOGIT_STEPS = 4.0f;
+
+// Logits are clamped to this before quantizing
+static const float LOGIT_LIMIT = 1.0e4f;
+
+// Frequency of the escape symbol, and the floor for END
+static const uint32_t ESCAPE_FREQ = 1024;
+static const uint32_t END_FREQ = 1024;
+
+// A beacon holds 9 bytes; nothing longer than this is worth coding
+static const int MAX_CODED_TOKENS = 64;
+
+// round(65536 * exp(-k / 4)): frequency of a token k quarter nats below the best
+static const uint32_t FREQ_TABLE[] = {
+    65536, 51039, 39750, 30957, 24109, 18776, 14623, 11388, 8869, 6907, 5380,
+    4190, 3263, 2541, 1979, 1541, 1200, 935, 728, 567, 442, 344, 268, 209,
+    162, 127, 99, 77, 60, 47, 36, 28, 22, 17, 13, 10, 8, 6, 5, 4, 3, 2, 2, 1,
+};
+static const int FREQ_TABLE_SIZE = (int) (sizeof(FREQ_TABLE) / sizeof(FREQ_TABLE[0]));
+
+// 32-bit coder state
+static const uint64_t CODE_TOP = 0xFFFFFFFFull;
+static const uint64_t CODE_HALF = 0x80000000ull;
+static const uint64_t CODE_QUARTER = 0x40000000ull;
+
+// ════════════════════════════════════════════════════════════════════
+// MODEL PREDICTOR
+// ════════════════════════════════════════════════════════════════════
+
+ModelPredictor::ModelPredictor(llama_model* model, llama_context* ctx, llama_seq_id seq)
+    : model_(model), ctx_(ctx), seq_(seq) {
+    if (!smith::tokenize(model_, "\n", true, prefix_) || prefix_.empty()) {
+        prefix_.assign(1, llama_token_bos(model_));
+    }
+    batch_ = llama_batch_init((int32_t) prefix_.size() + CODEC_WINDOW, 0, 1);
+
+    // SentencePiece vocabularies prefix a space that detokenizing keeps
+    std::vector<llama_token> probe;
+    std::string text;
+    if (smith::tokenize(model_, "a", false, probe)) {
+        for (llama_token t : probe) {
+            append_piece(model_, t, text);
+        }
+    }
+    strip_space_ = text == " a";
+}
+
+ModelPredictor::~ModelPredictor() {
+    llama_batch_free(batch_);
+}
+
+int ModelPredictor::n_vocab() const {
+    return llama_n_vocab(model_);
+}
+
+llama_token ModelPredictor::eos() const {
+    return llama_token_eos(model_);
+}
+
+bool ModelPredictor::tokenize(const std::string& text, std::vector<llama_token>& out) {
+    return smith::tokenize(model_, text, false, out);
+}
+
+std::string ModelPredictor::detokenize(const std::vector<llama_token>& tokens) {
+    std::string text;
+    for (llama_token t : tokens) {
+        append_piece(model_, t, text);
+    }
+    if (strip_space_ && !text.empty() && text[0] == ' ') {
+        text.erase(0, 1);
+    }
+    return text;
+}
+
+bool ModelPredictor::predict(const std::vector<llama_token>& context, std::vector<float>& logits) {
+    llama_kv_cache_seq_rm(ctx_, seq_, -1, -1);
+    llama_batch_clear(batch_);
+    int pos = 0;
+    for (llama_token t : prefix_) {
+        llama_batch_add(batch_, t, pos++, { seq_ }, false);
+    }
+    for (llama_token t : context) {
+        llama_batch_add(batch_, t, pos++, { seq_ }, false);
+    }
+    batch_.logits[batch_.n_tokens - 1] = true;
+
+    bool ok = llama_decode(ctx_, batch_) == 0;
+    const float* row = ok ? llama_get_logits_ith(ctx_, batch_.n_tokens - 1) : nullptr;
+    if (row != nullptr) {
+        logits.assign(row, row + llama_n_vocab(model_));
+    } else {
+        LOGE("Codec decode failed");
+        ok = false;
+    }
+    llama_kv_cache_seq_rm(ctx_, seq_, -1, -1);
+    return ok;
+}
+
+uint8_t model_fingerprint(const llama_model* model, uint64_t file_size) {
+    // FNV-1a over the shape of the model and its file
+    const uint64_t fields[] = {
+        (uint64_t) llama_n_vocab(model),
+        (uint64_t) llama_n_embd(model),
+        llama_model_n_params(model),
+        file_size,
+    };
+    uint32_t h = 2166136261u;
+    for (uint64_t f : fields) {
+        for (int i = 0; i < 8; i++) {
+            h = (h ^ (uint8_t) (f >> (i * 8))) * 16777619u;
+        }
+    }
+    return (uint8_t) ((h ^ (h >> 3) ^ (h >> 6)) & 0x07);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DISTRIBUTION
+// ════════════════════════════════════════════════════════════════════
+
+namespace {
+
+/**
+ * Integer frequencies for one step. Symbols are the top tokens in order,
+ * then ESCAPE, then END; cum has one more entry than there are symbols.
+ */
+struct Distribution {
+    std::vector<llama_token> tokens;
+    std::vector<uint32_t> cum;
+    std::vector<std::pair<int32_t, llama_token>> scratch;
+
+    int escape() const { return (int) tokens.size(); }
+    int end() const { return (int) tokens.size() + 1; }
+    uint32_t total() const { return cum.back(); }
+
+    void build(const std::vector<float>& logits, llama_token eos) {
+        scratch.resize(logits.size());
+        for (size_t i = 0; i < logits.size(); i++) {
+            float x = logits[i];
+            if (!(x > -LOGIT_LIMIT)) {
+                x = -LOGIT_LIMIT;
+            } else if (x > LOGIT_LIMIT) {
+                x = LOGIT_LIMIT;
+            }
+            scratch[i] = { (int32_t) lrintf(x * LOGIT_STEPS), (llama_token) i };
+        }
+        // One extra in case EOS is among the best
+        const size_t n = std::min(scratch.size(), (size_t) TOP_K + 1);
+        std::partial_sort(scratch.begin(), scratch.begin() + n, scratch.end(),
+                          [](const std::pair<int32_t, llama_token>& a,
+                             const std::pair<int32_t, llama_token>& b) {
+                              return a.first != b.first ? a.first > b.first : a.second < b.second;
+                          });
+
+        tokens.clear();
+        cum.assign(1, 0);
+        uint32_t end_freq = END_FREQ;
+        const int32_t best = n > 0 ? scratch[0].first : 0;
+        for (size_t i = 0; i < n; i++) {
+            const int32_t below = std::min(best - scratch[i].first, (int32_t) FREQ_TABLE_SIZE - 1);
+            const uint32_t freq = FREQ_TABLE[below];
+            if (scratch[i].second == eos) {
+                end_freq = std::max(end_freq, freq);
+            } else if ((int) tokens.size() < TOP_K) {
+                tokens.push_back(scratch[i].second);
+                cum.push_back(cum.back() + freq);
+            }
+        }
+        cum.push_back(cum.back() + ESCAPE_FREQ);
+        cum.push_back(cum.back() + end_freq);
+    }
+
+    int find(llama_token token) const {
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (tokens[i] == token) {
+                return (int) i;
+            }
+        }
+        return -1;
+    }
+};
+
+// ════════════════════════════════════════════════════════════════════
+// ARITHMETIC CODER
+// ════════════════════════════════════════════════════════════════════
+
+class ArithmeticEncoder {
+public:
+    explicit ArithmeticEncoder(std::vector<uint8_t>& out) : out_(out) {}
+
+    void encode(uint32_t lo, uint32_t hi, uint32_t total) {
+        const uint64_t range = high_ - low_ + 1;
+        high_ = low_ + range * hi / total - 1;
+        low_ = low_ + range * lo / total;
+        while (true) {
+            if (high_ < CODE_HALF) {
+                emit(0);
+            } else if (low_ >= CODE_HALF) {
+                emit(1);
+                low_ -= CODE_HALF;
+                high_ -= CODE_HALF;
+            } else if (low_ >= CODE_QUARTER && high_ < CODE_HALF + CODE_QUARTER) {
+                pending_++;
+                low_ -= CODE_QUARTER;
+                high_ -= CODE_QUARTER;
+            } else {
+                break;
+            }
+            low_ <<= 1;
+            high_ = (high_ << 1) | 1;
+        }
+    }
+
+    /** Two more bits pin the final interval; the decoder reads zeros past the end. */
+    void finish() {
+        pending_++;
+        emit(low_ < CODE_QUARTER ? 0 : 1);
+        if (n_bits_ > 0) {
+            out_.push_back(bits_);
+        }
+        while (!out_.empty() && out_.back() == 0) {
+            out_.pop_back();
+        }
+    }
+
+    /** Bytes the output needs at least, whatever follows. */
+    size_t committed_bytes() const { return out_.size() + (n_bits_ > 0 ? 1 : 0); }
+
+private:
+    void put(int bit) {
+        bits_ = (uint8_t) (bits_ | (bit << (7 - n_bits_)));
+        if (++n_bits_ == 8) {
+            out_.push_back(bits_);
+            bits_ = 0;
+            n_bits_ = 0;
+        }
+    }
+
+    void emit(int bit) {
+        put(bit);
+        for (; pending_ > 0; pending_--) {
+            put(!bit);
+        }
+    }
+
+    std::vector<uint8_t>& out_;
+    uint64_t low_ = 0;
+    uint64_t high_ = CODE_TOP;
+    int pending_ = 0;
+    uint8_t bits_ = 0;
+    int n_bits_ = 0;
+};
+
+class ArithmeticDecoder {
+public:
+    ArithmeticDecoder(const uint8_t* data, size_t size) : data_(data), size_(size) {
+        for (int i = 0; i < 32; i++) {
+            value_ = (value_ << 1) | next_bit();
+        }
+    }
+
+    /** Scaled position of the code value in [0, total). */
+    uint32_t target(uint32_t total) const {
+        const uint64_t range = high_ - low_ + 1;
+        return (uint32_t) (((value_ - low_ + 1) * total - 1) / range);
+    }
+
+    void consume(uint32_t lo, uint32_t hi, uint32_t total) {
+        const uint64_t range = high_ - low_ + 1;
+        high_ = low_ + range * hi / total - 1;
+        low_ = low_ + range * lo / total;
+        while (true) {
+            if (high_ < CODE_HALF) {
+                // nothing to subtract
+            } else if (low_ >= CODE_HALF) {
+                low_ -= CODE_HALF;
+                high_ -= CODE_HALF;
+                value_ -= CODE_HALF;
+            } else if (low_ >= CODE_QUARTER && high_ < CODE_HALF + CODE_QUARTER) {
+                low_ -= CODE_QUARTER;
+                high_ -= CODE_QUARTER;
+                value_ -= CODE_QUARTER;
+            } else {
+                break;
+            }
+            low_ <<= 1;
+            high_ = (high_ << 1) | 1;
+            value_ = (value_ << 1) | next_bit();
+        }
+    }
+
+private:
+    uint64_t next_bit() {
+        const size_t byte = pos_ >> 3;
+        const uint64_t bit = byte < size_ ? (data_[byte] >> (7 - (pos_ & 7))) & 1 : 0;
+        pos_++;
+        return bit;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint64_t low_ = 0;
+    uint64_t high_ = CODE_TOP;
+    uint64_t value_ = 0;
+};
+
+uint8_t crc8(const std::string& text) {
+    uint8_t crc = 0;
+    for (unsigned char c : text) {
+        crc ^= c;
+        for (int i = 0; i < 8; i++) {
+            crc = (uint8_t) ((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+void window(const std::vector<llama_token>& tokens, size_t end, std::vector<llama_token>& out) {
+    const size_t start = end > (size_t) CODEC_WINDOW ? end - CODEC_WINDOW : 0;
+    out.assign(tokens.begin() + start, tokens.begin() + end);
+}
+
+} // namespace
+
+// ════════════════════════════════════════════════════════════════════
+// ENCODE / DECODE
+// ════════════════════════════════════════════════════════════════════
+
+bool codec_encode(TokenPredictor& predictor, uint8_t fingerprint, const std::string& text,
+                  size_t max_bytes, std::vector<uint8_t>& out, std::string& error) {
+    std::vector<llama_token> tokens;
+    if (!predictor.tokenize(text, tokens) || predictor.detokenize(tokens) != text) {
+        error = "Text does not round-trip through the tokenizer";
+        return false;
+    }
+    if ((int) tokens.size() > MAX_CODED_TOKENS) {
+        error = "Text too long to compress";
+        return false;
+    }
+
+    const int n_vocab = predictor.n_vocab();
+    const uint32_t n_high = (uint32_t) (n_vocab + 255) / 256;
+    std::vector<uint8_t> coded;
+    ArithmeticEncoder encoder(coded);
+    Distribution dist;
+    std::vector<llama_token> context;
+    std::vector<float> logits;
+    for (size_t i = 0; i <= tokens.size(); i++) {
+        window(tokens, i, context);
+        if (!predictor.predict(context, logits) || (int) logits.size() != n_vocab) {
+            error = "Prediction failed";
+            return false;
+        }
+        dist.build(logits, predictor.eos());
+
+        int symbol = i == tokens.size() ? dist.end() : dist.find(tokens[i]);
+        if (symbol < 0) {
+            symbol = dist.escape();
+        }
+        encoder.encode(dist.cum[symbol], dist.cum[symbol + 1], dist.total());
+        if (symbol == dist.escape()) {
+            const uint32_t id = (uint32_t) tokens[i];
+            encoder.encode(id / 256, id / 256 + 1, n_high);
+            encoder.encode(id % 256, id % 256 + 1, 256);
+        }
+        if (max_bytes > 0 && 2 + encoder.committed_bytes() > max_bytes) {
+            error = "Does not fit";
+            return false;
+        }
+    }
+    encoder.finish();
+    if (max_bytes > 0 && 2 + coded.size() > max_bytes) {
+        error = "Does not fit";
+        return false;
+    }
+
+    out.clear();
+    out.push_back((uint8_t) (CODEC_FRAME_TAG | (fingerprint & 0x07)));
+    out.push_back(crc8(text));
+    out.insert(out.end(), coded.begin(), coded.end());
+    return true;
+}
+
+bool codec_decode(TokenPredictor& predictor, uint8_t fingerprint, const uint8_t* data,
+                  size_t size, std::string& out, std::string& error) {
+    if (!is_codec_frame(data, size)) {
+        error = "Not a compressed frame";
+        return false;
+    }
+    if ((data[0] & 0x07) != (fingerprint & 0x07)) {
+        error = "Compressed with a different model";
+        return false;
+    }
+
+    const int n_vocab = predictor.n_vocab();
+    const uint32_t n_high = (uint32_t) (n_vocab + 255) / 256;
+    ArithmeticDecoder decoder(data + 2, size - 2);
+    Distribution dist;
+    std::vector<llama_token> tokens;
+    std::vector<llama_token> context;
+    std::vector<float> logits;
+    while (true) {
+        window(tokens, tokens.size(), context);
+        if (!predictor.predict(context, logits) || (int) logits.size() != n_vocab) {
+            error = "Prediction failed";
+            return false;
+        }
+        dist.build(logits, predictor.eos());
+
+        const uint32_t target = decoder.target(dist.total());
+        int symbol = 0;
+        while (symbol < dist.end() && dist.cum[symbol + 1] <= target) {
+            symbol++;
+        }
+        decoder.consume(dist.cum[symbol], dist.cum[symbol + 1], dist.total());
+        if (symbol == dist.end()) {
+            break;
+        }
+        if ((int) tokens.size() == MAX_CODED_TOKENS) {
+            error = "Corrupt frame";
+            return false;
+        }
+        if (symbol == dist.escape()) {
+            const uint32_t high = std::min(decoder.target(n_high), n_high - 1);
+            decoder.consume(high, high + 1, n_high);
+            const uint32_t low = std::min(decoder.target(256), 255u);
+            decoder.consume(low, low + 1, 256);
+            const uint32_t id = high * 256 + low;
+            if (id >= (uint32_t) n_vocab) {
+                error = "Corrupt frame";
+                return false;
+            }
+            tokens.push_back((llama_token) id);
+        } else {
+            tokens.push_back(dist.tokens[symbol]);
+        }
+    }
+
+    std::string text = predictor.detokenize(tokens);
+    if (crc8(text) != data[1]) {
+        error = "Checksum mismatch";
+        return false;
+    }
+    out.swap(text);
+    return true;
+}
+
+} // namespace smith
@@ -0,0 +1,117 @@
+/**
+ * predictive_codec.h - Model-predictive compression for mesh messages
+ * Guild of Smiths - Offline AI Module
+ *
+ * A mesh beacon carries 9 bytes of text. Every device in a crew runs the
+ * same GGUF, so sender and receiver can both ask it how likely each next
+ * token is and arithmetic-code the message against that distribution: a
+ * short, predictable job-site sentence costs a few bits per token instead
+ * of eight per character.
+ *
+ * Both ends must see bit-identical frequencies, so the model is only used
+ * in a narrow, reproducible way: every step decodes a fresh window of the
+ * last CODEC_WINDOW tokens, logits are quantized to quarter nats, the
+ * TOP_K most likely tokens (ties by id) get frequencies from a fixed
+ * integer table, and everything else goes through an escape that spells
+ * out the token id. Integer coding after that is exact.
+ *
+ * Frame: [0xF8 | model fingerprint][CRC-8 of the text][coded bits]. 0xF8
+ * and above never start UTF-8, so receivers tell a frame from plain text
+ * by its first byte. Float results can still differ across CPUs; the CRC
+ * turns that into a rejected frame rather than a wrong message.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace smith {
+
+enum class CodecOp : int {
+    ENCODE = 0,
+    DECODE = 1,
+};
+
+// First byte of a frame; the low 3 bits hold the model fingerprint
+static const uint8_t CODEC_FRAME_TAG = 0xF8;
+
+/**
+ * Next-token distribution source. The codec only needs tokenizing,
+ * detokenizing and logits, so tests can stand in a table-driven model.
+ */
+class TokenPredictor {
+public:
+    virtual ~TokenPredictor() = default;
+
+    virtual int n_vocab() const = 0;
+
+    /** Ends a message; the codec folds its probability into the END symbol. */
+    virtual llama_token eos() const = 0;
+
+    /** Tokens without BOS; false if the text cannot be tokenized. */
+    virtual bool tokenize(const std::string& text, std::vector<llama_token>& out) = 0;
+
+    /** Inverse of tokenize (including any space the tokenizer prepends). */
+    virtual std::string detokenize(const std::vector<llama_token>& tokens) = 0;
+
+    /** Logits (n_vocab floats) for the token following context. */
+    virtual bool predict(const std::vector<llama_token>& context, std::vector<float>& logits) = 0;
+};
+
+/**
+ * Predictions from a loaded model. Each call replaces the cells of seq
+ * with BOS, a newline and the context, and leaves the sequence empty.
+ */
+class ModelPredictor : public TokenPredictor {
+public:
+    ModelPredictor(llama_model* model, llama_context* ctx, llama_seq_id seq);
+    ~ModelPredictor() override;
+
+    ModelPredictor(const ModelPredictor&) = delete;
+    ModelPredictor& operator=(const ModelPredictor&) = delete;
+
+    int n_vocab() const override;
+    llama_token eos() const override;
+    bool tokenize(const std::string& text, std::vector<llama_token>& out) override;
+    std::string detokenize(const std::vector<llama_token>& tokens) override;
+    bool predict(const std::vector<llama_token>& context, std::vector<float>& logits) override;
+
+private:
+    llama_model* model_;
+    llama_context* ctx_;
+    llama_seq_id seq_;
+    llama_batch batch_;
+    std::vector<llama_token> prefix_;
+    bool strip_space_ = false;   // tokenizer prepends a space to every text
+};
+
+/** 3-bit model identity carried in each frame; peers on another model drop it. */
+uint8_t model_fingerprint(const llama_model* model, uint64_t file_size);
+
+/** True if data starts like a codec frame rather than UTF-8 text. */
+inline bool is_codec_frame(const uint8_t* data, size_t size) {
+    return size >= 2 && (data[0] & CODEC_FRAME_TAG) == CODEC_FRAME_TAG;
+}
+
+/**
+ * Compress text into a frame.
+ * @param max_bytes Give up as soon as the frame would exceed this; 0 for no limit
+ * @return false with error set if the text does not round-trip through the
+ *         tokenizer, is too long, or does not fit
+ */
+bool codec_encode(TokenPredictor& predictor, uint8_t fingerprint, const std::string& text,
+                  size_t max_bytes, std::vector<uint8_t>& out, std::string& error);
+
+/**
+ * Expand a frame made by codec_encode with the same model.
+ * @return false with error set on a foreign model, corrupt frame or checksum mismatch
+ */
+bool codec_decode(TokenPredictor& predictor, uint8_t fingerprint, const uint8_t* data,
+                  size_t size, std::string& out, std::string& error);
+
+} // namespace smith
@@ -0,0 +1,369 @@
+/**
+ * prefix_cache.cpp - Host-memory KV snapshots of common prompt prefixes
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "PrefixCache"
+
+#include "prefix_cache.h"
+#include "checkpoint.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace smith {
+
+// Below this, restoring a snapshot costs about as much as prefilling
+static const int MIN_REUSE_TOKENS = 16;
+
+static const char PREFIX_MAGIC[4] = { 'S', 'P', 'F', 'X' };
+static const uint32_t PREFIX_VERSION = 1;
+static const char* const PREFIX_SUFFIX = ".kvp";
+
+static int common_prefix(const std::vector<llama_token>& a, const std::vector<llama_token>& b) {
+    const size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return (int) i;
+}
+
+PrefixCache::PrefixCache(size_t max_bytes)
+    : max_bytes_(max_bytes) {
+}
+
+bool PrefixCache::store(llama_context* ctx, llama_seq_id seq, const std::vector<llama_token>& tokens) {
+    if ((int) tokens.size() < MIN_REUSE_TOKENS) {
+        return false;
+    }
+    const size_t size = llama_state_seq_get_size(ctx, seq);
+    if (size == 0 || size > max_bytes_) {
+        return false;
+    }
+
+    Entry entry;
+    entry.tokens = tokens;
+    entry.kv.resize(size);
+    if (llama_state_seq_get_data(ctx, entry.kv.data(), seq) != size) {
+        LOGE("Snapshot of %zu tokens failed", tokens.size());
+        return false;
+    }
+    // Same model, same tokens: the file already holds these exact cells
+    const bool on_disk = std::any_of(disk_.begin(), disk_.end(),
+                                     [&tokens](const DiskEntry& d) { return d.tokens == tokens; });
+    if (!disk_dir_.empty() && !model_path_.empty() && !on_disk) {
+        write_disk(entry);
+    }
+    insert(std::move(entry));
+
+    LOGI("Stored prefix of %zu tokens (%zu KB, %zu entries, %zu KB total)",
+         tokens.size(), size / 1024, entries_.size(), bytes_ / 1024);
+    return true;
+}
+
+void PrefixCache::insert(Entry entry) {
+    entry.last_used = ++clock_;
+    auto same = std::find_if(entries_.begin(), entries_.end(),
+                             [&entry](const Entry& e) { return e.tokens == entry.tokens; });
+    if (same != entries_.end()) {
+        bytes_ -= same->kv.size();
+        entries_.erase(same);
+    }
+    evict_to(max_bytes_ - entry.kv.size());
+    bytes_ += entry.kv.size();
+    entries_.push_back(std::move(entry));
+}
+
+int PrefixCache::restore(llama_context* ctx, llama_seq_id seq, const std::vector<llama_token>& tokens,
+                         int max_len) {
+    Entry* best = nullptr;
+    int best_len = 0;
+    for (Entry& e : entries_) {
+        const int len = std::min(common_prefix(e.tokens, tokens), max_len);
+        if (len > best_len) {
+            best = &e;
+            best_len = len;
+        }
+    }
+
+    // A file beats memory only when it covers more of the prompt
+    auto disk = disk_.end();
+    int disk_len = std::max(best_len, MIN_REUSE_TOKENS - 1);
+    for (auto d = disk_.begin(); d != disk_.end(); ++d) {
+        const int len = std::min(common_prefix(d->tokens, tokens), max_len);
+        if (len > disk_len) {
+            disk = d;
+            disk_len = len;
+        }
+    }
+    if (disk != disk_.end()) {
+        Entry loaded;
+        if (load_disk(*disk, loaded) && loaded.kv.size() <= max_bytes_) {
+            utime(disk->path.c_str(), nullptr);
+            disk->last_used = (int64_t) time(nullptr);
+            insert(std::move(loaded));
+            best = &entries_.back();
+            best_len = disk_len;
+            stats_.disk_loads++;
+            LOGI("Loaded prefix of %zu tokens from disk", best->tokens.size());
+        } else if (loaded.kv.empty()) {
+            LOGW("Dropping unreadable prefix file %s", disk->path.c_str());
+            unlink(disk->path.c_str());
+            disk_bytes_ -= disk->bytes;
+            disk_.erase(disk);
+        }
+    }
+
+    llama_kv_cache_seq_rm(ctx, seq, -1, -1);
+    if (best == nullptr || best_len < MIN_REUSE_TOKENS) {
+        stats_.misses++;
+        return 0;
+    }
+    if (llama_state_seq_set_data(ctx, best->kv.data(), seq) == 0) {
+        LOGE("Restoring prefix of %zu tokens failed", best->tokens.size());
+        llama_kv_cache_seq_rm(ctx, seq, -1, -1);
+        stats_.misses++;
+        return 0;
+    }
+    llama_kv_cache_seq_rm(ctx, seq, best_len, -1);
+
+    best->last_used = ++clock_;
+    stats_.hits++;
+    stats_.tokens_reused += best_len;
+    return best_len;
+}
+
+bool PrefixCache::contains(const std::vector<llama_token>& tokens) const {
+    return std::any_of(entries_.begin(), entries_.end(),
+                       [&tokens](const Entry& e) { return e.tokens == tokens; }) ||
+           std::any_of(disk_.begin(), disk_.end(),
+                       [&tokens](const DiskEntry& d) { return d.tokens == tokens; });
+}
+
+void PrefixCache::clear() {
+    entries_.clear();
+    bytes_ = 0;
+}
+
+void PrefixCache::evict_to(size_t budget) {
+    while (bytes_ > budget && !entries_.empty()) {
+        auto lru = std::min_element(entries_.begin(), entries_.end(),
+                                    [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+        bytes_ -= lru->kv.size();
+        entries_.erase(lru);
+    }
+}
+
+void PrefixCache::set_disk_dir(const std::string& dir, size_t max_bytes) {
+    disk_dir_ = dir;
+    disk_max_bytes_ = max_bytes;
+    scan_disk();
+}
+
+void PrefixCache::set_model(const std::string& path, uint64_t size) {
+    model_path_ = path;
+    model_size_ = size;
+    scan_disk();
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DISK TIER
+// ════════════════════════════════════════════════════════════════════
+
+static void put(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+static bool get(FILE* f, void* out, size_t size) {
+    return size == 0 || fread(out, 1, size, f) == size;
+}
+
+/** Fields before the KV bytes; leaves f positioned at kv_size. */
+static bool read_header(FILE* f, std::string& model_path, uint64_t& model_size,
+                        std::vector<llama_token>& tokens) {
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t path_len = 0;
+    uint32_t n_tokens = 0;
+    if (!get(f, magic, 4) || memcmp(magic, PREFIX_MAGIC, 4) != 0 ||
+        !get(f, &version, sizeof(version)) || version != PREFIX_VERSION ||
+        !get(f, &path_len, sizeof(path_len)) || path_len > 4096) {
+        return false;
+    }
+    model_path.resize(path_len);
+    if (!get(f, &model_path[0], path_len) || !get(f, &model_size, sizeof(model_size)) ||
+        !get(f, &n_tokens, sizeof(n_tokens)) || n_tokens > (1u << 20)) {
+        return false;
+    }
+    tokens.resize(n_tokens);
+    return get(f, tokens.data(), (size_t) n_tokens * sizeof(llama_token));
+}
+
+void PrefixCache::scan_disk() {
+    disk_.clear();
+    disk_bytes_ = 0;
+    if (disk_dir_.empty() || model_path_.empty()) {
+        return;
+    }
+    DIR* d = opendir(disk_dir_.c_str());
+    if (d == nullptr) {
+        LOGW("Prefix cache directory %s is not readable", disk_dir_.c_str());
+        return;
+    }
+
+    const size_t suffix_len = strlen(PREFIX_SUFFIX);
+    while (struct dirent* e = readdir(d)) {
+        const std::string name = e->d_name;
+        const std::string path = disk_dir_ + "/" + name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            unlink(path.c_str());   // left by a crash mid-write
+            continue;
+        }
+        if (name.size() <= suffix_len ||
+            name.compare(name.size() - suffix_len, suffix_len, PREFIX_SUFFIX) != 0) {
+            continue;
+        }
+
+        DiskEntry entry;
+        std::string model_path;
+        uint64_t model_size = 0;
+        struct stat st;
+        FILE* f = fopen(path.c_str(), "rb");
+        const bool ok = f != nullptr && fstat(fileno(f), &st) == 0 &&
+                        read_header(f, model_path, model_size, entry.tokens);
+        if (f != nullptr) {
+            fclose(f);
+        }
+        if (!ok || model_path != model_path_ || model_size != model_size_) {
+            unlink(path.c_str());
+            continue;
+        }
+        entry.path = path;
+        entry.bytes = (size_t) st.st_size;
+        entry.last_used = (int64_t) st.st_mtime;
+        disk_bytes_ += entry.bytes;
+        disk_.push_back(std::move(entry));
+    }
+    closedir(d);
+
+    evict_disk_to(disk_max_bytes_);
+    LOGI("Prefix cache has %zu entries on disk (%zu KB)", disk_.size(), disk_bytes_ / 1024);
+}
+
+void PrefixCache::write_disk(const Entry& entry) {
+    std::vector<uint8_t> header;
+    const uint32_t path_len = (uint32_t) model_path_.size();
+    const uint32_t n_tokens = (uint32_t) entry.tokens.size();
+    const uint64_t kv_size = entry.kv.size();
+    put(header, PREFIX_MAGIC, 4);
+    put(header, &PREFIX_VERSION, sizeof(PREFIX_VERSION));
+    put(header, &path_len, sizeof(path_len));
+    put(header, model_path_.data(), model_path_.size());
+    put(header, &model_size_, sizeof(model_size_));
+    put(header, &n_tokens, sizeof(n_tokens));
+    put(header, entry.tokens.data(), entry.tokens.size() * sizeof(llama_token));
+    put(header, &kv_size, sizeof(kv_size));
+
+    const size_t total = header.size() + entry.kv.size() + sizeof(uint32_t);
+    if (total > disk_max_bytes_) {
+        return;
+    }
+    evict_disk_to(disk_max_bytes_ - total);
+
+    uint64_t h = 1469598103934665603ull;
+    for (llama_token t : entry.tokens) {
+        h = (h ^ (uint32_t) t) * 1099511628211ull;
+    }
+    char name[40];
+    snprintf(name, sizeof(name), "/%016llx%s", (unsigned long long) h, PREFIX_SUFFIX);
+    const std::string path = disk_dir_ + name;
+    const std::string tmp = path + ".tmp";
+
+    uint32_t crc = crc32_update(0, header.data(), header.size());
+    crc = crc32_update(crc, entry.kv.data(), entry.kv.size());
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        LOGE("Cannot create %s", tmp.c_str());
+        return;
+    }
+    bool ok = fwrite(header.data(), 1, header.size(), f) == header.size() &&
+              fwrite(entry.kv.data(), 1, entry.kv.size(), f) == entry.kv.size() &&
+              fwrite(&crc, sizeof(crc), 1, f) == 1 &&
+              fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        LOGE("Writing prefix file %s failed", path.c_str());
+        unlink(tmp.c_str());
+        return;
+    }
+
+    // A hash collision overwrote another entry's file
+    auto same = std::find_if(disk_.begin(), disk_.end(),
+                             [&path](const DiskEntry& d) { return d.path == path; });
+    if (same != disk_.end()) {
+        disk_bytes_ -= same->bytes;
+        disk_.erase(same);
+    }
+    DiskEntry disk;
+    disk.tokens = entry.tokens;
+    disk.path = path;
+    disk.bytes = total;
+    disk.last_used = (int64_t) time(nullptr);
+    disk_bytes_ += total;
+    disk_.push_back(std::move(disk));
+}
+
+bool PrefixCache::load_disk(const DiskEntry& disk, Entry& entry) const {
+    FILE* f = fopen(disk.path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    std::string model_path;
+    uint64_t model_size = 0;
+    uint64_t kv_size = 0;
+    uint32_t stored_crc = 0;
+    bool ok = read_header(f, model_path, model_size, entry.tokens) &&
+              entry.tokens == disk.tokens && get(f, &kv_size, sizeof(kv_size)) &&
+              kv_size + sizeof(stored_crc) <= disk.bytes;
+    const long kv_offset = ok ? ftell(f) : 0;
+    if (ok) {
+        entry.kv.resize((size_t) kv_size);
+        ok = get(f, entry.kv.data(), entry.kv.size()) && get(f, &stored_crc, sizeof(stored_crc));
+    }
+
+    // The header is read again for the CRC rather than re-serialized
+    if (ok) {
+        std::vector<uint8_t> header((size_t) kv_offset);
+        ok = fseek(f, 0, SEEK_SET) == 0 && get(f, header.data(), header.size());
+        uint32_t crc = crc32_update(0, header.data(), header.size());
+        crc = crc32_update(crc, entry.kv.data(), entry.kv.size());
+        ok = ok && crc == stored_crc;
+    }
+    fclose(f);
+    if (!ok) {
+        entry.kv.clear();
+    }
+    return ok;
+}
+
+void PrefixCache::evict_disk_to(size_t budget) {
+    while (disk_bytes_ > budget && !disk_.empty()) {
+        auto lru = std::min_element(disk_.begin(), disk_.end(),
+                                    [](const DiskEntry& a, const DiskEntry& b) { return a.last_used < b.last_used; });
+        unlink(lru->path.c_str());
+        disk_bytes_ -= lru->bytes;
+        disk_.erase(lru);
+    }
+}
+
+} // namespace smith
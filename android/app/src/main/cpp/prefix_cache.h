@@ -0,0 +1,121 @@
+/**
+ * prefix_cache.h - Host-memory KV snapshots of common prompt prefixes
+ * Guild of Smiths - Offline AI Module
+ *
+ * Holds the KV cells of prompts that many requests start with (system
+ * prompts for the current jobs, warmed while the device charges). A new
+ * generation restores the entry sharing the longest token prefix with its
+ * prompt and only prefills the rest. Entries match partially: cells past
+ * the shared prefix are dropped after the restore, which is exact for a
+ * causal model.
+ *
+ * With a disk directory set, every stored entry is also written there and
+ * survives eviction and restarts: a prompt that shares more with a file
+ * than with any entry in memory loads that file instead of prefilling.
+ * That is how warmed knowledge chunks ("system header + chunk") are
+ * computed once per model rather than once per process.
+ *
+ * Disk entry (little-endian), written to "<name>.tmp" and renamed:
+ *   "SPFX" | u32 version | str model_path | u64 model_size
+ *   u32 n_tokens | i32 tokens[n_tokens] | u64 kv_size | kv bytes
+ *   u32 crc32 of everything before it
+ * Only the part before kv is read to index the directory; the CRC is
+ * checked when an entry is loaded.
+ *
+ * Not thread-safe; the engine uses it from the worker only.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace smith {
+
+struct PrefixCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t tokens_reused = 0;
+    uint64_t disk_loads = 0;
+};
+
+class PrefixCache {
+public:
+    explicit PrefixCache(size_t max_bytes);
+
+    /**
+     * Snapshot sequence seq, which must hold exactly tokens at positions
+     * 0..n-1. Replaces an entry with the same tokens; evicts least
+     * recently used entries to stay within the byte budget.
+     */
+    bool store(llama_context* ctx, llama_seq_id seq, const std::vector<llama_token>& tokens);
+
+    /**
+     * Load the best entry into seq (cleared first) and trim it to the
+     * shared prefix, capped at max_len tokens.
+     * @return tokens now in seq; 0 on a miss (seq left empty)
+     */
+    int restore(llama_context* ctx, llama_seq_id seq, const std::vector<llama_token>& tokens, int max_len);
+
+    /** True if an entry for exactly these tokens exists, in memory or on disk. */
+    bool contains(const std::vector<llama_token>& tokens) const;
+
+    /** Drop everything in memory, e.g. when the model changes. Disk entries stay. */
+    void clear();
+
+    /**
+     * Also keep entries as files in dir (which must exist), at most
+     * max_bytes of them; empty dir turns the disk tier off.
+     */
+    void set_disk_dir(const std::string& dir, size_t max_bytes);
+
+    /**
+     * Model the entries belong to (empty path for none). Indexes the disk
+     * directory; files made with another model are deleted.
+     */
+    void set_model(const std::string& path, uint64_t size);
+
+    size_t size() const { return entries_.size(); }
+    size_t bytes() const { return bytes_; }
+    const PrefixCacheStats& stats() const { return stats_; }
+
+private:
+    struct Entry {
+        std::vector<llama_token> tokens;
+        std::vector<uint8_t> kv;
+        uint64_t last_used = 0;
+    };
+
+    struct DiskEntry {
+        std::vector<llama_token> tokens;
+        std::string path;
+        size_t bytes = 0;
+        int64_t last_used = 0;   // file mtime, seconds
+    };
+
+    void evict_to(size_t budget);
+    void insert(Entry entry);
+    void scan_disk();
+    void write_disk(const Entry& entry);
+    bool load_disk(const DiskEntry& disk, Entry& entry) const;
+    void evict_disk_to(size_t budget);
+
+    std::vector<Entry> entries_;
+    size_t max_bytes_;
+    size_t bytes_ = 0;
+    uint64_t clock_ = 0;
+    PrefixCacheStats stats_;
+
+    std::string disk_dir_;
+    size_t disk_max_bytes_ = 0;
+    std::string model_path_;
+    uint64_t model_size_ = 0;
+    std::vector<DiskEntry> disk_;
+    size_t disk_bytes_ = 0;
+};
+
+} // namespace smith
@@ -0,0 +1,161 @@
+/**
+ * prompt_assembler.cpp - Fit prioritized prompt segments into a token budget
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "PromptAssembler"
+
+#include "prompt_assembler.h"
+#include "inference_core.h"
+#include "native_log.h"
+
+#include <algorithm>
+
+namespace smith {
+
+static const char* const MARKER_OPEN = "<|";
+static const char* const MARKER_CLOSE = "|>";
+
+static int full_length(const PromptSegment& segment, int n_tokens) {
+    return segment.max_tokens > 0 ? std::min(n_tokens, segment.max_tokens) : n_tokens;
+}
+
+/**
+ * Text of the first (or, with keep_tail, last) n tokens of a segment,
+ * pulled back so it neither splits a marker nor a UTF-8 character.
+ */
+static std::string cut_segment(const llama_model* model, const PromptSegment& segment,
+                               const std::vector<llama_token>& tokens, int n) {
+    if (n >= (int) tokens.size()) {
+        return segment.text;
+    }
+    if (n <= 0) {
+        return std::string();
+    }
+
+    std::string out;
+    if (!segment.keep_tail) {
+        for (int i = 0; i < n; i++) {
+            append_piece(model, tokens[i], out);
+        }
+        // SPM pieces carry the space the tokenizer put in front of the text
+        if (!out.empty() && out[0] == ' ' && (segment.text.empty() || segment.text[0] != ' ')) {
+            out.erase(0, 1);
+        }
+        out.resize(utf8_complete_length(out));
+        const size_t open = out.rfind(MARKER_OPEN);
+        if (open != std::string::npos && out.find(MARKER_CLOSE, open) == std::string::npos) {
+            out.resize(open);
+        }
+        return out;
+    }
+
+    for (size_t i = tokens.size() - n; i < tokens.size(); i++) {
+        append_piece(model, tokens[i], out);
+    }
+    size_t start = 0;
+    while (start < out.size() && (static_cast<unsigned char>(out[start]) & 0xC0) == 0x80) {
+        start++;
+    }
+    const size_t close = out.find(MARKER_CLOSE, start);
+    const size_t open = out.find(MARKER_OPEN, start);
+    if (close != std::string::npos && (open == std::string::npos || close < open)) {
+        start = close + 2;
+    }
+    return out.substr(start);
+}
+
+bool assemble_prompt(const llama_model* model, const std::vector<PromptSegment>& segments,
+                     int budget, AssembledPrompt& out) {
+    const size_t n = segments.size();
+    std::vector<std::vector<llama_token>> tokens(n);
+    std::vector<int> allowance(n, 0);
+
+    // BOS and friends, added once for the whole prompt
+    std::vector<llama_token> scratch;
+    if (!tokenize(model, std::string(), true, scratch)) {
+        return false;
+    }
+    int used = (int) scratch.size();
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < n; i++) {
+        if (!tokenize(model, segments[i].text, false, tokens[i])) {
+            LOGE("Tokenizing segment %zu failed", i);
+            return false;
+        }
+        if (segments[i].required) {
+            allowance[i] = (int) tokens[i].size();
+            used += allowance[i];
+        } else if (!tokens[i].empty()) {
+            order.push_back(i);
+        }
+    }
+    if (used > budget) {
+        LOGW("Required segments need %d tokens, budget is %d", used, budget);
+        return false;
+    }
+    std::stable_sort(order.begin(), order.end(), [&segments](size_t a, size_t b) {
+        return segments[a].priority > segments[b].priority;
+    });
+
+    // Minimums first, so a low-priority segment is cut before a higher one is dropped
+    for (size_t i : order) {
+        const int minimum = std::min(full_length(segments[i], (int) tokens[i].size()),
+                                     std::max(segments[i].min_tokens, 0));
+        if (used + minimum <= budget) {
+            allowance[i] = minimum;
+            used += minimum;
+        } else {
+            allowance[i] = -1;
+        }
+    }
+    for (size_t i : order) {
+        if (allowance[i] < 0) {
+            allowance[i] = 0;
+            continue;
+        }
+        const int extra = std::min(full_length(segments[i], (int) tokens[i].size()) - allowance[i],
+                                   budget - used);
+        allowance[i] += extra;
+        used += extra;
+    }
+
+    std::vector<std::string> parts(n);
+    for (size_t i = 0; i < n; i++) {
+        parts[i] = cut_segment(model, segments[i], tokens[i], allowance[i]);
+    }
+
+    // Counted alone the parts can be off by a token or two at each seam
+    while (true) {
+        out.text.clear();
+        for (const std::string& part : parts) {
+            out.text += part;
+        }
+        if (!tokenize(model, out.text, true, scratch)) {
+            return false;
+        }
+        const int over = (int) scratch.size() - budget;
+        if (over <= 0) {
+            break;
+        }
+        auto last = std::find_if(order.rbegin(), order.rend(),
+                                 [&allowance](size_t i) { return allowance[i] > 0; });
+        if (last == order.rend()) {
+            LOGW("Prompt is %d tokens over budget with every optional segment dropped", over);
+            return false;
+        }
+        const size_t i = *last;
+        allowance[i] -= over;
+        if (allowance[i] < std::max(segments[i].min_tokens, 1)) {
+            allowance[i] = 0;
+        }
+        parts[i] = cut_segment(model, segments[i], tokens[i], allowance[i]);
+    }
+
+    out.n_tokens = (int) scratch.size();
+    out.kept_tokens = allowance;
+    return true;
+}
+
+} // namespace smith
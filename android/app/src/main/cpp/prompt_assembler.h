@@ -0,0 +1,55 @@
+/**
+ * prompt_assembler.h - Fit prioritized prompt segments into a token budget
+ * Guild of Smiths - Offline AI Module
+ *
+ * Prompts are built from parts of very different value: chat template
+ * markers and the user's question must survive whole, while the context
+ * summary or the tool list can be shortened or left out. The assembler
+ * counts every part with the model's own tokenizer and keeps the joined
+ * prompt within a budget (context size less the tokens to generate):
+ *
+ *   1. required segments are kept whole;
+ *   2. in priority order, every other segment gets its minimum, or is
+ *      dropped if even that does not fit;
+ *   3. in priority order again, each grows toward its full length or
+ *      its maximum.
+ *
+ * Cuts fall on token boundaries, and never inside a "<|...|>" marker or
+ * a UTF-8 character. Segments tokenize a little differently alone and
+ * joined, so the joined prompt is counted again and the lowest-priority
+ * segment shrinks until the exact count fits.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "llama.h"
+
+namespace smith {
+
+struct PromptSegment {
+    std::string text;
+    int priority = 0;        // higher keeps its tokens longer
+    int min_tokens = 0;      // shortest useful cut; below it the segment is dropped
+    int max_tokens = 0;      // cap even when there is room; 0 for none
+    bool required = false;   // template markers and the query: never cut or dropped
+    bool keep_tail = false;  // cut from the front, keeping the most recent text
+};
+
+struct AssembledPrompt {
+    std::string text;
+    int n_tokens = 0;               // exact, as Generation::start tokenizes it
+    std::vector<int> kept_tokens;   // per segment, counted alone; 0 if dropped
+};
+
+/**
+ * Join segments, in their order, into at most budget tokens. Only needs
+ * the vocabulary, so model may be loaded with vocab_only.
+ * @return false if the required segments alone do not fit, or tokenizing fails
+ */
+bool assemble_prompt(const llama_model* model, const std::vector<PromptSegment>& segments,
+                     int budget, AssembledPrompt& out);
+
+} // namespace smith
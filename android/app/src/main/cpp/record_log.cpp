@@ -0,0 +1,322 @@
+/**
+ * record_log.cpp - Append-only keyed record store
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "RecordLog"
+
+#include "record_log.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smith {
+
+static const char LOG_MAGIC[4] = { 'S', 'R', 'L', '1' };
+static const size_t HEADER_SIZE = 4;
+static const size_t RECORD_HEADER = 8;   // body_len + checksum
+static const uint8_t OP_PUT = 1;
+static const uint8_t OP_REMOVE = 2;
+
+// Superseded bytes tolerated before a rewrite, so small stores never compact
+static const size_t COMPACT_MIN_DEAD = 64 * 1024;
+
+static uint32_t checksum(const uint8_t* data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void append_le32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out += (char) ((v >> (8 * i)) & 0xFF);
+}
+
+static void encode_record(std::string& out, uint8_t op, const std::string& key,
+                          const char* value, size_t value_len) {
+    std::string body;
+    body.reserve(3 + key.size() + value_len);
+    body += (char) op;
+    body += (char) (key.size() & 0xFF);
+    body += (char) (key.size() >> 8);
+    body += key;
+    body.append(value, value_len);
+    append_le32(out, (uint32_t) body.size());
+    append_le32(out, checksum(reinterpret_cast<const uint8_t*>(body.data()), body.size()));
+    out += body;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// FILE
+// ════════════════════════════════════════════════════════════════════
+
+RecordLog::RecordLog(const std::string& path)
+    : path_(path) {
+    if (!load()) {
+        reset_file();
+    }
+}
+
+RecordLog::~RecordLog() {
+    remap(0);
+}
+
+bool RecordLog::remap(size_t size) {
+    if (map_ != nullptr) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    map_size_ = 0;
+    if (size == 0) {
+        return true;
+    }
+    const int fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("Cannot map %s", path_.c_str());
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+    map_size_ = size;
+    return true;
+}
+
+bool RecordLog::reset_file() {
+    remap(0);
+    slots_.clear();
+    live_bytes_ = 0;
+    FILE* f = fopen(path_.c_str(), "wb");
+    if (f == nullptr) {
+        LOGE("Cannot create %s", path_.c_str());
+        return false;
+    }
+    bool ok = fwrite(LOG_MAGIC, 1, 4, f) == 4;
+    ok = fclose(f) == 0 && ok;
+    return ok && remap(HEADER_SIZE);
+}
+
+bool RecordLog::load() {
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0 || (size_t) st.st_size < HEADER_SIZE) {
+        return false;
+    }
+    if (!remap((size_t) st.st_size) || memcmp(map_, LOG_MAGIC, 4) != 0) {
+        LOGI("Starting %s over (format changed)", path_.c_str());
+        return false;
+    }
+
+    size_t off = HEADER_SIZE;
+    while (off + RECORD_HEADER <= map_size_) {
+        const uint32_t body_len = read_le32(map_ + off);
+        if (body_len > map_size_ - off - RECORD_HEADER ||
+            checksum(map_ + off + RECORD_HEADER, body_len) != read_le32(map_ + off + 4) ||
+            !apply_record(off, body_len)) {
+            break;
+        }
+        off += RECORD_HEADER + body_len;
+    }
+
+    if (off != map_size_) {
+        LOGW("Dropping %zu bytes of torn records from %s", map_size_ - off, path_.c_str());
+        remap(0);
+        if (truncate(path_.c_str(), (off_t) off) != 0 || !remap(off)) {
+            return false;
+        }
+    }
+    maybe_compact();
+    LOGI("Loaded %zu records from %s", slots_.size(), path_.c_str());
+    return true;
+}
+
+bool RecordLog::apply_record(size_t off, size_t body_len) {
+    const uint8_t* body = map_ + off + RECORD_HEADER;
+    if (body_len < 3) return false;
+    const uint8_t op = body[0];
+    const size_t key_len = (size_t) body[1] | ((size_t) body[2] << 8);
+    if (key_len == 0 || 3 + key_len > body_len) return false;
+    std::string key(reinterpret_cast<const char*>(body + 3), key_len);
+    const size_t record_len = RECORD_HEADER + body_len;
+
+    auto it = slots_.find(key);
+    if (op == OP_PUT) {
+        Slot slot;
+        slot.seq = it != slots_.end() ? it->second.seq : next_seq_++;
+        slot.value_off = off + RECORD_HEADER + 3 + key_len;
+        slot.value_len = body_len - 3 - key_len;
+        slot.record_len = record_len;
+        if (it != slots_.end()) {
+            live_bytes_ -= it->second.record_len;
+            it->second = slot;
+        } else {
+            slots_.emplace(std::move(key), slot);
+        }
+        live_bytes_ += record_len;
+        return true;
+    }
+    if (op == OP_REMOVE) {
+        if (it != slots_.end()) {
+            live_bytes_ -= it->second.record_len;
+            slots_.erase(it);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool RecordLog::append(const std::string& records) {
+    const size_t old_size = map_size_;
+    FILE* f = fopen(path_.c_str(), "ab");
+    bool ok = f != nullptr && fwrite(records.data(), 1, records.size(), f) == records.size();
+    if (f != nullptr) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        LOGE("Append to %s failed", path_.c_str());
+        // A partial record would be cut off on the next open; cut it now
+        if (truncate(path_.c_str(), (off_t) old_size) != 0) {
+            LOGE("Cannot trim %s", path_.c_str());
+        }
+        return false;
+    }
+    if (!remap(old_size + records.size())) {
+        return false;
+    }
+    for (size_t off = old_size; off < map_size_;) {
+        const uint32_t body_len = read_le32(map_ + off);
+        apply_record(off, body_len);
+        off += RECORD_HEADER + body_len;
+    }
+    maybe_compact();
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// COMPACTION
+// ════════════════════════════════════════════════════════════════════
+
+void RecordLog::maybe_compact() {
+    const size_t dead = map_size_ - HEADER_SIZE - live_bytes_;
+    if (dead >= COMPACT_MIN_DEAD && dead > live_bytes_) {
+        compact_locked();
+    }
+}
+
+bool RecordLog::compact_locked() {
+    std::vector<std::pair<uint64_t, const std::string*>> order;
+    order.reserve(slots_.size());
+    for (const auto& entry : slots_) {
+        order.emplace_back(entry.second.seq, &entry.first);
+    }
+    std::sort(order.begin(), order.end());
+
+    std::string data(LOG_MAGIC, 4);
+    data.reserve(HEADER_SIZE + live_bytes_);
+    for (const auto& item : order) {
+        const Slot& slot = slots_.at(*item.second);
+        encode_record(data, OP_PUT, *item.second,
+                      reinterpret_cast<const char*>(map_ + slot.value_off), slot.value_len);
+    }
+
+    // Write aside and rename, so a crash leaves either the old or the new file
+    const std::string tmp = path_ + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    bool ok = f != nullptr && fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (f != nullptr) {
+        ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok || rename(tmp.c_str(), path_.c_str()) != 0) {
+        LOGE("Compaction of %s failed", path_.c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    const size_t before = map_size_;
+    slots_.clear();
+    live_bytes_ = 0;
+    if (!remap(data.size())) {
+        return false;
+    }
+    for (size_t off = HEADER_SIZE; off < map_size_;) {
+        const uint32_t body_len = read_le32(map_ + off);
+        apply_record(off, body_len);
+        off += RECORD_HEADER + body_len;
+    }
+    LOGI("Compacted %s from %zu to %zu bytes", path_.c_str(), before, map_size_);
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// PUBLIC API
+// ════════════════════════════════════════════════════════════════════
+
+bool RecordLog::put(const std::string& key, const std::string& value) {
+    if (key.empty() || key.size() > 0xFFFF || value.size() > 0x7FFFFFFF) {
+        return false;
+    }
+    std::string record;
+    encode_record(record, OP_PUT, key, value.data(), value.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    return append(record);
+}
+
+bool RecordLog::remove(const std::vector<std::string>& keys) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string records;
+    for (const std::string& key : keys) {
+        if (slots_.count(key) != 0) {
+            encode_record(records, OP_REMOVE, key, nullptr, 0);
+        }
+    }
+    return records.empty() || append(records);
+}
+
+bool RecordLog::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reset_file();
+}
+
+std::vector<std::string> RecordLog::values() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const Slot*> order;
+    order.reserve(slots_.size());
+    for (const auto& entry : slots_) {
+        order.push_back(&entry.second);
+    }
+    std::sort(order.begin(), order.end(), [](const Slot* a, const Slot* b) { return a->seq < b->seq; });
+
+    std::vector<std::string> result;
+    result.reserve(order.size());
+    for (const Slot* slot : order) {
+        result.emplace_back(reinterpret_cast<const char*>(map_ + slot->value_off), slot->value_len);
+    }
+    return result;
+}
+
+size_t RecordLog::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slots_.size();
+}
+
+bool RecordLog::compact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compact_locked();
+}
+
+} // namespace smith
@@ -0,0 +1,90 @@
+/**
+ * record_log.h - Append-only keyed record store
+ * Guild of Smiths - Offline AI Module
+ *
+ * Persistence for small queues and caches that change one entry at a time
+ * (cached AI responses, the offline sync queue). Adding, replacing or
+ * removing an entry appends one record, so the cost of a write does not
+ * grow with the size of the store. Opening the store maps the file and
+ * indexes it in place; values are read straight from the mapping.
+ *
+ * File: magic "SRL1", then records
+ *   le32 body_len | le32 checksum | body
+ *   body: u8 op (1 put, 2 remove) | le16 key_len | key | value
+ * A torn or corrupt tail from a crash is cut off on open. Once superseded
+ * records outweigh live ones the file is rewritten with only the live
+ * entries and renamed over the old one.
+ *
+ * Thread-safe.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace smith {
+
+class RecordLog {
+public:
+    /** Open or create the store at path. */
+    explicit RecordLog(const std::string& path);
+    ~RecordLog();
+
+    RecordLog(const RecordLog&) = delete;
+    RecordLog& operator=(const RecordLog&) = delete;
+
+    /**
+     * Store value under key. Replacing a key keeps its place in values().
+     * @return false if the key is empty or too long, or the write failed
+     */
+    bool put(const std::string& key, const std::string& value);
+
+    /**
+     * Remove keys; keys not present are ignored.
+     * @return false if the write failed
+     */
+    bool remove(const std::vector<std::string>& keys);
+
+    /** Remove everything. */
+    bool clear();
+
+    /** Values in the order their keys were first stored. */
+    std::vector<std::string> values() const;
+
+    size_t size() const;
+
+    /** Rewrite the file with only live entries. */
+    bool compact();
+
+private:
+    struct Slot {
+        uint64_t seq;         // first insertion, for ordering
+        size_t value_off;     // in map_
+        size_t value_len;
+        size_t record_len;    // whole record, for compaction accounting
+    };
+
+    bool load();
+    bool reset_file();
+    bool remap(size_t size);
+    bool append(const std::string& records);
+    bool apply_record(size_t off, size_t body_len);
+    bool compact_locked();
+    void maybe_compact();
+
+    std::string path_;
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+
+    std::unordered_map<std::string, Slot> slots_;
+    uint64_t next_seq_ = 0;
+    size_t live_bytes_ = 0;
+    mutable std::mutex mutex_;
+};
+
+} // namespace smith
@@ -0,0 +1,100 @@
+/**
+ * smith_server.cpp - Local OpenAI-compatible inference server
+ * Guild of Smiths - Offline AI Module
+ *
+ * Runs the app's inference engine on a laptop or gateway box so the
+ * backend and other local tools can use it in place of a cloud vendor.
+ * Binds to loopback by default; pass --host 0.0.0.0 only on a trusted
+ * job-site network.
+ *
+ * Usage:
+ *   smith_server --model PATH [--ctx N] [--threads N] [--name ID]
+ *                [--host ADDR] [--port N | --socket PATH]
+ *                [--worker PATH] [--max-clients N]
+ */
+
+#define LOG_TAG "SmithServer"
+
+#include "../local_server.h"
+#include "../native_log.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static smith::LocalServer* g_server = nullptr;
+
+static void handle_signal(int) {
+    if (g_server != nullptr) {
+        g_server->stop();
+    }
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s --model PATH [--ctx N] [--threads N] [--name ID]\n"
+            "          [--host ADDR] [--port N | --socket PATH] [--worker PATH] [--max-clients N]\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    smith::ServerConfig config;
+    std::string model_path;
+    int n_ctx = 4096;
+    int n_threads = 4;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (strcmp(arg, "--model") == 0) {
+            model_path = value;
+        } else if (strcmp(arg, "--ctx") == 0) {
+            n_ctx = atoi(value);
+        } else if (strcmp(arg, "--threads") == 0) {
+            n_threads = atoi(value);
+        } else if (strcmp(arg, "--name") == 0) {
+            config.model_name = value;
+        } else if (strcmp(arg, "--host") == 0) {
+            config.host = value;
+        } else if (strcmp(arg, "--port") == 0) {
+            config.port = atoi(value);
+        } else if (strcmp(arg, "--socket") == 0) {
+            config.unix_path = value;
+        } else if (strcmp(arg, "--worker") == 0) {
+            config.worker_path = value;
+        } else if (strcmp(arg, "--max-clients") == 0) {
+            config.max_clients = atoi(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (model_path.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    llama_backend_init();
+    smith::LocalServer server(config);
+    if (!server.load_model(model_path, n_ctx, n_threads)) {
+        LOGE("Cannot load %s", model_path.c_str());
+        return 1;
+    }
+
+    g_server = &server;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    const int status = server.run();
+    g_server = nullptr;
+    return status;
+}
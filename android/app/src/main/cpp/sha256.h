@@ -0,0 +1,48 @@
+/**
+ * sha256.h - SHA-256 with ARMv8 crypto extension acceleration
+ * Guild of Smiths - Offline AI Module
+ *
+ * Uses the SHA2 instructions when the CPU reports them (HWCAP_SHA2) and a
+ * portable implementation otherwise.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace smith {
+
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t digest[32]);
+
+    /** One-shot digest. */
+    static void hash(const uint8_t* data, size_t len, uint8_t digest[32]);
+
+    /** True if the hardware path is in use on this CPU. */
+    static bool hardware_accelerated();
+
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t buffered_ = 0;
+    uint64_t total_ = 0;
+};
+
+/** Lowercase hex of a 32-byte digest. */
+std::string digest_hex(const uint8_t digest[32]);
+
+namespace detail {
+// Process whole 64-byte blocks; len must be a multiple of 64
+void sha256_blocks_portable(uint32_t state[8], const uint8_t* data, size_t len);
+#if defined(__aarch64__)
+void sha256_blocks_arm(uint32_t state[8], const uint8_t* data, size_t len);
+#endif
+} // namespace detail
+
+} // namespace smith
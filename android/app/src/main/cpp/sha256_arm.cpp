@@ -0,0 +1,58 @@
+/**
+ * sha256_arm.cpp - SHA-256 block function using the ARMv8 SHA2 instructions
+ * Guild of Smiths - Offline AI Module
+ *
+ * Built with -march=armv8-a+crypto on arm64 only and called only when the
+ * CPU reports HWCAP_SHA2 (see sha256.cpp).
+ */
+
+#include "sha256.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+namespace smith {
+namespace detail {
+
+extern const uint32_t SHA256_K[64];
+
+void sha256_blocks_arm(uint32_t state[8], const uint8_t* data, size_t len) {
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    for (; len >= 64; data += 64, len -= 64) {
+        const uint32x4_t abcd_save = abcd;
+        const uint32x4_t efgh_save = efgh;
+
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+
+        // 16 groups of 4 rounds; msg[i & 3] holds W[4i..4i+3] until it is
+        // replaced with W[4i+16..4i+19] for the group 4 steps later
+        for (int i = 0; i < 16; i++) {
+            const uint32x4_t wk = vaddq_u32(msg[i & 3], vld1q_u32(&SHA256_K[4 * i]));
+            const uint32x4_t abcd_prev = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, abcd_prev, wk);
+            if (i < 12) {
+                msg[i & 3] = vsha256su1q_u32(
+                    vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]),
+                    msg[(i + 2) & 3], msg[(i + 3) & 3]);
+            }
+        }
+
+        abcd = vaddq_u32(abcd, abcd_save);
+        efgh = vaddq_u32(efgh, efgh_save);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+} // namespace detail
+} // namespace smith
+
+#endif
@@ -0,0 +1,746 @@
+/**
+ * smith_native_jni.cpp - JNI bridge for the lightweight native utilities
+ * Guild of Smiths - Offline AI Module
+ *
+ * libsmith_native.so holds native helpers that do not need llama.cpp
+ * (model verification, header metadata, embedding index, mesh compression,
+ * text scanning and chunking, language identification, translation
+ * memory, record logs, ...). It is small and cheap to load, unlike
+ * libllama_jni.so, so callers outside the LLM path can use it freely.
+ */
+
+#define LOG_TAG "SmithNative"
+
+#include <jni.h>
+#include <string>
+#include <vector>
+
+#include "json_util.h"
+#include "lang_id.h"
+#include "mesh_codec.h"
+#include "model_metadata.h"
+#include "model_verifier.h"
+#include "native_log.h"
+#include "record_log.h"
+#include "text_chunker.h"
+#include "text_scanner.h"
+#include "translation_memory.h"
+#include "vector_index.h"
+
+extern "C" {
+
+/**
+ * Verify a downloaded GGUF file (structure, tensor bounds, SHA-256).
+ *
+ * @param path Model file
+ * @param expectedDigest SHA-256 hex to require, or empty string
+ * @return JSON {"ok","cached","digest","error","file_size","n_tensors","elapsed_us"}
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_ModelVerifier_nativeVerify(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path,
+    jstring expectedDigest
+) {
+    const char* path_cstr = env->GetStringUTFChars(path, nullptr);
+    const char* expected_cstr = env->GetStringUTFChars(expectedDigest, nullptr);
+    
+    smith::VerifyResult r = smith::verify_model(path_cstr, expected_cstr, true);
+    
+    env->ReleaseStringUTFChars(path, path_cstr);
+    env->ReleaseStringUTFChars(expectedDigest, expected_cstr);
+    
+    std::string json = "{\"ok\":";
+    json += r.ok ? "true" : "false";
+    json += ",\"cached\":";
+    json += r.cached ? "true" : "false";
+    json += ",\"digest\":";
+    smith::json_append_string(json, r.digest);
+    json += ",\"error\":";
+    smith::json_append_string(json, r.error);
+    json += ",\"file_size\":" + std::to_string(r.file_size);
+    json += ",\"n_tensors\":" + std::to_string(r.n_tensors);
+    json += ",\"elapsed_us\":" + std::to_string(r.elapsed_us);
+    json += "}";
+    return env->NewStringUTF(json.c_str());
+}
+
+/**
+ * Read model details from the GGUF header without loading weights.
+ *
+ * @param path Model file
+ * @return JSON {"ok","error","architecture","name","file_type","context_length",
+ *         "embedding_length","block_count","head_count","head_count_kv","vocab_size",
+ *         "chat_template","file_size","n_tensors","n_params","tensor_bytes",
+ *         "kv_bytes_per_token","dominant_type","types":[{"type","n_tensors","bytes"}],
+ *         "elapsed_us"}
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_GgufMetadata_nativeReadMetadata(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path
+) {
+    const char* path_cstr = env->GetStringUTFChars(path, nullptr);
+    smith::ModelMetadata m = smith::read_model_metadata(path_cstr);
+    env->ReleaseStringUTFChars(path, path_cstr);
+    
+    std::string json = "{\"ok\":";
+    json += m.ok ? "true" : "false";
+    json += ",\"error\":";
+    smith::json_append_string(json, m.error);
+    json += ",\"gguf_version\":" + std::to_string(m.gguf_version);
+    json += ",\"architecture\":";
+    smith::json_append_string(json, m.architecture);
+    json += ",\"name\":";
+    smith::json_append_string(json, m.name);
+    json += ",\"file_type\":" + std::to_string(m.file_type);
+    json += ",\"context_length\":" + std::to_string(m.context_length);
+    json += ",\"embedding_length\":" + std::to_string(m.embedding_length);
+    json += ",\"block_count\":" + std::to_string(m.block_count);
+    json += ",\"head_count\":" + std::to_string(m.head_count);
+    json += ",\"head_count_kv\":" + std::to_string(m.head_count_kv);
+    json += ",\"vocab_size\":" + std::to_string(m.vocab_size);
+    json += ",\"chat_template\":";
+    smith::json_append_string(json, m.chat_template);
+    json += ",\"file_size\":" + std::to_string(m.file_size);
+    json += ",\"n_tensors\":" + std::to_string(m.n_tensors);
+    json += ",\"n_params\":" + std::to_string(m.n_params);
+    json += ",\"tensor_bytes\":" + std::to_string(m.tensor_bytes);
+    json += ",\"kv_bytes_per_token\":" + std::to_string(m.kv_bytes_per_token);
+    json += ",\"dominant_type\":";
+    smith::json_append_string(json, m.dominant_type);
+    json += ",\"types\":[";
+    for (size_t i = 0; i < m.types.size(); i++) {
+        if (i > 0) json += ",";
+        json += "{\"type\":";
+        smith::json_append_string(json, m.types[i].type);
+        json += ",\"n_tensors\":" + std::to_string(m.types[i].n_tensors);
+        json += ",\"bytes\":" + std::to_string(m.types[i].nbytes);
+        json += "}";
+    }
+    json += "],\"elapsed_us\":" + std::to_string(m.elapsed_us);
+    json += "}";
+    return env->NewStringUTF(json.c_str());
+}
+
+// ════════════════════════════════════════════════════════════════════
+// EMBEDDING INDEX
+// ════════════════════════════════════════════════════════════════════
+
+static smith::VectorIndex* to_index(jlong handle) {
+    return reinterpret_cast<smith::VectorIndex*>(handle);
+}
+
+/**
+ * Open (or create) a vector index file.
+ *
+ * @param path Index file
+ * @param dim Vector dimension
+ * @param fingerprint Embedding model id; a file of another dimension or fingerprint is started over
+ * @return Handle for the other calls, released with nativeClose
+ */
+JNIEXPORT jlong JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeOpen(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jstring path,
+    jint dim,
+    jlong fingerprint
+) {
+    const char* path_cstr = env->GetStringUTFChars(path, nullptr);
+    smith::VectorIndex* index = new smith::VectorIndex(path_cstr, dim, (uint64_t) fingerprint);
+    env->ReleaseStringUTFChars(path, path_cstr);
+    return reinterpret_cast<jlong>(index);
+}
+
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeClose(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    delete to_index(handle);
+}
+
+/**
+ * Append vectors; ids already present are skipped.
+ *
+ * @param ids One id per vector
+ * @param vectors ids.length * dim floats, one row per id
+ * @return Number added, or -1 on a write error
+ */
+JNIEXPORT jint JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeAdd(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jobjectArray ids,
+    jfloatArray vectors
+) {
+    smith::VectorIndex* index = to_index(handle);
+    const jsize n = env->GetArrayLength(ids);
+    if ((jlong) env->GetArrayLength(vectors) != (jlong) n * index->dim()) {
+        LOGE("Vector array does not match %d ids of dim %d", (int) n, index->dim());
+        return -1;
+    }
+
+    std::vector<std::string> id_list(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring id = static_cast<jstring>(env->GetObjectArrayElement(ids, i));
+        const char* id_cstr = env->GetStringUTFChars(id, nullptr);
+        id_list[i] = id_cstr;
+        env->ReleaseStringUTFChars(id, id_cstr);
+        env->DeleteLocalRef(id);
+    }
+    std::vector<float> data((size_t) n * index->dim());
+    env->GetFloatArrayRegion(vectors, 0, (jsize) data.size(), data.data());
+    return index->add(id_list, data.data());
+}
+
+/**
+ * Top-k ids by cosine similarity to query.
+ *
+ * @return JSON {"ids":[str],"scores":[float]}, best first
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeSearch(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jfloatArray query,
+    jint k
+) {
+    smith::VectorIndex* index = to_index(handle);
+    if (env->GetArrayLength(query) != index->dim()) {
+        return env->NewStringUTF("{\"ids\":[],\"scores\":[]}");
+    }
+    std::vector<float> q(index->dim());
+    env->GetFloatArrayRegion(query, 0, index->dim(), q.data());
+    std::vector<std::pair<std::string, float>> hits = index->search(q.data(), k);
+
+    std::string json = "{\"ids\":[";
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (i > 0) json += ",";
+        smith::json_append_string(json, hits[i].first);
+    }
+    json += "],\"scores\":[";
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (i > 0) json += ",";
+        char score[32];
+        snprintf(score, sizeof(score), "%.5f", hits[i].second);
+        json += score;
+    }
+    json += "]}";
+    return env->NewStringUTF(json.c_str());
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeContains(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jstring id
+) {
+    const char* id_cstr = env->GetStringUTFChars(id, nullptr);
+    const bool found = to_index(handle)->contains(id_cstr);
+    env->ReleaseStringUTFChars(id, id_cstr);
+    return found ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_guildofsmiths_trademesh_ai_EmbeddingIndex_nativeSize(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    return (jint) to_index(handle)->size();
+}
+
+// ════════════════════════════════════════════════════════════════════
+// MESH CODEC
+// ════════════════════════════════════════════════════════════════════
+
+static std::string to_bytes(JNIEnv* env, jbyteArray array) {
+    const jsize n = env->GetArrayLength(array);
+    std::string bytes((size_t) n, '\0');
+    env->GetByteArrayRegion(array, 0, n, reinterpret_cast<jbyte*>(&bytes[0]));
+    return bytes;
+}
+
+static jbyteArray new_byte_array(JNIEnv* env, const uint8_t* data, size_t size) {
+    jbyteArray array = env->NewByteArray((jsize) size);
+    if (array != nullptr) {
+        env->SetByteArrayRegion(array, 0, (jsize) size, reinterpret_cast<const jbyte*>(data));
+    }
+    return array;
+}
+
+/**
+ * Compress messages with the static trade dictionary.
+ *
+ * @param texts UTF-8 text of each message
+ * @param maxBytes Largest useful frame; 0 for no limit
+ * @return One frame per message, null where it would not fit
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_guildofsmiths_trademesh_service_MeshCodec_nativeEncodeBatch(
+    JNIEnv* env,
+    jobject /* this */,
+    jobjectArray texts,
+    jint maxBytes
+) {
+    jclass byte_array_class = env->FindClass("[B");
+    const jsize n = env->GetArrayLength(texts);
+    jobjectArray result = env->NewObjectArray(n, byte_array_class, nullptr);
+    env->DeleteLocalRef(byte_array_class);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> frame;
+    for (jsize i = 0; i < n; i++) {
+        jbyteArray text = static_cast<jbyteArray>(env->GetObjectArrayElement(texts, i));
+        if (text != nullptr &&
+            smith::mesh_encode(to_bytes(env, text), maxBytes > 0 ? (size_t) maxBytes : 0, frame)) {
+            jbyteArray out = new_byte_array(env, frame.data(), frame.size());
+            env->SetObjectArrayElement(result, i, out);
+            env->DeleteLocalRef(out);
+        }
+        env->DeleteLocalRef(text);
+    }
+    return result;
+}
+
+/**
+ * Expand frames made by nativeEncodeBatch.
+ *
+ * @param frames Received content bytes
+ * @return UTF-8 text per frame, null where it is not a valid frame
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_guildofsmiths_trademesh_service_MeshCodec_nativeDecodeBatch(
+    JNIEnv* env,
+    jobject /* this */,
+    jobjectArray frames
+) {
+    jclass byte_array_class = env->FindClass("[B");
+    const jsize n = env->GetArrayLength(frames);
+    jobjectArray result = env->NewObjectArray(n, byte_array_class, nullptr);
+    env->DeleteLocalRef(byte_array_class);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    std::string text;
+    for (jsize i = 0; i < n; i++) {
+        jbyteArray frame = static_cast<jbyteArray>(env->GetObjectArrayElement(frames, i));
+        if (frame != nullptr) {
+            const std::string bytes = to_bytes(env, frame);
+            if (smith::mesh_decode(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), text)) {
+                jbyteArray out = new_byte_array(env, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+                env->SetObjectArrayElement(result, i, out);
+                env->DeleteLocalRef(out);
+            }
+        }
+        env->DeleteLocalRef(frame);
+    }
+    return result;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// TEXT SCANNER
+// ════════════════════════════════════════════════════════════════════
+
+static smith::TextScanner* to_scanner(jlong handle) {
+    return reinterpret_cast<smith::TextScanner*>(handle);
+}
+
+/**
+ * Compile patterns into one automaton.
+ *
+ * @param patterns UTF-8 bytes of each pattern
+ * @return Handle for nativeScanBatch, released with nativeRelease
+ */
+JNIEXPORT jlong JNICALL
+Java_com_guildofsmiths_trademesh_ai_TextScanner_nativeCompile(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jobjectArray patterns
+) {
+    const jsize n = env->GetArrayLength(patterns);
+    std::vector<std::string> list(n);
+    for (jsize i = 0; i < n; i++) {
+        jbyteArray pattern = static_cast<jbyteArray>(env->GetObjectArrayElement(patterns, i));
+        if (pattern != nullptr) {
+            list[i] = to_bytes(env, pattern);
+        }
+        env->DeleteLocalRef(pattern);
+    }
+    smith::TextScanner* scanner = new smith::TextScanner(list);
+    LOGI("Compiled %d patterns into %zu states", (int) n, scanner->state_count());
+    return reinterpret_cast<jlong>(scanner);
+}
+
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_TextScanner_nativeRelease(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    delete to_scanner(handle);
+}
+
+/**
+ * Scan many texts with one call.
+ *
+ * @param texts UTF-8 bytes of each text
+ * @return Per text, the index of the pattern behind each match, in text order
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_TextScanner_nativeScanBatch(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jobjectArray texts
+) {
+    const smith::TextScanner* scanner = to_scanner(handle);
+    jclass int_array_class = env->FindClass("[I");
+    const jsize n = env->GetArrayLength(texts);
+    jobjectArray result = env->NewObjectArray(n, int_array_class, nullptr);
+    env->DeleteLocalRef(int_array_class);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    std::vector<smith::ScanMatch> matches;
+    std::vector<jint> ids;
+    for (jsize i = 0; i < n; i++) {
+        jbyteArray text = static_cast<jbyteArray>(env->GetObjectArrayElement(texts, i));
+        matches.clear();
+        if (text != nullptr) {
+            const jsize size = env->GetArrayLength(text);
+            jbyte* bytes = static_cast<jbyte*>(env->GetPrimitiveArrayCritical(text, nullptr));
+            if (bytes != nullptr) {
+                scanner->scan(reinterpret_cast<const uint8_t*>(bytes), (size_t) size, matches);
+                env->ReleasePrimitiveArrayCritical(text, bytes, JNI_ABORT);
+            }
+        }
+        env->DeleteLocalRef(text);
+
+        ids.resize(matches.size());
+        for (size_t k = 0; k < matches.size(); k++) {
+            ids[k] = (jint) matches[k].pattern;
+        }
+        jintArray out = env->NewIntArray((jsize) ids.size());
+        if (out == nullptr) {
+            return nullptr;
+        }
+        env->SetIntArrayRegion(out, 0, (jsize) ids.size(), ids.data());
+        env->SetObjectArrayElement(result, i, out);
+        env->DeleteLocalRef(out);
+    }
+    return result;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// TEXT CHUNKING
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * Split a document into chunks for embedding and retrieval.
+ *
+ * @param text UTF-8 bytes
+ * @param targetBytes Approximate chunk size
+ * @param overlapBytes Text shared by consecutive chunks of a section, at most
+ * @return UTF-8 bytes of each chunk in document order, or null if out of memory
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_TextChunker_nativeChunk(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray text,
+    jint targetBytes,
+    jint overlapBytes
+) {
+    const std::string bytes = to_bytes(env, text);
+    smith::ChunkOptions options;
+    options.target_bytes = targetBytes > 0 ? (size_t) targetBytes : options.target_bytes;
+    options.overlap_bytes = overlapBytes > 0 ? (size_t) overlapBytes : 0;
+    const std::vector<std::string> chunks = smith::chunk_text(bytes.data(), bytes.size(), options);
+
+    jclass byte_array_class = env->FindClass("[B");
+    jobjectArray result = env->NewObjectArray((jsize) chunks.size(), byte_array_class, nullptr);
+    env->DeleteLocalRef(byte_array_class);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        jbyteArray chunk = new_byte_array(env, reinterpret_cast<const uint8_t*>(chunks[i].data()),
+                                          chunks[i].size());
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+        env->SetObjectArrayElement(result, (jsize) i, chunk);
+        env->DeleteLocalRef(chunk);
+    }
+    return result;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// LANGUAGE IDENTIFICATION
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * Most likely languages of a message.
+ *
+ * @param text UTF-8 bytes
+ * @param topK Guesses to return
+ * @return JSON {"langs":[str],"scores":[float]}, best first; empty if the text has no letters
+ */
+JNIEXPORT jstring JNICALL
+Java_com_guildofsmiths_trademesh_ai_LanguageId_nativeIdentify(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray text,
+    jint topK
+) {
+    const std::string bytes = to_bytes(env, text);
+    const std::vector<smith::LangGuess> guesses =
+        smith::identify_language(bytes.data(), bytes.size(), topK > 0 ? (size_t) topK : 1);
+
+    std::string json = "{\"langs\":[";
+    for (size_t i = 0; i < guesses.size(); i++) {
+        if (i > 0) json += ",";
+        smith::json_append_string(json, guesses[i].lang);
+    }
+    json += "],\"scores\":[";
+    for (size_t i = 0; i < guesses.size(); i++) {
+        if (i > 0) json += ",";
+        char score[32];
+        snprintf(score, sizeof(score), "%.4f", guesses[i].confidence);
+        json += score;
+    }
+    json += "]}";
+    return env->NewStringUTF(json.c_str());
+}
+
+// ════════════════════════════════════════════════════════════════════
+// TRANSLATION MEMORY
+// ════════════════════════════════════════════════════════════════════
+
+static smith::TranslationMemory* to_memory(jlong handle) {
+    return reinterpret_cast<smith::TranslationMemory*>(handle);
+}
+
+static std::string to_string(JNIEnv* env, jstring s) {
+    const char* cstr = env->GetStringUTFChars(s, nullptr);
+    std::string result(cstr);
+    env->ReleaseStringUTFChars(s, cstr);
+    return result;
+}
+
+/**
+ * Open (or create) a translation memory file.
+ *
+ * @return Handle for the other calls, released with nativeClose
+ */
+JNIEXPORT jlong JNICALL
+Java_com_guildofsmiths_trademesh_ai_TranslationMemory_nativeOpen(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jstring path
+) {
+    return reinterpret_cast<jlong>(new smith::TranslationMemory(to_string(env, path)));
+}
+
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_TranslationMemory_nativeClose(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    delete to_memory(handle);
+}
+
+/**
+ * Stored translation of a segment, exact or near.
+ *
+ * @param text UTF-8 bytes of the source segment
+ * @param minSimilarity Near hits below this are misses
+ * @return UTF-8 JSON {"found","exact","similarity","source","translation"}
+ *         (bytes, since translations may hold characters NewStringUTF rejects)
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_TranslationMemory_nativeLookup(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jstring sourceLang,
+    jstring targetLang,
+    jbyteArray text,
+    jfloat minSimilarity
+) {
+    const smith::TranslationHit hit = to_memory(handle)->lookup(
+        to_string(env, sourceLang), to_string(env, targetLang), to_bytes(env, text), minSimilarity);
+
+    char similarity[32];
+    snprintf(similarity, sizeof(similarity), "%.4f", hit.similarity);
+    std::string json = "{\"found\":";
+    json += hit.found ? "true" : "false";
+    json += ",\"exact\":";
+    json += hit.exact ? "true" : "false";
+    json += ",\"similarity\":";
+    json += similarity;
+    json += ",\"source\":";
+    smith::json_append_string(json, hit.source);
+    json += ",\"translation\":";
+    smith::json_append_string(json, hit.translation);
+    json += "}";
+    return new_byte_array(env, reinterpret_cast<const uint8_t*>(json.data()), json.size());
+}
+
+/**
+ * Store the translation of a segment, replacing an older one.
+ *
+ * @return false if the segment is empty or too long, or the write failed
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_TranslationMemory_nativePut(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jstring sourceLang,
+    jstring targetLang,
+    jbyteArray text,
+    jbyteArray translation
+) {
+    const bool ok = to_memory(handle)->put(to_string(env, sourceLang), to_string(env, targetLang),
+                                           to_bytes(env, text), to_bytes(env, translation));
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_guildofsmiths_trademesh_ai_TranslationMemory_nativeSize(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    return (jint) to_memory(handle)->size();
+}
+
+// ════════════════════════════════════════════════════════════════════
+// RECORD LOG
+// ════════════════════════════════════════════════════════════════════
+
+static smith::RecordLog* to_log(jlong handle) {
+    return reinterpret_cast<smith::RecordLog*>(handle);
+}
+
+/**
+ * Open (or create) an append-only record store.
+ *
+ * @return Handle for the other calls, released with nativeClose
+ */
+JNIEXPORT jlong JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeOpen(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jstring path
+) {
+    return reinterpret_cast<jlong>(new smith::RecordLog(to_string(env, path)));
+}
+
+JNIEXPORT void JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeClose(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    delete to_log(handle);
+}
+
+/**
+ * Store value under key, replacing an older value in place.
+ *
+ * @return false if the key is empty or too long, or the write failed
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativePut(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jstring key,
+    jbyteArray value
+) {
+    return to_log(handle)->put(to_string(env, key), to_bytes(env, value)) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Remove keys in one write; absent keys are ignored.
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeRemove(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle,
+    jobjectArray keys
+) {
+    const jsize n = env->GetArrayLength(keys);
+    std::vector<std::string> key_list(n);
+    for (jsize i = 0; i < n; i++) {
+        jstring key = static_cast<jstring>(env->GetObjectArrayElement(keys, i));
+        key_list[i] = to_string(env, key);
+        env->DeleteLocalRef(key);
+    }
+    return to_log(handle)->remove(key_list) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeClear(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    return to_log(handle)->clear() ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * All values, in the order their keys were first stored.
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeValues(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    const std::vector<std::string> values = to_log(handle)->values();
+    jclass byte_array_class = env->FindClass("[B");
+    jobjectArray result = env->NewObjectArray((jsize) values.size(), byte_array_class, nullptr);
+    env->DeleteLocalRef(byte_array_class);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < values.size(); i++) {
+        jbyteArray value = new_byte_array(
+            env, reinterpret_cast<const uint8_t*>(values[i].data()), values[i].size());
+        if (value == nullptr) {
+            return nullptr;
+        }
+        env->SetObjectArrayElement(result, (jsize) i, value);
+        env->DeleteLocalRef(value);
+    }
+    return result;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_guildofsmiths_trademesh_ai_RecordLog_nativeSize(
+    JNIEnv* env,
+    jclass /* clazz */,
+    jlong handle
+) {
+    return (jint) to_log(handle)->size();
+}
+
+} // extern "C"
@@ -0,0 +1,416 @@
+/**
+ * inference_regression.cpp - Output and throughput regression checks for the inference core
+ * Guild of Smiths - Offline AI Module
+ *
+ * Writes tiny synthetic GGUF models, then runs the same prompts down every
+ * path that must not change what a greedy decode produces:
+ *   plain      - one Generation per prompt (the reference output)
+ *   prefix     - prompt head restored from a warmed PrefixCache
+ *   preempt    - suspended mid-decode while another prompt runs, then resumed
+ *   checkpoint - saved mid-decode and finished by a new Generation
+ *   batch      - all prompts as parallel sequences of one BatchGeneration
+ * Every path has to reproduce the reference tokens exactly, and every path
+ * has a throughput floor. The default floors are low enough for a
+ * sanitizer build on a shared CI runner; pass --floor to hold a release
+ * build to real numbers.
+ *
+ * Usage:
+ *   inference_regression [--dir DIR] [--threads N] [--tokens N]
+ *                        [--floor PATH=TOK_PER_S]...
+ * Exits 0 when every check passes, 1 on any mismatch or missed floor.
+ */
+
+#define LOG_TAG "InferenceRegression"
+
+#include "../batch_generate.h"
+#include "../checkpoint.h"
+#include "../inference_core.h"
+#include "../native_log.h"
+#include "../prefix_cache.h"
+#include "../bench/synthetic_model.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llama.h"
+#include "common.h"
+
+// Shared system prompt so the prefix cache and batch prefix sharing have work to do
+static const char* const SYSTEM_PROMPT =
+    "<|im_start|>system\nYou are Smith, a helpful AI assistant for construction and trade workers. "
+    "Keep responses brief, practical, and professional.<|im_end|>\n";
+
+static const char* const USER_MESSAGES[] = {
+    "where is the ladder",
+    "make a checklist for the breaker panel inspection",
+    "need more conduit and wire on site by noon",
+    "clock out crew for lunch, back at 1",
+};
+
+static const int N_PROMPTS = (int) (sizeof(USER_MESSAGES) / sizeof(USER_MESSAGES[0]));
+
+// One Q4_K model like q4_k_m files, one f32 with grouped KV heads
+struct ModelCase {
+    const char* name;
+    smith::SyntheticModelConfig config;
+};
+
+static std::vector<ModelCase> model_cases() {
+    ModelCase q4k = { "q4_k", smith::SyntheticModelConfig() };
+    ModelCase f32 = { "f32-gqa", smith::SyntheticModelConfig() };
+    f32.config.weights = smith::SyntheticWeights::F32;
+    f32.config.n_head_kv = 2;
+    f32.config.seed = 7;
+    return { q4k, f32 };
+}
+
+// Decode tok/s each path must reach
+static const std::pair<const char*, double> DEFAULT_FLOORS[] = {
+    { "plain", 20.0 },
+    { "prefix", 20.0 },
+    { "preempt", 20.0 },
+    { "checkpoint", 20.0 },
+    { "batch", 20.0 },
+};
+
+struct RegressionArgs {
+    std::string dir = ".";
+    int threads = 4;
+    int max_tokens = 32;
+    std::map<std::string, double> floors;
+};
+
+// What one path produced for every prompt
+struct PathResult {
+    std::vector<std::vector<llama_token>> tokens;   // empty for batch, which only reports text
+    std::vector<std::string> text;
+    long long generated = 0;
+    int64_t elapsed_us = 0;
+
+    double tokens_per_second() const {
+        return elapsed_us > 0 ? generated * 1e6 / elapsed_us : 0.0;
+    }
+};
+
+static std::string build_prompt(int p) {
+    return std::string(SYSTEM_PROMPT) + "<|im_start|>user\n" + USER_MESSAGES[p] +
+           "<|im_end|>\n<|im_start|>assistant\n";
+}
+
+static void add(PathResult& result, const smith::Generation& gen) {
+    result.tokens.push_back(gen.generated_tokens());
+    result.text.push_back(gen.text());
+    result.generated += gen.stats().n_generated;
+    result.elapsed_us += gen.stats().t_decode_us;
+}
+
+// Stops a run after a fixed number of sampled tokens
+static smith::GenerationHooks stop_after(int& polls, int n) {
+    smith::GenerationHooks hooks;
+    hooks.should_stop = [&polls, n]() { return ++polls > n; };
+    return hooks;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// PATHS
+// ════════════════════════════════════════════════════════════════════
+
+static bool run_plain(llama_model* model, llama_context* ctx, const smith::GenerationParams& params,
+                      PathResult& result) {
+    for (int p = 0; p < N_PROMPTS; p++) {
+        smith::Generation gen(model, params, 0);
+        if (gen.start(build_prompt(p)) != smith::GenerationStatus::OK ||
+            gen.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK) {
+            return false;
+        }
+        add(result, gen);
+    }
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    return true;
+}
+
+static bool run_prefix(llama_model* model, llama_context* ctx, const smith::GenerationParams& params,
+                       PathResult& result) {
+    // Warm the system prompt the way Engine::execute_warm does
+    std::vector<llama_token> head;
+    if (!smith::tokenize(model, SYSTEM_PROMPT, true, head) || head.empty()) {
+        return false;
+    }
+    smith::PrefixCache cache(64u << 20);
+    llama_batch batch = llama_batch_init((int) head.size(), 0, 1);
+    for (size_t i = 0; i < head.size(); i++) {
+        llama_batch_add(batch, head[i], (llama_pos) i, { 0 }, false);
+    }
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    const bool warmed = llama_decode(ctx, batch) == 0 && cache.store(ctx, 0, head);
+    llama_batch_free(batch);
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    if (!warmed) {
+        return false;
+    }
+
+    for (int p = 0; p < N_PROMPTS; p++) {
+        smith::Generation gen(model, params, 0);
+        gen.set_prefix_cache(&cache);
+        if (gen.start(build_prompt(p)) != smith::GenerationStatus::OK ||
+            gen.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK) {
+            return false;
+        }
+        if (gen.stats().n_prefix_reused == 0) {
+            LOGE("Prompt %d did not reuse the warmed prefix", p);
+            return false;
+        }
+        add(result, gen);
+    }
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    return true;
+}
+
+static bool run_preempt(llama_model* model, llama_context* ctx, const smith::GenerationParams& params,
+                        PathResult& result) {
+    for (int p = 0; p < N_PROMPTS; p++) {
+        smith::Generation gen(model, params, 0);
+        int polls = 0;
+        if (gen.start(build_prompt(p)) != smith::GenerationStatus::OK ||
+            gen.run(ctx, stop_after(polls, params.max_tokens / 2)) != smith::GenerationStatus::OK) {
+            return false;
+        }
+        if (!gen.done()) {
+            // Another request takes the sequence meanwhile, as a higher-priority job would
+            smith::Generation other(model, params, 0);
+            if (!gen.suspend(ctx) ||
+                other.start(build_prompt((p + 1) % N_PROMPTS)) != smith::GenerationStatus::OK ||
+                other.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK ||
+                !gen.resume(ctx) ||
+                gen.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK) {
+                return false;
+            }
+        }
+        add(result, gen);
+    }
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    return true;
+}
+
+static bool run_checkpoint(llama_model* model, llama_context* ctx, const smith::GenerationParams& params,
+                           PathResult& result) {
+    for (int p = 0; p < N_PROMPTS; p++) {
+        const std::string prompt = build_prompt(p);
+        smith::Generation first(model, params, 0);
+        int polls = 0;
+        if (first.start(prompt) != smith::GenerationStatus::OK ||
+            first.run(ctx, stop_after(polls, params.max_tokens / 2)) != smith::GenerationStatus::OK) {
+            return false;
+        }
+        if (first.done()) {
+            add(result, first);
+            continue;
+        }
+
+        smith::GenerationCheckpoint cp;
+        if (!first.save_state(ctx, cp)) {
+            return false;
+        }
+        llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+
+        // The second half runs as if in a new process; count both halves
+        smith::Generation second(model, params, 0);
+        if (second.start(prompt) != smith::GenerationStatus::OK ||
+            !second.restore_state(ctx, cp) ||
+            second.run(ctx, smith::GenerationHooks()) != smith::GenerationStatus::OK) {
+            return false;
+        }
+        result.tokens.push_back(second.generated_tokens());
+        result.text.push_back(second.text());
+        result.generated += second.stats().n_generated;
+        result.elapsed_us += first.stats().t_decode_us + second.stats().t_decode_us;
+    }
+    llama_kv_cache_seq_rm(ctx, 0, -1, -1);
+    return true;
+}
+
+static bool run_batch(llama_model* model, llama_context* ctx, const smith::GenerationParams& params,
+                      PathResult& result) {
+    std::vector<smith::BatchItem> items;
+    for (int p = 0; p < N_PROMPTS; p++) {
+        items.push_back({ build_prompt(p), params });
+    }
+    smith::BatchGeneration batch(model, std::move(items));
+    batch.start();
+    batch.run(ctx, std::function<bool()>());
+    if (!batch.done()) {
+        return false;
+    }
+    for (const smith::BatchItemResult& item : batch.results()) {
+        if (item.status != smith::GenerationStatus::OK) {
+            return false;
+        }
+        result.text.push_back(item.text);
+        result.generated += item.n_generated;
+    }
+    // Prefill and decode share calls in a wave, so this rate includes the prompts
+    result.elapsed_us = batch.stats().t_total_us;
+    return true;
+}
+
+typedef bool (*PathFn)(llama_model*, llama_context*, const smith::GenerationParams&, PathResult&);
+
+static const std::pair<const char*, PathFn> PATHS[] = {
+    { "prefix", run_prefix },
+    { "preempt", run_preempt },
+    { "checkpoint", run_checkpoint },
+    { "batch", run_batch },
+};
+
+// ════════════════════════════════════════════════════════════════════
+// CHECKS
+// ════════════════════════════════════════════════════════════════════
+
+// Prints the first difference; true if the outputs match
+static bool same_output(const char* model_name, const char* path,
+                        const PathResult& reference, const PathResult& result) {
+    if (result.text.size() != reference.text.size()) {
+        printf("FAIL %s/%s: %zu outputs, expected %zu\n",
+               model_name, path, result.text.size(), reference.text.size());
+        return false;
+    }
+    for (size_t p = 0; p < reference.text.size(); p++) {
+        if (!result.tokens.empty() && result.tokens[p] != reference.tokens[p]) {
+            const auto& want = reference.tokens[p];
+            const auto& got = result.tokens[p];
+            size_t at = 0;
+            while (at < want.size() && at < got.size() && want[at] == got[at]) {
+                at++;
+            }
+            printf("FAIL %s/%s: prompt %zu diverges at token %zu (%d vs %d)\n", model_name, path, p, at,
+                   at < got.size() ? got[at] : -1, at < want.size() ? want[at] : -1);
+            return false;
+        }
+        if (result.text[p] != reference.text[p]) {
+            printf("FAIL %s/%s: prompt %zu text differs\n  got:      %s\n  expected: %s\n",
+                   model_name, path, p, result.text[p].c_str(), reference.text[p].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool meets_floor(const RegressionArgs& args, const char* model_name, const char* path,
+                        const PathResult& result) {
+    const double rate = result.tokens_per_second();
+    const double min_rate = args.floors.at(path);
+    const bool ok = rate >= min_rate;
+    printf("%s %s/%s: %lld tokens, %.1f tok/s (floor %.1f)\n",
+           ok ? "ok  " : "FAIL", model_name, path, result.generated, rate, min_rate);
+    return ok;
+}
+
+static bool run_model(const RegressionArgs& args, const ModelCase& mc) {
+    const std::string path = args.dir + "/regression-" + mc.name + ".gguf";
+    if (!smith::write_synthetic_model(path, mc.config)) {
+        printf("FAIL %s: cannot write %s\n", mc.name, path.c_str());
+        return false;
+    }
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 0;
+    llama_model* model = llama_load_model_from_file(path.c_str(), model_params);
+    if (model == nullptr) {
+        printf("FAIL %s: cannot load %s\n", mc.name, path.c_str());
+        return false;
+    }
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = 2048;
+    ctx_params.n_seq_max = N_PROMPTS;
+    ctx_params.n_threads = args.threads;
+    ctx_params.n_threads_batch = args.threads;
+    llama_context* ctx = llama_new_context_with_model(model, ctx_params);
+    if (ctx == nullptr) {
+        printf("FAIL %s: cannot create a context\n", mc.name);
+        llama_free_model(model);
+        return false;
+    }
+
+    smith::GenerationParams params;
+    params.max_tokens = args.max_tokens;
+
+    bool ok = true;
+    PathResult reference;
+    if (!run_plain(model, ctx, params, reference)) {
+        printf("FAIL %s/plain: generation failed\n", mc.name);
+        ok = false;
+    } else {
+        ok = meets_floor(args, mc.name, "plain", reference);
+        for (const auto& entry : PATHS) {
+            PathResult result;
+            if (!entry.second(model, ctx, params, result)) {
+                printf("FAIL %s/%s: generation failed\n", mc.name, entry.first);
+                ok = false;
+                continue;
+            }
+            const bool same = same_output(mc.name, entry.first, reference, result);
+            ok = meets_floor(args, mc.name, entry.first, result) && same && ok;
+        }
+    }
+
+    llama_free(ctx);
+    llama_free_model(model);
+    return ok;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--dir DIR] [--threads N] [--tokens N] [--floor PATH=TOK_PER_S]...\n"
+            "paths: plain prefix preempt checkpoint batch\n", argv0);
+}
+
+static bool parse_args(int argc, char** argv, RegressionArgs& args) {
+    for (const auto& entry : DEFAULT_FLOORS) {
+        args.floors[entry.first] = entry.second;
+    }
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (strcmp(a, "--dir") == 0 && has_value) {
+            args.dir = argv[++i];
+        } else if (strcmp(a, "--threads") == 0 && has_value) {
+            args.threads = atoi(argv[++i]);
+        } else if (strcmp(a, "--tokens") == 0 && has_value) {
+            args.max_tokens = atoi(argv[++i]);
+        } else if (strcmp(a, "--floor") == 0 && has_value) {
+            const std::string spec = argv[++i];
+            const size_t eq = spec.find('=');
+            if (eq == std::string::npos || args.floors.count(spec.substr(0, eq)) == 0) {
+                return false;
+            }
+            args.floors[spec.substr(0, eq)] = atof(spec.c_str() + eq + 1);
+        } else {
+            return false;
+        }
+    }
+    // Preempt and checkpoint need a midpoint to stop at
+    return args.threads > 0 && args.max_tokens >= 2;
+}
+
+int main(int argc, char** argv) {
+    RegressionArgs args;
+    if (!parse_args(argc, argv, args)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    llama_backend_init();
+    bool ok = true;
+    for (const ModelCase& mc : model_cases()) {
+        ok = run_model(args, mc) && ok;
+    }
+    llama_backend_free();
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
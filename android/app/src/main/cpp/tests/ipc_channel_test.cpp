@@ -0,0 +1,251 @@
+/**
+ * ipc_channel_test.cpp - Round-trip and peer-loss checks for the worker transport
+ * Guild of Smiths - Offline AI Module
+ *
+ * Forks a child that attaches to the channel the way the inference worker
+ * does, then checks:
+ *   echo    - N messages (default 200000) of mixed sizes, some near the
+ *             ring's capacity, come back in order and intact while both
+ *             rings wrap many times; a CANCEL control frame overtakes them
+ *   timeout - send() into a full ring the peer never drains gives up
+ *             after its timeout instead of blocking
+ *   death   - once the peer is killed, receive() returns false and send()
+ *             fails instead of hanging
+ *
+ * Usage:
+ *   ipc_channel_test [--messages N]
+ * Exits 0 when every check passes, 1 otherwise.
+ */
+
+#define LOG_TAG "IpcChannelTest"
+
+#include "../ipc_channel.h"
+#include "../native_log.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const size_t RING_BYTES = 64 * 1024;
+static const uint32_t ECHO_TYPE = 7;
+static const uint64_t CANCEL_ID = 0xC0FFEE;
+static const int TIMEOUT_MS = 50;
+
+// Payload for message i: its size varies, every 5000th nearly fills the ring
+static std::vector<uint8_t> payload_for(uint64_t i) {
+    const size_t size = i % 5000 == 4999 ? RING_BYTES - 1024 : (size_t) ((i * 2654435761u) % 700);
+    std::vector<uint8_t> payload(size);
+    for (size_t b = 0; b < size; b++) {
+        payload[b] = (uint8_t) (i * 31 + b);
+    }
+    return payload;
+}
+
+/** Child side: attach and echo messages and control frames until the parent closes. */
+static int run_echo_peer(int control_fd, int shm_fd) {
+    std::unique_ptr<smith::IpcChannel> channel = smith::IpcChannel::attach(control_fd, shm_fd);
+    if (!channel) {
+        return 3;
+    }
+    smith::RingMessage message;
+    smith::ControlFrame control;
+    bool is_control = false;
+    while (channel->receive(message, control, is_control)) {
+        const bool ok = is_control
+            ? channel->send_control(control.type, control.id)
+            : channel->send(message.type, message.id, message.payload);
+        if (!ok) {
+            return 4;
+        }
+    }
+    return 0;
+}
+
+/** Fork a peer; the child runs body with its ends and exits with its result. */
+template <typename Body>
+static std::unique_ptr<smith::IpcChannel> spawn_peer(pid_t& pid, Body body) {
+    int peer_control = -1, peer_shm = -1;
+    std::unique_ptr<smith::IpcChannel> channel = smith::IpcChannel::create(RING_BYTES, peer_control, peer_shm);
+    if (!channel) {
+        return nullptr;
+    }
+    pid = fork();
+    if (pid == 0) {
+        // Drop the creator's end so the parent sees EOF when we go
+        channel.reset();
+        _exit(body(peer_control, peer_shm));
+    }
+    close(peer_control);
+    close(peer_shm);
+    if (pid < 0) {
+        return nullptr;
+    }
+    return channel;
+}
+
+static bool check_echo(uint64_t n_messages) {
+    pid_t pid = -1;
+    std::unique_ptr<smith::IpcChannel> channel = spawn_peer(pid, run_echo_peer);
+    if (!channel) {
+        printf("FAIL echo: cannot create the channel or fork\n");
+        return false;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    bool sent_all = true;
+    std::thread sender([&]() {
+        for (uint64_t i = 0; i < n_messages && sent_all; i++) {
+            sent_all = channel->send(ECHO_TYPE, i, payload_for(i));
+        }
+        sent_all = sent_all && channel->send_control(smith::ControlType::CANCEL, CANCEL_ID);
+    });
+
+    bool ok = true;
+    bool cancel_seen = false;
+    uint64_t next = 0;
+    smith::RingMessage message;
+    smith::ControlFrame control;
+    bool is_control = false;
+    while ((next < n_messages || !cancel_seen) && channel->receive(message, control, is_control)) {
+        if (is_control) {
+            if (control.type != smith::ControlType::CANCEL || control.id != CANCEL_ID || cancel_seen) {
+                printf("FAIL echo: unexpected control frame %u/%llu\n",
+                       (unsigned) control.type, (unsigned long long) control.id);
+                ok = false;
+                break;
+            }
+            cancel_seen = true;
+            continue;
+        }
+        if (message.type != ECHO_TYPE || message.id != next || message.payload != payload_for(next)) {
+            printf("FAIL echo: message %llu came back as id %llu with %zu bytes\n",
+                   (unsigned long long) next, (unsigned long long) message.id, message.payload.size());
+            ok = false;
+            break;
+        }
+        next++;
+    }
+    channel->close();
+    sender.join();
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (ok && (!sent_all || next != n_messages || !cancel_seen)) {
+        printf("FAIL echo: %llu of %llu messages back, cancel %s\n", (unsigned long long) next,
+               (unsigned long long) n_messages, cancel_seen ? "seen" : "missing");
+        ok = false;
+    }
+    if (ok && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+        printf("FAIL echo: peer exited with status %d\n", status);
+        ok = false;
+    }
+    if (ok) {
+        printf("PASS echo: %llu messages in %.2f s (%.0f round trips/s)\n",
+               (unsigned long long) n_messages, seconds, n_messages / seconds);
+    }
+    return ok;
+}
+
+static bool check_timeout_and_death() {
+    // A peer that attaches and never reads
+    pid_t pid = -1;
+    std::unique_ptr<smith::IpcChannel> channel = spawn_peer(pid, [](int control_fd, int shm_fd) {
+        std::unique_ptr<smith::IpcChannel> peer = smith::IpcChannel::attach(control_fd, shm_fd);
+        while (peer) {
+            pause();
+        }
+        return 3;
+    });
+    if (!channel) {
+        printf("FAIL timeout: cannot create the channel or fork\n");
+        return false;
+    }
+
+    bool ok = true;
+    const std::vector<uint8_t> block(1024, 0x5A);
+    int queued = 0;
+    while (channel->send(ECHO_TYPE, (uint64_t) queued, block, 0)) {
+        if (++queued > (int) (RING_BYTES / block.size())) {
+            printf("FAIL timeout: ring never filled\n");
+            ok = false;
+            break;
+        }
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool sent = channel->send(ECHO_TYPE, 0, block, TIMEOUT_MS);
+    const long waited = (long) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    if (ok && (sent || waited < TIMEOUT_MS || channel->closed())) {
+        printf("FAIL timeout: send into a full ring returned %d after %ld ms\n", sent, waited);
+        ok = false;
+    } else if (ok) {
+        printf("PASS timeout: full ring (%d messages) gave up after %ld ms\n", queued, waited);
+    }
+
+    kill(pid, SIGKILL);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    // The receive must see EOF rather than block; run it on a thread so a hang is reported
+    bool received = true;
+    std::atomic<bool> returned{ false };
+    std::thread receiver([&]() {
+        smith::RingMessage message;
+        smith::ControlFrame control;
+        bool is_control = false;
+        received = channel->receive(message, control, is_control);
+        returned = true;
+    });
+    for (int i = 0; i < 200 && !returned; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!returned) {
+        printf("FAIL death: receive still blocked 2 s after the peer died\n");
+        channel->close();
+        receiver.join();
+        return false;
+    }
+    receiver.join();
+    if (received || !channel->closed()) {
+        printf("FAIL death: receive returned %d after the peer died\n", received);
+        return false;
+    }
+    if (channel->send(ECHO_TYPE, 0, block, -1) || channel->send_control(smith::ControlType::CANCEL_ALL)) {
+        printf("FAIL death: send succeeded after the peer died\n");
+        return false;
+    }
+    printf("PASS death: receive and send fail once the peer is gone\n");
+    return ok;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "Usage: %s [--messages N]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    uint64_t n_messages = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            n_messages = strtoull(argv[++i], nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    // A dead peer must show up as a failed send, not kill the test
+    signal(SIGPIPE, SIG_IGN);
+
+    bool ok = check_echo(n_messages);
+    ok = check_timeout_and_death() && ok;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/**
+ * model_repack_test.cpp - Repacking of catalog-format models into the interleaved layout
+ * Guild of Smiths - Offline AI Module
+ *
+ * Writes synthetic models in the formats ModelDownloader fetches and runs
+ * them through repack_model the way ModelOptimizer does:
+ *   catalog - Q4_0 weights like the catalog downloads; must convert to
+ *             Q4_0_4_4, pass the probe gate and load as a Q4_0_4_4 file
+ *   kquant  - Q4_K weights like q4_k_m files; must be refused untouched
+ * Builds whose llama.cpp has no ggml-aarch64.c must refuse the layout
+ * instead. Off ARM, ggml runs the layout through its generic kernels, so
+ * the conversion and the probe are exercised on Linux hosts as well.
+ *
+ * Usage:
+ *   model_repack_test [--dir DIR] [--threads N]
+ * Exits 0 when every check passes, 1 otherwise.
+ */
+
+#define LOG_TAG "ModelRepackTest"
+
+#include "../model_repack.h"
+#include "../native_log.h"
+#include "../bench/synthetic_model.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+
+#include "llama.h"
+
+struct RepackArgs {
+    std::string dir = ".";
+    int threads = 4;
+};
+
+static bool file_exists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+/** general.file_type of a GGUF, read with a vocabulary-only load; -1 if unknown. */
+static long file_type(const std::string& path) {
+    llama_model_params mparams = llama_model_default_params();
+    mparams.vocab_only = true;
+    llama_model* model = llama_load_model_from_file(path.c_str(), mparams);
+    if (model == nullptr) {
+        return -1;
+    }
+    char value[32];
+    long ftype = -1;
+    if (llama_model_meta_val_str(model, "general.file_type", value, sizeof(value)) > 0) {
+        ftype = std::strtol(value, nullptr, 10);
+    }
+    llama_free_model(model);
+    return ftype;
+}
+
+static bool write_model(const RepackArgs& args, const char* name, smith::SyntheticWeights weights,
+                        std::string& path) {
+    smith::SyntheticModelConfig config;
+    config.weights = weights;
+    path = args.dir + "/repack-" + name + ".gguf";
+    if (!smith::write_synthetic_model(path, config)) {
+        printf("FAIL %s: cannot write %s\n", name, path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// CASES
+// ════════════════════════════════════════════════════════════════════
+
+static bool check_catalog(const RepackArgs& args) {
+    std::string src;
+    if (!write_model(args, "catalog", smith::SyntheticWeights::Q4_0, src)) {
+        return false;
+    }
+    const std::string dst = args.dir + "/repack-catalog."
+        + smith::layout_name(smith::RepackLayout::Q4_0_4_4) + ".gguf";
+    std::remove(dst.c_str());
+
+    const smith::RepackResult result =
+        smith::repack_model(src, dst, smith::RepackLayout::Q4_0_4_4, args.threads);
+
+#if defined(SMITH_GGML_AARCH64)
+    if (!result.ok) {
+        printf("FAIL catalog: repack refused: %s\n", result.error.c_str());
+        return false;
+    }
+    const long ftype = file_type(dst);
+    const bool ok = ftype == LLAMA_FTYPE_MOSTLY_Q4_0_4_4 && !file_exists(dst + ".tmp");
+    printf("%s catalog: q4_0 -> %s, file type %ld, probe agreement %.2f\n",
+           ok ? "ok  " : "FAIL", smith::layout_name(smith::RepackLayout::Q4_0_4_4),
+           ftype, result.top1_agreement);
+    return ok;
+#else
+    const bool ok = !result.ok && !file_exists(dst);
+    printf("%s catalog: no ggml-aarch64 kernels in this build, layout refused (%s)\n",
+           ok ? "ok  " : "FAIL", result.error.c_str());
+    return ok;
+#endif
+}
+
+static bool check_kquant(const RepackArgs& args) {
+    std::string src;
+    if (!write_model(args, "kquant", smith::SyntheticWeights::Q4_K, src)) {
+        return false;
+    }
+    const std::string dst = args.dir + "/repack-kquant.q4_0_4_4.gguf";
+    std::remove(dst.c_str());
+
+    const smith::RepackResult result =
+        smith::repack_model(src, dst, smith::RepackLayout::Q4_0_4_4, args.threads);
+    const bool ok = !result.ok && !file_exists(dst) && !file_exists(dst + ".tmp");
+    printf("%s kquant: refused (%s)\n", ok ? "ok  " : "FAIL", result.error.c_str());
+    return ok;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--dir DIR] [--threads N]\n", argv0);
+}
+
+static bool parse_args(int argc, char** argv, RepackArgs& args) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (strcmp(a, "--dir") == 0 && has_value) {
+            args.dir = argv[++i];
+        } else if (strcmp(a, "--threads") == 0 && has_value) {
+            args.threads = atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return args.threads > 0;
+}
+
+int main(int argc, char** argv) {
+    RepackArgs args;
+    if (!parse_args(argc, argv, args)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    llama_backend_init();
+    const char* device_layout = smith::layout_name(smith::detect_optimal_layout());
+    printf("device layout: %s\n", *device_layout ? device_layout : "none");
+    bool ok = check_catalog(args);
+    ok = check_kquant(args) && ok;
+    llama_backend_free();
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
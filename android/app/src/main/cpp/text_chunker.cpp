@@ -0,0 +1,237 @@
+/**
+ * text_chunker.cpp - Split long documents into retrievable chunks
+ * Guild of Smiths - Offline AI Module
+ */
+
+#include "text_chunker.h"
+
+#include <algorithm>
+
+namespace smith {
+
+static const size_t MAX_HEADING_BYTES = 100;
+
+// What joins a unit to the one before it, weakest first; a cut prefers the strongest
+enum class Join {
+    SPACE = 0,
+    LINE = 1,
+    PARAGRAPH = 2,
+    HEADING = 3,
+};
+
+struct Line {
+    size_t begin;
+    size_t end;
+    bool blank;
+    bool rule;
+};
+
+struct Unit {
+    size_t begin;
+    size_t end;
+    Join join;
+    int heading;   // unit index of the section's heading, -1 before the first
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Rules are runs of = - _ * ~ or box-drawing characters (U+2500..U+257F)
+static bool is_rule(const char* text, size_t begin, size_t end) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; n++) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '=' || c == '-' || c == '_' || c == '*' || c == '~') {
+            i++;
+        } else if (c == 0xE2 && end - i >= 3 &&
+                   (static_cast<unsigned char>(text[i + 1]) == 0x94 ||
+                    static_cast<unsigned char>(text[i + 1]) == 0x95)) {
+            i += 3;
+        } else {
+            return false;
+        }
+    }
+    return n >= 3;
+}
+
+static bool is_heading(const char* text, const std::vector<Line>& lines, size_t index) {
+    const Line& line = lines[index];
+    if (line.end - line.begin > MAX_HEADING_BYTES) {
+        return false;
+    }
+    if (text[line.begin] == '#') {
+        return true;
+    }
+    // Underlined, or the middle of a banner; the line after a banner is body text
+    if (index + 1 < lines.size() && lines[index + 1].rule) {
+        return true;
+    }
+    int letters = 0;
+    for (size_t i = line.begin; i < line.end; i++) {
+        const char c = text[i];
+        if (c >= 'a' && c <= 'z') {
+            return false;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            letters++;
+        }
+    }
+    return letters >= 3;
+}
+
+static size_t utf8_boundary(const char* text, size_t begin, size_t at) {
+    while (at > begin && (static_cast<unsigned char>(text[at]) & 0xC0) == 0x80) {
+        at--;
+    }
+    return at;
+}
+
+/** Cut a line longer than limit at sentence ends, then spaces. */
+static void split_line(const char* text, size_t begin, size_t end, size_t limit, Join join,
+                       int heading, std::vector<Unit>& out) {
+    while (end - begin > limit) {
+        const size_t earliest = begin + limit / 2;
+        size_t cut = 0;
+        for (size_t i = begin + limit; i > earliest; i--) {
+            const char c = text[i - 1];
+            if ((c == '.' || c == '?' || c == '!' || c == ';') && is_space(text[i])) {
+                cut = i;
+                break;
+            }
+        }
+        for (size_t i = begin + limit; cut == 0 && i > earliest; i--) {
+            if (is_space(text[i])) {
+                cut = i;
+            }
+        }
+        if (cut == 0) {
+            cut = utf8_boundary(text, begin, begin + limit);
+        }
+        size_t piece_end = cut;
+        while (piece_end > begin && is_space(text[piece_end - 1])) {
+            piece_end--;
+        }
+        if (piece_end > begin) {
+            out.push_back(Unit{ begin, piece_end, join, heading });
+            join = Join::SPACE;
+        }
+        begin = cut;
+        while (begin < end && is_space(text[begin])) {
+            begin++;
+        }
+    }
+    if (end > begin) {
+        out.push_back(Unit{ begin, end, join, heading });
+    }
+}
+
+static size_t join_size(Join join) {
+    return join == Join::SPACE || join == Join::LINE ? 1 : 2;
+}
+
+std::vector<std::string> chunk_text(const char* text, size_t size, const ChunkOptions& options) {
+    const size_t target = std::max<size_t>(options.target_bytes, 64);
+
+    std::vector<Line> lines;
+    for (size_t pos = 0; pos < size;) {
+        size_t end = pos;
+        while (end < size && text[end] != '\n') {
+            end++;
+        }
+        size_t b = pos;
+        size_t e = end;
+        while (b < e && is_space(text[b])) b++;
+        while (e > b && is_space(text[e - 1])) e--;
+        lines.push_back(Line{ b, e, b == e, b < e && is_rule(text, b, e) });
+        pos = end + 1;
+    }
+
+    std::vector<Unit> units;
+    Join join = Join::PARAGRAPH;
+    int heading = -1;
+    for (size_t i = 0; i < lines.size(); i++) {
+        const Line& line = lines[i];
+        if (line.blank || line.rule) {
+            join = Join::PARAGRAPH;
+            continue;
+        }
+        if (is_heading(text, lines, i)) {
+            heading = (int) units.size();
+            units.push_back(Unit{ line.begin, line.end, Join::HEADING, heading });
+        } else {
+            // Room for the heading a continuation chunk starts with
+            const size_t reserve = heading >= 0 ? units[heading].end - units[heading].begin + 1 : 0;
+            split_line(text, line.begin, line.end, std::max(target - std::min(reserve, target / 2), target / 2),
+                       join, heading, units);
+        }
+        join = Join::LINE;
+    }
+
+    std::vector<std::string> chunks;
+    auto prefix = [&units](size_t first) -> int {
+        const Unit& u = units[first];
+        return u.join == Join::HEADING || u.heading < 0 ? -1 : u.heading;
+    };
+    auto body = [&units](size_t first, size_t last) {
+        size_t n = 0;
+        for (size_t i = first; i < last; i++) {
+            n += units[i].end - units[i].begin + (i > first ? join_size(units[i].join) : 0);
+        }
+        return n;
+    };
+    auto length = [&units, &prefix, &body](size_t first, size_t last) {
+        const int h = prefix(first);
+        return body(first, last) + (h >= 0 ? units[h].end - units[h].begin + 1 : 0);
+    };
+    auto emit = [&](size_t first, size_t last) {
+        std::string chunk;
+        const int h = prefix(first);
+        if (h >= 0) {
+            chunk.append(text + units[h].begin, units[h].end - units[h].begin);
+            chunk += '\n';
+        }
+        for (size_t i = first; i < last; i++) {
+            if (i > first) {
+                chunk += units[i].join == Join::SPACE ? " " : units[i].join == Join::LINE ? "\n" : "\n\n";
+            }
+            chunk.append(text + units[i].begin, units[i].end - units[i].begin);
+        }
+        chunks.push_back(std::move(chunk));
+    };
+
+    size_t first = 0;
+    for (size_t i = 1; i <= units.size(); i++) {
+        if (i == units.size()) {
+            emit(first, i);
+            break;
+        }
+        const bool overflow = length(first, i + 1) > target;
+        const bool section = units[i].join == Join::HEADING && length(first, i) >= target / 4;
+        if (!overflow && !section) {
+            continue;
+        }
+
+        // Strongest join in the back half of the chunk; the latest among equals
+        size_t cut = i;
+        for (size_t j = i - 1; !section && j > first && length(first, j) >= target / 2; j--) {
+            if (units[j].join > units[cut].join) {
+                cut = j;
+            }
+        }
+        emit(first, cut);
+
+        // Overlap with the end of the previous chunk, within the same section
+        size_t next = cut;
+        while (units[cut].join != Join::HEADING && next - 1 > first &&
+               units[next - 1].join != Join::HEADING &&
+               body(next - 1, cut) <= options.overlap_bytes && length(next - 1, cut + 1) <= target) {
+            next--;
+        }
+        first = next;
+        i = std::max(cut, first + 1) - 1;
+    }
+    return chunks;
+}
+
+} // namespace smith
@@ -0,0 +1,34 @@
+/**
+ * text_chunker.h - Split long documents into retrievable chunks
+ * Guild of Smiths - Offline AI Module
+ *
+ * Cuts plain-text documents (the bundled instruction corpus, role
+ * guides) into chunks of about target_bytes for embedding and retrieval.
+ * Cuts prefer, in order: a heading, a blank line, a line break, the end
+ * of a sentence, a space. Headings are lines underlined by a rule
+ * ("====", "----"), lines starting with '#', and short lines with
+ * letters but no lowercase. A chunk that continues a section starts with that section's
+ * heading, so it still says what it is about; rule lines are dropped.
+ * Consecutive chunks of one section share up to overlap_bytes of text.
+ *
+ * Cuts never split a UTF-8 character. Identical input gives identical
+ * chunks, so duplicate documents can be deduplicated by chunk hash.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+struct ChunkOptions {
+    size_t target_bytes = 600;
+    size_t overlap_bytes = 120;
+};
+
+/** Chunks of text, in document order; empty if it has no content. */
+std::vector<std::string> chunk_text(const char* text, size_t size, const ChunkOptions& options);
+
+} // namespace smith
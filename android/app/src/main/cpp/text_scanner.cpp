@@ -0,0 +1,140 @@
+/**
+ * text_scanner.cpp - One-pass multi-pattern matcher for message text
+ * Guild of Smiths - Offline AI Module
+ */
+
+#include "text_scanner.h"
+
+#include <cstring>
+
+namespace smith {
+
+static const uint32_t NO_STATE = UINT32_MAX;
+
+static bool is_space(uint8_t b) {
+    return b == ' ' || (b >= '\t' && b <= '\r');
+}
+
+// Case- and whitespace-folded form of a byte
+static uint8_t fold(uint8_t b) {
+    if (is_space(b)) return ' ';
+    if (b >= 'A' && b <= 'Z') return (uint8_t) (b - 'A' + 'a');
+    return b;
+}
+
+// Folded pattern with whitespace runs collapsed to one space
+static std::string normalize(const std::string& pattern) {
+    std::string out;
+    out.reserve(pattern.size());
+    for (unsigned char c : pattern) {
+        const uint8_t b = fold(c);
+        if (b == ' ' && !out.empty() && out.back() == ' ') continue;
+        out += (char) b;
+    }
+    return out;
+}
+
+TextScanner::TextScanner(const std::vector<std::string>& patterns)
+    : n_patterns_(patterns.size()) {
+    std::vector<std::string> folded;
+    folded.reserve(patterns.size());
+    for (const std::string& p : patterns) {
+        folded.push_back(normalize(p));
+    }
+
+    // Bytes no pattern uses share column 0, which keeps the table small
+    uint8_t folded_class[256] = {};
+    n_classes_ = 1;
+    for (const std::string& p : folded) {
+        for (unsigned char b : p) {
+            if (folded_class[b] == 0) folded_class[b] = (uint8_t) n_classes_++;
+        }
+    }
+    for (int b = 0; b < 256; b++) {
+        classes_[b] = folded_class[fold((uint8_t) b)];
+        space_[b] = is_space((uint8_t) b);
+    }
+
+    // Trie
+    std::vector<uint32_t> trie(n_classes_, NO_STATE);
+    std::vector<std::vector<uint32_t>> own(1);
+    for (size_t i = 0; i < folded.size(); i++) {
+        if (folded[i].empty()) continue;
+        uint32_t s = 0;
+        for (unsigned char b : folded[i]) {
+            const size_t at = (size_t) s * n_classes_ + folded_class[b];
+            if (trie[at] == NO_STATE) {
+                trie[at] = (uint32_t) own.size();
+                own.emplace_back();
+                trie.resize(own.size() * n_classes_, NO_STATE);
+            }
+            s = trie[at];
+        }
+        own[s].push_back((uint32_t) i);
+    }
+    const size_t n_states = own.size();
+
+    // Breadth-first: fill failure transitions into a full DFA and inherit
+    // the matches of each state's failure state
+    next_ = trie;
+    std::vector<uint32_t> fail(n_states, 0);
+    std::vector<uint32_t> order;
+    order.reserve(n_states);
+    for (uint32_t c = 0; c < n_classes_; c++) {
+        uint32_t& t = next_[c];
+        if (t == NO_STATE) {
+            t = 0;
+        } else {
+            order.push_back(t);
+        }
+    }
+    for (size_t head = 0; head < order.size(); head++) {
+        const uint32_t s = order[head];
+        for (uint32_t c = 0; c < n_classes_; c++) {
+            uint32_t& t = next_[(size_t) s * n_classes_ + c];
+            const uint32_t via_fail = next_[(size_t) fail[s] * n_classes_ + c];
+            if (t == NO_STATE) {
+                t = via_fail;
+            } else {
+                fail[t] = via_fail;
+                order.push_back(t);
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> all(n_states);
+    for (uint32_t s : order) {
+        all[s] = own[s];
+        const std::vector<uint32_t>& inherited = all[fail[s]];
+        all[s].insert(all[s].end(), inherited.begin(), inherited.end());
+    }
+    out_begin_.assign(n_states + 1, 0);
+    for (size_t s = 0; s < n_states; s++) {
+        out_begin_[s + 1] = out_begin_[s] + (uint32_t) all[s].size();
+        out_.insert(out_.end(), all[s].begin(), all[s].end());
+    }
+
+    for (int b = 0; b < 256; b++) {
+        start_[b] = next_[classes_[b]] != 0;
+    }
+}
+
+void TextScanner::scan(const uint8_t* text, size_t size, std::vector<ScanMatch>& out) const {
+    const uint32_t* next = next_.data();
+    uint32_t s = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (s == 0) {
+            // Most bytes cannot start a pattern; skip them without a table walk
+            while (i < size && !start_[text[i]]) i++;
+            if (i == size) break;
+        }
+        const uint8_t b = text[i];
+        if (space_[b] && i > 0 && space_[text[i - 1]]) continue;
+        s = next[(size_t) s * n_classes_ + classes_[b]];
+        for (uint32_t k = out_begin_[s]; k < out_begin_[s + 1]; k++) {
+            out.push_back({ out_[k], (uint32_t) (i + 1) });
+        }
+    }
+}
+
+} // namespace smith
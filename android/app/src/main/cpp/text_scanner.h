@@ -0,0 +1,56 @@
+/**
+ * text_scanner.h - One-pass multi-pattern matcher for message text
+ * Guild of Smiths - Offline AI Module
+ *
+ * Compiles a list of literal patterns into a single Aho-Corasick DFA, so
+ * every cue, keyword and rule word is found in one pass over a message
+ * instead of one regex or contains() per pattern.
+ *
+ * Matching folds ASCII case and treats any run of whitespace as a single
+ * space, in patterns and text alike ("what do i need" matches
+ * "What  do\ti need"). Other bytes, including UTF-8 beyond ASCII, must
+ * match exactly. Like contains(), matches may start mid-word.
+ *
+ * Immutable once built; scan() is safe from any number of threads.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace smith {
+
+struct ScanMatch {
+    uint32_t pattern;   // index into the pattern list
+    uint32_t end;       // byte offset just past the match in the text
+};
+
+class TextScanner {
+public:
+    /** Build the automaton; empty patterns never match. */
+    explicit TextScanner(const std::vector<std::string>& patterns);
+
+    /**
+     * Append every match in text to out, ordered by end offset (patterns
+     * ending at the same byte: longest first).
+     */
+    void scan(const uint8_t* text, size_t size, std::vector<ScanMatch>& out) const;
+
+    size_t pattern_count() const { return n_patterns_; }
+    size_t state_count() const { return out_begin_.size() - 1; }
+
+private:
+    size_t n_patterns_;
+    uint32_t n_classes_;
+    uint8_t classes_[256];        // raw byte -> column in next_
+    bool start_[256];             // byte can leave the root state
+    bool space_[256];
+    std::vector<uint32_t> next_;  // state * n_classes_ + class -> state
+    std::vector<uint32_t> out_begin_;  // matches of state s: out_[out_begin_[s] .. out_begin_[s + 1])
+    std::vector<uint32_t> out_;
+};
+
+} // namespace smith
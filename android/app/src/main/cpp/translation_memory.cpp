@@ -0,0 +1,455 @@
+/**
+ * translation_memory.cpp - Persistent translation memory with fuzzy lookup
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "TranslationMemory"
+
+#include "translation_memory.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smith {
+
+static const char TM_MAGIC[4] = { 'S', 'T', 'M', '1' };
+static const size_t HEADER_SIZE = 4;
+static const size_t RECORD_HEADER = 8;   // body_len + checksum
+static const uint32_t UNKNOWN_WORD = UINT32_MAX;
+
+static uint32_t checksum(const uint8_t* data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint64_t segment_key(uint32_t pair, const char* source, size_t size) {
+    uint64_t h = 14695981039346656037ull ^ pair;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ (uint8_t) source[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t* p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void append_le32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out += (char) ((v >> (8 * i)) & 0xFF);
+}
+
+static void append_le16(std::string& out, uint16_t v) {
+    out += (char) (v & 0xFF);
+    out += (char) (v >> 8);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// NORMALIZATION
+// ════════════════════════════════════════════════════════════════════
+
+// Next code point; invalid bytes come back as U+FFFD one at a time
+static uint32_t next_code_point(const uint8_t* s, size_t size, size_t& i) {
+    const uint8_t b = s[i++];
+    if (b < 0x80) return b;
+    int extra;
+    uint32_t cp;
+    if ((b & 0xE0) == 0xC0) { extra = 1; cp = b & 0x1F; }
+    else if ((b & 0xF0) == 0xE0) { extra = 2; cp = b & 0x0F; }
+    else if ((b & 0xF8) == 0xF0) { extra = 3; cp = b & 0x07; }
+    else return 0xFFFD;
+    if (i + extra > size) return 0xFFFD;
+    for (int k = 0; k < extra; k++) {
+        if ((s[i + k] & 0xC0) != 0x80) return 0xFFFD;
+        cp = (cp << 6) | (s[i + k] & 0x3F);
+    }
+    i += extra;
+    return cp;
+}
+
+static void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char) cp;
+    } else if (cp < 0x800) {
+        out += (char) (0xC0 | (cp >> 6));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char) (0xE0 | (cp >> 12));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    } else {
+        out += (char) (0xF0 | (cp >> 18));
+        out += (char) (0x80 | ((cp >> 12) & 0x3F));
+        out += (char) (0x80 | ((cp >> 6) & 0x3F));
+        out += (char) (0x80 | (cp & 0x3F));
+    }
+}
+
+static bool is_word_char(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') || (cp >= '0' && cp <= '9');
+    }
+    // Latin-1 punctuation (¿ ¡ « » ...) and the math signs separate words
+    return cp >= 0xC0 && cp != 0xD7 && cp != 0xF7 && cp != 0xFFFD &&
+           !(cp >= 0x2000 && cp <= 0x206F);
+}
+
+// Base letters of U+00E0..U+00FF; 0 keeps the letter as is (æ ð ø þ)
+static const char LATIN1_BASE[33] = "aaaaaa\0ceeeeiiii\0nooooo\0\0uuuuy\0y";
+
+// Lowercase, with Latin-1 accents dropped: crews often type without them
+static uint32_t fold(uint32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') return cp + 32;
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) cp += 32;
+    if (cp >= 0xE0 && cp <= 0xFF && LATIN1_BASE[cp - 0xE0] != 0) return (uint32_t) LATIN1_BASE[cp - 0xE0];
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 32;   // Cyrillic
+    return cp;
+}
+
+std::string TranslationMemory::normalize(const std::string& text) {
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(text.data());
+    std::string out;
+    out.reserve(text.size());
+    bool pending_space = false;
+    for (size_t i = 0; i < text.size();) {
+        const uint32_t cp = next_code_point(s, text.size(), i);
+        if (cp == '\'' || cp == 0x2019) {
+            continue;   // "where's" and "wheres" are the same segment
+        }
+        if (!is_word_char(cp)) {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out += ' ';
+            pending_space = false;
+        }
+        append_utf8(out, fold(cp));
+    }
+    return out;
+}
+
+// Word-level Levenshtein distance
+static size_t edit_distance(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    std::vector<size_t> prev(b.size() + 1), cur(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) prev[j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+        cur[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            const size_t sub = prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            cur[j] = std::min(sub, std::min(prev[j], cur[j - 1]) + 1);
+        }
+        std::swap(prev, cur);
+    }
+    return prev[b.size()];
+}
+
+// ════════════════════════════════════════════════════════════════════
+// FILE
+// ════════════════════════════════════════════════════════════════════
+
+TranslationMemory::TranslationMemory(const std::string& path)
+    : path_(path) {
+    if (!load()) {
+        reset_file();
+    }
+}
+
+TranslationMemory::~TranslationMemory() {
+    remap(0);
+}
+
+bool TranslationMemory::remap(size_t size) {
+    if (map_ != nullptr) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    map_size_ = 0;
+    if (size == 0) {
+        return true;
+    }
+    const int fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("Cannot map %s", path_.c_str());
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+    map_size_ = size;
+    return true;
+}
+
+bool TranslationMemory::reset_file() {
+    remap(0);
+    entries_.clear();
+    exact_.clear();
+    postings_.clear();
+    vocab_.clear();
+    pairs_.clear();
+    FILE* f = fopen(path_.c_str(), "wb");
+    if (f == nullptr) {
+        LOGE("Cannot create %s", path_.c_str());
+        return false;
+    }
+    bool ok = fwrite(TM_MAGIC, 1, 4, f) == 4;
+    ok = fclose(f) == 0 && ok;
+    return ok && remap(HEADER_SIZE);
+}
+
+bool TranslationMemory::load() {
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0 || (size_t) st.st_size < HEADER_SIZE) {
+        return false;
+    }
+    if (!remap((size_t) st.st_size) || memcmp(map_, TM_MAGIC, 4) != 0) {
+        LOGI("Starting %s over (format changed)", path_.c_str());
+        return false;
+    }
+
+    size_t off = HEADER_SIZE;
+    while (off + RECORD_HEADER <= map_size_) {
+        const uint32_t body_len = read_le32(map_ + off);
+        const uint32_t sum = read_le32(map_ + off + 4);
+        const size_t body_off = off + RECORD_HEADER;
+        if (body_len > map_size_ - body_off || checksum(map_ + body_off, body_len) != sum ||
+            !index_record(body_off, body_len)) {
+            break;
+        }
+        off = body_off + body_len;
+    }
+
+    if (off != map_size_) {
+        LOGW("Dropping %zu bytes of torn records from %s", map_size_ - off, path_.c_str());
+        remap(0);
+        if (truncate(path_.c_str(), (off_t) off) != 0 || !remap(off)) {
+            return false;
+        }
+    }
+    LOGI("Loaded %zu translations", entries_.size());
+    return true;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// INDEX
+// ════════════════════════════════════════════════════════════════════
+
+uint32_t TranslationMemory::add_pair(const std::string& source_lang, const std::string& target_lang) {
+    const std::string key = source_lang + '>' + target_lang;
+    return pairs_.emplace(key, (uint32_t) pairs_.size()).first->second;
+}
+
+std::vector<uint32_t> TranslationMemory::add_words(const std::string& normalized) {
+    std::vector<uint32_t> ids;
+    size_t start = 0;
+    while (start < normalized.size()) {
+        size_t end = normalized.find(' ', start);
+        if (end == std::string::npos) end = normalized.size();
+        ids.push_back(vocab_.emplace(normalized.substr(start, end - start), (uint32_t) vocab_.size()).first->second);
+        start = end + 1;
+    }
+    return ids;
+}
+
+std::vector<uint32_t> TranslationMemory::known_words(const std::string& normalized) const {
+    std::vector<uint32_t> ids;
+    size_t start = 0;
+    while (start < normalized.size()) {
+        size_t end = normalized.find(' ', start);
+        if (end == std::string::npos) end = normalized.size();
+        auto it = vocab_.find(normalized.substr(start, end - start));
+        ids.push_back(it != vocab_.end() ? it->second : UNKNOWN_WORD);
+        start = end + 1;
+    }
+    return ids;
+}
+
+bool TranslationMemory::index_record(size_t body_off, size_t body_len) {
+    const uint8_t* p = map_ + body_off;
+    const uint8_t* end = p + body_len;
+
+    std::string langs[2];
+    for (std::string& lang : langs) {
+        if (p + 1 > end || p + 1 + p[0] > end) return false;
+        lang.assign(reinterpret_cast<const char*>(p + 1), p[0]);
+        p += 1 + p[0];
+    }
+    uint32_t offs[2];
+    uint16_t lens[2];
+    for (int k = 0; k < 2; k++) {
+        if (p + 2 > end) return false;
+        lens[k] = read_le16(p);
+        offs[k] = (uint32_t) (p + 2 - map_);
+        if (p + 2 + lens[k] > end) return false;
+        p += 2 + lens[k];
+    }
+    if (p != end || lens[0] == 0) return false;
+
+    Entry e;
+    e.source_off = offs[0];
+    e.source_len = lens[0];
+    e.target_off = offs[1];
+    e.target_len = lens[1];
+    e.pair = add_pair(langs[0], langs[1]);
+    const std::string source = entry_source(e);
+    e.words = add_words(source);
+
+    const uint32_t index = (uint32_t) entries_.size();
+    exact_[segment_key(e.pair, source.data(), source.size())] = index;
+    std::vector<uint32_t> distinct = e.words;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    for (uint32_t w : distinct) {
+        postings_[w].push_back(index);
+    }
+    entries_.push_back(std::move(e));
+    return true;
+}
+
+std::string TranslationMemory::entry_source(const Entry& e) const {
+    return std::string(reinterpret_cast<const char*>(map_ + e.source_off), e.source_len);
+}
+
+// ════════════════════════════════════════════════════════════════════
+// PUBLIC API
+// ════════════════════════════════════════════════════════════════════
+
+bool TranslationMemory::put(const std::string& source_lang, const std::string& target_lang,
+                            const std::string& text, const std::string& translation) {
+    const std::string source = normalize(text);
+    if (source.empty() || source.size() > 0xFFFF || translation.size() > 0xFFFF ||
+        source_lang.size() > 0xFF || target_lang.size() > 0xFF) {
+        return false;
+    }
+
+    std::string body;
+    body += (char) source_lang.size();
+    body += source_lang;
+    body += (char) target_lang.size();
+    body += target_lang;
+    append_le16(body, (uint16_t) source.size());
+    body += source;
+    append_le16(body, (uint16_t) translation.size());
+    body += translation;
+
+    std::string record;
+    append_le32(record, (uint32_t) body.size());
+    append_le32(record, checksum(reinterpret_cast<const uint8_t*>(body.data()), body.size()));
+    record += body;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t old_size = map_size_;
+    FILE* f = fopen(path_.c_str(), "ab");
+    bool ok = f != nullptr && fwrite(record.data(), 1, record.size(), f) == record.size();
+    if (f != nullptr) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        LOGE("Append to %s failed", path_.c_str());
+        // A partial record would be cut off on the next open; cut it now
+        if (truncate(path_.c_str(), (off_t) old_size) != 0) {
+            LOGE("Cannot trim %s", path_.c_str());
+        }
+        return false;
+    }
+    if (!remap(old_size + record.size())) {
+        return false;
+    }
+    return index_record(old_size + RECORD_HEADER, body.size());
+}
+
+TranslationHit TranslationMemory::lookup(const std::string& source_lang, const std::string& target_lang,
+                                         const std::string& text, float min_similarity) const {
+    TranslationHit hit;
+    const std::string source = normalize(text);
+    if (source.empty()) {
+        return hit;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pair_it = pairs_.find(source_lang + '>' + target_lang);
+    if (pair_it == pairs_.end() || map_ == nullptr) {
+        return hit;
+    }
+    const uint32_t pair = pair_it->second;
+
+    auto fill = [&](const Entry& e, bool exact, float similarity) {
+        hit.found = true;
+        hit.exact = exact;
+        hit.similarity = similarity;
+        hit.source = entry_source(e);
+        hit.translation.assign(reinterpret_cast<const char*>(map_ + e.target_off), e.target_len);
+    };
+
+    auto exact_it = exact_.find(segment_key(pair, source.data(), source.size()));
+    if (exact_it != exact_.end()) {
+        const Entry& e = entries_[exact_it->second];
+        if (e.pair == pair && e.source_len == source.size() &&
+            memcmp(map_ + e.source_off, source.data(), source.size()) == 0) {
+            fill(e, true, 1.0f);
+            return hit;
+        }
+    }
+
+    // Near hits: only entries sharing enough words can be within the distance
+    std::vector<uint32_t> words = known_words(source);
+    std::vector<uint32_t> distinct = words;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    std::unordered_map<uint32_t, uint32_t> shared;
+    for (uint32_t w : distinct) {
+        if (w == UNKNOWN_WORD) continue;
+        auto post = postings_.find(w);
+        if (post == postings_.end()) continue;
+        for (uint32_t index : post->second) {
+            shared[index]++;
+        }
+    }
+    // Unknown words must never equal each other in the distance
+    uint32_t unknown = UNKNOWN_WORD;
+    for (uint32_t& w : words) {
+        if (w == UNKNOWN_WORD) w = unknown--;
+    }
+
+    int best = -1;
+    float best_similarity = min_similarity;
+    for (const auto& candidate : shared) {
+        const Entry& e = entries_[candidate.first];
+        if (e.pair != pair) continue;
+        const size_t longer = std::max(words.size(), e.words.size());
+        if ((float) candidate.second < min_similarity * (float) longer - 1e-4f) continue;
+        const float similarity = 1.0f - (float) edit_distance(words, e.words) / (float) longer;
+        if (similarity > best_similarity ||
+            (similarity == best_similarity && (int) candidate.first > best)) {
+            best = (int) candidate.first;
+            best_similarity = similarity;
+        }
+    }
+    if (best >= 0) {
+        fill(entries_[best], false, best_similarity);
+    }
+    return hit;
+}
+
+size_t TranslationMemory::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+} // namespace smith
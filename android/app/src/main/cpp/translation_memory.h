@@ -0,0 +1,101 @@
+/**
+ * translation_memory.h - Persistent translation memory with fuzzy lookup
+ * Guild of Smiths - Offline AI Module
+ *
+ * Crews repeat the same phrases all day ("where is the ladder", "lunch at
+ * noon"). Each translation the LLM produces is stored here under its
+ * normalized source segment (lowercase, accents and punctuation
+ * dropped, single spaces). A later request for the same segment is an exact hit. One that
+ * differs by a few words is a near hit, scored by word-level edit
+ * distance. Only misses need the decoder.
+ *
+ * The file is append-only and memory-mapped. Each record is
+ *   le32 body_len | le32 checksum | body
+ *   body: u8 len, source lang | u8 len, target lang |
+ *         le16 len, normalized source | le16 len, translation
+ * Lookups read the strings straight from the mapping. Only offsets and
+ * word ids are kept in memory. A torn or corrupt tail from a crash is cut
+ * off on open. Adding a segment again replaces the older translation.
+ *
+ * Thread-safe.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace smith {
+
+struct TranslationHit {
+    bool found = false;
+    bool exact = false;
+    float similarity = 0.0f;   // 1 - word edit distance / longer length
+    std::string source;        // normalized source segment that matched
+    std::string translation;
+};
+
+class TranslationMemory {
+public:
+    /** Open or create the memory at path. */
+    explicit TranslationMemory(const std::string& path);
+    ~TranslationMemory();
+
+    TranslationMemory(const TranslationMemory&) = delete;
+    TranslationMemory& operator=(const TranslationMemory&) = delete;
+
+    /**
+     * Store a translation of text.
+     * @return false if the segment is empty or too long, or the write failed
+     */
+    bool put(const std::string& source_lang, const std::string& target_lang,
+             const std::string& text, const std::string& translation);
+
+    /**
+     * Best stored translation of text between the two languages.
+     * @param min_similarity Near hits below this count as misses
+     */
+    TranslationHit lookup(const std::string& source_lang, const std::string& target_lang,
+                          const std::string& text, float min_similarity) const;
+
+    size_t size() const;
+
+    /** Lowercased, unaccented words of text joined by single spaces. */
+    static std::string normalize(const std::string& text);
+
+private:
+    struct Entry {
+        uint32_t source_off;     // in map_
+        uint16_t source_len;
+        uint32_t target_off;
+        uint16_t target_len;
+        uint32_t pair;           // language pair id
+        std::vector<uint32_t> words;
+    };
+
+    bool load();
+    bool reset_file();
+    bool remap(size_t size);
+    bool index_record(size_t body_off, size_t body_len);
+    uint32_t add_pair(const std::string& source_lang, const std::string& target_lang);
+    std::vector<uint32_t> add_words(const std::string& normalized);
+    std::vector<uint32_t> known_words(const std::string& normalized) const;
+    std::string entry_source(const Entry& e) const;
+
+    std::string path_;
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+
+    std::vector<Entry> entries_;
+    std::unordered_map<uint64_t, uint32_t> exact_;            // hash of pair and source -> entry
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;  // word -> entries
+    std::unordered_map<std::string, uint32_t> vocab_;
+    std::unordered_map<std::string, uint32_t> pairs_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace smith
@@ -0,0 +1,194 @@
+/**
+ * vector_index.cpp - Persistent flat index of embedding vectors
+ * Guild of Smiths - Offline AI Module
+ */
+
+#define LOG_TAG "VectorIndex"
+
+#include "vector_index.h"
+#include "native_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace smith {
+
+static const char INDEX_MAGIC[4] = { 'S', 'V', 'X', '2' };
+static const size_t HEADER_SIZE = 16;
+
+static void normalize(float* v, int dim) {
+    double norm = 0.0;
+    for (int d = 0; d < dim; d++) {
+        norm += (double) v[d] * v[d];
+    }
+    if (norm <= 0.0) {
+        return;
+    }
+    const float inv = (float) (1.0 / std::sqrt(norm));
+    for (int d = 0; d < dim; d++) {
+        v[d] *= inv;
+    }
+}
+
+VectorIndex::VectorIndex(const std::string& path, int dim, uint64_t fingerprint)
+    : path_(path), dim_(dim), fingerprint_(fingerprint) {
+    if (!load()) {
+        reset_file();
+    }
+}
+
+bool VectorIndex::reset_file() {
+    ids_.clear();
+    data_.clear();
+    rows_.clear();
+    FILE* f = fopen(path_.c_str(), "wb");
+    if (f == nullptr) {
+        LOGE("Cannot create %s", path_.c_str());
+        return false;
+    }
+    const uint32_t dim = (uint32_t) dim_;
+    bool ok = fwrite(INDEX_MAGIC, 1, 4, f) == 4 && fwrite(&dim, 4, 1, f) == 1 &&
+              fwrite(&fingerprint_, 8, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+bool VectorIndex::load() {
+    FILE* f = fopen(path_.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    char magic[4];
+    uint32_t dim = 0;
+    uint64_t fingerprint = 0;
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, INDEX_MAGIC, 4) != 0 ||
+        fread(&dim, 4, 1, f) != 1 || (int) dim != dim_ ||
+        fread(&fingerprint, 8, 1, f) != 1 || fingerprint != fingerprint_) {
+        fclose(f);
+        LOGI("Starting %s over (format or embedding model changed)", path_.c_str());
+        return false;
+    }
+
+    const size_t row_bytes = (size_t) dim_ * sizeof(float);
+    long good_end = (long) HEADER_SIZE;
+    std::vector<float> row(dim_);
+    while (true) {
+        uint16_t id_len = 0;
+        if (fread(&id_len, 2, 1, f) != 1) {
+            break;
+        }
+        std::string id(id_len, '\0');
+        if ((id_len > 0 && fread(&id[0], 1, id_len, f) != id_len) ||
+            fread(row.data(), 1, row_bytes, f) != row_bytes) {
+            break;
+        }
+        good_end = ftell(f);
+        if (rows_.emplace(id, ids_.size()).second) {
+            ids_.push_back(std::move(id));
+            data_.insert(data_.end(), row.begin(), row.end());
+        }
+    }
+    fseek(f, 0, SEEK_END);
+    const long file_end = ftell(f);
+    fclose(f);
+
+    if (file_end != good_end) {
+        LOGW("Dropping %ld bytes of torn records from %s", file_end - good_end, path_.c_str());
+        if (truncate(path_.c_str(), good_end) != 0) {
+            return false;
+        }
+    }
+    LOGI("Loaded %zu vectors of dim %d", ids_.size(), dim_);
+    return true;
+}
+
+int VectorIndex::add(const std::vector<std::string>& ids, const float* vectors) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string out;
+    std::vector<float> row(dim_);
+    const size_t first_row = ids_.size();
+    for (size_t i = 0; i < ids.size(); i++) {
+        const std::string& id = ids[i];
+        if (id.size() > 0xFFFF || rows_.count(id) != 0) {
+            continue;
+        }
+        memcpy(row.data(), vectors + i * dim_, (size_t) dim_ * sizeof(float));
+        normalize(row.data(), dim_);
+
+        const uint16_t id_len = (uint16_t) id.size();
+        out.append(reinterpret_cast<const char*>(&id_len), 2);
+        out.append(id);
+        out.append(reinterpret_cast<const char*>(row.data()), (size_t) dim_ * sizeof(float));
+
+        rows_.emplace(id, ids_.size());
+        ids_.push_back(id);
+        data_.insert(data_.end(), row.begin(), row.end());
+    }
+    const int added = (int) (ids_.size() - first_row);
+    if (added == 0) {
+        return 0;
+    }
+
+    FILE* f = fopen(path_.c_str(), "ab");
+    bool ok = f != nullptr && fwrite(out.data(), 1, out.size(), f) == out.size();
+    if (f != nullptr) {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok) {
+        // Memory must not get ahead of the file
+        LOGE("Append to %s failed", path_.c_str());
+        for (size_t r = first_row; r < ids_.size(); r++) {
+            rows_.erase(ids_[r]);
+        }
+        ids_.resize(first_row);
+        data_.resize(first_row * dim_);
+        return -1;
+    }
+    return added;
+}
+
+std::vector<std::pair<std::string, float>> VectorIndex::search(const float* query, int k) const {
+    std::vector<float> q(query, query + dim_);
+    normalize(q.data(), dim_);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t n = ids_.size();
+    std::vector<std::pair<float, size_t>> scored(n);
+    for (size_t r = 0; r < n; r++) {
+        const float* v = data_.data() + r * dim_;
+        float dot = 0.0f;
+        for (int d = 0; d < dim_; d++) {
+            dot += v[d] * q[d];
+        }
+        scored[r] = { dot, r };
+    }
+
+    const size_t top = std::min(n, (size_t) std::max(k, 0));
+    std::partial_sort(scored.begin(), scored.begin() + top, scored.end(),
+                      [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) {
+                          return a.first > b.first;
+                      });
+    std::vector<std::pair<std::string, float>> result;
+    result.reserve(top);
+    for (size_t i = 0; i < top; i++) {
+        result.emplace_back(ids_[scored[i].second], scored[i].first);
+    }
+    return result;
+}
+
+bool VectorIndex::contains(const std::string& id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_.count(id) != 0;
+}
+
+size_t VectorIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ids_.size();
+}
+
+} // namespace smith
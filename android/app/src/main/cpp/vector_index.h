@@ -0,0 +1,63 @@
+/**
+ * vector_index.h - Persistent flat index of embedding vectors
+ * Guild of Smiths - Offline AI Module
+ *
+ * Stores L2-normalized vectors under string ids and answers top-k cosine
+ * queries by a scan over one contiguous float array. At the sizes a
+ * phone accumulates (thousands of messages) a scan beats any tree.
+ *
+ * The file is append-only: a header (magic, dim, fingerprint) followed
+ * by records
+ *   le16 id_len | id bytes | dim x f32
+ * so adding a batch costs one write. A torn tail from a crash is cut off
+ * on open. The fingerprint identifies the embedding model; a file of
+ * another dimension or fingerprint (model changed) is started over, since
+ * vectors from two models are not comparable even at equal size.
+ *
+ * Thread-safe.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace smith {
+
+class VectorIndex {
+public:
+    /** Open or create the index at path for vectors of dim floats from the model fingerprint names. */
+    VectorIndex(const std::string& path, int dim, uint64_t fingerprint);
+
+    /**
+     * Add vectors (ids.size() * dim floats, row per id); ids already in
+     * the index are skipped. Normalizes each row.
+     * @return number added, or -1 if the file write failed
+     */
+    int add(const std::vector<std::string>& ids, const float* vectors);
+
+    /** Up to k (id, score) pairs by descending cosine similarity. */
+    std::vector<std::pair<std::string, float>> search(const float* query, int k) const;
+
+    bool contains(const std::string& id) const;
+    size_t size() const;
+    int dim() const { return dim_; }
+
+private:
+    bool load();
+    bool reset_file();
+
+    std::string path_;
+    int dim_;
+    uint64_t fingerprint_;
+    std::vector<std::string> ids_;
+    std::vector<float> data_;                 // ids_.size() rows of dim_
+    std::unordered_map<std::string, size_t> rows_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace smith
@@ -0,0 +1,37 @@
+/**
+ * smith_worker.cpp - Standalone inference worker process
+ * Guild of Smiths - Offline AI Module
+ *
+ * Serves one WorkerClient over the channel ends it inherits, then exits
+ * when the client closes the channel or dies. WorkerClient::spawn starts
+ * it; on Android the same loop runs inside InferenceWorkerService instead.
+ *
+ * Usage:
+ *   smith_worker --control-fd N --shm-fd M
+ */
+
+#define LOG_TAG "SmithWorker"
+
+#include "../inference_worker.h"
+#include "../native_log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    int control_fd = -1;
+    int shm_fd = -1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--control-fd") == 0) {
+            control_fd = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--shm-fd") == 0) {
+            shm_fd = atoi(argv[i + 1]);
+        }
+    }
+    if (control_fd < 0 || shm_fd < 0) {
+        fprintf(stderr, "usage: %s --control-fd N --shm-fd M\n", argv[0]);
+        return 2;
+    }
+    return smith::serve_worker(control_fd, shm_fd);
+}
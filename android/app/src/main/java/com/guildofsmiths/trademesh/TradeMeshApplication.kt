@@ -1,10 +1,13 @@
 package com.guildofsmiths.trademesh
 
 import android.app.Application
+import android.os.Build
+import android.os.SystemClock
 import android.util.Log
 import com.guildofsmiths.trademesh.ai.AIRouter
 import com.guildofsmiths.trademesh.ai.BatteryGate
-import com.guildofsmiths.trademesh.ai.LlamaInference
+import com.guildofsmiths.trademesh.ai.IdlePrecompute
+import com.guildofsmiths.trademesh.ai.InferenceWorkerService
 import com.guildofsmiths.trademesh.ai.ResponseCache
 import com.guildofsmiths.trademesh.planner.KeywordObserver
 import com.guildofsmiths.trademesh.data.BeaconRepository
@@ -41,6 +44,12 @@ class TradeMeshApplication : Application() {
     override fun onCreate() {
         super.onCreate()
         instance = this
+        // The :inference process only hosts the LLM engine; it needs none of the app
+        if (InferenceWorkerService.isWorkerProcess(currentProcessName())) {
+            Log.i(TAG, "Inference worker process started")
+            return
+        }
+        val startTime = SystemClock.elapsedRealtime()
         
         // Initialize Supabase Auth (primary)
         SupabaseAuth.init(this)
@@ -75,7 +84,9 @@ class TradeMeshApplication : Application() {
         BatteryGate.initialize(this)
         ResponseCache.initialize(this)
         AIRouter.initialize(this)
-        LlamaInference.initialize()
+        IdlePrecompute.initialize(this)
+        // LlamaInference is not touched here: libllama_jni.so is loaded and the
+        // backend initialized off the main thread on first AI use
         
         // Initialize Planner components (keyword observation for TEST ⧉)
         KeywordObserver.initialize(this)
@@ -115,6 +126,18 @@ class TradeMeshApplication : Application() {
         Log.i(TAG, "────────────────────────────────────────")
         Log.i(TAG, "AI: $aiStatus")
         Log.i(TAG, "Battery: $batteryStatus")
+        Log.i(TAG, "Startup: ${SystemClock.elapsedRealtime() - startTime}ms (native AI deferred)")
         Log.i(TAG, "════════════════════════════════════════")
     }
+    
+    private fun currentProcessName(): String {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.P) {
+            return Application.getProcessName()
+        }
+        return try {
+            java.io.File("/proc/self/cmdline").readText().substringBefore('\u0000')
+        } catch (e: Exception) {
+            packageName
+        }
+    }
 }
@@ -6,11 +6,16 @@ import android.net.NetworkCapabilities
 import android.util.Log
 import com.guildofsmiths.trademesh.data.AIMode
 import com.guildofsmiths.trademesh.data.Message
+import com.guildofsmiths.trademesh.data.MessageRepository
 import com.guildofsmiths.trademesh.data.UserPreferences
+import com.guildofsmiths.trademesh.engine.BoundaryEngine
+import com.guildofsmiths.trademesh.service.MeshReplyStream
+import com.guildofsmiths.trademesh.service.MeshService
 import kotlinx.coroutines.*
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.asStateFlow
+import java.io.File
 import java.util.UUID
 import java.util.concurrent.ConcurrentLinkedQueue
 
@@ -34,6 +39,9 @@ object AIRouter {
     
     private const val TAG = "AIRouter"
     
+    /** Stored translations at least this alike are reused (labeled as near matches) */
+    private const val TRANSLATION_NEAR_MATCH = 0.8f
+    
     // Status state
     private val _status = MutableStateFlow(AIStatus.OFFLINE)
     val status: StateFlow<AIStatus> = _status.asStateFlow()
@@ -50,6 +58,9 @@ object AIRouter {
     // Response cache for offline sync
     private val responseCache = ConcurrentLinkedQueue<CachedAIResponse>()
     
+    // Past LLM translations, so repeated phrases skip the decoder
+    private var translationMemory: TranslationMemory? = null
+    
     // Coroutine scope for AI processing
     private val aiScope = CoroutineScope(Dispatchers.Default + SupervisorJob())
     
@@ -68,11 +79,16 @@ object AIRouter {
         
         context = appContext.applicationContext
         
-        // Initialize subsystems
+        // Initialize subsystems (native LLM backend is deferred until AI is used)
+        LlamaInference.configureWorkerProcess(appContext)
+        LlamaInference.configureCheckpoints(appContext)
+        LlamaInference.configurePrefixCache(appContext)
         BatteryGate.initialize(appContext)
-        LlamaInference.initialize()
         OfflineQueueManager.initialize(appContext)
         AgentInitializer.initialize(appContext)
+        KnowledgeBase.initialize(appContext)
+        ModelOptimizer.initialize(appContext)
+        translationMemory = TranslationMemory.open(File(appContext.filesDir, "translation_memory.bin"))
         
         isInitialized = true
         updateStatus()
@@ -87,6 +103,12 @@ object AIRouter {
         aiEnabled = enabled
         updateStatus()
         Log.i(TAG, "AI ${if (enabled) "enabled" else "disabled"}")
+        
+        // Warm the native backend in the background so the first load is quick
+        if (enabled) {
+            aiScope.launch { LlamaInference.initializeAsync() }
+            ModelOptimizer.requestOptimization()
+        }
     }
     
     fun isEnabled(): Boolean = aiEnabled
@@ -101,6 +123,10 @@ object AIRouter {
         BatteryGate.shutdown()
         OfflineQueueManager.shutdown()
         AgentInitializer.shutdown()
+        KnowledgeBase.shutdown()
+        ModelOptimizer.shutdown()
+        translationMemory?.close()
+        translationMemory = null
         isInitialized = false
         context = null
     }
@@ -114,7 +140,9 @@ object AIRouter {
      * No explicit cues needed - AI observes and assists contextually.
      *
      * @param message The message to observe
-     * @param messageContext Where the message came from
+     * @param messageContext Where the message came from; replies to @AI
+     *        questions from mesh peers are also streamed onto the mesh as
+     *        they are generated, if the user allows it (see [mayReplyOnMesh])
      * @param metadata Additional context (job ID, channel ID, etc.)
      * @param onResponse Callback with the AI response (only if assistance is needed)
      */
@@ -144,6 +172,9 @@ object AIRouter {
 
         _isProcessing.value = true
 
+        // Mesh replies go on air segment by segment while the model is still writing
+        val meshReply = if (mayReplyOnMesh(message, messageContext)) BoundaryEngine.openMeshReply(message) else null
+
         try {
             // Step 2: Check battery gate
             val availability = BatteryGate.getAIStatus()
@@ -158,22 +189,51 @@ object AIRouter {
 
                 else -> {
                     // Process with sub-agents (works in all modes including offline)
-                    processWithSubAgents(observation, metadata, availability)
+                    processWithSubAgents(observation, metadata, availability, meshReply)
                 }
             }
 
             // Step 3: Handle offline queuing and sync
             if (response is AIResponse.Success) {
-                handleResponseDelivery(response, message, metadata, onResponse)
+                handleResponseDelivery(response, message, observation, metadata, availability, onResponse)
             } else {
                 onResponse(response)
             }
 
         } finally {
+            meshReply?.finish()
             _isProcessing.value = false
         }
     }
     
+    /**
+     * Answer an inbound mesh message that asks @AI, on the mesh, when the
+     * user has opted in. Other mesh traffic is not observed.
+     */
+    fun onMeshMessageReceived(message: Message) {
+        if (!aiEnabled || !mayReplyOnMesh(message, MessageContext.MESH)) return
+        aiScope.launch {
+            processMessage(
+                message = message,
+                messageContext = MessageContext.MESH,
+                metadata = AIMetadata(channelId = message.channelId, userId = message.senderId)
+            ) { response ->
+                if (response is AIResponse.Success && response.text.isNotBlank()) {
+                    // The peers got it over the air; this keeps the local copy
+                    MessageRepository.addMessage(Message.createAIResponse(
+                        channelId = message.channelId,
+                        content = response.text,
+                        aiModel = response.model,
+                        aiSource = response.source.name.lowercase(),
+                        originalPrompt = message.content,
+                        aiContext = "mesh-reply",
+                        isMeshOrigin = true
+                    ))
+                }
+            }
+        }
+    }
+    
     /**
      * Check if AI is currently available for requests.
      */
@@ -327,11 +387,46 @@ object AIRouter {
     // PRIVATE HELPERS
     // ════════════════════════════════════════════════════════════════════
     
+    /**
+     * A reply goes on air only for an explicit @AI question from another
+     * person on the mesh, with the user's opt-in: every peer in range gets
+     * it. The user's own messages and AI messages never qualify. Senders
+     * are compared in their truncated wire form, which is all a beacon
+     * carries; AI frames are flagged on the wire (see [MeshService]).
+     */
+    private fun mayReplyOnMesh(message: Message, messageContext: MessageContext): Boolean {
+        val sender = MeshService.wireSenderId(message.senderId)
+        return messageContext == MessageContext.MESH &&
+               UserPreferences.isMeshAiRepliesEnabled() &&
+               sender != MeshService.wireSenderId(UserPreferences.getUserId()) &&
+               message.senderId != Message.AI_SENDER_ID &&
+               !MeshService.isAiSenderId(sender) &&
+               !message.aiGenerated &&
+               CueDetector.hasAICue(message.content)
+    }
+    
     private suspend fun processWithLLM(
         cue: AICue,
         metadata: AIMetadata,
         maxTokens: Int
     ): AIResponse {
+        // Translations come from memory when the phrase was seen before
+        if (cue.intent == AIIntent.TRANSLATE) {
+            val text = cue.extractedQuery ?: cue.originalMessage
+            translate(text, cue.detectedLanguage, maxTokens, InferencePriority.INTERACTIVE)?.let {
+                val label = it.hit?.takeIf { hit -> !hit.exact }?.let { hit -> " " + nearMatchLabel(hit) } ?: ""
+                return AIResponse.Success(
+                    text = it.text + label,
+                    source = AISource.LLM,
+                    model = it.model,
+                    durationMs = it.durationMs,
+                    tokensGenerated = it.tokensGenerated,
+                    cueType = cue.type,
+                    intent = cue.intent
+                )
+            }
+        }
+        
         // Check if model is ready
         if (!LlamaInference.isModelLoaded()) {
             Log.w(TAG, "Model not loaded, falling back to rule-based")
@@ -361,13 +456,29 @@ object AIRouter {
             }
         }
 
+        // Answered ahead of time while the device was charging
+        IdlePrecompute.precomputedAnswer(
+            cue.extractedQuery ?: cue.originalMessage, cue.context, cue.intent, metadata.jobTitle
+        )?.let {
+            return AIResponse.Success(
+                text = it,
+                source = AISource.LLM,
+                model = "qwen3-1.7b-q4-precomputed",
+                durationMs = 0,
+                tokensGenerated = 0,
+                cueType = cue.type,
+                intent = cue.intent
+            )
+        }
+        
         // Standard LLM inference (fallback)
         val prompt = buildPrompt(cue, metadata)
         
         val result = LlamaInference.generate(
             prompt = prompt,
             maxTokens = maxTokens,
-            temperature = 0.7f
+            temperature = 0.7f,
+            priority = InferencePriority.INTERACTIVE
         )
         
         return when (result) {
@@ -410,10 +521,18 @@ object AIRouter {
     private suspend fun processWithSubAgents(
         observation: AmbientObserver.Observation,
         metadata: AIMetadata,
-        availability: AIAvailability
+        availability: AIAvailability,
+        meshReply: MeshReplyStream? = null
     ): AIResponse {
         Log.d(TAG, "Processing with sub-agent: ${observation.subAgent}")
 
+        if (observation.subAgent == AmbientObserver.SubAgent.TRANSLATOR) {
+            translateObservation(observation, availability)?.let { response ->
+                meshReply?.append(response.text)
+                return response
+            }
+        }
+
         // Get sub-agent response
         val subResponse = SubAgents.process(observation)
 
@@ -430,7 +549,12 @@ object AIRouter {
         }
 
         // For Hybrid Mode, enhance with external LLM if conditions met
-        val enhancedText = if (shouldUseHybridMode(context!!)) {
+        val useHybrid = shouldUseHybridMode(context!!)
+        if (!useHybrid) {
+            // The base response is final; only the local enhancement streams after it
+            meshReply?.append(subResponse.content)
+        }
+        val enhancedText = if (useHybrid) {
             Log.d(TAG, "Using Hybrid Mode - attempting external LLM enhancement")
             try {
                 // Call external vendor-neutral LLM layer
@@ -447,11 +571,14 @@ object AIRouter {
             }
         } else if (availability == AIAvailability.FULL && LlamaInference.isModelLoaded()) {
             // Standard Mode with local LLM available
-            enhanceWithLLM(subResponse.content, observation, metadata)
+            enhanceWithLLM(subResponse.content, observation, metadata, meshReply)
         } else {
             // Standard Mode: rule-based only
             subResponse.content
         }
+        if (useHybrid) {
+            meshReply?.append(enhancedText)
+        }
 
         return AIResponse.Success(
             text = enhancedText,
@@ -464,19 +591,111 @@ object AIRouter {
         )
     }
 
+    /**
+     * Translation for the TRANSLATOR sub-agent: from memory, else from the
+     * local model when it is allowed to run. Null leaves the sub-agent's
+     * own answer in place.
+     */
+    private suspend fun translateObservation(
+        observation: AmbientObserver.Observation,
+        availability: AIAvailability
+    ): AIResponse.Success? {
+        val content = observation.message.content
+        val maxTokens = if (availability == AIAvailability.FULL) {
+            minOf(BatteryGate.getRecommendedMaxTokens(), 150)
+        } else 0
+        val translation = translate(
+            content, observation.detectedLanguage, maxTokens, InferencePriority.BACKGROUND
+        ) ?: return null
+
+        val lang = observation.detectedLanguage.uppercase()
+        val label = translation.hit?.takeIf { !it.exact }?.let { nearMatchLabel(it) }
+            ?: "(auto-translated from $lang)"
+        return AIResponse.Success(
+            text = "\"$content\" → \"${translation.text}\" $label",
+            source = if (translation.hit != null) AISource.RULE_BASED else AISource.LLM,
+            model = translation.model,
+            durationMs = translation.durationMs,
+            tokensGenerated = translation.tokensGenerated,
+            cueType = AICueType.GENERAL,
+            intent = AIIntent.TRANSLATE
+        )
+    }
+
+    /**
+     * Translate [text] to English, from the translation memory when the
+     * phrase (or one close to it) was translated before. Only misses reach
+     * the model, and its answer is remembered.
+     *
+     * @param maxTokens Generation budget; 0 to answer from memory only
+     * @return null on a miss with no model, or if generation failed
+     */
+    private suspend fun translate(
+        text: String,
+        sourceLang: String,
+        maxTokens: Int,
+        priority: InferencePriority
+    ): Translation? {
+        val memory = translationMemory
+        memory?.lookup(sourceLang, "en", text, TRANSLATION_NEAR_MATCH)?.let { hit ->
+            Log.d(TAG, "Translation memory ${if (hit.exact) "hit" else "near hit (${hit.similarity})"}")
+            return Translation(hit.translation, "translation-memory", hit)
+        }
+        if (maxTokens <= 0 || !LlamaInference.isModelLoaded()) return null
+
+        val result = LlamaInference.generate(
+            prompt = buildChatPrompt(text, MessageContext.CHAT, AIIntent.TRANSLATE, null),
+            maxTokens = maxTokens,
+            temperature = 0.2f, // Stored for reuse, so keep it literal
+            priority = priority
+        )
+        if (result !is GenerationResult.Success) return null
+        val translated = result.text.trim()
+        if (translated.isEmpty()) return null
+        memory?.put(sourceLang, "en", text, translated)
+        return Translation(translated, "qwen3-1.7b-q4", null, result.durationMs, result.tokensGenerated)
+    }
+
+    private fun nearMatchLabel(hit: TranslationHit): String =
+        "(≈ ${(hit.similarity * 100).toInt()}% match to a saved translation of \"${hit.source}\")"
+
+    /** A translation and where it came from; [hit] is null when freshly generated */
+    private data class Translation(
+        val text: String,
+        val model: String,
+        val hit: TranslationHit?,
+        val durationMs: Long = 0,
+        val tokensGenerated: Int = 0
+    )
+
     private suspend fun enhanceWithLLM(
         baseResponse: String,
         observation: AmbientObserver.Observation,
-        metadata: AIMetadata
+        metadata: AIMetadata,
+        meshReply: MeshReplyStream? = null
     ): String {
         // Build a context-aware prompt for enhancement
         val contextPrompt = buildContextPrompt(observation, metadata, baseResponse)
 
+        // Forward tokens to the mesh as they arrive, after the base response
+        var streamedAny = false
+        val onText: ((String) -> Unit)? = meshReply?.let { stream ->
+            { piece ->
+                if (!streamedAny) {
+                    streamedAny = true
+                    stream.append(" 💡 ")
+                }
+                stream.append(piece)
+            }
+        }
+
         return try {
             val result = LlamaInference.generate(
                 prompt = contextPrompt,
                 maxTokens = minOf(BatteryGate.getRecommendedMaxTokens(), 100),
-                temperature = 0.3f // Lower temperature for more focused responses
+                temperature = 0.3f, // Lower temperature for more focused responses
+                priority = InferencePriority.BACKGROUND, // Never delays an explicit question
+                onText = onText
             )
 
             when (result) {
@@ -566,24 +785,51 @@ object AIRouter {
     }
     
     private fun buildPrompt(cue: AICue, metadata: AIMetadata): String {
-        val systemPrompt = buildSystemPrompt(cue, metadata)
         val userQuery = cue.extractedQuery ?: cue.originalMessage
-        
+        return buildChatPrompt(userQuery, cue.context, cue.intent, metadata.jobTitle)
+    }
+    
+    /**
+     * Full chat prompt for a query, as sent to the local model.
+     * Shared with IdlePrecompute so precomputed answers match live ones.
+     */
+    internal fun buildChatPrompt(
+        query: String,
+        context: MessageContext,
+        intent: AIIntent,
+        jobTitle: String?
+    ): String {
         // Qwen3 chat template
-        return """<|im_start|>system
-$systemPrompt<|im_end|>
-<|im_start|>user
-$userQuery<|im_end|>
+        return """${systemPromptBlock(context, intent, jobTitle)}<|im_start|>user
+$query<|im_end|>
 <|im_start|>assistant
 """
     }
     
-    private fun buildSystemPrompt(cue: AICue, metadata: AIMetadata): String {
+    /**
+     * The system part of [buildChatPrompt]: the prefix every chat prompt
+     * about a job shares, and what IdlePrecompute warms while charging.
+     */
+    internal fun systemPromptBlock(
+        context: MessageContext,
+        intent: AIIntent,
+        jobTitle: String?
+    ): String {
+        return """<|im_start|>system
+${buildSystemPrompt(context, intent, jobTitle)}<|im_end|>
+"""
+    }
+    
+    private fun buildSystemPrompt(
+        context: MessageContext,
+        intent: AIIntent,
+        jobTitle: String?
+    ): String {
         val basePrompt = "You are Smith, a helpful AI assistant for construction and trade workers. " +
                          "Keep responses brief, practical, and professional. " +
                          "Use simple language. Respond in 2-4 sentences max."
         
-        val contextPrompt = when (cue.context) {
+        val contextPrompt = when (context) {
             MessageContext.JOB_BOARD -> 
                 " You're helping with job management. Focus on tasks, materials, and timelines."
             MessageContext.TIME_TRACKING -> 
@@ -593,7 +839,7 @@ $userQuery<|im_end|>
             MessageContext.CHAT -> ""
         }
         
-        val intentPrompt = when (cue.intent) {
+        val intentPrompt = when (intent) {
             AIIntent.TRANSLATE -> 
                 " Translate the following to English. Only provide the translation."
             AIIntent.CHECKLIST -> 
@@ -603,8 +849,8 @@ $userQuery<|im_end|>
             else -> ""
         }
         
-        val jobContext = if (metadata.jobTitle != null) {
-            " Current job: ${metadata.jobTitle}."
+        val jobContext = if (jobTitle != null) {
+            " Current job: $jobTitle."
         } else ""
         
         return basePrompt + contextPrompt + intentPrompt + jobContext
@@ -641,7 +887,9 @@ $userQuery<|im_end|>
     private fun handleResponseDelivery(
         response: AIResponse.Success,
         message: Message,
+        observation: AmbientObserver.Observation,
         metadata: AIMetadata,
+        availability: AIAvailability,
         onResponse: (AIResponse) -> Unit
     ) {
         val channelId = message.channelId
@@ -660,12 +908,17 @@ $userQuery<|im_end|>
             ), metadata)
             onResponse(response)
         } else {
-            // Queue for later sync when connectivity returns
+            // Queue for later sync when connectivity returns. If the local LLM
+            // was skipped, the queue enhances this with the rest of the backlog later.
+            val llmSkipped = availability != AIAvailability.FULL || !LlamaInference.isModelLoaded()
             OfflineQueueManager.queueResponse(
                 response = response,
                 channelId = channelId,
                 jobId = metadata.jobId,
-                contextId = "ambient-${System.currentTimeMillis()}"
+                contextId = "ambient-${System.currentTimeMillis()}",
+                enhancementPrompt = if (llmSkipped && response.text.isNotEmpty()) {
+                    buildContextPrompt(observation, metadata, response.text)
+                } else null
             )
 
             // Still call onResponse for immediate UI feedback
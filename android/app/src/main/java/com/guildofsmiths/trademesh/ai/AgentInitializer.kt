@@ -31,6 +31,11 @@ object AgentInitializer {
 
     private const val TAG = "AgentInitializer"
 
+    // Answer length for enhancedReasoning; the prompt gets the rest of the context
+    private const val REASONING_MAX_TOKENS = 200
+    // Cap on the memory summary in a reasoning prompt, even when the context has room
+    private const val CONTEXT_SUMMARY_MAX_TOKENS = 384
+
     // ════════════════════════════════════════════════════════════════════
     // AGENT STATE
     // ════════════════════════════════════════════════════════════════════
@@ -442,6 +447,7 @@ object AgentInitializer {
         // This would integrate with the reasoning loop to provide helpful suggestions
 
         Log.d(TAG, "Generating proactive suggestions")
+        // LLM calls from here must use InferencePriority.BACKGROUND so they yield to @ai questions
         // Implementation would check:
         // - Time for breaks
         // - Upcoming deadlines
@@ -460,20 +466,24 @@ object AgentInitializer {
     suspend fun enhancedReasoning(
         query: String,
         context: AgentContext,
-        availableTools: List<String>
+        availableTools: List<String>,
+        priority: InferencePriority = InferencePriority.INTERACTIVE
     ): String {
         if (!isAgentAlive()) {
             return "Agent not active - using rule-based response"
         }
 
-        // Build enhanced prompt with context and tools
-        val enhancedPrompt = buildReasoningPrompt(query, context, availableTools)
+        // Build enhanced prompt with the relevant knowledge, context and tools
+        val knowledge = KnowledgeBase.retrieve(query, context.tradeRole, reasoningHeader(context.tradeRole))
+        val enhancedPrompt = buildReasoningPrompt(query, context, availableTools, knowledge)
 
-        // Call LLM with tool integration
+        // Call LLM with tool integration; a restart mid-answer picks up from the last checkpoint
         val result = LlamaInference.generate(
             prompt = enhancedPrompt,
-            maxTokens = 200,
-            temperature = 0.3f
+            maxTokens = REASONING_MAX_TOKENS,
+            temperature = 0.3f,
+            priority = priority,
+            checkpointKey = "reasoning:${Integer.toHexString(query.hashCode())}"
         )
 
         return when (result) {
@@ -494,43 +504,86 @@ object AgentInitializer {
         }
     }
 
+    /**
+     * Fixed start of every reasoning prompt for [role]. Knowledge chunks
+     * follow it directly, so "header + chunk" prefixes can be warmed ahead
+     * of time (see [KnowledgeBase.warmPopular]).
+     */
+    fun reasoningHeader(role: TradeRole): String {
+        val name = role.displayName
+        return "<|im_start|>system\n" +
+            "You are Smith, an intelligent AI assistant specialized for ${name}s in construction and trade work.\n" +
+            "You have deep knowledge of $name procedures, tools, safety protocols, and dexterity requirements.\n\n"
+    }
+
     private fun buildReasoningPrompt(
         query: String,
         context: AgentContext,
-        availableTools: List<String>
+        availableTools: List<String>,
+        knowledge: List<KnowledgeChunk>
     ): String {
+        val role = context.tradeRole.displayName
         val roleGuidance = """
-            TRADE ROLE: ${context.tradeRole.displayName}
+            TRADE ROLE: $role
             - Focus on ${context.roleKnowledge.coreSkills.joinToString(", ")}
             - Reference ${context.roleKnowledge.regulations.joinToString(", ")} when relevant
             - Include dexterity considerations: ${context.roleKnowledge.breakReminders.take(2).joinToString("; ")}
             - Use role-appropriate procedures and safety protocols
         """.trimIndent()
 
-        val systemPrompt = """
-            You are Smith, an intelligent AI assistant specialized for ${context.tradeRole.displayName}s in construction and trade work.
-            You have deep knowledge of ${context.tradeRole.displayName} procedures, tools, safety protocols, and dexterity requirements.
-
-            $roleGuidance
-
-            USER CONTEXT:
-            ${_contextSummary.value}
-
-            AVAILABLE TOOLS:
-            ${availableTools.joinToString("\n")}
-
-            When responding as a ${context.tradeRole.displayName}:
+        val instructions = """
+            When responding as a $role:
             - Reference role-specific procedures and safety protocols naturally
             - Include dexterity and fatigue prevention in tool/skill suggestions
             - Mention relevant regulations (NEC, OSHA, etc.) when applicable
             - Keep responses under 100 words for mobile efficiency
+            - Prefer the reference notes above when they answer the question
             - Use tools when they would provide better information
             - Format tool calls as [TOOL_CALL:tool_name:parameters]
-
-            Current query: $query
         """.trimIndent()
 
-        return "<|im_start|>system\n$systemPrompt<|im_end|>\n<|im_start|>user\n$query<|im_end|>\n<|im_start|>assistant\n"
+        // Retrieved chunks replace the inline role guidance; each is kept whole or
+        // dropped. The leading one, right after the header, may come from the prefix cache.
+        val reference = if (knowledge.isEmpty()) {
+            listOf(PromptSegment("$roleGuidance\n\n", priority = 2, minTokens = 24))
+        } else {
+            knowledge.mapIndexed { i, chunk ->
+                PromptSegment(
+                    KnowledgeBase.chunkBlock(chunk.text),
+                    priority = if (i == 0) 4 else 2,
+                    minTokens = Int.MAX_VALUE
+                )
+            }
+        }
+
+        // Template markers, identity, instructions and the query always fit;
+        // the summary gives way first, then reference text, then the tool list
+        val segments = buildList {
+            add(PromptSegment(reasoningHeader(context.tradeRole), required = true))
+            addAll(reference)
+            add(PromptSegment(
+                "USER CONTEXT:\n${_contextSummary.value}\n\n",
+                priority = 1,
+                minTokens = 32,
+                maxTokens = CONTEXT_SUMMARY_MAX_TOKENS
+            ))
+            add(PromptSegment("AVAILABLE TOOLS:\n${availableTools.joinToString("\n")}\n\n", priority = 3, minTokens = 16))
+            add(PromptSegment(instructions, required = true))
+            add(PromptSegment(
+                "<|im_end|>\n<|im_start|>user\n$query<|im_end|>\n<|im_start|>assistant\n",
+                required = true
+            ))
+        }
+
+        val contextSize = LlamaInference.modelInfo.value?.contextSize?.takeIf { it > 0 }
+            ?: LlamaInference.DEFAULT_CONTEXT_SIZE
+        val untrimmed = segments.joinToString("") { it.text }
+        val assembled = LlamaInference.assemblePrompt(segments, contextSize - REASONING_MAX_TOKENS)
+            ?: return untrimmed
+        if (assembled.text != untrimmed) {
+            Log.d(TAG, "Reasoning prompt trimmed to ${assembled.tokenCount} tokens: ${assembled.keptTokens}")
+        }
+        return assembled.text
     }
 
     private suspend fun executeToolChain(response: String, context: AgentContext): String {
@@ -162,9 +162,14 @@ object AmbientObserver {
             )
         }
 
-        // Detect language
-        val detectedLanguage = detectLanguage(content)
-        val needsTranslation = detectedLanguage != "en" && detectedLanguage != "unknown"
+        // Detect language (native model, or the indicator heuristics without it)
+        val language = LanguageId.detect(content)
+        val detectedLanguage = language?.lang ?: detectLanguage(content)
+        val needsTranslation = if (language != null) {
+            language.needsTranslation
+        } else {
+            detectedLanguage != "en" && detectedLanguage != "unknown"
+        }
 
         // If message is in another language, always offer translation
         if (needsTranslation) {
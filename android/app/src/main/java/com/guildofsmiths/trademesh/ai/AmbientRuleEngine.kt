@@ -8,6 +8,7 @@ import com.guildofsmiths.trademesh.ai.OfflineQueueManager
 import com.guildofsmiths.trademesh.ai.AIAction
 import kotlinx.coroutines.*
 import kotlinx.coroutines.flow.*
+import java.util.EnumSet
 
 /**
  * AmbientRuleEngine - Standard Mode: Local, lightweight, always-on ambient AI
@@ -32,13 +33,8 @@ object AmbientRuleEngine {
     // PATTERN MATCHERS (lightweight, deterministic)
     // ════════════════════════════════════════════════════════════════════
 
-    private val clockPatterns = listOf(
-        Regex("clock in", RegexOption.IGNORE_CASE),
-        Regex("clock out", RegexOption.IGNORE_CASE),
-        Regex("start work", RegexOption.IGNORE_CASE),
-        Regex("end work", RegexOption.IGNORE_CASE),
-        Regex("lunch break", RegexOption.IGNORE_CASE),
-        Regex("back from break", RegexOption.IGNORE_CASE)
+    private val clockPhrases = listOf(
+        "clock in", "clock out", "start work", "end work", "lunch break", "back from break"
     )
 
     private val materialPatterns = listOf(
@@ -49,11 +45,10 @@ object AmbientRuleEngine {
         Regex("send (.+)", RegexOption.IGNORE_CASE)
     )
 
+    private val checklistPhrases = listOf("checklist", "check list", "next step")
+
     private val checklistPatterns = listOf(
-        Regex("checklist", RegexOption.IGNORE_CASE),
-        Regex("check list", RegexOption.IGNORE_CASE),
         Regex("what.*do.*next", RegexOption.IGNORE_CASE),
-        Regex("next steps?", RegexOption.IGNORE_CASE),
         Regex("how.*do.*this", RegexOption.IGNORE_CASE)
     )
 
@@ -68,6 +63,21 @@ object AmbientRuleEngine {
         "drywall" to "drywall"
     )
 
+    /** What a scanner pattern indicates */
+    private enum class RuleWord { AI_MENTION, CLOCK, MATERIAL, CHECKLIST, CHECKLIST_HINT, TRADE }
+
+    // Every literal rule word, matched in one pass; the regexes above only
+    // run once the scan has found their leading word
+    private val ruleWords: List<Pair<String, RuleWord>> =
+        listOf("@ai", "assistant").map { it to RuleWord.AI_MENTION } +
+        clockPhrases.map { it to RuleWord.CLOCK } +
+        listOf("need ", "out of ", "missing ", "send ").map { it to RuleWord.MATERIAL } +
+        checklistPhrases.map { it to RuleWord.CHECKLIST } +
+        listOf("what", "how").map { it to RuleWord.CHECKLIST_HINT } +
+        tradeKeywords.keys.map { it to RuleWord.TRADE }
+
+    private val ruleScanner = TextScanner(ruleWords.map { it.first })
+
     // ════════════════════════════════════════════════════════════════════
     // EVENT PROCESSING
     // ════════════════════════════════════════════════════════════════════
@@ -183,37 +193,45 @@ object AmbientRuleEngine {
 
     private fun analyzeMessage(message: Message, context: AmbientEventHub.MessageContext): AmbientResponse? {
         val content = message.content.lowercase().trim()
+        val found = ruleScanner.find(content)
+        val words = EnumSet.noneOf(RuleWord::class.java)
+        var bit = found.nextSetBit(0)
+        while (bit >= 0) {
+            words.add(ruleWords[bit].second)
+            bit = found.nextSetBit(bit + 1)
+        }
 
         // Skip if already processed or contains AI mentions
-        if (content.contains("@ai") || content.contains("assistant")) {
+        if (RuleWord.AI_MENTION in words) {
             return null
         }
 
         // Clock in/out detection
-        if (clockPatterns.any { it.containsMatchIn(content) }) {
+        if (RuleWord.CLOCK in words) {
             return generateClockResponse(content)
         }
 
         // Material requests
-        materialPatterns.forEach { pattern ->
-            pattern.find(content)?.let { match ->
-                val material = match.groupValues.getOrNull(1)?.trim()
-                if (!material.isNullOrBlank()) {
-                    return generateMaterialResponse(material)
+        if (RuleWord.MATERIAL in words) {
+            materialPatterns.forEach { pattern ->
+                pattern.find(content)?.let { match ->
+                    val material = match.groupValues.getOrNull(1)?.trim()
+                    if (!material.isNullOrBlank()) {
+                        return generateMaterialResponse(material)
+                    }
                 }
             }
         }
 
         // Checklist requests
-        if (checklistPatterns.any { it.containsMatchIn(content) }) {
+        if (RuleWord.CHECKLIST in words ||
+            (RuleWord.CHECKLIST_HINT in words && checklistPatterns.any { it.containsMatchIn(content) })) {
             return generateChecklistResponse(content, context)
         }
 
-        // Trade-specific patterns
-        tradeKeywords.forEach { (keyword, trade) ->
-            if (content.contains(keyword)) {
-                return generateTradeChecklistResponse(trade)
-            }
+        // Trade-specific patterns, first keyword in map order
+        ruleWords.indices.firstOrNull { ruleWords[it].second == RuleWord.TRADE && found[it] }?.let { index ->
+            return generateTradeChecklistResponse(tradeKeywords.getValue(ruleWords[index].first))
         }
 
         // Non-English text detection (simple heuristics)
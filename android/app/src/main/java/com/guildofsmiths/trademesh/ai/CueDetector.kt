@@ -1,7 +1,7 @@
 package com.guildofsmiths.trademesh.ai
 
 import android.util.Log
-import java.util.Locale
+import java.util.EnumSet
 import java.util.regex.Pattern
 
 /**
@@ -23,42 +23,19 @@ object CueDetector {
     // PATTERNS
     // ════════════════════════════════════════════════════════════════════
     
-    // Explicit AI cues - case insensitive
+    // Explicit AI cues - case insensitive; strips the cue from the query.
+    // A whole word after a space or punctuation, so user@ai.com is no cue
     private val AI_CUE_PATTERN = Pattern.compile(
-        """(?i)@(ai|assistant|helper|smith|smithy|ayuda|aide)""",
+        """(?i)(?<![\w.])@(ai|assistant|helper|smith|smithy|ayuda|aide)\b""",
         Pattern.CASE_INSENSITIVE
     )
     
-    // Translation request patterns
+    // Translation request patterns; extracts the text to translate
     private val TRANSLATE_PATTERN = Pattern.compile(
         """(?i)(translate|traducir|traduire|traduzir|übersetzen)\s*:?\s*(.+)""",
         Pattern.CASE_INSENSITIVE
     )
     
-    // Task/checklist request patterns
-    private val TASK_PATTERN = Pattern.compile(
-        """(?i)(checklist|task|tasks|todo|to-do|list|steps|what\s+do\s+i\s+need)""",
-        Pattern.CASE_INSENSITIVE
-    )
-    
-    // Confirmation request patterns  
-    private val CONFIRM_PATTERN = Pattern.compile(
-        """(?i)(confirm|verify|check|is\s+this\s+right|correct\?|good\?|ok\?)""",
-        Pattern.CASE_INSENSITIVE
-    )
-    
-    // Time tracking related patterns
-    private val TIME_PATTERN = Pattern.compile(
-        """(?i)(clock|time|hours|break|lunch|overtime|shift|punch)""",
-        Pattern.CASE_INSENSITIVE
-    )
-    
-    // Job/work related patterns
-    private val JOB_PATTERN = Pattern.compile(
-        """(?i)(job|work|project|material|tool|invoice|estimate|quote)""",
-        Pattern.CASE_INSENSITIVE
-    )
-    
     // Common non-English phrases that indicate translation need
     private val NON_ENGLISH_INDICATORS = listOf(
         // Spanish
@@ -71,6 +48,28 @@ object CueDetector {
         "guten tag", "danke", "bitte", "wie", "was", "wo"
     )
     
+    /** What a scanner pattern indicates */
+    private enum class CueWord {
+        AI_CUE, TRANSLATE, TASK, CONFIRM, TIME, JOB, SPANISH, FRENCH, PORTUGUESE, GERMAN
+    }
+    
+    // Every literal cue, intent and language word, matched in one pass by SCANNER.
+    // Intent words are the alternatives of the former per-intent regexes.
+    private val CUE_WORDS: List<Pair<String, CueWord>> =
+        listOf("@ai", "@assistant", "@helper", "@smith", "@smithy", "@ayuda", "@aide").map { it to CueWord.AI_CUE } +
+        listOf("translate", "traducir", "traduire", "traduzir", "übersetzen").map { it to CueWord.TRANSLATE } +
+        listOf("checklist", "task", "tasks", "todo", "to-do", "list", "steps", "what do i need").map { it to CueWord.TASK } +
+        listOf("confirm", "verify", "check", "is this right", "correct?", "good?", "ok?").map { it to CueWord.CONFIRM } +
+        listOf("clock", "time", "hours", "break", "lunch", "overtime", "shift", "punch").map { it to CueWord.TIME } +
+        listOf("job", "work", "project", "material", "tool", "invoice", "estimate", "quote").map { it to CueWord.JOB } +
+        NON_ENGLISH_INDICATORS.take(9).map { it to CueWord.SPANISH } +
+        NON_ENGLISH_INDICATORS.slice(9..13).map { it to CueWord.FRENCH } +
+        NON_ENGLISH_INDICATORS.slice(14..17).map { it to CueWord.PORTUGUESE } +
+        NON_ENGLISH_INDICATORS.slice(18..22).map { it to CueWord.GERMAN }
+    
+    // Lazy: compiled on first detection, not when the class is loaded
+    private val SCANNER by lazy { TextScanner(CUE_WORDS.map { it.first }) }
+    
     // Language detection character patterns
     private val CYRILLIC_PATTERN = Pattern.compile("[\\p{IsCyrillic}]")
     private val CJK_PATTERN = Pattern.compile("[\\p{IsCJK}]|[\\u4e00-\\u9fff]")
@@ -92,7 +91,7 @@ object CueDetector {
         val trimmed = message.trim()
         
         // Check for explicit @AI cue
-        val hasExplicitCue = AI_CUE_PATTERN.matcher(trimmed).find()
+        val hasExplicitCue = CueWord.AI_CUE in cueWords(trimmed)
         
         if (!hasExplicitCue) {
             // No explicit cue - no AI processing
@@ -106,20 +105,22 @@ object CueDetector {
         
         // Extract the query part (everything after the @AI cue)
         val query = extractQuery(trimmed)
+        val words = cueWords(query)
         
-        // Detect language
-        val detectedLanguage = detectLanguage(query)
-        val needsTranslation = detectedLanguage != "en" && detectedLanguage != "unknown"
+        // Detect language; low-confidence guesses do not trigger translation
+        val language = detectLanguage(query, words)
+        val detectedLanguage = language.lang
+        val needsTranslation = language.needsTranslation
         
-        // Check for explicit translation request
-        val translateMatcher = TRANSLATE_PATTERN.matcher(query)
-        val isTranslationRequest = translateMatcher.find()
+        // Check for explicit translation request (the regex only runs on a translate word)
+        val translateMatcher = if (CueWord.TRANSLATE in words) TRANSLATE_PATTERN.matcher(query) else null
+        val isTranslationRequest = translateMatcher?.find() == true
         val translationText = if (isTranslationRequest) {
-            translateMatcher.group(2)?.trim()
+            translateMatcher?.group(2)?.trim()
         } else null
         
         // Determine intent
-        val intent = determineIntent(query, context)
+        val intent = determineIntent(query, words, isTranslationRequest, context)
         
         // Determine cue type
         val cueType = when {
@@ -135,12 +136,14 @@ object CueDetector {
             originalMessage = message,
             extractedQuery = translationText ?: query,
             detectedLanguage = detectedLanguage,
+            languageConfidence = language.confidence,
             needsTranslation = needsTranslation,
             context = context
         )
         
         Log.d(TAG, "Detected cue: type=${cue.type}, intent=${cue.intent}, " +
-                   "lang=${cue.detectedLanguage}, query=${cue.extractedQuery?.take(50)}")
+                   "lang=${cue.detectedLanguage} (${"%.2f".format(cue.languageConfidence)}), " +
+                   "query=${cue.extractedQuery?.take(50)}")
         
         return cue
     }
@@ -150,7 +153,7 @@ object CueDetector {
      * Faster check for pre-filtering messages.
      */
     fun hasAICue(message: String): Boolean {
-        return AI_CUE_PATTERN.matcher(message).find()
+        return CueWord.AI_CUE in cueWords(message)
     }
     
     /**
@@ -159,8 +162,9 @@ object CueDetector {
      */
     fun estimateComplexity(message: String): CueComplexity {
         val wordCount = message.split(Regex("\\s+")).size
-        val hasTranslation = TRANSLATE_PATTERN.matcher(message).find() || 
-                             detectLanguage(message) != "en"
+        val words = cueWords(message)
+        val hasTranslation = (CueWord.TRANSLATE in words && TRANSLATE_PATTERN.matcher(message).find()) ||
+                             detectLanguage(message, words).needsTranslation
         
         return when {
             wordCount > 100 -> CueComplexity.HIGH
@@ -175,6 +179,16 @@ object CueDetector {
     // PRIVATE HELPERS
     // ════════════════════════════════════════════════════════════════════
     
+    private fun cueWords(text: String): Set<CueWord> {
+        val found = EnumSet.noneOf(CueWord::class.java)
+        for (index in SCANNER.scan(text)) {
+            found.add(CUE_WORDS[index].second)
+        }
+        // The scanner also matches inside words and addresses
+        if (CueWord.AI_CUE in found && !AI_CUE_PATTERN.matcher(text).find()) found.remove(CueWord.AI_CUE)
+        return found
+    }
+    
     private fun extractQuery(message: String): String {
         // Remove the @AI cue and get the rest
         val withoutCue = AI_CUE_PATTERN.matcher(message).replaceFirst("").trim()
@@ -187,50 +201,44 @@ object CueDetector {
         return cleaned.ifEmpty { withoutCue }
     }
     
-    private fun detectLanguage(text: String): String {
-        val lower = text.lowercase(Locale.ROOT)
-        
+    private fun detectLanguage(text: String, words: Set<CueWord>): LanguageGuess {
+        // Native n-gram model when available; the heuristics below are the fallback
+        LanguageId.detect(text)?.let { return it }
+        return LanguageGuess(heuristicLanguage(text, words), 1f)
+    }
+    
+    private fun heuristicLanguage(text: String, words: Set<CueWord>): String {
         // Check for non-Latin scripts first
         if (CYRILLIC_PATTERN.matcher(text).find()) return "ru"
         if (CJK_PATTERN.matcher(text).find()) return "zh"
         if (ARABIC_PATTERN.matcher(text).find()) return "ar"
         if (DEVANAGARI_PATTERN.matcher(text).find()) return "hi"
         
-        // Check for Spanish indicators
-        if (lower.contains("¿") || lower.contains("¡") ||
-            NON_ENGLISH_INDICATORS.take(9).any { lower.contains(it) }) {
-            return "es"
-        }
-        
-        // Check for French indicators
-        if (NON_ENGLISH_INDICATORS.slice(9..13).any { lower.contains(it) }) {
-            return "fr"
-        }
-        
-        // Check for Portuguese indicators
-        if (NON_ENGLISH_INDICATORS.slice(14..17).any { lower.contains(it) }) {
-            return "pt"
-        }
-        
-        // Check for German indicators
-        if (NON_ENGLISH_INDICATORS.slice(18..22).any { lower.contains(it) }) {
-            return "de"
-        }
+        // Indicator phrases, by language
+        if (CueWord.SPANISH in words) return "es"
+        if (CueWord.FRENCH in words) return "fr"
+        if (CueWord.PORTUGUESE in words) return "pt"
+        if (CueWord.GERMAN in words) return "de"
         
         // Default to English for Latin script
         return if (text.matches(Regex("^[\\x00-\\x7F\\s]+$"))) "en" else "unknown"
     }
     
-    private fun determineIntent(query: String, context: MessageContext): AIIntent {
+    private fun determineIntent(
+        query: String,
+        words: Set<CueWord>,
+        isTranslationRequest: Boolean,
+        context: MessageContext
+    ): AIIntent {
         return when {
-            TRANSLATE_PATTERN.matcher(query).find() -> AIIntent.TRANSLATE
-            CONFIRM_PATTERN.matcher(query).find() -> AIIntent.CONFIRM
-            TASK_PATTERN.matcher(query).find() -> {
+            isTranslationRequest -> AIIntent.TRANSLATE
+            CueWord.CONFIRM in words -> AIIntent.CONFIRM
+            CueWord.TASK in words -> {
                 if (context == MessageContext.JOB_BOARD) AIIntent.CHECKLIST
                 else AIIntent.TASK_HELP
             }
-            TIME_PATTERN.matcher(query).find() -> AIIntent.TIME_TRACKING
-            JOB_PATTERN.matcher(query).find() -> AIIntent.JOB_HELP
+            CueWord.TIME in words -> AIIntent.TIME_TRACKING
+            CueWord.JOB in words -> AIIntent.JOB_HELP
             query.endsWith("?") -> AIIntent.QUESTION
             else -> AIIntent.GENERAL
         }
@@ -296,6 +304,7 @@ data class AICue(
     val originalMessage: String,
     val extractedQuery: String?,
     val detectedLanguage: String = "en",
+    val languageConfidence: Float = 1f,
     val needsTranslation: Boolean = false,
     val context: MessageContext = MessageContext.CHAT
 ) {
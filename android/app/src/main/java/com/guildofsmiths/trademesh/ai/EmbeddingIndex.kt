@@ -0,0 +1,111 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import org.json.JSONObject
+import java.io.Closeable
+import java.io.File
+
+/**
+ * EmbeddingIndex - Persistent vector index for similarity search
+ *
+ * Thin handle over the native flat index in libsmith_native.so: vectors
+ * (from [LlamaInference.embed]) are stored under string ids in an
+ * append-only file and queried by cosine similarity. Thread-safe.
+ *
+ * A file written by another embedding model (other fingerprint or vector
+ * size) is started over on open: vectors of two models do not compare.
+ */
+class EmbeddingIndex private constructor(
+    private var handle: Long,
+    val dimension: Int,
+    val fingerprint: Long
+) : Closeable {
+
+    companion object {
+        private const val TAG = "EmbeddingIndex"
+
+        /**
+         * Open or create the index at [file] for vectors of [dimension] from
+         * the model identified by [fingerprint] ([ModelInfo.fingerprint]).
+         * @return null if the native library is unavailable
+         */
+        fun open(file: File, dimension: Int, fingerprint: Long): EmbeddingIndex? {
+            if (!SmithNative.available || dimension <= 0) return null
+            return EmbeddingIndex(nativeOpen(file.absolutePath, dimension, fingerprint), dimension, fingerprint)
+        }
+
+        // ════════════════════════════════════════════════════════════════════
+        // NATIVE METHODS (JNI)
+        // ════════════════════════════════════════════════════════════════════
+
+        @JvmStatic private external fun nativeOpen(path: String, dim: Int, fingerprint: Long): Long
+        @JvmStatic private external fun nativeClose(handle: Long)
+        @JvmStatic private external fun nativeAdd(handle: Long, ids: Array<String>, vectors: FloatArray): Int
+        @JvmStatic private external fun nativeSearch(handle: Long, query: FloatArray, k: Int): String
+        @JvmStatic private external fun nativeContains(handle: Long, id: String): Boolean
+        @JvmStatic private external fun nativeSize(handle: Long): Int
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Add vectors under ids; ids already present are skipped.
+     * @return number added, or -1 if the index file could not be written
+     */
+    @Synchronized
+    fun add(ids: List<String>, vectors: List<FloatArray>): Int {
+        require(ids.size == vectors.size) { "ids and vectors differ in size" }
+        if (handle == 0L || ids.isEmpty()) return 0
+        val flat = FloatArray(ids.size * dimension)
+        vectors.forEachIndexed { i, v ->
+            require(v.size == dimension) { "vector $i has size ${v.size}, expected $dimension" }
+            v.copyInto(flat, i * dimension)
+        }
+        return nativeAdd(handle, ids.toTypedArray(), flat)
+    }
+
+    /**
+     * The k ids most similar to query, best first.
+     */
+    @Synchronized
+    fun search(query: FloatArray, k: Int): List<IndexHit> {
+        if (handle == 0L || query.size != dimension) return emptyList()
+        return try {
+            val json = JSONObject(nativeSearch(handle, query, k))
+            val ids = json.getJSONArray("ids")
+            val scores = json.getJSONArray("scores")
+            (0 until ids.length()).map { i -> IndexHit(ids.getString(i), scores.getDouble(i).toFloat()) }
+        } catch (e: Exception) {
+            Log.e(TAG, "Search failed", e)
+            emptyList()
+        }
+    }
+
+    @Synchronized
+    fun contains(id: String): Boolean = handle != 0L && nativeContains(handle, id)
+
+    @Synchronized
+    fun size(): Int = if (handle != 0L) nativeSize(handle) else 0
+
+    @Synchronized
+    override fun close() {
+        if (handle != 0L) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DATA CLASSES
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * One search result
+ */
+data class IndexHit(
+    val id: String,
+    val score: Float
+)
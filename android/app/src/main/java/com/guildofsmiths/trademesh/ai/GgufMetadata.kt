@@ -0,0 +1,152 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import org.json.JSONObject
+import java.io.File
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * GgufMetadata - Model details without loading the model
+ *
+ * Reads architecture, parameter count, quantization, trained context,
+ * chat template and tensor byte totals from the GGUF header via
+ * libsmith_native.so. Only header pages are touched (microseconds to a
+ * millisecond), so the model picker and memory budgeting no longer need
+ * a full nativeLoadModel.
+ *
+ * Results are cached per file, keyed by size and mtime.
+ */
+object GgufMetadata {
+
+    private const val TAG = "GgufMetadata"
+
+    private data class CacheKey(val path: String, val size: Long, val modified: Long)
+
+    private val cache = ConcurrentHashMap<CacheKey, ModelMetadata>()
+
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+
+    private external fun nativeReadMetadata(path: String): String
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Read metadata of a GGUF file.
+     *
+     * @param file The .gguf file
+     * @return Metadata, or null if the file is missing, malformed or the
+     *         native library is unavailable
+     */
+    suspend fun read(file: File): ModelMetadata? = withContext(Dispatchers.IO) {
+        if (!file.exists() || !SmithNative.available) {
+            return@withContext null
+        }
+
+        val key = CacheKey(file.absolutePath, file.length(), file.lastModified())
+        cache[key]?.let { return@withContext it }
+
+        try {
+            val json = JSONObject(nativeReadMetadata(file.absolutePath))
+            if (!json.optBoolean("ok", false)) {
+                Log.w(TAG, "${file.name}: ${json.optString("error")}")
+                return@withContext null
+            }
+
+            val types = json.optJSONArray("types")
+            val breakdown = (0 until (types?.length() ?: 0)).map { i ->
+                val t = types!!.getJSONObject(i)
+                TensorTypeBreakdown(
+                    type = t.optString("type"),
+                    tensorCount = t.optLong("n_tensors", 0),
+                    bytes = t.optLong("bytes", 0)
+                )
+            }
+
+            val metadata = ModelMetadata(
+                architecture = json.optString("architecture", ""),
+                name = json.optString("name", ""),
+                fileType = json.optInt("file_type", -1),
+                contextLength = json.optInt("context_length", 0),
+                embeddingLength = json.optInt("embedding_length", 0),
+                layerCount = json.optInt("block_count", 0),
+                headCount = json.optInt("head_count", 0),
+                headCountKv = json.optInt("head_count_kv", 0),
+                vocabSize = json.optInt("vocab_size", 0),
+                chatTemplate = json.optString("chat_template", ""),
+                fileSize = json.optLong("file_size", 0),
+                tensorCount = json.optLong("n_tensors", 0),
+                parameterCount = json.optLong("n_params", 0),
+                tensorBytes = json.optLong("tensor_bytes", 0),
+                kvBytesPerToken = json.optLong("kv_bytes_per_token", 0),
+                quantization = json.optString("dominant_type", ""),
+                tensorTypes = breakdown
+            )
+            Log.d(TAG, "${file.name}: ${metadata.summary} in ${json.optLong("elapsed_us")}us")
+
+            cache.keys.removeAll { it.path == key.path }
+            cache[key] = metadata
+            metadata
+        } catch (e: Exception) {
+            Log.e(TAG, "Metadata read error", e)
+            null
+        }
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DATA CLASSES
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * Model details read from the GGUF header
+ */
+data class ModelMetadata(
+    val architecture: String,
+    val name: String,
+    val fileType: Int,
+    val contextLength: Int,
+    val embeddingLength: Int,
+    val layerCount: Int,
+    val headCount: Int,
+    val headCountKv: Int,
+    val vocabSize: Int,
+    val chatTemplate: String,
+    val fileSize: Long,
+    val tensorCount: Long,
+    val parameterCount: Long,
+    val tensorBytes: Long,
+    val kvBytesPerToken: Long,
+    val quantization: String,
+    val tensorTypes: List<TensorTypeBreakdown>
+) {
+    val hasChatTemplate: Boolean get() = chatTemplate.isNotEmpty()
+
+    val parameterDisplay: String get() = when {
+        parameterCount >= 1_000_000_000 -> "%.1fB".format(parameterCount / 1_000_000_000f)
+        parameterCount >= 1_000_000 -> "${parameterCount / 1_000_000}M"
+        else -> "${parameterCount / 1_000}K"
+    }
+
+    /**
+     * Approximate resident memory for a context of nCtx tokens:
+     * weights plus an f16 KV cache (compute buffers not included).
+     */
+    fun estimateMemoryBytes(nCtx: Int): Long = tensorBytes + kvBytesPerToken * nCtx
+
+    val summary: String get() = "$architecture · $parameterDisplay · $quantization · ctx $contextLength"
+}
+
+/**
+ * Tensor count and size for one quantization type
+ */
+data class TensorTypeBreakdown(
+    val type: String,
+    val tensorCount: Long,
+    val bytes: Long
+)
@@ -0,0 +1,283 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.content.Context
+import android.os.PowerManager
+import android.util.Log
+import com.guildofsmiths.trademesh.data.JobRepository
+import com.guildofsmiths.trademesh.data.MessageRepository
+import com.guildofsmiths.trademesh.data.UserPreferences
+import kotlinx.coroutines.*
+import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.flow.StateFlow
+import kotlinx.coroutines.flow.asStateFlow
+import java.io.File
+import java.time.LocalDate
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * IdlePrecompute - Uses idle charging time to prepare for the day
+ *
+ * While the device is charging with the screen off and a model is loaded,
+ * the engine would otherwise sit unused. Each pass:
+ * 1. Warms the system prompt of every active job into the native prefix
+ *    cache, so questions about a job skip most of their prefill
+ * 2. Embeds knowledge chunks not yet indexed and warms the most retrieved
+ *    ones behind the reasoning prompt header ([KnowledgeBase])
+ * 3. Embeds messages not yet in the message index
+ * 4. Answers predictable daily questions ahead of time
+ *
+ * All work is submitted at [InferencePriority.IDLE]: any real request
+ * preempts it at the next token or prefill slice. A pass stops as soon as
+ * a step yields and resumes in the next idle window.
+ */
+object IdlePrecompute {
+
+    private const val TAG = "IdlePrecompute"
+
+    private const val CHECK_INTERVAL_MS = 2 * 60 * 1000L
+    private const val MAX_WARM_JOBS = 5
+    private const val MAX_PRECOMPUTE_JOBS = 3
+    private const val EMBED_CHUNK = 16
+    private const val MAX_EMBED_PER_PASS = 128
+    private const val ANSWER_MAX_TOKENS = 150
+    private const val INDEX_FILE = "message_index.svx"
+
+    // Questions crews ask most mornings, answered per active job
+    private val DAILY_QUESTIONS = listOf(
+        "What safety checks should I do before starting today?",
+        "What materials should I double-check for today's work?",
+        "Give me an end-of-day wrap-up checklist."
+    )
+
+    // The prompt the answers are generated with; only cues asked the same way get them
+    private val ANSWER_CONTEXT = MessageContext.CHAT
+    private val ANSWER_INTENT = AIIntent.NONE
+
+    private val scope = CoroutineScope(Dispatchers.Default + SupervisorJob())
+
+    private var context: Context? = null
+    private var powerManager: PowerManager? = null
+    private var loopJob: Job? = null
+
+    @Volatile private var messageIndex: EmbeddingIndex? = null
+    private val indexLock = Any()
+
+    // Normalized question + job -> answer, valid for answerDay only
+    private val answers = ConcurrentHashMap<String, String>()
+    @Volatile private var answerDay: Long = -1
+
+    private val _lastPass = MutableStateFlow<PrecomputePass?>(null)
+    val lastPass: StateFlow<PrecomputePass?> = _lastPass.asStateFlow()
+
+    // ════════════════════════════════════════════════════════════════════
+    // LIFECYCLE
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Start watching for idle charging windows. Call once at app startup.
+     */
+    fun initialize(appContext: Context) {
+        if (loopJob != null) return
+        context = appContext.applicationContext
+        powerManager = appContext.getSystemService(Context.POWER_SERVICE) as? PowerManager
+
+        // Answers and warmed prefixes belong to the model that produced them
+        scope.launch {
+            LlamaInference.modelState.collect { state ->
+                if (state != ModelState.READY) answers.clear()
+            }
+        }
+
+        loopJob = scope.launch {
+            while (isActive) {
+                delay(CHECK_INTERVAL_MS)
+                if (isIdleWindow()) {
+                    try {
+                        runPass()
+                    } catch (e: CancellationException) {
+                        throw e
+                    } catch (e: Exception) {
+                        Log.w(TAG, "Precompute pass failed", e)
+                    }
+                }
+            }
+        }
+        Log.i(TAG, "IdlePrecompute initialized")
+    }
+
+    fun shutdown() {
+        scope.cancel()
+        loopJob = null
+        synchronized(indexLock) {
+            messageIndex?.close()
+            messageIndex = null
+        }
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Today's precomputed answer for a query, if it is one of the daily
+     * questions (case and punctuation ignored) for this job, asked in the
+     * context and with the intent the answers were generated for.
+     */
+    fun precomputedAnswer(query: String, context: MessageContext, intent: AIIntent, jobTitle: String?): String? {
+        if (answerDay != LocalDate.now().toEpochDay()) return null
+        return answers[answerKey(query, context, intent, jobTitle)]
+    }
+
+    /**
+     * Messages most similar to text, from the index built while idle.
+     * Embeds text at normal priority.
+     */
+    suspend fun findSimilarMessages(text: String, k: Int = 5): List<IndexHit> {
+        val info = LlamaInference.modelInfo.value ?: return emptyList()
+        val index = messageIndex?.takeIf { it.fingerprint == info.fingerprint } ?: return emptyList()
+        val query = LlamaInference.embed(listOf(text), InferencePriority.NORMAL)?.firstOrNull()
+            ?: return emptyList()
+        return index.search(query, k)
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - PASS
+    // ════════════════════════════════════════════════════════════════════
+
+    private fun isIdleWindow(): Boolean {
+        return BatteryGate.gateState.value.isCharging &&
+               powerManager?.isInteractive == false &&
+               AIRouter.isEnabled() &&
+               !AIRouter.isProcessing.value &&
+               LlamaInference.modelState.value == ModelState.READY
+    }
+
+    private suspend fun runPass() {
+        var pass = PrecomputePass(timestamp = System.currentTimeMillis())
+        val role = UserPreferences.getTradeRole()
+        val header = AgentInitializer.reasoningHeader(role)
+        pass = pass.copy(promptsWarmed = warmJobPrompts() ?: return finishPass(pass, yielded = true))
+        pass = pass.copy(chunksIndexed = KnowledgeBase.indexPending(role, ::isIdleWindow)
+            ?: return finishPass(pass, yielded = true))
+        pass = pass.copy(chunksWarmed = KnowledgeBase.warmPopular(header, role, ::isIdleWindow)
+            ?: return finishPass(pass, yielded = true))
+        pass = pass.copy(messagesEmbedded = embedNewMessages() ?: return finishPass(pass, yielded = true))
+        pass = pass.copy(answersPrecomputed = precomputeDailyAnswers() ?: return finishPass(pass, yielded = true))
+        finishPass(pass, yielded = false)
+    }
+
+    private fun finishPass(counts: PrecomputePass, yielded: Boolean) {
+        val pass = counts.copy(durationMs = System.currentTimeMillis() - counts.timestamp, yielded = yielded)
+        _lastPass.value = pass
+        Log.i(TAG, "Pass: ${pass.promptsWarmed} prompts warmed, ${pass.chunksIndexed} chunks indexed, " +
+                "${pass.chunksWarmed} chunks warm, ${pass.messagesEmbedded} messages embedded, " +
+                "${pass.answersPrecomputed} answers in ${pass.durationMs}ms${if (yielded) " (yielded)" else ""}")
+    }
+
+    /** @return prompts now cached, or null if the engine was needed elsewhere */
+    private suspend fun warmJobPrompts(): Int? {
+        val jobs = listOf<String?>(null) + JobRepository.getActiveJobTitles().take(MAX_WARM_JOBS)
+        var warmed = 0
+        for (job in jobs) {
+            val prefix = AIRouter.systemPromptBlock(MessageContext.CHAT, AIIntent.NONE, job)
+            if (!isIdleWindow() || !LlamaInference.warmPrefix(prefix)) return null
+            warmed++
+        }
+        return warmed
+    }
+
+    /** @return messages added to the index, or null if interrupted */
+    private suspend fun embedNewMessages(): Int? {
+        val info = LlamaInference.modelInfo.value ?: return 0
+        val dimension = info.embeddingSize
+        val index = openIndex(dimension, info.fingerprint) ?: return 0
+        val pending = MessageRepository.getAllMessages()
+            .filter { it.content.isNotBlank() && !index.contains(it.id) }
+            .takeLast(MAX_EMBED_PER_PASS)
+        var added = 0
+        for (chunk in pending.chunked(EMBED_CHUNK)) {
+            if (!isIdleWindow()) return null
+            val vectors = LlamaInference.embed(chunk.map { it.content }) ?: return null
+            if (vectors.any { it.size != dimension }) return added
+            added += index.add(chunk.map { it.id }, vectors).coerceAtLeast(0)
+        }
+        return added
+    }
+
+    /** @return answers generated this pass, or null if interrupted */
+    private suspend fun precomputeDailyAnswers(): Int? {
+        val today = LocalDate.now().toEpochDay()
+        if (answerDay != today) {
+            answers.clear()
+            answerDay = today
+        }
+
+        val jobs = listOf<String?>(null) + JobRepository.getActiveJobTitles().take(MAX_PRECOMPUTE_JOBS)
+        val todo = jobs.flatMap { job -> DAILY_QUESTIONS.map { q -> q to job } }
+            .filter { (q, job) -> !answers.containsKey(answerKey(q, ANSWER_CONTEXT, ANSWER_INTENT, job)) }
+        if (todo.isEmpty()) return 0
+        if (!isIdleWindow()) return null
+
+        val results = LlamaInference.generateBatch(
+            prompts = todo.map { (q, job) ->
+                AIRouter.buildChatPrompt(q, ANSWER_CONTEXT, ANSWER_INTENT, job)
+            },
+            params = todo.map { GenerationParams(maxTokens = ANSWER_MAX_TOKENS, temperature = 0.7f) },
+            priority = InferencePriority.IDLE
+        )
+        var answered = 0
+        todo.zip(results).forEach { (item, result) ->
+            val text = result.text.trim()
+            if (result.ok && text.isNotEmpty()) {
+                answers[answerKey(item.first, ANSWER_CONTEXT, ANSWER_INTENT, item.second)] = text
+                answered++
+            }
+        }
+        // A preempted batch keeps its finished items; the rest come next time
+        return if (answered < todo.size) null else answered
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - UTILITIES
+    // ════════════════════════════════════════════════════════════════════
+
+    // Reopened (and started over) when another model is loaded
+    private fun openIndex(dimension: Int, fingerprint: Long): EmbeddingIndex? {
+        messageIndex?.let { if (it.dimension == dimension && it.fingerprint == fingerprint) return it }
+        synchronized(indexLock) {
+            messageIndex?.let {
+                if (it.dimension == dimension && it.fingerprint == fingerprint) return it
+                it.close()
+            }
+            val ctx = context ?: return null
+            messageIndex = EmbeddingIndex.open(File(ctx.filesDir, INDEX_FILE), dimension, fingerprint)
+            return messageIndex
+        }
+    }
+
+    private fun answerKey(query: String, context: MessageContext, intent: AIIntent, jobTitle: String?): String {
+        val normalized = query.lowercase()
+            .replace(Regex("[^\\p{L}\\p{N}\\s]"), "")
+            .replace(Regex("\\s+"), " ")
+            .trim()
+        return "$normalized|$context|$intent|${jobTitle ?: ""}"
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DATA CLASSES
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * Outcome of one idle precompute pass
+ */
+data class PrecomputePass(
+    val timestamp: Long,
+    val durationMs: Long = 0,
+    val promptsWarmed: Int = 0,
+    val chunksIndexed: Int = 0,
+    val chunksWarmed: Int = 0,   // popular knowledge chunks cached behind the reasoning header
+    val messagesEmbedded: Int = 0,
+    val answersPrecomputed: Int = 0,
+    val yielded: Boolean = false     // stopped early because real work arrived
+)
@@ -0,0 +1,94 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.app.Service
+import android.content.Intent
+import android.os.Binder
+import android.os.IBinder
+import android.os.Parcel
+import android.os.ParcelFileDescriptor
+import android.util.Log
+import kotlin.concurrent.thread
+
+/**
+ * InferenceWorkerService - Hosts the LLM engine in its own process
+ *
+ * Declared with android:process=":inference", so the model's memory is
+ * charged to this process. If the system kills it under memory pressure
+ * or inference crashes, messaging in the main process carries on and
+ * LlamaInference reconnects and reloads.
+ *
+ * The app binds, then hands over the worker's ends of a shared-memory
+ * channel (prompts and streamed tokens in the shared rings, cancellation
+ * and liveness on the socket). The engine serves that channel on its own
+ * thread until the app closes it or dies.
+ */
+class InferenceWorkerService : Service() {
+
+    companion object {
+        private const val TAG = "InferenceWorker"
+        const val DESCRIPTOR = "com.guildofsmiths.trademesh.ai.InferenceWorker"
+        const val TRANSACTION_CONNECT = IBinder.FIRST_CALL_TRANSACTION
+
+        /** True in the worker process, where app-wide initialization is skipped. */
+        fun isWorkerProcess(processName: String): Boolean = processName.endsWith(":inference")
+    }
+
+    private val libraryLoaded: Boolean by lazy {
+        try {
+            LlamaInference.loadNativeLibrary()
+            true
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Failed to load native library", e)
+            false
+        }
+    }
+
+    // Plain Binder transaction: one call carrying two descriptors needs no AIDL
+    private val binder = object : Binder() {
+        override fun onTransact(code: Int, data: Parcel, reply: Parcel?, flags: Int): Boolean {
+            if (code != TRANSACTION_CONNECT) {
+                return super.onTransact(code, data, reply, flags)
+            }
+            data.enforceInterface(DESCRIPTOR)
+            val control = data.readFileDescriptor()
+            val shm = data.readFileDescriptor()
+            val ok = control != null && shm != null && serve(control, shm)
+            reply?.writeInt(if (ok) 1 else 0)
+            return true
+        }
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+
+    private external fun nativeServe(controlFd: Int, shmFd: Int): Int
+
+    // ════════════════════════════════════════════════════════════════════
+    // LIFECYCLE
+    // ════════════════════════════════════════════════════════════════════
+
+    override fun onBind(intent: Intent?): IBinder = binder
+
+    override fun onDestroy() {
+        Log.i(TAG, "Worker service destroyed")
+        super.onDestroy()
+    }
+
+    private fun serve(control: ParcelFileDescriptor, shm: ParcelFileDescriptor): Boolean {
+        if (!libraryLoaded) {
+            control.close()
+            shm.close()
+            return false
+        }
+        // Ownership passes to native code, which closes both
+        val controlFd = control.detachFd()
+        val shmFd = shm.detachFd()
+        thread(name = "inference-worker") {
+            Log.i(TAG, "Serving inference channel")
+            val code = nativeServe(controlFd, shmFd)
+            Log.i(TAG, "Inference channel closed (code $code)")
+        }
+        return true
+    }
+}
@@ -0,0 +1,295 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.content.Context
+import android.util.Log
+import com.guildofsmiths.trademesh.data.OccupationalForms
+import com.guildofsmiths.trademesh.data.TradeRole
+import kotlinx.coroutines.*
+import org.json.JSONObject
+import java.io.File
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
+
+/**
+ * KnowledgeBase - Retrieval over the bundled instructions and role guides
+ *
+ * Instead of inlining a role's whole knowledge into every prompt, the
+ * documents are chunked (TextChunker), embedded while idle into an
+ * [EmbeddingIndex], and a query gets only its top-k chunks:
+ * - Sources: the instruction corpus bundled as assets/knowledge/*.txt and
+ *   a document built from the user's [OccupationalForms] knowledge.
+ *   Identical chunks (duplicate documents) are stored once.
+ * - Every retrieval counts as a hit for its chunks; counts persist.
+ * - [warmPopular] prefills "prompt header + chunk" for the most hit
+ *   chunks into the native prefix cache, which keeps them on disk, and
+ *   [retrieve] puts a warmed chunk first after that header. Its KV is then
+ *   restored instead of computed; the other chunks are prefilled.
+ *
+ * Until the chunks are embedded (first idle window with a model loaded)
+ * [retrieve] returns nothing and callers keep their inline guidance.
+ */
+object KnowledgeBase {
+
+    private const val TAG = "KnowledgeBase"
+
+    private const val ASSET_DIR = "knowledge"
+    private const val INDEX_FILE = "knowledge_index.svx"
+    private const val HITS_FILE = "knowledge_hits.log"
+
+    const val DEFAULT_TOP_K = 3
+    // Cosine similarity below which a chunk is unrelated to the query
+    private const val MIN_SCORE = 0.35f
+    private const val EMBED_CHUNK = 16
+    private const val MAX_EMBED_PER_PASS = 128
+    private const val MAX_WARM_CHUNKS = 8
+    private const val MIN_WARM_HITS = 2
+
+    private val scope = CoroutineScope(Dispatchers.Default + SupervisorJob())
+
+    private var context: Context? = null
+
+    // Chunk id -> text, for the corpus plus the current role's guide
+    @Volatile private var chunks: Map<String, String> = emptyMap()
+    @Volatile private var chunksRole: TradeRole? = null
+    private val chunksLock = Any()
+
+    @Volatile private var index: EmbeddingIndex? = null
+    private val indexLock = Any()
+
+    private var hitLog: RecordLog? = null
+    private val hits = ConcurrentHashMap<String, Int>()
+
+    // "header|chunk" prefixes warmed for the loaded model
+    private val warmed = ConcurrentHashMap.newKeySet<String>()
+
+    // ════════════════════════════════════════════════════════════════════
+    // LIFECYCLE
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Load hit counts. Call once at app startup; chunks are read on first use.
+     */
+    fun initialize(appContext: Context) {
+        if (context != null) return
+        context = appContext.applicationContext
+        hitLog = RecordLog.open(File(appContext.filesDir, HITS_FILE))
+        hitLog?.values()?.forEach { value ->
+            try {
+                val json = JSONObject(value)
+                hits[json.getString("id")] = json.getInt("hits")
+            } catch (e: Exception) {
+                Log.w(TAG, "Skipping bad hit record", e)
+            }
+        }
+
+        // Warmed prefixes belong to the model that computed them
+        scope.launch {
+            LlamaInference.modelState.collect { state ->
+                if (state != ModelState.READY) warmed.clear()
+            }
+        }
+        Log.i(TAG, "KnowledgeBase initialized (${hits.size} chunks with hits)")
+    }
+
+    fun shutdown() {
+        scope.cancel()
+        synchronized(indexLock) {
+            index?.close()
+            index = null
+        }
+        hitLog?.close()
+        hitLog = null
+        context = null
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * The k chunks most relevant to [query] for [role], best first, except
+     * that a chunk already warmed after [header] (or else the most popular
+     * one) leads: callers place the chunks right after [header] in that
+     * order. Embeds the query at normal priority.
+     *
+     * @return Chunks, empty if none is relevant or the index is not built yet
+     */
+    suspend fun retrieve(
+        query: String,
+        role: TradeRole,
+        header: String,
+        k: Int = DEFAULT_TOP_K
+    ): List<KnowledgeChunk> {
+        val info = LlamaInference.modelInfo.value ?: return emptyList()
+        val available = chunksFor(role)
+        val idx = openIndex(info)?.takeIf { it.size() > 0 } ?: return emptyList()
+        val vector = LlamaInference.embed(listOf(query), InferencePriority.NORMAL)?.firstOrNull()
+            ?: return emptyList()
+
+        // Over-fetch: the index also holds chunks of other roles' guides
+        val found = idx.search(vector, k * 4)
+            .filter { it.score >= MIN_SCORE }
+            .mapNotNull { hit -> available[hit.id]?.let { KnowledgeChunk(hit.id, it, hit.score) } }
+            .take(k)
+        if (found.isEmpty()) return emptyList()
+        found.forEach { recordHit(it.id) }
+
+        val lead = found.firstOrNull { warmKey(header, it.id) in warmed }
+            ?: found.maxBy { hits[it.id] ?: 0 }
+        return listOf(lead) + found.filter { it !== lead }
+    }
+
+    /**
+     * Embed chunks not yet in the index, a few at a time while [idle].
+     * @return chunks added, or null if interrupted
+     */
+    suspend fun indexPending(role: TradeRole, idle: () -> Boolean): Int? {
+        val info = LlamaInference.modelInfo.value ?: return 0
+        val dimension = info.embeddingSize
+        val idx = openIndex(info) ?: return 0
+        val pending = chunksFor(role).entries
+            .filter { !idx.contains(it.key) }
+            .take(MAX_EMBED_PER_PASS)
+        var added = 0
+        for (batch in pending.chunked(EMBED_CHUNK)) {
+            if (!idle()) return null
+            val vectors = LlamaInference.embed(batch.map { it.value }) ?: return null
+            if (vectors.any { it.size != dimension }) return added
+            added += idx.add(batch.map { it.key }, vectors).coerceAtLeast(0)
+        }
+        return added
+    }
+
+    /**
+     * Prefill [header] + chunk for the most retrieved chunks of [role], so
+     * prompts that lead with one skip both. Entries persist in the prefix
+     * cache's directory; already cached ones finish at once.
+     * @return chunks warmed, or null if interrupted
+     */
+    suspend fun warmPopular(header: String, role: TradeRole, idle: () -> Boolean): Int? {
+        val available = chunksFor(role)
+        val popular = hits.entries
+            .filter { it.value >= MIN_WARM_HITS && it.key in available }
+            .sortedByDescending { it.value }
+            .take(MAX_WARM_CHUNKS)
+        var count = 0
+        for ((id, _) in popular) {
+            val key = warmKey(header, id)
+            if (key !in warmed) {
+                if (!idle() || !LlamaInference.warmPrefix(header + chunkBlock(available.getValue(id)))) return null
+                warmed.add(key)
+            }
+            count++
+        }
+        return count
+    }
+
+    /** Text a chunk occupies in a prompt; warmed prefixes end with it. */
+    fun chunkBlock(text: String): String = "$text\n\n"
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - CHUNKS
+    // ════════════════════════════════════════════════════════════════════
+
+    private suspend fun chunksFor(role: TradeRole): Map<String, String> {
+        if (chunksRole == role) return chunks
+        return withContext(Dispatchers.IO) {
+            synchronized(chunksLock) {
+                if (chunksRole != role) {
+                    val documents = readCorpus() + roleDocument(OccupationalForms.getKnowledgeBase(role))
+                    val map = LinkedHashMap<String, String>()
+                    for (document in documents) {
+                        val pieces = TextChunker.chunk(document) ?: break
+                        pieces.forEach { map.putIfAbsent(chunkId(it), it) }
+                    }
+                    chunks = map
+                    chunksRole = role
+                    Log.i(TAG, "${map.size} chunks from ${documents.size} documents for ${role.displayName}")
+                }
+                chunks
+            }
+        }
+    }
+
+    private fun readCorpus(): List<String> {
+        val assets = context?.assets ?: return emptyList()
+        return try {
+            assets.list(ASSET_DIR).orEmpty().filter { it.endsWith(".txt") }.sorted().map { name ->
+                assets.open("$ASSET_DIR/$name").use { it.readBytes().toString(Charsets.UTF_8) }
+            }
+        } catch (e: Exception) {
+            Log.w(TAG, "Cannot read knowledge assets", e)
+            emptyList()
+        }
+    }
+
+    // Headings in capitals so the chunker cuts between sections
+    private fun roleDocument(kb: OccupationalForms.RoleKnowledgeBase): String {
+        val role = kb.role.displayName.uppercase()
+        fun StringBuilder.section(title: String, lines: List<String>) {
+            if (lines.isEmpty()) return
+            append("$role - $title\n")
+            lines.forEach { append("- ").append(it).append('\n') }
+            append('\n')
+        }
+        return buildString {
+            section("CORE SKILLS", kb.coreSkills)
+            section("PROCEDURES", kb.procedures)
+            section("TOOLS AND DEXTERITY", kb.tools.map {
+                "${it.name}: ${it.dexterityNotes} Fatigue risk: ${it.fatigueRisk}. Grip: ${it.gripTechnique}"
+            })
+            section("REGULATIONS", kb.regulations)
+            section("SAFETY PROTOCOLS", kb.safetyProtocols)
+            section("BREAK REMINDERS", kb.breakReminders)
+            section("TASK BREAKDOWNS", kb.taskBreakdowns.map { (task, steps) -> "$task: ${steps.joinToString("; ")}" })
+            section("COMMON PATTERNS", kb.commonPatterns)
+        }
+    }
+
+    private fun chunkId(text: String): String {
+        val digest = MessageDigest.getInstance("SHA-1").digest(text.toByteArray(Charsets.UTF_8))
+        return digest.take(8).joinToString("") { "%02x".format(it) }
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - UTILITIES
+    // ════════════════════════════════════════════════════════════════════
+
+    private fun recordHit(id: String) {
+        val count = hits.merge(id, 1, Int::plus) ?: 1
+        hitLog?.put(id, JSONObject().put("id", id).put("hits", count).toString())
+    }
+
+    private fun warmKey(header: String, id: String): String = "${header.hashCode()}|$id"
+
+    // Reopened (and started over) when another model is loaded
+    private fun openIndex(info: ModelInfo): EmbeddingIndex? {
+        fun matches(idx: EmbeddingIndex) = idx.dimension == info.embeddingSize && idx.fingerprint == info.fingerprint
+        index?.let { if (matches(it)) return it }
+        synchronized(indexLock) {
+            index?.let {
+                if (matches(it)) return it
+                it.close()
+            }
+            val ctx = context ?: return null
+            index = EmbeddingIndex.open(File(ctx.filesDir, INDEX_FILE), info.embeddingSize, info.fingerprint)
+            return index
+        }
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DATA CLASSES
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * One retrieved chunk.
+ *
+ * @property id Hash of the text; the same in every document it appears in
+ * @property score Cosine similarity to the query
+ */
+data class KnowledgeChunk(
+    val id: String,
+    val text: String,
+    val score: Float
+)
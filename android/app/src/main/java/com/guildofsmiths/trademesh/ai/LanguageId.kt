@@ -0,0 +1,87 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import org.json.JSONObject
+
+/**
+ * LanguageId - Native language identification for translation routing
+ *
+ * Classifies a message in microseconds with the character n-gram model in
+ * libsmith_native.so (lang_id.cpp): script detection for ru/ar/hi/zh/ja/ko,
+ * naive Bayes over hashed n-grams for en/es/fr/pt/de. Confidences let
+ * callers send text to the LLM for translation only when it is clearly
+ * foreign.
+ *
+ * Safe from any thread. Returns null when the library is missing, so
+ * callers keep their own heuristics as a fallback.
+ */
+object LanguageId {
+
+    private const val TAG = "LanguageId"
+
+    /**
+     * Below this a non-English guess is not worth a translation. The one
+     * bar for explicit @AI requests and ambient offers alike; the model
+     * already leans English, so short English text stays well under it.
+     */
+    const val TRANSLATE_CONFIDENCE = 0.65f
+
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+
+    private external fun nativeIdentify(text: ByteArray, topK: Int): String
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Most likely languages of [text], best first. Latin text too short to
+     * tell (under 8 letters) comes back as "unknown".
+     *
+     * @return Guesses (empty if the text has no letters), or null if unavailable
+     */
+    fun identify(text: String, topK: Int = 3): List<LanguageGuess>? {
+        if (!SmithNative.available) return null
+        return try {
+            val json = JSONObject(nativeIdentify(text.toByteArray(Charsets.UTF_8), topK))
+            val langs = json.getJSONArray("langs")
+            val scores = json.getJSONArray("scores")
+            List(langs.length()) { i ->
+                val lang = langs.getString(i).takeIf { it != "und" } ?: "unknown"
+                LanguageGuess(lang, scores.getDouble(i).toFloat())
+            }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Language identification unavailable", e)
+            null
+        } catch (e: Exception) {
+            Log.w(TAG, "Language identification failed", e)
+            null
+        }
+    }
+
+    /**
+     * Best guess for [text]: "unknown" with confidence 0 if it has no
+     * letters, null if unavailable.
+     */
+    fun detect(text: String): LanguageGuess? {
+        val guesses = identify(text, topK = 1) ?: return null
+        return guesses.firstOrNull() ?: LanguageGuess("unknown", 0f)
+    }
+}
+
+/**
+ * One language guess.
+ *
+ * @property lang ISO 639-1 code ("en", "es", ...)
+ * @property confidence 0..1
+ */
+data class LanguageGuess(
+    val lang: String,
+    val confidence: Float
+) {
+    /** Foreign with enough confidence to be worth translating */
+    val needsTranslation: Boolean
+        get() = lang != "en" && lang != "unknown" && confidence >= LanguageId.TRANSLATE_CONFIDENCE
+}
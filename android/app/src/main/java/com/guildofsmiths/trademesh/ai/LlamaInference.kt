@@ -1,14 +1,33 @@
 package com.guildofsmiths.trademesh.ai
 
+import android.content.ComponentName
 import android.content.Context
+import android.content.Intent
+import android.content.ServiceConnection
+import android.os.IBinder
+import android.os.Parcel
+import android.os.ParcelFileDescriptor
+import android.os.SystemClock
 import android.util.Log
+import kotlinx.coroutines.CancellableContinuation
+import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.asStateFlow
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.suspendCancellableCoroutine
 import kotlinx.coroutines.withContext
 import org.json.JSONObject
 import java.io.File
+import java.nio.ByteBuffer
+import java.security.MessageDigest
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.CountDownLatch
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.atomic.AtomicLong
+import kotlin.coroutines.resume
 
 /**
  * LlamaInference - JNI wrapper for llama.cpp on-device LLM inference
@@ -21,17 +40,48 @@ import java.io.File
  * - Text generation with configurable parameters
  * - Cancellation support
  * - Thread-safe operations
+ * - Asynchronous generation: requests are queued to a native worker
+ *   thread and callers suspend until its completion callback, so no
+ *   thread is parked for the length of a generation
+ * - Batched generation: queued prompts run as parallel sequences of one
+ *   context, sharing their common prompt prefix
+ * - Out-of-process engine: by default the model lives in
+ *   InferenceWorkerService's process, so an OOM kill or crash there costs
+ *   the model, not the app; requests and tokens cross in shared memory
+ * - Checkpointing: long generations submitted with a checkpoint key are
+ *   saved to disk periodically and continue after process death
+ * - Lazy native loading: libllama_jni.so is not touched until the first
+ *   real AI use, so app start pays nothing for users with AI disabled
+ * - Mesh compression: short messages are arithmetic-coded against the
+ *   model's next-token predictions, so peers with the same model fit far
+ *   more text into a BLE beacon
  */
 object LlamaInference {
     
     private const val TAG = "LlamaInference"
     
+    // Same JNI surface; the dotprod build (arm64 only) has the Q4_0_4_4 kernels
+    private const val BASE_LIBRARY = "llama_jni"
+    private const val DOTPROD_LIBRARY = "llama_jni_dotprod"
+    
     // Default inference parameters
-    private const val DEFAULT_CONTEXT_SIZE = 2048
+    const val DEFAULT_CONTEXT_SIZE = 2048
     private const val DEFAULT_MAX_TOKENS = 256
     private const val DEFAULT_TEMPERATURE = 0.7f
     private const val DEFAULT_THREADS = 4
     
+    // Checkpoints left by requests nobody resubmitted
+    private const val CHECKPOINT_DIR = "generation_checkpoints"
+    private const val CHECKPOINT_MAX_AGE_MS = 2 * 24 * 60 * 60 * 1000L
+    
+    // Warmed prefixes (job system prompts, knowledge chunks) kept across restarts
+    private const val PREFIX_CACHE_DIR = "prefix_cache"
+    private const val PREFIX_CACHE_MAX_BYTES = 256L * 1024 * 1024
+    
+    // Worker process: bind timeout, and no automatic reload after a second loss within this window
+    private const val WORKER_BIND_TIMEOUT_MS = 5000L
+    private const val WORKER_RELOAD_BACKOFF_MS = 60_000L
+    
     // Model state
     private val _modelState = MutableStateFlow(ModelState.NOT_LOADED)
     val modelState: StateFlow<ModelState> = _modelState.asStateFlow()
@@ -39,17 +89,92 @@ object LlamaInference {
     private val _modelInfo = MutableStateFlow<ModelInfo?>(null)
     val modelInfo: StateFlow<ModelInfo?> = _modelInfo.asStateFlow()
     
-    private var isInitialized = false
+    private val _initMetrics = MutableStateFlow<NativeInitMetrics?>(null)
+    val initMetrics: StateFlow<NativeInitMetrics?> = _initMetrics.asStateFlow()
+    
+    @Volatile private var isInitialized = false
+    @Volatile private var libraryLoaded = false
+    private val initLock = Any()
     private var modelPath: String? = null
+    @Volatile private var modelFingerprint = 0L
+    @Volatile private var checkpointDir: String? = null
+    @Volatile private var prefixCacheDir: String? = null
     
-    // Load native library
-    init {
-        try {
-            System.loadLibrary("llama_jni")
-            Log.i(TAG, "Native library loaded successfully")
-        } catch (e: UnsatisfiedLinkError) {
-            Log.e(TAG, "Failed to load native library", e)
+    // Worker process state
+    @Volatile private var appContext: Context? = null
+    @Volatile private var useWorkerProcess = false
+    @Volatile private var workerConnected = false
+    @Volatile private var workerBinder: IBinder? = null
+    private var workerConnection: ServiceConnection? = null
+    private var lastWorkerLoss = 0L
+    private val recoveryScope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    
+    // In-flight requests, completed from the native worker thread.
+    // Ids are allocated here so a callback can never beat its registration.
+    private val pendingRequests = ConcurrentHashMap<Long, PendingRequest>()
+    private val nextRequestId = AtomicLong(0)
+    
+    private class PendingRequest(
+        val continuation: CancellableContinuation<GenerationResult>,
+        val onText: ((String) -> Unit)?,
+        val startTime: Long
+    )
+    
+    private val pendingBatches = ConcurrentHashMap<Long, CancellableContinuation<List<BatchItemResult>>>()
+    private val pendingEmbeddings = ConcurrentHashMap<Long, CancellableContinuation<List<FloatArray>?>>()
+    private val pendingCodec = ConcurrentHashMap<Long, CancellableContinuation<ByteArray?>>()
+    
+    /**
+     * Load libllama_jni.so (dlopen) on first real use. The heavy llama code
+     * lives only in that library, so nothing is mapped until this runs.
+     */
+    private fun ensureLibraryLoaded(): Boolean {
+        if (libraryLoaded) return true
+        synchronized(initLock) {
+            if (libraryLoaded) return true
+            val start = SystemClock.elapsedRealtime()
+            return try {
+                val name = loadNativeLibrary()
+                libraryLoaded = true
+                val elapsed = SystemClock.elapsedRealtime() - start
+                _initMetrics.value = NativeInitMetrics(libraryLoadMs = elapsed, backendInitMs = 0)
+                Log.i(TAG, "Native library lib$name.so loaded in ${elapsed}ms (deferred from app start)")
+                true
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e(TAG, "Failed to load native library", e)
+                false
+            }
+        }
+    }
+    
+    /**
+     * Load the llama JNI build for this CPU: libllama_jni_dotprod.so where the
+     * CPU has dotprod (asimddp), else the ARMv8-A baseline. Also used by
+     * InferenceWorkerService. Returns the library name; throws
+     * UnsatisfiedLinkError if neither loads.
+     */
+    internal fun loadNativeLibrary(): String {
+        if (cpuHasDotprod()) {
+            try {
+                System.loadLibrary(DOTPROD_LIBRARY)
+                return DOTPROD_LIBRARY
+            } catch (e: UnsatisfiedLinkError) {
+                Log.w(TAG, "lib$DOTPROD_LIBRARY.so not packaged for this ABI", e)
+            }
+        }
+        System.loadLibrary(BASE_LIBRARY)
+        return BASE_LIBRARY
+    }
+    
+    // Android has no Java API for hwcaps; the kernel lists them in /proc/cpuinfo
+    private fun cpuHasDotprod(): Boolean = try {
+        File("/proc/cpuinfo").useLines { lines ->
+            lines.any { line ->
+                line.startsWith("Features") && line.substringAfter(':').split(' ', '\t').contains("asimddp")
+            }
         }
+    } catch (e: Exception) {
+        false
     }
     
     // ════════════════════════════════════════════════════════════════════
@@ -58,19 +183,60 @@ object LlamaInference {
     
     private external fun nativeInit(): Boolean
     private external fun nativeLoadModel(modelPath: String, nCtx: Int, nThreads: Int): Boolean
-    private external fun nativeGenerate(prompt: String, maxTokens: Int, temperature: Float): String
+    private external fun nativeSubmit(
+        requestId: Long,
+        prompt: String,
+        maxTokens: Int,
+        temperature: Float,
+        stream: Boolean,
+        priority: Int,
+        checkpointKey: String?
+    ): Boolean
+    private external fun nativeSubmitBatch(
+        requestId: Long,
+        prompts: Array<String>,
+        maxTokens: IntArray,
+        temperatures: FloatArray,
+        priority: Int
+    ): Boolean
+    private external fun nativeSubmitWarm(requestId: Long, prompt: String, priority: Int): Boolean
+    private external fun nativeSubmitEmbed(requestId: Long, texts: Array<String>, priority: Int): Boolean
+    private external fun nativeSubmitCodec(
+        requestId: Long,
+        decode: Boolean,
+        data: ByteArray,
+        maxBytes: Int,
+        priority: Int
+    ): Boolean
+    private external fun nativeConnectWorker(): IntArray?
+    private external fun nativeSetCheckpointDir(dir: String)
+    private external fun nativeSetPrefixCacheDir(dir: String, maxBytes: Long)
+    private external fun nativeCancelRequest(requestId: Long)
     private external fun nativeCancelGeneration()
     private external fun nativeUnloadModel()
     private external fun nativeIsModelLoaded(): Boolean
     private external fun nativeFree()
     private external fun nativeGetModelInfo(): String
+    private external fun nativeAssemblePrompt(
+        texts: Array<String>,
+        priorities: IntArray,
+        minTokens: IntArray,
+        maxTokens: IntArray,
+        required: BooleanArray,
+        keepTail: BooleanArray,
+        budget: Int
+    ): ByteArray?
+    private external fun nativeGetOptimalLayout(): String
+    private external fun nativeRepackModel(srcPath: String, dstPath: String, nThreads: Int): String
     
     // ════════════════════════════════════════════════════════════════════
     // PUBLIC API
     // ════════════════════════════════════════════════════════════════════
     
     /**
-     * Initialize the llama backend. Call once at app startup.
+     * Load the native library and initialize the llama backend.
+     * Blocking - call off the main thread (see [initializeAsync]).
+     * Not needed at app startup: [loadModel] initializes on demand.
      */
     fun initialize(): Boolean {
         if (isInitialized) {
@@ -78,17 +244,87 @@ object LlamaInference {
             return true
         }
         
-        return try {
-            val result = nativeInit()
-            isInitialized = result
-            Log.i(TAG, "Initialization: ${if (result) "SUCCESS" else "FAILED"}")
-            result
-        } catch (e: Exception) {
-            Log.e(TAG, "Initialization error", e)
-            false
+        if (!ensureLibraryLoaded()) return false
+        
+        synchronized(initLock) {
+            if (isInitialized) return true
+            return try {
+                val start = SystemClock.elapsedRealtime()
+                val result = (useWorkerProcess && connectWorker()) || nativeInit()
+                val elapsed = SystemClock.elapsedRealtime() - start
+                if (result) checkpointDir?.let { nativeSetCheckpointDir(it) }
+                if (result) prefixCacheDir?.let { nativeSetPrefixCacheDir(it, PREFIX_CACHE_MAX_BYTES) }
+                isInitialized = result
+                _initMetrics.value = (_initMetrics.value ?: NativeInitMetrics(0, 0))
+                    .copy(backendInitMs = elapsed)
+                Log.i(TAG, "Initialization: ${if (result) "SUCCESS" else "FAILED"} " +
+                        "(backend init ${elapsed}ms, ${if (workerConnected) "worker process" else "in-process"})")
+                result
+            } catch (e: Exception) {
+                Log.e(TAG, "Initialization error", e)
+                false
+            }
         }
     }
     
+    /**
+     * Run the engine in InferenceWorkerService's process instead of this
+     * one. Applies from the next initialization, so call at startup.
+     */
+    fun configureWorkerProcess(context: Context, enabled: Boolean = true) {
+        appContext = context.applicationContext
+        useWorkerProcess = enabled
+    }
+    
+    /** True while the engine runs in the worker process. */
+    val isOutOfProcess: Boolean get() = workerConnected
+    
+    /**
+     * Enable generation checkpoints under the app's files directory and
+     * drop ones older than two days. Cheap; call once at startup, before
+     * any generation that passes a checkpoint key.
+     */
+    fun configureCheckpoints(context: Context) {
+        val dir = File(context.filesDir, CHECKPOINT_DIR)
+        if (!dir.isDirectory && !dir.mkdirs()) {
+            Log.w(TAG, "Cannot create checkpoint directory")
+            return
+        }
+        val cutoff = System.currentTimeMillis() - CHECKPOINT_MAX_AGE_MS
+        dir.listFiles()?.filter { it.name.endsWith(".tmp") || it.lastModified() < cutoff }?.forEach { it.delete() }
+        
+        checkpointDir = dir.absolutePath
+        synchronized(initLock) {
+            if (isInitialized) nativeSetCheckpointDir(dir.absolutePath)
+        }
+    }
+    
+    /**
+     * Keep warmed prompt prefixes under the app's files directory, so a
+     * prefix is prefilled once per model rather than after every restart
+     * or eviction. Entries for other models are deleted at load. Call
+     * once at startup.
+     */
+    fun configurePrefixCache(context: Context) {
+        val dir = File(context.filesDir, PREFIX_CACHE_DIR)
+        if (!dir.isDirectory && !dir.mkdirs()) {
+            Log.w(TAG, "Cannot create prefix cache directory")
+            return
+        }
+        
+        prefixCacheDir = dir.absolutePath
+        synchronized(initLock) {
+            if (isInitialized) nativeSetPrefixCacheDir(dir.absolutePath, PREFIX_CACHE_MAX_BYTES)
+        }
+    }
+    
+    /**
+     * Initialize on the IO dispatcher. Safe to call from the main thread.
+     */
+    suspend fun initializeAsync(): Boolean = withContext(Dispatchers.IO) {
+        initialize()
+    }
+    
     /**
      * Load a GGUF model from the specified path.
      * 
@@ -103,7 +339,7 @@ object LlamaInference {
         threads: Int = DEFAULT_THREADS
     ): Boolean = withContext(Dispatchers.IO) {
         if (!isInitialized) {
-            Log.w(TAG, "Not initialized, initializing now")
+            Log.i(TAG, "First model load, initializing native backend")
             if (!initialize()) {
                 _modelState.value = ModelState.ERROR
                 return@withContext false
@@ -118,14 +354,30 @@ object LlamaInference {
             return@withContext false
         }
         
-        Log.i(TAG, "Loading model: $path (ctx=$contextSize, threads=$threads)")
+        // Header-only read: never ask for more context than the model was trained on
+        val metadata = GgufMetadata.read(modelFile)
+        val nCtx = metadata?.contextLength?.takeIf { it > 0 }?.let { contextSize.coerceAtMost(it) } ?: contextSize
+        metadata?.let {
+            Log.i(TAG, "Model: ${it.summary}, ~${it.estimateMemoryBytes(nCtx) / 1_000_000}MB at ctx=$nCtx")
+        }
+        
+        Log.i(TAG, "Loading model: $path (ctx=$nCtx, threads=$threads)")
         _modelState.value = ModelState.LOADING
         
+        // Truncated/corrupt files fail here rather than inside llama.cpp (cached after first check)
+        val verification = ModelVerifier.verify(modelFile, ModelDownloader.expectedDigest(modelFile))
+        if (!verification.ok) {
+            Log.e(TAG, "Model failed verification: ${verification.error}")
+            _modelState.value = ModelState.ERROR
+            return@withContext false
+        }
+        
         try {
-            val result = nativeLoadModel(path, contextSize, threads)
+            val result = nativeLoadModel(path, nCtx, threads)
             
             if (result) {
                 modelPath = path
+                modelFingerprint = fingerprintOf(modelFile, verification.digest)
                 _modelState.value = ModelState.READY
                 updateModelInfo()
                 Log.i(TAG, "Model loaded successfully")
@@ -145,42 +397,259 @@ object LlamaInference {
     /**
      * Generate text from a prompt.
      * 
+     * Suspends without holding a thread: the request is queued to the
+     * native worker and the coroutine resumes from its completion callback.
+     * Cancelling the coroutine cancels the native request.
+     * 
      * @param prompt Input prompt text
      * @param maxTokens Maximum tokens to generate (default 256)
      * @param temperature Sampling temperature 0.0-1.0 (default 0.7)
+     * @param priority Scheduling class; a higher one preempts a running
+     *                 lower-priority generation, which resumes afterwards
+     * @param checkpointKey Stable name for a long generation. It is saved
+     *                      to disk periodically; if the process dies, the
+     *                      same call with the same key continues from the
+     *                      last checkpoint instead of starting over
+     * @param onText Receives output as it is generated, on the native
+     *               worker thread - keep it short and non-blocking
      * @return Generated text response
      */
     suspend fun generate(
         prompt: String,
         maxTokens: Int = DEFAULT_MAX_TOKENS,
-        temperature: Float = DEFAULT_TEMPERATURE
-    ): GenerationResult = withContext(Dispatchers.IO) {
+        temperature: Float = DEFAULT_TEMPERATURE,
+        priority: InferencePriority = InferencePriority.NORMAL,
+        checkpointKey: String? = null,
+        onText: ((String) -> Unit)? = null
+    ): GenerationResult {
         if (_modelState.value != ModelState.READY) {
             Log.w(TAG, "Model not ready, state: ${_modelState.value}")
-            return@withContext GenerationResult.Error("Model not loaded")
+            return GenerationResult.Error("Model not loaded")
         }
         
-        val startTime = System.currentTimeMillis()
-        Log.d(TAG, "Generating response (maxTokens=$maxTokens, temp=$temperature)")
+        val requestId = nextRequestId.incrementAndGet()
+        Log.d(TAG, "Submitting request $requestId (maxTokens=$maxTokens, temp=$temperature, $priority)")
         
-        try {
-            val response = nativeGenerate(prompt, maxTokens, temperature)
-            val duration = System.currentTimeMillis() - startTime
+        return suspendCancellableCoroutine { continuation ->
+            pendingRequests[requestId] = PendingRequest(continuation, onText, System.currentTimeMillis())
+            continuation.invokeOnCancellation {
+                if (pendingRequests.remove(requestId) != null) {
+                    nativeCancelRequest(requestId)
+                }
+            }
             
-            Log.i(TAG, "Generation complete in ${duration}ms, response length: ${response.length}")
+            val queued = try {
+                nativeSubmit(requestId, prompt, maxTokens, temperature, onText != null, priority.ordinal, checkpointKey)
+            } catch (e: Exception) {
+                Log.e(TAG, "Generation error", e)
+                false
+            }
+            if (!queued) {
+                pendingRequests.remove(requestId)?.continuation?.resume(
+                    GenerationResult.Error("[Error: Request rejected]")
+                )
+            }
+        }
+    }
+    
+    /**
+     * Generate answers for many independent prompts in one pass.
+     * 
+     * The prompts run as parallel sequences: each decode step advances
+     * every one of them for roughly the cost of one, and a prompt prefix
+     * they share is evaluated once. Meant for draining queued work; a
+     * single waiting user is better served by [generate].
+     * 
+     * Batches decode greedily. A higher-priority request preempts the
+     * batch; items already finished are kept and the rest rerun afterwards.
+     * 
+     * @param prompts Input prompts
+     * @param params Per-prompt limits, same size as [prompts]
+     * @param priority Scheduling class (default background)
+     * @return One result per prompt, in order; all failed if the batch was rejected
+     */
+    suspend fun generateBatch(
+        prompts: List<String>,
+        params: List<GenerationParams>,
+        priority: InferencePriority = InferencePriority.BACKGROUND
+    ): List<BatchItemResult> {
+        require(prompts.size == params.size) { "prompts and params differ in size" }
+        if (prompts.isEmpty()) return emptyList()
+        if (_modelState.value != ModelState.READY) {
+            Log.w(TAG, "Model not ready, state: ${_modelState.value}")
+            return prompts.map { BatchItemResult.failed("Model not loaded") }
+        }
+        
+        val requestId = nextRequestId.incrementAndGet()
+        Log.d(TAG, "Submitting batch $requestId (${prompts.size} prompts, $priority)")
+        
+        val results = suspendCancellableCoroutine { continuation ->
+            pendingBatches[requestId] = continuation
+            continuation.invokeOnCancellation {
+                if (pendingBatches.remove(requestId) != null) {
+                    nativeCancelRequest(requestId)
+                }
+            }
             
-            if (response.startsWith("[Error:")) {
-                GenerationResult.Error(response)
-            } else {
-                GenerationResult.Success(
-                    text = response,
-                    durationMs = duration,
-                    tokensGenerated = estimateTokenCount(response)
+            val queued = try {
+                nativeSubmitBatch(
+                    requestId,
+                    prompts.toTypedArray(),
+                    params.map { it.maxTokens }.toIntArray(),
+                    params.map { it.temperature }.toFloatArray(),
+                    priority.ordinal
                 )
+            } catch (e: Exception) {
+                Log.e(TAG, "Batch generation error", e)
+                false
+            }
+            if (!queued) {
+                pendingBatches.remove(requestId)?.resume(emptyList())
+            }
+        }
+        return if (results.size == prompts.size) results
+               else prompts.map { BatchItemResult.failed("[Error: Request rejected]") }
+    }
+    
+    /**
+     * Prefill a prompt prefix into the native prefix cache, so later prompts
+     * that start with it (a job's system prompt, say) skip that prefill.
+     * 
+     * Runs below all other work and gives way the moment anything else
+     * is queued; the result is then an error ("Yielded") and the caller may
+     * retry in a later idle window.
+     * 
+     * @param prompt Prefix to warm, e.g. a system prompt block
+     * @return true if the prefix is cached
+     */
+    suspend fun warmPrefix(
+        prompt: String,
+        priority: InferencePriority = InferencePriority.IDLE
+    ): Boolean {
+        if (_modelState.value != ModelState.READY) return false
+        
+        val requestId = nextRequestId.incrementAndGet()
+        val result = suspendCancellableCoroutine { continuation ->
+            pendingRequests[requestId] = PendingRequest(continuation, null, System.currentTimeMillis())
+            continuation.invokeOnCancellation {
+                if (pendingRequests.remove(requestId) != null) {
+                    nativeCancelRequest(requestId)
+                }
+            }
+            val queued = try {
+                nativeSubmitWarm(requestId, prompt, priority.ordinal)
+            } catch (e: Exception) {
+                Log.e(TAG, "Warm error", e)
+                false
+            }
+            if (!queued) {
+                pendingRequests.remove(requestId)?.continuation?.resume(
+                    GenerationResult.Error("[Error: Request rejected]")
+                )
+            }
+        }
+        return result is GenerationResult.Success
+    }
+    
+    /**
+     * Embed texts for similarity search with the loaded model: one
+     * L2-normalized vector per text, in order. Low priority by default,
+     * yielding to any other request like [warmPrefix].
+     * 
+     * @return Vectors, or null if the model is not ready, the request
+     *         yielded, or embeddings are unavailable (stub build)
+     */
+    suspend fun embed(
+        texts: List<String>,
+        priority: InferencePriority = InferencePriority.IDLE
+    ): List<FloatArray>? {
+        if (texts.isEmpty()) return emptyList()
+        if (_modelState.value != ModelState.READY) return null
+        
+        val requestId = nextRequestId.incrementAndGet()
+        return suspendCancellableCoroutine { continuation ->
+            pendingEmbeddings[requestId] = continuation
+            continuation.invokeOnCancellation {
+                if (pendingEmbeddings.remove(requestId) != null) {
+                    nativeCancelRequest(requestId)
+                }
+            }
+            val queued = try {
+                nativeSubmitEmbed(requestId, texts.toTypedArray(), priority.ordinal)
+            } catch (e: Exception) {
+                Log.e(TAG, "Embed error", e)
+                false
+            }
+            if (!queued) {
+                pendingEmbeddings.remove(requestId)?.resume(null)
+            }
+        }
+    }
+    
+    /**
+     * Compress a mesh message against the loaded model's predictions.
+     * Only a peer running the same model file can expand the result.
+     * 
+     * @param maxBytes Largest frame worth sending (e.g. one beacon's content)
+     * @return The frame, or null if the model is not ready or the text
+     *         does not compress into maxBytes
+     */
+    suspend fun compressMessage(
+        text: String,
+        maxBytes: Int,
+        priority: InferencePriority = InferencePriority.INTERACTIVE
+    ): ByteArray? {
+        if (text.isEmpty()) return null
+        return runCodec(decode = false, text.toByteArray(Charsets.UTF_8), maxBytes, priority)
+    }
+    
+    /**
+     * Expand a frame made by [compressMessage] on another device.
+     * 
+     * @return The text, or null if the model is not ready, differs from the
+     *         sender's, or the frame is corrupt
+     */
+    suspend fun expandMessage(
+        frame: ByteArray,
+        priority: InferencePriority = InferencePriority.INTERACTIVE
+    ): String? {
+        if (!isCompressedFrame(frame)) return null
+        return runCodec(decode = true, frame, 0, priority)?.toString(Charsets.UTF_8)
+    }
+    
+    /**
+     * True if bytes start with a compression frame tag rather than UTF-8
+     * text (0xF8 and above never begin a UTF-8 sequence).
+     */
+    fun isCompressedFrame(bytes: ByteArray): Boolean {
+        return bytes.size >= 2 && (bytes[0].toInt() and 0xF8) == 0xF8
+    }
+    
+    private suspend fun runCodec(
+        decode: Boolean,
+        data: ByteArray,
+        maxBytes: Int,
+        priority: InferencePriority
+    ): ByteArray? {
+        if (_modelState.value != ModelState.READY) return null
+        
+        val requestId = nextRequestId.incrementAndGet()
+        return suspendCancellableCoroutine { continuation ->
+            pendingCodec[requestId] = continuation
+            continuation.invokeOnCancellation {
+                if (pendingCodec.remove(requestId) != null) {
+                    nativeCancelRequest(requestId)
+                }
+            }
+            val queued = try {
+                nativeSubmitCodec(requestId, decode, data, maxBytes, priority.ordinal)
+            } catch (e: Exception) {
+                Log.e(TAG, "Codec error", e)
+                false
+            }
+            if (!queued) {
+                pendingCodec.remove(requestId)?.resume(null)
             }
-        } catch (e: Exception) {
-            Log.e(TAG, "Generation error", e)
-            GenerationResult.Error(e.message ?: "Unknown error")
         }
     }
     
@@ -188,6 +657,7 @@ object LlamaInference {
      * Cancel ongoing text generation.
      */
     fun cancelGeneration() {
+        if (!libraryLoaded) return
         Log.d(TAG, "Cancelling generation")
         try {
             nativeCancelGeneration()
@@ -200,6 +670,7 @@ object LlamaInference {
      * Unload the current model and free memory.
      */
     fun unloadModel() {
+        if (!libraryLoaded) return
         Log.i(TAG, "Unloading model")
         try {
             nativeUnloadModel()
@@ -215,6 +686,7 @@ object LlamaInference {
      * Check if a model is currently loaded.
      */
     fun isModelLoaded(): Boolean {
+        if (!libraryLoaded) return false
         return try {
             nativeIsModelLoaded()
         } catch (e: Exception) {
@@ -226,16 +698,94 @@ object LlamaInference {
      * Free all resources. Call at app shutdown.
      */
     fun shutdown() {
+        if (!isInitialized) return
         Log.i(TAG, "Shutting down llama inference")
         try {
+            workerConnected = false
             nativeFree()
             isInitialized = false
             _modelState.value = ModelState.NOT_LOADED
+            unbindWorker()
         } catch (e: Exception) {
             Log.e(TAG, "Error during shutdown", e)
         }
     }
     
+    /**
+     * Join [segments] into a prompt of at most [budget] tokens, counted with
+     * the loaded model's tokenizer. Optional segments are cut at token
+     * boundaries or left out, lowest priority first; required ones are
+     * kept whole.
+     * 
+     * @param budget Usually the context size less the tokens to generate
+     * @return null if no model is loaded (stub builds included) or the
+     *         required segments alone exceed the budget
+     */
+    fun assemblePrompt(segments: List<PromptSegment>, budget: Int): AssembledPrompt? {
+        if (_modelState.value != ModelState.READY || segments.isEmpty()) return null
+        return try {
+            val bytes = nativeAssemblePrompt(
+                segments.map { it.text }.toTypedArray(),
+                segments.map { it.priority }.toIntArray(),
+                segments.map { it.minTokens }.toIntArray(),
+                segments.map { it.maxTokens }.toIntArray(),
+                segments.map { it.required }.toBooleanArray(),
+                segments.map { it.keepTail }.toBooleanArray(),
+                budget
+            ) ?: return null
+            val json = JSONObject(String(bytes, Charsets.UTF_8))
+            val kept = json.getJSONArray("kept")
+            AssembledPrompt(
+                text = json.getString("text"),
+                tokenCount = json.getInt("n_tokens"),
+                keptTokens = List(kept.length()) { kept.getInt(it) }
+            )
+        } catch (e: Exception) {
+            Log.e(TAG, "Prompt assembly error", e)
+            null
+        }
+    }
+    
+    /**
+     * Repack layout that runs fastest on this CPU ("" = keep the downloaded
+     * file), or null if the native library is unavailable.
+     */
+    fun getOptimalLayout(): String? {
+        if (!ensureLibraryLoaded()) return null
+        return try {
+            nativeGetOptimalLayout()
+        } catch (e: Exception) {
+            Log.e(TAG, "Error detecting optimal layout", e)
+            null
+        }
+    }
+    
+    /**
+     * Requantize a downloaded model into this device's optimal layout.
+     * Long running (tens of seconds); independent of the loaded model.
+     */
+    suspend fun repackModel(
+        srcPath: String,
+        dstPath: String,
+        threads: Int = DEFAULT_THREADS
+    ): RepackResult = withContext(Dispatchers.IO) {
+        if (!ensureLibraryLoaded()) {
+            return@withContext RepackResult(false, "", 0f, "Native library unavailable")
+        }
+        try {
+            val json = JSONObject(nativeRepackModel(srcPath, dstPath, threads))
+            RepackResult(
+                ok = json.optBoolean("ok", false),
+                layout = json.optString("layout", ""),
+                agreement = json.optDouble("agreement", 0.0).toFloat(),
+                error = json.optString("error", "")
+            )
+        } catch (e: Exception) {
+            Log.e(TAG, "Repack error", e)
+            RepackResult(false, "", 0f, e.message ?: "Unknown error")
+        }
+    }
+    
     /**
      * Get the path to the models directory in app storage.
      */
@@ -259,6 +809,84 @@ object LlamaInference {
     // PRIVATE HELPERS
     // ════════════════════════════════════════════════════════════════════
     
+    /**
+     * Bind the worker service and hand it a fresh channel. Blocking and
+     * never on the main thread: the binding is delivered there.
+     * @return false to fall back to the in-process engine
+     */
+    private fun connectWorker(): Boolean {
+        val context = appContext ?: return false
+        val binder = bindWorker(context) ?: run {
+            Log.w(TAG, "Inference worker service unavailable")
+            return false
+        }
+        val fds = nativeConnectWorker() ?: return false
+        
+        // Binder dups the descriptors into the worker; ours are closed either way
+        val control = ParcelFileDescriptor.adoptFd(fds[0])
+        val shm = ParcelFileDescriptor.adoptFd(fds[1])
+        val data = Parcel.obtain()
+        val reply = Parcel.obtain()
+        return try {
+            data.writeInterfaceToken(InferenceWorkerService.DESCRIPTOR)
+            data.writeFileDescriptor(control.fileDescriptor)
+            data.writeFileDescriptor(shm.fileDescriptor)
+            binder.transact(InferenceWorkerService.TRANSACTION_CONNECT, data, reply, 0)
+            workerConnected = reply.readInt() == 1
+            workerConnected
+        } catch (e: Exception) {
+            Log.e(TAG, "Worker connect failed", e)
+            false
+        } finally {
+            data.recycle()
+            reply.recycle()
+            control.close()
+            shm.close()
+        }
+    }
+    
+    private fun bindWorker(context: Context): IBinder? {
+        workerBinder?.takeIf { it.isBinderAlive }?.let { return it }
+        
+        val connected = CountDownLatch(1)
+        val connection = object : ServiceConnection {
+            override fun onServiceConnected(name: ComponentName?, service: IBinder?) {
+                workerBinder = service
+                connected.countDown()
+            }
+            
+            override fun onServiceDisconnected(name: ComponentName?) {
+                workerBinder = null
+            }
+        }
+        unbindWorker()
+        val intent = Intent(context, InferenceWorkerService::class.java)
+        if (!context.bindService(intent, connection, Context.BIND_AUTO_CREATE)) {
+            return null
+        }
+        workerConnection = connection
+        connected.await(WORKER_BIND_TIMEOUT_MS, TimeUnit.MILLISECONDS)
+        return workerBinder
+    }
+    
+    private fun unbindWorker() {
+        val connection = workerConnection ?: return
+        workerConnection = null
+        workerBinder = null
+        try {
+            appContext?.unbindService(connection)
+        } catch (e: IllegalArgumentException) {
+            // Already unbound
+        }
+    }
+    
+    // Path, size and content digest; the mtime stands in when the verifier could not hash
+    private fun fingerprintOf(file: File, digest: String): Long {
+        val id = "${file.absolutePath}|${file.length()}|${digest.ifEmpty { file.lastModified().toString() }}"
+        val hash = MessageDigest.getInstance("SHA-1").digest(id.toByteArray(Charsets.UTF_8))
+        return ByteBuffer.wrap(hash).long
+    }
+    
     private fun updateModelInfo() {
         try {
             val infoJson = nativeGetModelInfo()
@@ -267,16 +895,147 @@ object LlamaInference {
             _modelInfo.value = ModelInfo(
                 vocabSize = json.optInt("vocab_size", 0),
                 contextSize = json.optInt("context_size", 0),
+                embeddingSize = json.optInt("embedding_size", 0),
                 isLoaded = json.optBoolean("loaded", false),
-                isStub = json.optBoolean("stub", false)
+                isStub = json.optBoolean("stub", false),
+                fingerprint = modelFingerprint
             )
         } catch (e: Exception) {
             Log.w(TAG, "Failed to get model info", e)
         }
     }
     
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE CALLBACKS (worker thread)
+    // ════════════════════════════════════════════════════════════════════
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeText(requestId: Long, text: ByteArray) {
+        val request = pendingRequests[requestId] ?: return
+        try {
+            request.onText?.invoke(String(text, Charsets.UTF_8))
+        } catch (e: Exception) {
+            Log.w(TAG, "onText callback failed for request $requestId", e)
+        }
+    }
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeComplete(
+        requestId: Long,
+        text: ByteArray,
+        promptTokens: Int,
+        generatedTokens: Int,
+        prefillUs: Long,
+        decodeUs: Long
+    ) {
+        pendingCodec.remove(requestId)?.let {
+            it.resume(text)
+            return
+        }
+        val request = pendingRequests.remove(requestId) ?: return
+        val response = String(text, Charsets.UTF_8)
+        val duration = System.currentTimeMillis() - request.startTime
+        
+        Log.i(TAG, "Generation $requestId complete in ${duration}ms, response length: ${response.length} " +
+                "(prompt $promptTokens tok / ${prefillUs / 1000}ms, $generatedTokens tok / ${decodeUs / 1000}ms)")
+        
+        request.continuation.resume(
+            GenerationResult.Success(
+                text = response,
+                durationMs = duration,
+                tokensGenerated = if (generatedTokens > 0) generatedTokens else estimateTokenCount(response)
+            )
+        )
+    }
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeError(requestId: Long, message: String) {
+        pendingBatches.remove(requestId)?.let {
+            Log.w(TAG, "Batch $requestId failed: $message")
+            it.resume(emptyList())
+            return
+        }
+        pendingEmbeddings.remove(requestId)?.let {
+            Log.d(TAG, "Embedding $requestId failed: $message")
+            it.resume(null)
+            return
+        }
+        pendingCodec.remove(requestId)?.let {
+            Log.d(TAG, "Codec $requestId failed: $message")
+            it.resume(null)
+            return
+        }
+        val request = pendingRequests.remove(requestId) ?: return
+        Log.w(TAG, "Generation $requestId failed: $message")
+        request.continuation.resume(GenerationResult.Error("[Error: $message]"))
+    }
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeBatchComplete(requestId: Long, json: ByteArray) {
+        val continuation = pendingBatches.remove(requestId) ?: return
+        val results = try {
+            val root = JSONObject(String(json, Charsets.UTF_8))
+            val items = root.getJSONArray("items")
+            Log.i(TAG, "Batch $requestId complete: ${items.length()} items, ${root.optInt("waves")} waves, " +
+                    "${root.optInt("decode_calls")} decodes, ${root.optInt("prefill_saved")} prefill tok shared, " +
+                    "${root.optLong("total_us") / 1000}ms")
+            (0 until items.length()).map { i ->
+                val item = items.getJSONObject(i)
+                BatchItemResult(
+                    ok = item.optBoolean("ok", false),
+                    text = item.optString("text", ""),
+                    error = item.optString("error", ""),
+                    promptTokens = item.optInt("prompt_tokens", 0),
+                    sharedPrefixTokens = item.optInt("prefix_tokens", 0),
+                    tokensGenerated = item.optInt("generated_tokens", 0),
+                    firstTokenMs = item.optLong("first_token_us", 0) / 1000,
+                    latencyMs = item.optLong("latency_us", 0) / 1000
+                )
+            }
+        } catch (e: Exception) {
+            Log.e(TAG, "Malformed batch result for $requestId", e)
+            emptyList()
+        }
+        continuation.resume(results)
+    }
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeWorkerLost() {
+        // A channel that never connected is being replaced by nativeInit; nothing was lost
+        if (!workerConnected) return
+        workerConnected = false
+        isInitialized = false
+        val path = modelPath
+        modelPath = null
+        _modelInfo.value = null
+        _modelState.value = ModelState.NOT_LOADED
+        Log.e(TAG, "Inference worker process died; reconnecting on next use")
+        
+        // Reload once; a second loss soon after is most likely the same OOM
+        val now = SystemClock.elapsedRealtime()
+        val reload = path != null && (lastWorkerLoss == 0L || now - lastWorkerLoss > WORKER_RELOAD_BACKOFF_MS)
+        lastWorkerLoss = now
+        if (reload) {
+            // Off this (the dead client's) thread: reconnecting tears that client down
+            recoveryScope.launch { loadModel(path!!) }
+        }
+    }
+    
+    @Suppress("unused") // Called from native
+    @JvmStatic
+    private fun onNativeEmbeddings(requestId: Long, nEmbd: Int, vectors: FloatArray) {
+        val continuation = pendingEmbeddings.remove(requestId) ?: return
+        val count = if (nEmbd > 0) vectors.size / nEmbd else 0
+        continuation.resume(List(count) { i -> vectors.copyOfRange(i * nEmbd, (i + 1) * nEmbd) })
+    }
+    
     private fun estimateTokenCount(text: String): Int {
-        // Rough estimate: ~4 characters per token for English
+        // Rough estimate: ~4 characters per token for English (stub builds report no counts)
         return (text.length / 4).coerceAtLeast(1)
     }
 }
@@ -295,16 +1054,108 @@ enum class ModelState {
     ERROR
 }
 
+/**
+ * Scheduling class for a generation request. Order matters: the ordinal
+ * is the native priority, and higher preempts lower.
+ */
+enum class InferencePriority {
+    IDLE,         // Precomputation while charging; yields to everything
+    BACKGROUND,   // Ambient enhancement, proactive suggestions
+    NORMAL,
+    INTERACTIVE   // A user asked and is waiting
+}
+
+/**
+ * Cost of the deferred native startup, paid on first AI use instead of in
+ * Application.onCreate
+ */
+data class NativeInitMetrics(
+    val libraryLoadMs: Long,
+    val backendInitMs: Long
+) {
+    val totalMs: Long get() = libraryLoadMs + backendInitMs
+}
+
 /**
  * Model information
+ *
+ * @property fingerprint Identifies the loaded weights; stored with indexes of their embeddings
  */
 data class ModelInfo(
     val vocabSize: Int,
     val contextSize: Int,
+    val embeddingSize: Int,
     val isLoaded: Boolean,
-    val isStub: Boolean = false
+    val isStub: Boolean = false,
+    val fingerprint: Long = 0L
 )
 
+/**
+ * Result of a one-time model repack
+ */
+data class RepackResult(
+    val ok: Boolean,
+    val layout: String,
+    val agreement: Float,
+    val error: String
+)
+
+/**
+ * Per-prompt limits for [LlamaInference.generateBatch]
+ */
+data class GenerationParams(
+    val maxTokens: Int = 256,
+    val temperature: Float = 0.7f
+)
+
+/**
+ * One part of a prompt for [LlamaInference.assemblePrompt]
+ *
+ * @property priority Higher keeps its tokens longer
+ * @property minTokens Shortest useful cut; below it the segment is left out
+ * @property maxTokens Cap even when there is room (0 = none)
+ * @property required Never cut or left out (template markers, the query)
+ * @property keepTail Cut from the front, keeping the most recent text
+ */
+data class PromptSegment(
+    val text: String,
+    val priority: Int = 0,
+    val minTokens: Int = 0,
+    val maxTokens: Int = 0,
+    val required: Boolean = false,
+    val keepTail: Boolean = false
+)
+
+/**
+ * A prompt fitted to a token budget
+ *
+ * @property tokenCount Exact length with the loaded model's tokenizer
+ * @property keptTokens Tokens each segment kept, in order; 0 if left out
+ */
+data class AssembledPrompt(
+    val text: String,
+    val tokenCount: Int,
+    val keptTokens: List<Int>
+)
+
+/**
+ * Outcome of one prompt of a batch
+ */
+data class BatchItemResult(
+    val ok: Boolean,
+    val text: String,
+    val error: String = "",
+    val promptTokens: Int = 0,
+    val sharedPrefixTokens: Int = 0,   // prompt tokens evaluated once for the whole wave
+    val tokensGenerated: Int = 0,
+    val firstTokenMs: Long = 0,
+    val latencyMs: Long = 0
+) {
+    companion object {
+        fun failed(error: String) = BatchItemResult(ok = false, text = "", error = error)
+    }
+}
+
 /**
  * Result of text generation
  */
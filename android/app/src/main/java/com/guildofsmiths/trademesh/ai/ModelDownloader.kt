@@ -22,6 +22,10 @@ object ModelDownloader {
     
     private const val TAG = "ModelDownloader"
     
+    // Expected SHA-256 recorded at download, next to the model
+    private const val DIGEST_SUFFIX = ".sha256"
+    private val SHA256_HEX = Regex("^[0-9a-f]{64}$")
+    
     // Download state
     private val _downloadState = MutableStateFlow<DownloadState>(DownloadState.Idle)
     val downloadState: StateFlow<DownloadState> = _downloadState.asStateFlow()
@@ -37,7 +41,9 @@ object ModelDownloader {
     // ════════════════════════════════════════════════════════════════════
     
     /**
-     * Available models for download
+     * Available models for download. Q4_0 rather than q4_k_m: ModelOptimizer
+     * can repack Q4_0 into the interleaved layout losslessly, while
+     * k-quants would have to be requantized.
      */
     val availableModels = listOf(
         ModelInfo(
@@ -46,7 +52,7 @@ object ModelDownloader {
             description = "Tiny, fast responses (~400MB)",
             filename = "qwen3-0.6b-q4.gguf",
             sizeBytes = 420_000_000L, // ~400MB
-            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-0.5B-Instruct-GGUF/resolve/main/qwen2.5-0.5b-instruct-q4_k_m.gguf",
+            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-0.5B-Instruct-GGUF/resolve/main/qwen2.5-0.5b-instruct-q4_0.gguf",
             recommended = false
         ),
         ModelInfo(
@@ -55,7 +61,7 @@ object ModelDownloader {
             description = "Balanced speed & quality (~1.1GB)",
             filename = "qwen3-1.7b-q4.gguf",
             sizeBytes = 1_100_000_000L, // ~1.1GB
-            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-1.5B-Instruct-GGUF/resolve/main/qwen2.5-1.5b-instruct-q4_k_m.gguf",
+            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-1.5B-Instruct-GGUF/resolve/main/qwen2.5-1.5b-instruct-q4_0.gguf",
             recommended = true
         ),
         ModelInfo(
@@ -64,7 +70,7 @@ object ModelDownloader {
             description = "Higher quality (~2GB)",
             filename = "qwen3-3b-q4.gguf",
             sizeBytes = 2_000_000_000L, // ~2GB
-            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-3B-Instruct-GGUF/resolve/main/qwen2.5-3b-instruct-q4_k_m.gguf",
+            downloadUrl = "https://huggingface.co/Qwen/Qwen2.5-3B-Instruct-GGUF/resolve/main/qwen2.5-3b-instruct-q4_0.gguf",
             recommended = false
         )
     )
@@ -94,13 +100,43 @@ object ModelDownloader {
     }
     
     /**
-     * Get the path to a downloaded model
+     * Get the path to a downloaded model. Prefers the device-optimized copy
+     * produced by [ModelOptimizer] when one exists.
      */
     fun getModelPath(context: Context, modelId: String): String? {
         val model = availableModels.find { it.id == modelId } ?: return null
         val modelsDir = LlamaInference.getModelsDirectory(context)
         val file = File(modelsDir, model.filename)
-        return if (file.exists()) file.absolutePath else null
+        if (!file.exists()) return null
+        
+        val optimized = ModelOptimizer.getOptimizedFile(modelsDir, model)
+        return (optimized ?: file).absolutePath
+    }
+    
+    /**
+     * Read a downloaded model's details from its GGUF header, without
+     * loading weights. Null if the model is not downloaded.
+     */
+    suspend fun getModelMetadata(context: Context, modelId: String): ModelMetadata? {
+        val path = getModelPath(context, modelId) ?: return null
+        return GgufMetadata.read(File(path))
+    }
+    
+    /**
+     * SHA-256 a downloaded catalog model must have: the entry's pinned
+     * digest, else the one its server published at download. Null for
+     * files outside the catalog (optimized copies are made on the device).
+     */
+    fun expectedDigest(file: File): String? {
+        val model = availableModels.find { it.filename == file.name } ?: return null
+        model.sha256?.let { return it }
+        val recorded = File(file.parentFile, file.name + DIGEST_SUFFIX)
+        return try {
+            recorded.takeIf { it.exists() }?.readText()?.trim()?.takeIf { SHA256_HEX.matches(it) }
+        } catch (e: Exception) {
+            Log.w(TAG, "Cannot read ${recorded.name}", e)
+            null
+        }
     }
     
     // ════════════════════════════════════════════════════════════════════
@@ -142,6 +178,12 @@ object ModelDownloader {
         Log.i(TAG, "URL: ${model.downloadUrl}")
         
         try {
+            val digest = model.sha256 ?: publishedDigest(model.downloadUrl)
+            if (digest == null) {
+                Log.w(TAG, "No published SHA-256 for ${model.name}; only its structure will be checked")
+            }
+            
+
             val url = URL(model.downloadUrl)
             val connection = url.openConnection() as HttpURLConnection
             connection.connectTimeout = 30000
@@ -166,7 +208,8 @@ object ModelDownloader {
                 return@withContext false
             }
             
-            val totalSize = connection.contentLengthLong + existingSize
+            val contentLength = connection.contentLengthLong
+            val totalSize = contentLength + existingSize
             Log.i(TAG, "Total size: $totalSize bytes (${totalSize / 1_000_000}MB)")
             
             // Open streams
@@ -205,11 +248,31 @@ object ModelDownloader {
             outputStream.close()
             connection.disconnect()
             
+            // A dropped connection ends the stream early; keep the temp file for resume
+            if (contentLength > 0 && downloadedBytes < totalSize) {
+                Log.e(TAG, "Download ended early: $downloadedBytes of $totalSize bytes")
+                _downloadState.value = DownloadState.Error("Download incomplete, tap to resume")
+                return@withContext false
+            }
+            
             // Rename temp file to final
+            val digestFile = File(modelsDir, model.filename + DIGEST_SUFFIX)
             if (tempFile.renameTo(targetFile)) {
+                // Only a structurally valid model with the published digest counts as downloaded
+                if (digest != null) digestFile.writeText(digest) else digestFile.delete()
+                val verification = ModelVerifier.verify(targetFile, digest)
+                if (!verification.ok) {
+                    Log.e(TAG, "Downloaded model is corrupt: ${verification.error}")
+                    targetFile.delete()
+                    digestFile.delete()
+                    _downloadState.value = DownloadState.Error("Download corrupt: ${verification.error}")
+                    return@withContext false
+                }
+                
                 Log.i(TAG, "Download complete: ${targetFile.absolutePath}")
                 _downloadProgress.value = 1f
                 _downloadState.value = DownloadState.Complete(model)
+                ModelOptimizer.requestOptimization()
                 return@withContext true
             } else {
                 Log.e(TAG, "Failed to rename temp file")
@@ -240,6 +303,10 @@ object ModelDownloader {
         val modelsDir = LlamaInference.getModelsDirectory(context)
         val file = File(modelsDir, model.filename)
         
+        ModelOptimizer.getAllOptimizedFiles(modelsDir, model).forEach { it.delete() }
+        File(modelsDir, "${model.filename}.verify").delete()
+        File(modelsDir, model.filename + DIGEST_SUFFIX).delete()
+        
         return if (file.exists()) {
             val deleted = file.delete()
             Log.i(TAG, "Deleted model ${model.name}: $deleted")
@@ -249,6 +316,27 @@ object ModelDownloader {
         }
     }
     
+    /**
+     * SHA-256 Hugging Face publishes for an LFS file: the X-Linked-Etag of
+     * the resolve URL's redirect. Null if the server sends none.
+     */
+    private fun publishedDigest(downloadUrl: String): String? {
+        return try {
+            val connection = URL(downloadUrl).openConnection() as HttpURLConnection
+            connection.requestMethod = "HEAD"
+            connection.instanceFollowRedirects = false
+            connection.connectTimeout = 30000
+            connection.readTimeout = 30000
+            connection.setRequestProperty("User-Agent", "TradeMesh-Android/1.0")
+            val etag = connection.getHeaderField("X-Linked-Etag")
+            connection.disconnect()
+            etag?.removePrefix("W/")?.trim('"')?.lowercase()?.takeIf { SHA256_HEX.matches(it) }
+        } catch (e: Exception) {
+            Log.w(TAG, "Cannot fetch published digest", e)
+            null
+        }
+    }
+    
     /**
      * Reset state to idle
      */
@@ -268,7 +356,10 @@ object ModelDownloader {
         val filename: String,
         val sizeBytes: Long,
         val downloadUrl: String,
-        val recommended: Boolean = false
+        val recommended: Boolean = false,
+        // Plain SHA-256 of the file (the Hugging Face LFS oid). Null: use the
+        // digest the server publishes for downloadUrl, recorded at download
+        val sha256: String? = null
     ) {
         val sizeMB: Int get() = (sizeBytes / 1_000_000).toInt()
         val sizeDisplay: String get() = when {
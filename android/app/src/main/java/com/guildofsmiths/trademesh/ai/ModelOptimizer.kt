@@ -0,0 +1,185 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.content.Context
+import android.content.SharedPreferences
+import android.util.Log
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.Job
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.flow.MutableStateFlow
+import kotlinx.coroutines.flow.StateFlow
+import kotlinx.coroutines.flow.asStateFlow
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import java.io.File
+
+/**
+ * ModelOptimizer - One-time repack of downloaded models to a device-optimal layout
+ * 
+ * On ARM cores with dotprod the interleaved Q4_0_4_4 layout decodes
+ * faster, so while the device is charging each downloaded Q4_0/Q8_0/F16
+ * model (the catalog ships Q4_0) is converted natively, verified against
+ * the original, and cached next to it as `<name>.<layout>.gguf`.
+ * K-quantized files (q4_k_m) are refused natively and remembered as
+ * failed. A layout is offered only by libllama_jni_dotprod.so, which
+ * LlamaInference loads on dotprod CPUs and which has the matching kernels.
+ * [ModelDownloader.getModelPath] returns the fast file once it exists.
+ * 
+ * Runs only when:
+ * - AI is enabled (the native library is not loaded otherwise)
+ * - Charging, not in power save, thermal LIGHT or cooler
+ * - No download is in progress
+ */
+object ModelOptimizer {
+    
+    private const val TAG = "ModelOptimizer"
+    private const val PREFS_NAME = "model_optimizer"
+    private const val KEY_LAYOUT = "layout"
+    private const val KEY_FAILED_PREFIX = "failed_"
+    
+    private val _state = MutableStateFlow<OptimizerState>(OptimizerState.Idle)
+    val state: StateFlow<OptimizerState> = _state.asStateFlow()
+    
+    private var context: Context? = null
+    private var prefs: SharedPreferences? = null
+    private var watchJob: Job? = null
+    private val runLock = Mutex()
+    private val scope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    
+    // ════════════════════════════════════════════════════════════════════
+    // INITIALIZATION
+    // ════════════════════════════════════════════════════════════════════
+    
+    /**
+     * Start watching the battery gate. Call once at app startup.
+     */
+    fun initialize(appContext: Context) {
+        if (context != null) return
+        context = appContext.applicationContext
+        prefs = appContext.getSharedPreferences(PREFS_NAME, Context.MODE_PRIVATE)
+        
+        watchJob = scope.launch {
+            BatteryGate.gateState.collect { state ->
+                if (isGoodTimeToOptimize(state)) {
+                    optimizePending()
+                }
+            }
+        }
+        Log.i(TAG, "ModelOptimizer initialized (layout: ${prefs?.getString(KEY_LAYOUT, null) ?: "not detected"})")
+    }
+    
+    fun shutdown() {
+        watchJob?.cancel()
+        watchJob = null
+        context = null
+    }
+    
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+    
+    /**
+     * Path of the optimized copy of a model on this device, or null if none
+     * has been produced yet. Never loads the native library.
+     */
+    fun getOptimizedFile(modelsDir: File, model: ModelDownloader.ModelInfo): File? {
+        val layout = prefs?.getString(KEY_LAYOUT, null)
+        if (layout.isNullOrEmpty()) return null
+        val file = optimizedFileFor(modelsDir, model, layout)
+        return if (file.exists()) file else null
+    }
+    
+    /**
+     * All optimized copies of a model (any layout) and their sidecars, for deletion.
+     */
+    fun getAllOptimizedFiles(modelsDir: File, model: ModelDownloader.ModelInfo): List<File> {
+        val base = model.filename.removeSuffix(".gguf")
+        return modelsDir.listFiles { f -> f.name.startsWith("$base.q4_0_") }?.toList() ?: emptyList()
+    }
+    
+    /**
+     * Optimize pending models now if conditions allow (after a download, or
+     * when AI is enabled); otherwise the battery watcher picks them up later.
+     */
+    fun requestOptimization() {
+        if (isGoodTimeToOptimize(BatteryGate.gateState.value)) {
+            scope.launch { optimizePending() }
+        }
+    }
+    
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE HELPERS
+    // ════════════════════════════════════════════════════════════════════
+    
+    private fun isGoodTimeToOptimize(state: GateState): Boolean {
+        return context != null &&
+               AIRouter.isEnabled() &&
+               state.isCharging &&
+               !state.isPowerSaveMode &&
+               state.thermalStatus <= ThermalStatus.LIGHT &&
+               ModelDownloader.downloadState.value !is ModelDownloader.DownloadState.Downloading
+    }
+    
+    private suspend fun optimizePending() {
+        val ctx = context ?: return
+        if (runLock.isLocked) return
+        
+        runLock.withLock {
+            val layout = LlamaInference.getOptimalLayout() ?: return
+            prefs?.edit()?.putString(KEY_LAYOUT, layout)?.apply()
+            if (layout.isEmpty()) {
+                Log.i(TAG, "No faster layout for this CPU, keeping downloaded models")
+                return
+            }
+            
+            val modelsDir = LlamaInference.getModelsDirectory(ctx)
+            for (model in ModelDownloader.getDownloadedModels(ctx)) {
+                if (!isGoodTimeToOptimize(BatteryGate.gateState.value)) {
+                    Log.i(TAG, "Conditions changed, deferring remaining models")
+                    break
+                }
+                val target = optimizedFileFor(modelsDir, model, layout)
+                if (target.exists()) continue
+                if (prefs?.getString(KEY_FAILED_PREFIX + model.id, null) == layout) continue
+                
+                optimize(File(modelsDir, model.filename), target, model, layout)
+            }
+            _state.value = OptimizerState.Idle
+        }
+    }
+    
+    private suspend fun optimize(
+        source: File,
+        target: File,
+        model: ModelDownloader.ModelInfo,
+        layout: String
+    ) {
+        Log.i(TAG, "Optimizing ${model.name} -> $layout")
+        _state.value = OptimizerState.Running(model, layout)
+        
+        val threads = (Runtime.getRuntime().availableProcessors() - 1).coerceIn(1, 8)
+        val result = LlamaInference.repackModel(source.absolutePath, target.absolutePath, threads)
+        
+        if (result.ok) {
+            Log.i(TAG, "Optimized ${model.name} ($layout, agreement ${result.agreement})")
+        } else {
+            // Remember per layout so a failing model is not retried on every charge
+            Log.w(TAG, "Optimization of ${model.name} failed: ${result.error}")
+            prefs?.edit()?.putString(KEY_FAILED_PREFIX + model.id, layout)?.apply()
+        }
+    }
+    
+    private fun optimizedFileFor(modelsDir: File, model: ModelDownloader.ModelInfo, layout: String): File {
+        return File(modelsDir, "${model.filename.removeSuffix(".gguf")}.$layout.gguf")
+    }
+}
+
+/**
+ * Model optimization state
+ */
+sealed class OptimizerState {
+    object Idle : OptimizerState()
+    data class Running(val model: ModelDownloader.ModelInfo, val layout: String) : OptimizerState()
+}
@@ -0,0 +1,88 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import org.json.JSONObject
+import java.io.File
+
+/**
+ * ModelVerifier - Integrity check for downloaded GGUF models
+ * 
+ * Backed by libsmith_native.so (no llama.cpp), which mmaps the file,
+ * validates the GGUF header and that every tensor lies inside the file,
+ * and takes its SHA-256 (SHA2 instructions where present). The digest is
+ * the plain file hash, comparable with the one Hugging Face publishes.
+ * 
+ * Results are cached next to the model keyed by size and mtime, so
+ * re-checking an unchanged file before each load is effectively free.
+ * A truncated download fails here instead of inside nativeLoadModel.
+ */
+object ModelVerifier {
+    
+    private const val TAG = "ModelVerifier"
+    
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+    
+    private external fun nativeVerify(path: String, expectedDigest: String): String
+    
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+    
+    /**
+     * Verify a model file.
+     * 
+     * @param file The .gguf file
+     * @param expectedDigest SHA-256 hex to require, or null to check structure only
+     * @return Verification result; [VerifyResult.verified] is false when the
+     *         native verifier is unavailable and only existence was checked
+     */
+    suspend fun verify(file: File, expectedDigest: String? = null): VerifyResult = withContext(Dispatchers.IO) {
+        if (!file.exists()) {
+            return@withContext VerifyResult(ok = false, verified = true, error = "File not found")
+        }
+        if (!SmithNative.available) {
+            Log.w(TAG, "Native verifier unavailable, trusting ${file.name}")
+            return@withContext VerifyResult(ok = file.length() > 0, verified = false)
+        }
+        
+        try {
+            val json = JSONObject(nativeVerify(file.absolutePath, expectedDigest ?: ""))
+            val result = VerifyResult(
+                ok = json.optBoolean("ok", false),
+                verified = true,
+                cached = json.optBoolean("cached", false),
+                digest = json.optString("digest", ""),
+                error = json.optString("error", ""),
+                tensorCount = json.optLong("n_tensors", 0),
+                elapsedMs = json.optLong("elapsed_us", 0) / 1000
+            )
+            if (result.ok) {
+                Log.i(TAG, "${file.name} verified in ${result.elapsedMs}ms" +
+                        if (result.cached) " (cached)" else "")
+            } else {
+                Log.e(TAG, "${file.name} failed verification: ${result.error}")
+            }
+            result
+        } catch (e: Exception) {
+            Log.e(TAG, "Verification error", e)
+            VerifyResult(ok = false, verified = false, error = e.message ?: "Unknown error")
+        }
+    }
+}
+
+/**
+ * Result of a model integrity check
+ */
+data class VerifyResult(
+    val ok: Boolean,
+    val verified: Boolean,
+    val cached: Boolean = false,
+    val digest: String = "",
+    val error: String = "",
+    val tensorCount: Long = 0,
+    val elapsedMs: Long = 0
+)
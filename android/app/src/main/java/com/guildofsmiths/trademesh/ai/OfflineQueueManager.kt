@@ -7,6 +7,9 @@ import com.guildofsmiths.trademesh.data.MessageRepository
 import com.guildofsmiths.trademesh.service.ChatManager
 import kotlinx.coroutines.*
 import kotlinx.coroutines.flow.*
+import kotlinx.coroutines.sync.Mutex
+import org.json.JSONObject
+import java.io.File
 import java.util.UUID
 import java.util.concurrent.ConcurrentLinkedQueue
 
@@ -16,6 +19,14 @@ import java.util.concurrent.ConcurrentLinkedQueue
  * Queues AI responses and actions locally when offline, then syncs to chat timeline
  * when connectivity returns. Preserves order and attribution as "Assistant".
  *
+ * Responses queued without the on-device LLM (battery-gated or model not yet
+ * loaded) keep their enhancement prompt. Once full AI is available again the
+ * whole backlog is enhanced in one LlamaInference.generateBatch call rather
+ * than one generation per item.
+ *
+ * Both queues survive a restart: each queued, updated or synced item is one
+ * append to a native RecordLog, when libsmith_native.so is available.
+ *
  * FITS IN: New service class in ai package, integrates with AIRouter and ChatManager
  */
 object OfflineQueueManager {
@@ -38,6 +49,19 @@ object OfflineQueueManager {
     private val _syncState = MutableStateFlow(SyncState.IDLE)
     val syncState: StateFlow<SyncState> = _syncState.asStateFlow()
 
+    // Held while a batch enhancement pass runs
+    private val enhanceMutex = Mutex()
+
+    private const val ENHANCE_MAX_TOKENS = 100
+    private const val ENHANCE_TEMPERATURE = 0.3f
+
+    private const val QUEUE_FILE = "ai_offline_queue.log"
+    private const val RESPONSE_KEY = "response:"
+    private const val ACTION_KEY = "action:"
+
+    // Persistent copy of both queues (null without the native library)
+    private var queueLog: RecordLog? = null
+
     private var context: Context? = null
     private var isInitialized = false
 
@@ -52,6 +76,8 @@ object OfflineQueueManager {
         if (isInitialized) return
 
         context = appContext.applicationContext
+        queueLog = RecordLog.open(File(appContext.filesDir, QUEUE_FILE))
+        restoreQueues()
         isInitialized = true
 
         // Start monitoring connectivity for auto-sync
@@ -65,6 +91,8 @@ object OfflineQueueManager {
      */
     fun shutdown() {
         scope.cancel()
+        queueLog?.close()
+        queueLog = null
         context = null
         isInitialized = false
     }
@@ -76,12 +104,16 @@ object OfflineQueueManager {
     /**
      * Queue an AI response for later sync to chat.
      * Called when AI generates response but we're offline or want to batch.
+     *
+     * @param enhancementPrompt LLM prompt to enhance the response with once
+     *        the on-device model is available, or null if already final
      */
     fun queueResponse(
         response: AIResponse.Success,
         channelId: String,
         jobId: String? = null,
-        contextId: String? = null
+        contextId: String? = null,
+        enhancementPrompt: String? = null
     ) {
         val queued = QueuedAIResponse(
             id = UUID.randomUUID().toString(),
@@ -90,10 +122,12 @@ object OfflineQueueManager {
             channelId = channelId,
             jobId = jobId,
             contextId = contextId,
-            retryCount = 0
+            retryCount = 0,
+            enhancementPrompt = enhancementPrompt
         )
 
         responseQueue.add(queued)
+        persist(queued)
         Log.d(TAG, "Queued AI response: ${queued.id}")
 
         // Try immediate sync if online
@@ -122,6 +156,7 @@ object OfflineQueueManager {
         )
 
         actionQueue.add(queued)
+        persist(queued)
         Log.d(TAG, "Queued AI action: ${queued.id}")
 
         // Try immediate sync if online
@@ -153,6 +188,7 @@ object OfflineQueueManager {
     fun clearQueue() {
         responseQueue.clear()
         actionQueue.clear()
+        queueLog?.clear()
         Log.d(TAG, "Cleared all queued items")
     }
 
@@ -180,6 +216,8 @@ object OfflineQueueManager {
     // ════════════════════════════════════════════════════════════════════
 
     private suspend fun trySyncQueuedItems(): Boolean {
+        enhancePendingResponses()
+
         if (_syncState.value == SyncState.SYNCING) {
             Log.d(TAG, "Sync already in progress")
             return false
@@ -252,6 +290,7 @@ object OfflineQueueManager {
 
             // Remove from queue
             responseQueue.remove(queued)
+            queueLog?.remove(listOf(RESPONSE_KEY + queued.id))
             Log.d(TAG, "Synced response: ${queued.id}")
 
             true
@@ -262,6 +301,7 @@ object OfflineQueueManager {
             queued.retryCount++
             if (queued.retryCount >= 3) {
                 responseQueue.remove(queued) // Give up after 3 retries
+                queueLog?.remove(listOf(RESPONSE_KEY + queued.id))
                 Log.w(TAG, "Gave up on response ${queued.id} after ${queued.retryCount} retries")
             }
             false
@@ -302,6 +342,7 @@ object OfflineQueueManager {
 
             // Remove from queue
             actionQueue.remove(queued)
+            queueLog?.remove(listOf(ACTION_KEY + queued.id))
             Log.d(TAG, "Synced action: ${queued.id}")
 
             true
@@ -311,12 +352,158 @@ object OfflineQueueManager {
             queued.retryCount++
             if (queued.retryCount >= 3) {
                 actionQueue.remove(queued)
+                queueLog?.remove(listOf(ACTION_KEY + queued.id))
                 Log.w(TAG, "Gave up on action ${queued.id} after ${queued.retryCount} retries")
             }
             false
         }
     }
 
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - BATCH ENHANCEMENT
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Enhance every queued response still waiting for the LLM, in one batch.
+     * Runs only when full AI is available; otherwise items stay as they are
+     * and are retried on the next pass (or synced unenhanced).
+     */
+    private suspend fun enhancePendingResponses() {
+        if (BatteryGate.getAIStatus() != AIAvailability.FULL ||
+            LlamaInference.modelState.value != ModelState.READY) {
+            return
+        }
+        if (!enhanceMutex.tryLock()) return
+        try {
+            val pending = responseQueue.filter { it.enhancementPrompt != null }.sortedBy { it.timestamp }
+            if (pending.isEmpty()) return
+
+            Log.i(TAG, "Enhancing ${pending.size} queued responses in one batch")
+            val results = LlamaInference.generateBatch(
+                prompts = pending.map { it.enhancementPrompt!! },
+                params = pending.map { GenerationParams(ENHANCE_MAX_TOKENS, ENHANCE_TEMPERATURE) },
+                priority = InferencePriority.BACKGROUND
+            )
+
+            pending.zip(results).forEach { (queued, result) ->
+                if (result.ok) {
+                    val enhanced = result.text.trim()
+                    if (enhanced.isNotEmpty()) {
+                        queued.response = queued.response.copy(text = "${queued.response.text}\n\n💡 $enhanced")
+                    }
+                    queued.enhancementPrompt = null
+                    persist(queued)
+                } else {
+                    Log.w(TAG, "Enhancement of ${queued.id} failed: ${result.error}")
+                }
+            }
+        } catch (e: CancellationException) {
+            throw e
+        } catch (e: Exception) {
+            Log.w(TAG, "Batch enhancement failed", e)
+        } finally {
+            enhanceMutex.unlock()
+        }
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE - PERSISTENCE
+    // ════════════════════════════════════════════════════════════════════
+
+    private fun restoreQueues() {
+        val store = queueLog ?: return
+        store.values().forEach { text ->
+            try {
+                val json = JSONObject(text)
+                if (json.has("action")) {
+                    actionQueue.add(actionFromJson(json))
+                } else {
+                    responseQueue.add(responseFromJson(json))
+                }
+            } catch (e: Exception) {
+                Log.w(TAG, "Skipping unreadable queued item", e)
+            }
+        }
+        if (store.size() > 0) {
+            Log.i(TAG, "Restored ${responseQueue.size} responses and ${actionQueue.size} actions")
+        }
+    }
+
+    private fun persist(queued: QueuedAIResponse) {
+        val json = JSONObject().apply {
+            put("id", queued.id)
+            put("timestamp", queued.timestamp)
+            put("text", queued.response.text)
+            put("source", queued.response.source.name)
+            put("model", queued.response.model)
+            put("durationMs", queued.response.durationMs)
+            put("tokensGenerated", queued.response.tokensGenerated)
+            put("cueType", queued.response.cueType.name)
+            put("intent", queued.response.intent.name)
+            put("channelId", queued.channelId)
+            put("jobId", queued.jobId)
+            put("contextId", queued.contextId)
+            put("enhancementPrompt", queued.enhancementPrompt)
+        }
+        queueLog?.put(RESPONSE_KEY + queued.id, json.toString())
+    }
+
+    private fun persist(queued: QueuedAIAction) {
+        val json = JSONObject().apply {
+            put("id", queued.id)
+            put("timestamp", queued.timestamp)
+            put("action", when (queued.action) {
+                is AIAction.TimeConfirmation -> "TimeConfirmation"
+                is AIAction.JobUpdate -> "JobUpdate"
+                is AIAction.MaterialRequest -> "MaterialRequest"
+            })
+            put("message", queued.action.message)
+            put("channelId", queued.channelId)
+            put("jobId", queued.jobId)
+            put("contextId", queued.contextId)
+        }
+        queueLog?.put(ACTION_KEY + queued.id, json.toString())
+    }
+
+    private fun responseFromJson(json: JSONObject) = QueuedAIResponse(
+        id = json.getString("id"),
+        timestamp = json.getLong("timestamp"),
+        response = AIResponse.Success(
+            text = json.getString("text"),
+            source = AISource.valueOf(json.getString("source")),
+            model = json.getString("model"),
+            durationMs = json.getLong("durationMs"),
+            tokensGenerated = json.getInt("tokensGenerated"),
+            cueType = AICueType.valueOf(json.getString("cueType")),
+            intent = AIIntent.valueOf(json.getString("intent"))
+        ),
+        channelId = json.getString("channelId"),
+        jobId = json.optStringOrNull("jobId"),
+        contextId = json.optStringOrNull("contextId"),
+        enhancementPrompt = json.optStringOrNull("enhancementPrompt")
+    )
+
+    private fun actionFromJson(json: JSONObject): QueuedAIAction {
+        val message = json.getString("message")
+        val action = when (json.getString("action")) {
+            "TimeConfirmation" -> AIAction.TimeConfirmation(message)
+            "JobUpdate" -> AIAction.JobUpdate(message)
+            "MaterialRequest" -> AIAction.MaterialRequest(message)
+            else -> throw IllegalArgumentException("Unknown action ${json.getString("action")}")
+        }
+        return QueuedAIAction(
+            id = json.getString("id"),
+            timestamp = json.getLong("timestamp"),
+            action = action,
+            channelId = json.getString("channelId"),
+            jobId = json.optStringOrNull("jobId"),
+            contextId = json.optStringOrNull("contextId")
+        )
+    }
+
+    private fun JSONObject.optStringOrNull(name: String): String? =
+        if (has(name) && !isNull(name)) getString(name) else null
+
     // ════════════════════════════════════════════════════════════════════
     // PRIVATE - UTILITIES
     // ════════════════════════════════════════════════════════════════════
@@ -351,11 +538,12 @@ object OfflineQueueManager {
 data class QueuedAIResponse(
     val id: String,
     val timestamp: Long,
-    val response: AIResponse.Success,
+    var response: AIResponse.Success,
     val channelId: String,
     val jobId: String?,
     val contextId: String?,
-    var retryCount: Int = 0
+    var retryCount: Int = 0,
+    var enhancementPrompt: String? = null   // pending on-device enhancement
 )
 
 /**
@@ -28,6 +28,7 @@ object PlanAgent {
 
     private const val TAG = "PlanAgent"
     private const val MODEL_NAME = "Qwen-0.6B" // Small model for language processing only
+    private const val SUMMARY_MAX_TOKENS = 400
 
     private var isInitialized = false
 
@@ -187,6 +188,13 @@ object PlanAgent {
             structured.appendLine(processedText)
             structured.appendLine()
 
+            writeSummaryProse(processedText)?.let { summary ->
+                structured.appendLine("PROJECT SUMMARY")
+                structured.appendLine("===============")
+                structured.appendLine(summary)
+                structured.appendLine()
+            }
+
             // Add standard sections
             structured.appendLine("ASSUMPTIONS & CONDITIONS")
             structured.appendLine("========================")
@@ -215,6 +223,33 @@ object PlanAgent {
         }
     }
 
+    /**
+     * Proposal prose summarizing the plan, or null without a loaded model.
+     * Long enough to outlive the process on a slow device, so it is
+     * checkpointed under a key derived from the text: asking again for the
+     * same plan after a restart continues where the last attempt stopped.
+     */
+    private suspend fun writeSummaryProse(processedText: String): String? {
+        if (LlamaInference.modelState.value != ModelState.READY) return null
+
+        val prompt = buildString {
+            appendLine("Rewrite the following trade job plan as a short, professional proposal summary")
+            appendLine("for the client. Plain prose only: no prices, no new scope, no lists.")
+            appendLine()
+            appendLine(processedText.trim())
+            appendLine()
+            append("Summary:")
+        }
+        val result = LlamaInference.generate(
+            prompt = prompt,
+            maxTokens = SUMMARY_MAX_TOKENS,
+            temperature = 0.3f,
+            priority = InferencePriority.NORMAL,
+            checkpointKey = "plan:${Integer.toHexString(processedText.hashCode())}"
+        )
+        return (result as? GenerationResult.Success)?.text?.trim()?.takeIf { it.isNotEmpty() }
+    }
+
     /**
      * Check if PlanAgent is available and functioning
      */
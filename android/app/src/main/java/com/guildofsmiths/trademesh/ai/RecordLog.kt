@@ -0,0 +1,79 @@
+package com.guildofsmiths.trademesh.ai
+
+import java.io.Closeable
+import java.io.File
+
+/**
+ * RecordLog - Append-only keyed store for queues and caches
+ *
+ * Thin handle over the native record log in libsmith_native.so
+ * (record_log.cpp). Each put or remove appends one checksummed record
+ * instead of rewriting the whole file, and opening maps the file rather
+ * than parsing it. Superseded records are compacted away once they
+ * outweigh the live ones. Thread-safe.
+ */
+class RecordLog private constructor(
+    private var handle: Long
+) : Closeable {
+
+    companion object {
+        /**
+         * Open or create the store at [file].
+         * @return null if the native library is unavailable
+         */
+        fun open(file: File): RecordLog? {
+            if (!SmithNative.available) return null
+            return RecordLog(nativeOpen(file.absolutePath))
+        }
+
+        // ════════════════════════════════════════════════════════════════════
+        // NATIVE METHODS (JNI)
+        // ════════════════════════════════════════════════════════════════════
+
+        @JvmStatic private external fun nativeOpen(path: String): Long
+        @JvmStatic private external fun nativeClose(handle: Long)
+        @JvmStatic private external fun nativePut(handle: Long, key: String, value: ByteArray): Boolean
+        @JvmStatic private external fun nativeRemove(handle: Long, keys: Array<String>): Boolean
+        @JvmStatic private external fun nativeClear(handle: Long): Boolean
+        @JvmStatic private external fun nativeValues(handle: Long): Array<ByteArray>?
+        @JvmStatic private external fun nativeSize(handle: Long): Int
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Store [value] under [key]; a replaced key keeps its place in [values].
+     * @return false if the file could not be written
+     */
+    @Synchronized
+    fun put(key: String, value: String): Boolean =
+        handle != 0L && nativePut(handle, key, value.toByteArray(Charsets.UTF_8))
+
+    /** Remove [keys] in one write. */
+    @Synchronized
+    fun remove(keys: Collection<String>): Boolean =
+        handle != 0L && (keys.isEmpty() || nativeRemove(handle, keys.toTypedArray()))
+
+    @Synchronized
+    fun clear(): Boolean = handle != 0L && nativeClear(handle)
+
+    /** Stored values, in the order their keys were first put. */
+    @Synchronized
+    fun values(): List<String> {
+        if (handle == 0L) return emptyList()
+        return nativeValues(handle)?.map { String(it, Charsets.UTF_8) } ?: emptyList()
+    }
+
+    @Synchronized
+    fun size(): Int = if (handle != 0L) nativeSize(handle) else 0
+
+    @Synchronized
+    override fun close() {
+        if (handle != 0L) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+}
@@ -18,16 +18,20 @@ import java.util.concurrent.ConcurrentLinkedQueue
  * - Attribution data for AI messages
  * - Recovery after app restart
  * 
- * Uses simple JSON file storage for reliability.
+ * Each change is one append to a native RecordLog (one JSON record per
+ * response), so a write no longer reserializes the whole cache. Without
+ * libsmith_native.so the cache falls back to a single JSON file.
  */
 object ResponseCache {
     
     private const val TAG = "ResponseCache"
     private const val CACHE_FILE = "ai_response_cache.json"
+    private const val LOG_FILE = "ai_response_cache.log"
     private const val MAX_CACHE_SIZE = 200
     private const val MAX_AGE_MS = 7 * 24 * 60 * 60 * 1000L // 7 days
     
     private var cacheFile: File? = null
+    private var log: RecordLog? = null
     private val cache = ConcurrentLinkedQueue<CachedAIResponse>()
     
     private val _pendingCount = MutableStateFlow(0)
@@ -42,6 +46,7 @@ object ResponseCache {
      */
     fun initialize(context: Context) {
         cacheFile = File(context.filesDir, CACHE_FILE)
+        log = RecordLog.open(File(context.filesDir, LOG_FILE))
         loadFromDisk()
         cleanupOldEntries()
         _pendingCount.value = cache.size
@@ -65,12 +70,13 @@ object ResponseCache {
         cache.add(response)
         
         // Enforce size limit
+        val evicted = mutableListOf<String>()
         while (cache.size > MAX_CACHE_SIZE) {
-            cache.poll()
+            cache.poll()?.let { evicted.add(it.id) }
         }
         
         _pendingCount.value = cache.size
-        saveToDisk()
+        persistAdded(response, evicted)
         
         Log.d(TAG, "Added response ${response.id} to cache (total: ${cache.size})")
     }
@@ -101,7 +107,7 @@ object ResponseCache {
         val before = cache.size
         cache.removeAll { it.id in ids }
         _pendingCount.value = cache.size
-        saveToDisk()
+        persistRemoved(ids)
         Log.d(TAG, "Removed ${before - cache.size} synced responses")
     }
     
@@ -116,7 +122,7 @@ object ResponseCache {
             // Or just remove if we don't need synced ones in cache
         }
         _pendingCount.value = cache.size
-        saveToDisk()
+        persistRemoved(listOf(id))
     }
     
     /**
@@ -125,7 +131,8 @@ object ResponseCache {
     fun clear() {
         cache.clear()
         _pendingCount.value = 0
-        saveToDisk()
+        val store = log
+        if (store != null) store.clear() else saveToDisk()
         Log.i(TAG, "Cache cleared")
     }
     
@@ -138,6 +145,22 @@ object ResponseCache {
     // PERSISTENCE
     // ════════════════════════════════════════════════════════════════════
     
+    private fun persistAdded(response: CachedAIResponse, evicted: List<String>) {
+        val store = log ?: return saveToDisk()
+        store.remove(evicted)
+        if (!store.put(response.id, responseToJson(response).toString())) {
+            Log.e(TAG, "Failed to append response ${response.id}")
+        }
+    }
+    
+    private fun persistRemoved(ids: List<String>) {
+        val store = log ?: return saveToDisk()
+        if (!store.remove(ids)) {
+            Log.e(TAG, "Failed to record removal of ${ids.size} responses")
+        }
+    }
+    
+    /** Whole-cache JSON write, used only without the native log. */
     private fun saveToDisk() {
         val file = cacheFile ?: return
         
@@ -153,6 +176,20 @@ object ResponseCache {
     }
     
     private fun loadFromDisk() {
+        log?.let { store ->
+            cache.clear()
+            store.values().forEach { text ->
+                try {
+                    jsonToResponse(JSONObject(text))?.let { cache.add(it) }
+                } catch (e: Exception) {
+                    Log.w(TAG, "Skipping unreadable cached response", e)
+                }
+            }
+            migrateJsonFile(store)
+            Log.i(TAG, "Loaded ${cache.size} responses from log")
+            return
+        }
+        
         val file = cacheFile ?: return
         
         if (!file.exists()) return
@@ -175,6 +212,25 @@ object ResponseCache {
         }
     }
     
+    /** Move entries from the old whole-file JSON cache into the log, once. */
+    private fun migrateJsonFile(store: RecordLog) {
+        val file = cacheFile ?: return
+        if (!file.exists()) return
+        try {
+            val json = JSONArray(file.readText().ifBlank { "[]" })
+            for (i in 0 until json.length()) {
+                val response = jsonToResponse(json.getJSONObject(i)) ?: continue
+                if (cache.none { it.id == response.id } && store.put(response.id, responseToJson(response).toString())) {
+                    cache.add(response)
+                }
+            }
+            file.delete()
+            Log.i(TAG, "Migrated ${json.length()} responses from $CACHE_FILE")
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to migrate $CACHE_FILE", e)
+        }
+    }
+    
     private fun responseToJson(response: CachedAIResponse): JSONObject {
         return JSONObject().apply {
             put("id", response.id)
@@ -214,12 +270,13 @@ object ResponseCache {
         val now = System.currentTimeMillis()
         val before = cache.size
         
-        cache.removeAll { (now - it.timestamp) > MAX_AGE_MS }
+        val expired = cache.filter { (now - it.timestamp) > MAX_AGE_MS }
+        cache.removeAll(expired.toSet())
         
         if (cache.size < before) {
             Log.d(TAG, "Cleaned up ${before - cache.size} old entries")
             _pendingCount.value = cache.size
-            saveToDisk()
+            persistRemoved(expired.map { it.id })
         }
     }
 }
@@ -0,0 +1,29 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+
+/**
+ * SmithNative - Loader for libsmith_native.so
+ * 
+ * The lightweight native utilities (verification, GGUF metadata, ...) share
+ * one small library with no llama.cpp dependency. Loading it is cheap, so
+ * it happens on first use from whichever wrapper object needs it.
+ */
+object SmithNative {
+    
+    private const val TAG = "SmithNative"
+    
+    /**
+     * True once the library is loaded; false if it is missing for this ABI,
+     * or on a plain JVM (unit tests), where the wrappers use Kotlin fallbacks.
+     */
+    val available: Boolean by lazy {
+        try {
+            System.loadLibrary("smith_native")
+            true
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Failed to load native library", e)
+            false
+        }
+    }
+}
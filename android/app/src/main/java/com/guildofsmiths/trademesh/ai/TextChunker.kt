@@ -0,0 +1,52 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+
+/**
+ * TextChunker - Splits documents into chunks for retrieval
+ *
+ * Runs the chunker in libsmith_native.so (text_chunker.cpp): chunks of
+ * about [targetBytes] that break at headings, then blank lines, line
+ * breaks, sentence ends. A chunk continuing a section starts with its
+ * heading. The same text always gives the same chunks, so identical
+ * documents can be deduplicated by chunk.
+ *
+ * Safe from any thread. Returns null when the library is missing.
+ */
+object TextChunker {
+
+    private const val TAG = "TextChunker"
+
+    const val DEFAULT_TARGET_BYTES = 600
+    const val DEFAULT_OVERLAP_BYTES = 120
+
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+
+    private external fun nativeChunk(text: ByteArray, targetBytes: Int, overlapBytes: Int): Array<ByteArray>?
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Chunks of [text] in document order.
+     *
+     * @return Chunks (empty if the text has no content), or null if unavailable
+     */
+    fun chunk(
+        text: String,
+        targetBytes: Int = DEFAULT_TARGET_BYTES,
+        overlapBytes: Int = DEFAULT_OVERLAP_BYTES
+    ): List<String>? {
+        if (!SmithNative.available) return null
+        return try {
+            nativeChunk(text.toByteArray(Charsets.UTF_8), targetBytes, overlapBytes)
+                ?.map { String(it, Charsets.UTF_8) }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Native chunker unavailable", e)
+            null
+        }
+    }
+}
@@ -0,0 +1,130 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import java.io.Closeable
+import java.util.BitSet
+
+/**
+ * TextScanner - Finds many literal patterns in one pass over a text
+ *
+ * The patterns are compiled into a single automaton in libsmith_native.so
+ * (text_scanner.cpp), so checking a message against every cue, keyword and
+ * rule word costs one pass instead of one regex or contains() each.
+ * Matching ignores ASCII case and treats any run of whitespace as one
+ * space; like contains(), a match may start mid-word.
+ *
+ * Without the native library the same matching runs in Kotlin, so results
+ * never depend on the device. Thread-safe.
+ */
+class TextScanner(patterns: List<String>) : Closeable {
+
+    companion object {
+        private const val TAG = "TextScanner"
+
+        // ════════════════════════════════════════════════════════════════════
+        // NATIVE METHODS (JNI)
+        // ════════════════════════════════════════════════════════════════════
+
+        @JvmStatic private external fun nativeCompile(patterns: Array<ByteArray>): Long
+        @JvmStatic private external fun nativeRelease(handle: Long)
+        @JvmStatic private external fun nativeScanBatch(handle: Long, texts: Array<ByteArray>): Array<IntArray>?
+
+        // Same folding as the native scanner: ASCII lowercase, whitespace runs to one space
+        private fun normalize(text: CharSequence): String {
+            val out = StringBuilder(text.length)
+            for (c in text) {
+                val folded = when (c) {
+                    ' ', '\t', '\n', '\u000B', '\u000C', '\r' -> ' '
+                    in 'A'..'Z' -> c + ('a' - 'A')
+                    else -> c
+                }
+                if (folded == ' ' && out.isNotEmpty() && out[out.length - 1] == ' ') continue
+                out.append(folded)
+            }
+            return out.toString()
+        }
+    }
+
+    val patterns: List<String> = patterns.toList()
+
+    private val foldedPatterns: List<String> by lazy { this.patterns.map { normalize(it) } }
+
+    @Volatile
+    private var handle: Long = if (SmithNative.available) {
+        try {
+            nativeCompile(Array(this.patterns.size) { i -> this.patterns[i].toByteArray(Charsets.UTF_8) })
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Native scanner unavailable", e)
+            0L
+        }
+    } else 0L
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Every match in [text], as the index of the pattern matched (a
+     * pattern found twice appears twice).
+     */
+    fun scan(text: String): IntArray = scanAll(listOf(text))[0]
+
+    /**
+     * Indices of the patterns found in [text].
+     */
+    fun find(text: String): BitSet = toBitSet(scan(text))
+
+    /**
+     * Scan many texts in one native call (e.g. backfilling message history).
+     *
+     * @return Matches per text, as for [scan]
+     */
+    fun scanAll(texts: List<String>): List<IntArray> {
+        if (texts.isEmpty()) return emptyList()
+        val h = handle
+        if (h != 0L) {
+            try {
+                val input = Array(texts.size) { i -> texts[i].toByteArray(Charsets.UTF_8) }
+                nativeScanBatch(h, input)?.let { return it.toList() }
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e(TAG, "Native scan failed", e)
+            }
+        }
+        return texts.map { scanInKotlin(it) }
+    }
+
+    /**
+     * Patterns found per text, for many texts in one native call.
+     */
+    fun findAll(texts: List<String>): List<BitSet> = scanAll(texts).map { toBitSet(it) }
+
+    override fun close() {
+        val h = handle
+        handle = 0L
+        if (h != 0L) nativeRelease(h)
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PRIVATE HELPERS
+    // ════════════════════════════════════════════════════════════════════
+
+    private fun toBitSet(matches: IntArray): BitSet {
+        val found = BitSet(patterns.size)
+        for (index in matches) found.set(index)
+        return found
+    }
+
+    private fun scanInKotlin(text: String): IntArray {
+        val folded = normalize(text)
+        val matches = ArrayList<Int>()
+        foldedPatterns.forEachIndexed { index, pattern ->
+            if (pattern.isEmpty()) return@forEachIndexed
+            var at = folded.indexOf(pattern)
+            while (at >= 0) {
+                matches.add(index)
+                at = folded.indexOf(pattern, at + 1)
+            }
+        }
+        return matches.toIntArray()
+    }
+}
@@ -0,0 +1,124 @@
+package com.guildofsmiths.trademesh.ai
+
+import android.util.Log
+import org.json.JSONObject
+import java.io.Closeable
+import java.io.File
+
+/**
+ * TranslationMemory - Persistent store of past translations
+ *
+ * Thin handle over the native translation memory in libsmith_native.so
+ * (translation_memory.cpp). Every translation the LLM produces is kept
+ * under its normalized source segment, so a repeated phrase is answered
+ * without touching the decoder. A phrase a few words off a stored one is
+ * a near hit, with its word-level similarity. Thread-safe.
+ */
+class TranslationMemory private constructor(
+    private var handle: Long
+) : Closeable {
+
+    companion object {
+        private const val TAG = "TranslationMemory"
+
+        /**
+         * Open or create the memory at [file].
+         * @return null if the native library is unavailable
+         */
+        fun open(file: File): TranslationMemory? {
+            if (!SmithNative.available) return null
+            return TranslationMemory(nativeOpen(file.absolutePath))
+        }
+
+        // ════════════════════════════════════════════════════════════════════
+        // NATIVE METHODS (JNI)
+        // ════════════════════════════════════════════════════════════════════
+
+        @JvmStatic private external fun nativeOpen(path: String): Long
+        @JvmStatic private external fun nativeClose(handle: Long)
+        @JvmStatic private external fun nativeLookup(
+            handle: Long,
+            sourceLang: String,
+            targetLang: String,
+            text: ByteArray,
+            minSimilarity: Float
+        ): ByteArray
+        @JvmStatic private external fun nativePut(
+            handle: Long,
+            sourceLang: String,
+            targetLang: String,
+            text: ByteArray,
+            translation: ByteArray
+        ): Boolean
+        @JvmStatic private external fun nativeSize(handle: Long): Int
+    }
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * Stored translation of [text], exact or at least [minSimilarity] alike.
+     * @return null on a miss
+     */
+    @Synchronized
+    fun lookup(sourceLang: String, targetLang: String, text: String, minSimilarity: Float): TranslationHit? {
+        if (handle == 0L) return null
+        return try {
+            val bytes = nativeLookup(handle, sourceLang, targetLang, text.toByteArray(Charsets.UTF_8), minSimilarity)
+            val json = JSONObject(String(bytes, Charsets.UTF_8))
+            if (!json.getBoolean("found")) return null
+            TranslationHit(
+                translation = json.getString("translation"),
+                exact = json.getBoolean("exact"),
+                similarity = json.getDouble("similarity").toFloat(),
+                source = json.getString("source")
+            )
+        } catch (e: Exception) {
+            Log.e(TAG, "Lookup failed", e)
+            null
+        }
+    }
+
+    /**
+     * Remember [translation] of [text], replacing an older one.
+     * @return false if the segment is empty or too long, or the file could not be written
+     */
+    @Synchronized
+    fun put(sourceLang: String, targetLang: String, text: String, translation: String): Boolean {
+        if (handle == 0L) return false
+        return nativePut(
+            handle, sourceLang, targetLang,
+            text.toByteArray(Charsets.UTF_8), translation.toByteArray(Charsets.UTF_8)
+        )
+    }
+
+    @Synchronized
+    fun size(): Int = if (handle != 0L) nativeSize(handle) else 0
+
+    @Synchronized
+    override fun close() {
+        if (handle != 0L) {
+            nativeClose(handle)
+            handle = 0L
+        }
+    }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// DATA CLASSES
+// ════════════════════════════════════════════════════════════════════
+
+/**
+ * A stored translation
+ *
+ * @property exact Same normalized segment; otherwise a near hit
+ * @property similarity 1 - word edit distance / longer segment length
+ * @property source The normalized segment that was matched
+ */
+data class TranslationHit(
+    val translation: String,
+    val exact: Boolean,
+    val similarity: Float,
+    val source: String
+)
@@ -33,6 +33,7 @@ object UserPreferences {
     // Onboarding-related keys
     private const val KEY_LANGUAGE = "language"
     private const val KEY_AI_ENABLED = "ai_enabled"
+    private const val KEY_MESH_AI_REPLIES = "mesh_ai_replies"
     private const val KEY_ADDRESS_STREET = "address_street"
     private const val KEY_ADDRESS_CITY = "address_city"
     private const val KEY_ADDRESS_STATE = "address_state"
@@ -252,6 +253,21 @@ object UserPreferences {
         return prefs?.getBoolean(KEY_AI_ENABLED, false) ?: false
     }
 
+    /**
+     * Whether @AI questions from mesh peers are answered on the mesh.
+     * Default: false - a reply is broadcast to every peer in range.
+     */
+    fun isMeshAiRepliesEnabled(): Boolean {
+        return prefs?.getBoolean(KEY_MESH_AI_REPLIES, false) ?: false
+    }
+
+    /**
+     * Set whether @AI questions from mesh peers are answered on the mesh.
+     */
+    fun setMeshAiRepliesEnabled(enabled: Boolean) {
+        prefs?.edit()?.putBoolean(KEY_MESH_AI_REPLIES, enabled)?.apply()
+    }
+
     /**
      * Set language preference.
      */
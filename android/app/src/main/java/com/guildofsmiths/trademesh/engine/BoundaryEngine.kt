@@ -4,6 +4,7 @@ import android.content.Context
 import android.net.ConnectivityManager
 import android.net.NetworkCapabilities
 import android.util.Log
+import com.guildofsmiths.trademesh.ai.AIRouter
 import com.guildofsmiths.trademesh.data.BeaconRepository
 import com.guildofsmiths.trademesh.data.Channel
 import com.guildofsmiths.trademesh.data.ChannelType
@@ -21,6 +22,7 @@ import com.guildofsmiths.trademesh.data.UserPreferences
 import com.guildofsmiths.trademesh.service.BackendConfig
 import com.guildofsmiths.trademesh.service.ChatManager
 import com.guildofsmiths.trademesh.service.GatewayClient
+import com.guildofsmiths.trademesh.service.MeshReplyStream
 import com.guildofsmiths.trademesh.service.MeshService
 import com.guildofsmiths.trademesh.service.SupabaseChat
 import kotlinx.coroutines.CoroutineScope
@@ -284,6 +286,28 @@ object BoundaryEngine {
         meshService?.broadcastMessage(meshMessage)
     }
     
+    /**
+     * Open a stream that puts an AI reply to [prompt] on the mesh segment by
+     * segment while it is generated. Returns null without a MeshService.
+     */
+    fun openMeshReply(prompt: Message): MeshReplyStream? {
+        val service = meshService ?: return null
+        val channelName = resolveChannelNameFromId(prompt.channelId) ?: prompt.channelId
+        val template = Message(
+            beaconId = prompt.beaconId,
+            channelId = channelName,
+            senderId = MeshService.aiSenderId(UserPreferences.getUserId()),
+            senderName = Message.AI_SENDER_NAME,
+            content = "",
+            isMeshOrigin = true,
+            aiGenerated = true,
+            aiPrompt = prompt.content
+        )
+        return MeshReplyStream(template, MeshService.MAX_CONTENT_BYTES) { segment ->
+            service.queueBroadcast(segment)
+        }
+    }
+    
     /**
      * Resolve a channel UUID to its name for mesh broadcast.
      * Returns the name if found, or the original ID if not.
@@ -582,6 +606,9 @@ object BoundaryEngine {
 
         // Forward to gateway if connected (bridge mesh → online)
         forwardToGateway(resolvedMessage)
+
+        // @AI questions from peers may be answered on air (opt-in)
+        AIRouter.onMeshMessageReceived(resolvedMessage)
     }
     
     /**
@@ -2,6 +2,7 @@ package com.guildofsmiths.trademesh.planner
 
 import android.content.Context
 import android.util.Log
+import com.guildofsmiths.trademesh.ai.TextScanner
 import com.guildofsmiths.trademesh.db.AppDatabase
 import com.guildofsmiths.trademesh.db.KeywordObservationEntity
 import kotlinx.coroutines.CoroutineScope
@@ -70,6 +71,12 @@ object KeywordObserver {
         "build", "install", "repair", "replace", "construct"
     )
     
+    // Keyword-in-token checks for a whole input run as one native scan
+    private val knownScanner = TextScanner(knownKeywords.toList())
+    
+    // Token-in-keyword checks; tokens never contain the separator
+    private val knownJoined = knownKeywords.joinToString("\n")
+    
     /**
      * Initialize with application context.
      * Call once at app startup.
@@ -222,11 +229,10 @@ object KeywordObserver {
             "got", "make", "made", "some", "any", "new", "old"
         )
         
-        return tokens.filter { token ->
-            // Not a known keyword
-            !knownKeywords.any { known -> 
-                token == known || token.contains(known) || known.contains(token)
-            } &&
+        val hits = knownScanner.scanAll(tokens)
+        return tokens.filterIndexed { i, token ->
+            // Not a known keyword (or part of one, or containing one)
+            hits[i].isEmpty() && !knownJoined.contains(token) &&
             // Not a stop word
             !stopWords.contains(token) &&
             // Not purely numeric
@@ -239,9 +245,7 @@ object KeywordObserver {
      */
     fun isKnownKeyword(keyword: String): Boolean {
         val lower = keyword.lowercase().trim()
-        return knownKeywords.any { known ->
-            lower == known || lower.contains(known) || known.contains(lower)
-        }
+        return knownScanner.scan(lower).isNotEmpty() || knownJoined.contains(lower)
     }
     
     // ════════════════════════════════════════════════════════════════════
@@ -0,0 +1,84 @@
+package com.guildofsmiths.trademesh.service
+
+import android.util.Log
+import com.guildofsmiths.trademesh.ai.SmithNative
+
+/**
+ * MeshCodec - Model-free compression for mesh payloads
+ *
+ * Huffman-codes text against a static dictionary of trade vocabulary in
+ * libsmith_native.so, so every device can fit more than 9 bytes of text
+ * into a beacon ("need more conduit on site" takes 7 bytes). Frames start
+ * with 0xC0, which never starts UTF-8 text.
+ *
+ * Calls take microseconds and are safe from any thread.
+ */
+object MeshCodec {
+
+    private const val TAG = "MeshCodec"
+
+    private const val FRAME_TAG = 0xC0.toByte()
+
+    // ════════════════════════════════════════════════════════════════════
+    // NATIVE METHODS (JNI)
+    // ════════════════════════════════════════════════════════════════════
+
+    private external fun nativeEncodeBatch(texts: Array<ByteArray>, maxBytes: Int): Array<ByteArray?>?
+    private external fun nativeDecodeBatch(frames: Array<ByteArray>): Array<ByteArray?>?
+
+    // ════════════════════════════════════════════════════════════════════
+    // PUBLIC API
+    // ════════════════════════════════════════════════════════════════════
+
+    /**
+     * True if content bytes are a frame of this codec.
+     */
+    fun isFrame(bytes: ByteArray): Boolean = bytes.isNotEmpty() && bytes[0] == FRAME_TAG
+
+    /**
+     * Compress one message.
+     *
+     * @param maxBytes Largest useful frame (e.g. one beacon's content)
+     * @return The frame, or null if it does not fit or the library is missing
+     */
+    fun encode(text: String, maxBytes: Int): ByteArray? = encodeAll(listOf(text), maxBytes)[0]
+
+    /**
+     * Expand one received frame.
+     *
+     * @return The text, or null if the frame is corrupt or the library is missing
+     */
+    fun decode(frame: ByteArray): String? = decodeAll(listOf(frame))[0]
+
+    /**
+     * Compress many messages in one native call (e.g. a drained outbound queue).
+     *
+     * @return One frame per text, null where it does not fit
+     */
+    fun encodeAll(texts: List<String>, maxBytes: Int): List<ByteArray?> {
+        if (texts.isEmpty() || !SmithNative.available) return List(texts.size) { null }
+        return try {
+            val input = Array(texts.size) { i -> texts[i].toByteArray(Charsets.UTF_8) }
+            nativeEncodeBatch(input, maxBytes)?.toList() ?: List(texts.size) { null }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Encode unavailable", e)
+            List(texts.size) { null }
+        }
+    }
+
+    /**
+     * Expand many frames in one native call.
+     *
+     * @return Text per frame, null where it is not a valid frame
+     */
+    fun decodeAll(frames: List<ByteArray>): List<String?> {
+        if (frames.isEmpty() || !SmithNative.available) return List(frames.size) { null }
+        return try {
+            val output = nativeDecodeBatch(frames.toTypedArray()) ?: return List(frames.size) { null }
+            output.map { it?.toString(Charsets.UTF_8) }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Decode unavailable", e)
+            List(frames.size) { null }
+        }
+    }
+}
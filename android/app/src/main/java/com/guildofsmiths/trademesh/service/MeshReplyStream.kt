@@ -0,0 +1,136 @@
+package com.guildofsmiths.trademesh.service
+
+import android.util.Log
+import com.guildofsmiths.trademesh.data.Message
+import java.util.UUID
+
+/**
+ * MeshReplyStream - Puts a generated reply on the mesh while it is generated
+ *
+ * Text is appended as the model streams it. As soon as the buffered text
+ * holds a beacon's worth of complete words, that segment is handed to
+ * [send] as its own message, so the first segment is advertising while
+ * the rest is still being generated. A segment is as many whole words as
+ * fit one beacon, raw or dictionary-coded (MeshCodec); a word too long
+ * for any beacon is cut.
+ *
+ * Beacon ids derive from sender, channel and a timestamp in seconds, so
+ * segments are stamped one second apart, and a reply never reuses a second
+ * an earlier reply from this device already stamped.
+ *
+ * Thread-safe; [send] is called on the appending thread.
+ */
+class MeshReplyStream(
+    private val template: Message,
+    private val maxBytes: Int,
+    private val send: (Message) -> Unit
+) {
+    companion object {
+        private const val TAG = "MeshReplyStream"
+
+        // Last second stamped on any reply segment from this device
+        private var lastStampSecond = Long.MIN_VALUE
+
+        @Synchronized
+        private fun nextStamp(timestamp: Long): Long {
+            lastStampSecond = maxOf(timestamp / 1000, lastStampSecond + 1)
+            return lastStampSecond * 1000
+        }
+    }
+
+    private val pending = StringBuilder()
+    private var segments = 0
+    private var finished = false
+
+    /** Number of segments sent so far. */
+    val segmentCount: Int
+        @Synchronized get() = segments
+
+    /**
+     * Add generated text; sends every segment that can no longer grow.
+     */
+    @Synchronized
+    fun append(text: String) {
+        if (finished || text.isEmpty()) return
+        pending.append(text.replace('\n', ' '))
+        emit(final = false)
+    }
+
+    /**
+     * Send whatever is left. Later appends are ignored.
+     */
+    @Synchronized
+    fun finish() {
+        if (finished) return
+        emit(final = true)
+        finished = true
+        if (segments > 0) {
+            Log.i(TAG, "Reply streamed to mesh in $segments segments")
+        }
+    }
+
+    private fun emit(final: Boolean) {
+        while (true) {
+            while (pending.isNotEmpty() && pending[0] == ' ') {
+                pending.deleteCharAt(0)
+            }
+            if (pending.isEmpty()) return
+
+            // Longest run of whole words that fits; a word is whole once a space follows it
+            var best = -1
+            var overflowed = false
+            var boundary = pending.indexOf(" ")
+            while (true) {
+                val end = if (boundary >= 0) boundary else if (final) pending.length else break
+                if (fits(pending.substring(0, end))) {
+                    best = end
+                } else {
+                    overflowed = true
+                    break
+                }
+                if (boundary < 0) break
+                boundary = pending.indexOf(" ", boundary + 1)
+            }
+
+            val cut = when {
+                best > 0 && (overflowed || final) -> best
+                best < 0 && overflowed -> hardCut()
+                else -> return   // the segment could still grow
+            }
+            sendSegment(pending.substring(0, cut).trimEnd())
+            pending.delete(0, cut)
+        }
+    }
+
+    // Longest prefix of the first word that fits, on a code point boundary
+    private fun hardCut(): Int {
+        var cut = 0
+        var i = 0
+        while (i < pending.length) {
+            val next = i + Character.charCount(Character.codePointAt(pending, i))
+            if (!fits(pending.substring(0, next))) break
+            cut = next
+            i = next
+        }
+        return if (cut > 0) cut else Character.charCount(Character.codePointAt(pending, 0))
+    }
+
+    private fun fits(text: String): Boolean {
+        return text.toByteArray(Charsets.UTF_8).size <= maxBytes || MeshCodec.encode(text, maxBytes) != null
+    }
+
+    private fun sendSegment(content: String) {
+        if (content.isEmpty()) return
+        val message = template.copy(
+            id = UUID.randomUUID().toString(),
+            content = content,
+            timestamp = nextStamp(template.timestamp + segments * 1000L)
+        )
+        segments++
+        try {
+            send(message)
+        } catch (e: Exception) {
+            Log.w(TAG, "Segment send failed", e)
+        }
+    }
+}
@@ -33,12 +33,18 @@ import android.util.Log
 import androidx.core.app.ActivityCompat
 import androidx.core.app.NotificationCompat
 import com.guildofsmiths.trademesh.R
+import com.guildofsmiths.trademesh.ai.LlamaInference
 import com.guildofsmiths.trademesh.data.Message
 import com.guildofsmiths.trademesh.data.PeerRepository
 import com.guildofsmiths.trademesh.engine.BoundaryEngine
 import java.nio.ByteBuffer
 import java.util.ArrayDeque
 import java.util.UUID
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.launch
 
 /**
  * MeshService: BLE-based mesh communication service.
@@ -50,6 +56,12 @@ import java.util.UUID
  * 
  * Channel invites are sent as special messages with content starting with "/invite:"
  * 
+ * Content longer than a beacon is compressed: first with the static trade
+ * dictionary (MeshCodec), which every peer can read, and if that does not
+ * fit, with the on-device model when one is loaded (see
+ * LlamaInference.compressMessage). Peers without the same model still
+ * relay a model frame untouched.
+ * 
  * Total: 16 bytes fixed + up to 9 bytes content = 25 bytes max
  */
 class MeshService : Service() {
@@ -79,11 +91,18 @@ class MeshService : Service() {
         private const val CHANNEL_HASH_BYTES = 2   // 2-byte channel hash for routing
         private const val TIMESTAMP_BYTES = 4      // Use 4-byte timestamp (seconds, not ms)
         private const val HOP_COUNT_BYTES = 1      // Hop counter for TTL (prevents infinite relay loops)
-        private const val MAX_CONTENT_BYTES = 9    // Message content (~9 chars due to BLE limits)
+        const val MAX_CONTENT_BYTES = 9            // Message content (~9 chars due to BLE limits)
         private const val MAX_PAYLOAD_BYTES = SENDER_ID_BYTES + CHANNEL_HASH_BYTES + TIMESTAMP_BYTES + HOP_COUNT_BYTES + MAX_CONTENT_BYTES // 20
 
         /** Default TTL (time-to-live) - max number of relay hops */
         private const val DEFAULT_TTL: Byte = 5
+
+        /** High bit of the hop byte: the content was generated by AI */
+        private const val AI_FRAME_FLAG = 0x80
+        private const val HOP_COUNT_MASK = 0x7F
+
+        /** First byte of a device's AI sender id; never starts a user id */
+        private const val AI_SENDER_MARK = "~"
         
         /** Special channel hash for invites */
         private const val INVITE_CHANNEL_HASH: Short = 0x7FFF.toShort()
@@ -93,6 +112,23 @@ class MeshService : Service() {
         
         /** Special channel hash for ACK packets */
         private const val ACK_CHANNEL_HASH: Short = 0x7FFD.toShort()
+
+        /** A sender id as peers receive it: its first 4 UTF-8 bytes. */
+        fun wireSenderId(senderId: String): String {
+            val bytes = senderId.toByteArray(Charsets.UTF_8)
+            return String(bytes, 0, minOf(bytes.size, SENDER_ID_BYTES), Charsets.UTF_8).trimEnd('\u0000')
+        }
+
+        /**
+         * Sender id for AI replies this device streams to the mesh. Unique
+         * per device, so beacon ids of two devices' replies never collide.
+         */
+        fun aiSenderId(userId: String): String {
+            return AI_SENDER_MARK + String(userId.toByteArray(Charsets.UTF_8).take(SENDER_ID_BYTES - 1).toByteArray(), Charsets.UTF_8)
+        }
+
+        /** True for the wire form of an [aiSenderId]. */
+        fun isAiSenderId(senderId: String): Boolean = senderId.startsWith(AI_SENDER_MARK)
     }
     
     private val binder = MeshBinder()
@@ -107,6 +143,9 @@ class MeshService : Service() {
     private var isScanning = false
     private var isAdvertising = false
     
+    /** An advertisement was requested and its callback has not arrived yet */
+    private var advertiseStarting = false
+    
     /** Queue of messages to broadcast */
     private val outboundQueue = ArrayDeque<Message>()
     
@@ -114,6 +153,13 @@ class MeshService : Service() {
     private val recentPayloadHashes = LinkedHashSet<Int>()
     private val maxRecentHashes = 100
     
+    /** Compressed content by message id, reused when the message is retried or relayed */
+    private val compressedFrames = LinkedHashMap<String, ByteArray>(50, 0.75f, true)
+    private val maxCompressedFrames = 50
+    
+    /** Model compression and expansion run off the main thread */
+    private val codecScope = CoroutineScope(Dispatchers.Default + SupervisorJob())
+    
     /** Cache of recent outbound messages for retry lookup */
     private val recentOutboundMessages = LinkedHashMap<String, Message>(50, 0.75f, true)
     private val maxRecentOutbound = 50
@@ -206,6 +252,7 @@ class MeshService : Service() {
         stopScanning()
         stopAdvertising()
         MeshAckManager.clearAll()
+        codecScope.cancel()
         BoundaryEngine.unregisterMeshService()
         BoundaryEngine.stopHeartbeat()
         
@@ -295,7 +342,8 @@ class MeshService : Service() {
     /**
      * Serialize a Message to beacon bytes.
      * Format: [senderId: 4][channelHash: 2][timestamp: 4][hopCount: 1][content: up to 9]
-     * Total max: 20 bytes (fits in BLE service data)
+     * Total max: 20 bytes (fits in BLE service data). The hop byte's high
+     * bit marks AI-generated content, so peers never answer AI with AI.
      *
      * @param message The message to serialize
      * @param hopCount TTL hop counter (default 5, decremented on each relay)
@@ -323,11 +371,12 @@ class MeshService : Service() {
         val timestampSeconds = (message.timestamp / 1000).toInt()
         buffer.putInt(timestampSeconds)
 
-        // Hop count: 1 byte (TTL for relay limiting)
-        buffer.put(hopCount)
+        // Hop count: 1 byte (TTL for relay limiting), high bit set for AI content
+        val aiFlag = if (message.aiGenerated) AI_FRAME_FLAG else 0
+        buffer.put(((hopCount.toInt() and HOP_COUNT_MASK) or aiFlag).toByte())
 
-        // Content: up to 9 bytes (truncate if needed)
-        val contentBytes = message.content.toByteArray(Charsets.UTF_8)
+        // Content: up to 9 bytes (truncate if needed), or the compressed frame
+        val contentBytes = compressedFrame(message.id) ?: message.content.toByteArray(Charsets.UTF_8)
         val contentLen = minOf(contentBytes.size, MAX_CONTENT_BYTES)
         buffer.put(contentBytes, 0, contentLen)
 
@@ -342,8 +391,15 @@ class MeshService : Service() {
     
     /**
      * Parsed beacon result containing message and hop count.
+     * [relayOnly] marks a dictionary frame this device could not decode:
+     * it is passed on unchanged for peers that can, not shown here.
      */
-    private data class ParsedBeacon(val message: Message, val hopCount: Byte)
+    private data class ParsedBeacon(
+        val message: Message,
+        val hopCount: Byte,
+        val frame: ByteArray? = null,
+        val relayOnly: Boolean = false
+    )
 
     /**
      * Deserialize beacon bytes to a Message.
@@ -371,17 +427,29 @@ class MeshService : Service() {
             val timestampSeconds = buffer.getInt()
             val timestamp = timestampSeconds.toLong() * 1000
 
-            // Hop count: 1 byte
-            val hopCount = buffer.get()
+            // Hop count: 1 byte, high bit = AI-generated
+            val hopByte = buffer.get().toInt()
+            val hopCount = (hopByte and HOP_COUNT_MASK).toByte()
+            val aiGenerated = hopByte and AI_FRAME_FLAG != 0
 
             // Content: remaining bytes
             val contentLen = data.size - minLen
-            val content = if (contentLen > 0) {
-                val contentBytes = ByteArray(contentLen)
-                buffer.get(contentBytes)
-                String(contentBytes, Charsets.UTF_8)
-            } else {
-                ""
+            val contentBytes = ByteArray(contentLen)
+            buffer.get(contentBytes)
+            val frame = if (LlamaInference.isCompressedFrame(contentBytes)) contentBytes else null
+            val dictFrame = if (MeshCodec.isFrame(contentBytes)) contentBytes else null
+            val decoded = dictFrame?.let { MeshCodec.decode(it) }
+            val undecodable = dictFrame != null && decoded == null
+            val content = when {
+                frame != null -> ""
+                dictFrame != null -> decoded ?: ""
+                else -> String(contentBytes, Charsets.UTF_8)
+            }
+            if (undecodable) {
+                Log.w(TAG, "   ⚠️ Dictionary frame (${contentBytes.size} bytes) from $senderId failed to decode - relay only")
+                // Invites, deletions and ACKs are acted on, never relayed; unreadable ones are useless
+                if (channelHashValue == INVITE_CHANNEL_HASH || channelHashValue == DELETE_CHANNEL_HASH ||
+                    channelHashValue == ACK_CHANNEL_HASH) return null
             }
             
             Log.d(TAG, "   📦 Parsed: sender=$senderId, channelHash=$channelHashValue, hops=$hopCount, content='$content'")
@@ -430,10 +498,11 @@ class MeshService : Service() {
 
             // Generate a deterministic UUID from payload for deduplication + valid UUID format
             val id = UUID.nameUUIDFromBytes("${senderId}_${timestamp}_${channelHashValue}".toByteArray()).toString()
+            dictFrame?.let { rememberCompressedFrame(id, it) }
 
             // Look up peer's display name if we've seen them before
             val knownPeer = PeerRepository.getPeer(senderId)
-            val displayName = knownPeer?.userName ?: senderId
+            val displayName = if (aiGenerated) Message.AI_SENDER_NAME else knownPeer?.userName ?: senderId
 
             val message = Message(
                 id = id,
@@ -443,9 +512,10 @@ class MeshService : Service() {
                 senderName = displayName,
                 timestamp = timestamp,
                 content = content,
-                isMeshOrigin = true
+                isMeshOrigin = true,
+                aiGenerated = aiGenerated
             )
-            ParsedBeacon(message, hopCount)
+            ParsedBeacon(message, hopCount, frame, relayOnly = undecodable)
         } catch (e: Exception) {
             Log.e(TAG, "   ❌ Parse error: ${e.message}")
             null
@@ -780,9 +850,42 @@ class MeshService : Service() {
             Log.d(TAG, "   ℹ️ Message filtered (invite or unjoined channel)")
             return
         }
+        if (parsed.relayOnly) {
+            // Relayed as the raw frame remembered under its id
+            relayIfNeeded(parsed.message, parsed.hopCount)
+            return
+        }
+        if (parsed.frame != null) {
+            expandAndDeliver(parsed, rssi)
+            return
+        }
+        deliverMessage(parsed.message, parsed.hopCount, rssi)
+    }
+    
+    /**
+     * Expand a compressed message with the local model, then deliver it.
+     * Without the sender's model it cannot be read here, but it is still
+     * relayed as-is for peers that can.
+     */
+    private fun expandAndDeliver(parsed: ParsedBeacon, rssi: Int) {
         val message = parsed.message
-        val hopCount = parsed.hopCount
-
+        val frame = parsed.frame ?: return
+        rememberCompressedFrame(message.id, frame)
+        codecScope.launch {
+            val text = LlamaInference.expandMessage(frame)
+            handler.post {
+                if (text != null) {
+                    Log.i(TAG, "   🗜️ Expanded ${frame.size} bytes → \"$text\"")
+                    deliverMessage(message.copy(content = text), parsed.hopCount, rssi)
+                } else {
+                    Log.d(TAG, "   🗜️ Compressed message not readable here (no matching model) - relay only")
+                    relayIfNeeded(message, parsed.hopCount)
+                }
+            }
+        }
+    }
+    
+    private fun deliverMessage(message: Message, hopCount: Byte, rssi: Int) {
         // Check if this is an ACK packet
         if (MeshAckManager.isAckPacket(message.content)) {
             val originalMessageId = MeshAckManager.extractAckMessageId(message.content)
@@ -807,10 +910,17 @@ class MeshService : Service() {
             sendAck(message.id, message.senderId)
         }
 
-        // ═══════════════════════════════════════════════════════════════
-        // MESH RELAY: Re-broadcast message to extend range
-        // This is the core of mesh networking - every device is a relay
-        // ═══════════════════════════════════════════════════════════════
+        relayIfNeeded(message, hopCount)
+
+        // Route to BoundaryEngine with RSSI for peer tracking
+        BoundaryEngine.onMeshMessageReceived(this, message, rssi)
+    }
+    
+    // ═══════════════════════════════════════════════════════════════
+    // MESH RELAY: Re-broadcast message to extend range
+    // This is the core of mesh networking - every device is a relay
+    // ═══════════════════════════════════════════════════════════════
+    private fun relayIfNeeded(message: Message, hopCount: Byte) {
         val myUserId = com.guildofsmiths.trademesh.data.UserPreferences.getUserId()
         if (message.senderId != myUserId && hopCount > 0) {
             val newHopCount = (hopCount - 1).toByte()
@@ -822,9 +932,6 @@ class MeshService : Service() {
         } else if (hopCount <= 0) {
             Log.d(TAG, "🔄 MESH RELAY: TTL expired (hops=0) - not relaying")
         }
-
-        // Route to BoundaryEngine with RSSI for peer tracking
-        BoundaryEngine.onMeshMessageReceived(this, message, rssi)
     }
     
     /**
@@ -931,6 +1038,56 @@ class MeshService : Service() {
         Log.i(TAG, "   Content: \"${message.content}\"")
         Log.i(TAG, "   Sender: ${message.senderId}")
         
+        if (message.content.toByteArray(Charsets.UTF_8).size <= MAX_CONTENT_BYTES) {
+            broadcastSingleMessage(message)
+            return
+        }
+        
+        // Too long for one beacon: the dictionary frame is readable by every peer
+        val dictFrame = MeshCodec.encode(message.content, MAX_CONTENT_BYTES)
+        if (dictFrame != null) {
+            Log.i(TAG, "   🗜️ Dictionary-coded ${message.content.length} chars → ${dictFrame.size} bytes")
+            rememberCompressedFrame(message.id, dictFrame)
+            broadcastSingleMessage(message)
+            return
+        }
+        
+        // Otherwise let the model compress it if one is loaded
+        if (LlamaInference.isModelLoaded()) {
+            codecScope.launch {
+                val frame = LlamaInference.compressMessage(message.content, MAX_CONTENT_BYTES)
+                handler.post {
+                    if (frame != null) {
+                        Log.i(TAG, "   🗜️ Compressed ${message.content.length} chars → ${frame.size} bytes")
+                        rememberCompressedFrame(message.id, frame)
+                        broadcastSingleMessage(message)
+                    } else {
+                        broadcastTruncated(message)
+                    }
+                }
+            }
+            return
+        }
+        broadcastTruncated(message)
+    }
+    
+    /**
+     * Broadcast after whatever is on air or already queued, instead of
+     * replacing it. Used for messages sent in sequence, such as the
+     * segments of a streamed reply (MeshReplyStream).
+     */
+    fun queueBroadcast(message: Message) {
+        handler.post {
+            val busy = isAdvertising || advertiseStarting || synchronized(outboundQueue) { outboundQueue.isNotEmpty() }
+            if (busy) {
+                queueOutboundMessage(message)
+            } else {
+                broadcastMessage(message)
+            }
+        }
+    }
+    
+    private fun broadcastTruncated(message: Message) {
         // For now, truncate long messages with "..." indicator
         // BLE mesh payload limit is ~10 chars, chunking is unreliable over air
         val truncatedContent = if (message.content.length > 10) {
@@ -950,6 +1107,19 @@ class MeshService : Service() {
         broadcastSingleMessage(finalMessage)
     }
     
+    private fun rememberCompressedFrame(messageId: String, frame: ByteArray) {
+        synchronized(compressedFrames) {
+            compressedFrames[messageId] = frame
+            if (compressedFrames.size > maxCompressedFrames) {
+                compressedFrames.remove(compressedFrames.keys.first())
+            }
+        }
+    }
+    
+    private fun compressedFrame(messageId: String): ByteArray? {
+        return synchronized(compressedFrames) { compressedFrames[messageId] }
+    }
+    
     /**
      * Broadcast a single message (or chunk) via BLE advertising.
      */
@@ -1025,6 +1195,7 @@ class MeshService : Service() {
         
         try {
             advertiser.startAdvertising(advertiseSettings, advertiseData, advertiseCallback)
+            advertiseStarting = true
             Log.i(TAG, "   ⏳ Starting legacy advertisement (${truncatedPayload.size} bytes)...")
             Log.i(TAG, "════════════════════════════════════════")
         } catch (e: SecurityException) {
@@ -1131,6 +1302,7 @@ class MeshService : Service() {
     private val advertiseCallback = object : AdvertiseCallback() {
         override fun onStartSuccess(settingsInEffect: AdvertiseSettings) {
             isAdvertising = true
+            advertiseStarting = false
             Log.i(TAG, "════════════════════════════════════════")
             Log.i(TAG, "📢 ADVERTISE STARTED")
             Log.i(TAG, "   Mode: ${settingsInEffect.mode}")
@@ -1149,6 +1321,7 @@ class MeshService : Service() {
         
         override fun onStartFailure(errorCode: Int) {
             isAdvertising = false
+            advertiseStarting = false
             val errorMsg = when (errorCode) {
                 ADVERTISE_FAILED_DATA_TOO_LARGE -> "Data too large"
                 ADVERTISE_FAILED_TOO_MANY_ADVERTISERS -> "Too many advertisers"
@@ -1243,6 +1416,7 @@ class MeshService : Service() {
         
         try {
             advertiser.startAdvertising(advertiseSettings, advertiseData, advertiseCallback)
+            advertiseStarting = true
         } catch (e: Exception) {
             Log.e(TAG, "❌ Direct broadcast error: ${e.message}")
         }
@@ -218,14 +218,20 @@ class ConversationViewModel(application: Application) : AndroidViewModel(applica
     }
 
     /**
-     * Observe sent messages for ambient AI assistance opportunities
+     * Observe sent messages for ambient AI assistance opportunities.
+     * The assistance stays on this device; only @AI questions from mesh
+     * peers are answered on air (AIRouter.onMeshMessageReceived).
      */
     private fun observeMessageForAI(message: Message) {
         viewModelScope.launch {
             try {
                 com.guildofsmiths.trademesh.ai.AIRouter.processMessage(
                     message = message,
-                    messageContext = com.guildofsmiths.trademesh.ai.MessageContext.CHAT,
+                    messageContext = if (message.isMeshOrigin) {
+                        com.guildofsmiths.trademesh.ai.MessageContext.MESH
+                    } else {
+                        com.guildofsmiths.trademesh.ai.MessageContext.CHAT
+                    },
                     metadata = com.guildofsmiths.trademesh.ai.AIMetadata(
                         channelId = message.channelId,
                         userId = message.senderId
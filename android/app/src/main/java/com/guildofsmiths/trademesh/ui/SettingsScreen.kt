@@ -27,6 +27,7 @@ import androidx.compose.runtime.LaunchedEffect
 import androidx.compose.runtime.collectAsState
 import androidx.compose.runtime.getValue
 import androidx.compose.runtime.mutableStateOf
+import androidx.compose.runtime.produceState
 import androidx.compose.runtime.remember
 import androidx.compose.runtime.rememberCoroutineScope
 import androidx.compose.runtime.setValue
@@ -42,6 +43,7 @@ import com.guildofsmiths.trademesh.ai.AIStatus
 import com.guildofsmiths.trademesh.ai.BatteryGate
 import com.guildofsmiths.trademesh.ai.LlamaInference
 import com.guildofsmiths.trademesh.ai.ModelDownloader
+import com.guildofsmiths.trademesh.ai.ModelMetadata
 import com.guildofsmiths.trademesh.ai.ModelState
 import com.guildofsmiths.trademesh.data.AIMode
 import com.guildofsmiths.trademesh.data.SupabaseAuth
@@ -498,6 +500,7 @@ private fun AISettingsSection() {
     var aiEnabled by remember { mutableStateOf(AIRouter.isEnabled()) }
     var aiMode by remember { mutableStateOf(UserPreferences.getAIMode()) }
     var autoDegradeEnabled by remember { mutableStateOf(BatteryGate.isAutoDegradeEnabled()) }
+    var meshRepliesEnabled by remember { mutableStateOf(UserPreferences.isMeshAiRepliesEnabled()) }
     var showModelPicker by remember { mutableStateOf(false) }
     
     // Check if any model exists
@@ -866,6 +869,29 @@ private fun AISettingsSection() {
         
         Spacer(modifier = Modifier.height(4.dp))
         
+        // Mesh replies toggle - answers go to every peer in range
+        Row(
+            modifier = Modifier
+                .fillMaxWidth()
+                .background(ConsoleTheme.surface)
+                .clickable {
+                    meshRepliesEnabled = !meshRepliesEnabled
+                    UserPreferences.setMeshAiRepliesEnabled(meshRepliesEnabled)
+                }
+                .padding(12.dp),
+            verticalAlignment = Alignment.CenterVertically
+        ) {
+            Text(text = "Answer @AI from mesh peers", style = ConsoleTheme.body, modifier = Modifier.weight(1f))
+            Text(
+                text = if (meshRepliesEnabled) "[ON]" else "[OFF]",
+                style = ConsoleTheme.bodyBold.copy(
+                    color = if (meshRepliesEnabled) ConsoleTheme.success else ConsoleTheme.textDim
+                )
+            )
+        }
+        
+        Spacer(modifier = Modifier.height(4.dp))
+        
         // Usage hint
         val usageHint = when (agentState) {
             com.guildofsmiths.trademesh.ai.AgentState.ALIVE ->
@@ -1046,6 +1072,7 @@ private fun ModelPickerDialog(
     onDelete: (ModelDownloader.ModelInfo) -> Unit,
     onDismiss: () -> Unit
 ) {
+    val context = LocalContext.current
     val isDownloading = downloadState is ModelDownloader.DownloadState.Downloading
     val downloadingModelId = (downloadState as? ModelDownloader.DownloadState.Downloading)?.model?.id
     
@@ -1096,6 +1123,11 @@ private fun ModelPickerDialog(
                 val isDownloaded = downloadedModels.any { it.id == model.id }
                 val isCurrentlyDownloading = downloadingModelId == model.id
                 
+                // Header-only read, weights are not loaded
+                val metadata by produceState<ModelMetadata?>(null, model.id, isDownloaded) {
+                    value = if (isDownloaded) ModelDownloader.getModelMetadata(context, model.id) else null
+                }
+                
                 Column(
                     modifier = Modifier
                         .fillMaxWidth()
@@ -1127,6 +1159,12 @@ private fun ModelPickerDialog(
                                 text = model.description,
                                 style = ConsoleTheme.caption.copy(color = ConsoleTheme.textDim)
                             )
+                            metadata?.let { meta ->
+                                Text(
+                                    text = "${meta.summary} · ~${meta.estimateMemoryBytes(LlamaInference.DEFAULT_CONTEXT_SIZE) / 1_000_000}MB RAM",
+                                    style = ConsoleTheme.caption.copy(color = ConsoleTheme.textMuted)
+                                )
+                            }
                         }
                         
                         // Size
@@ -0,0 +1,83 @@
+#!/bin/bash
+
+# Guild of Smiths - Profile-guided build of the native inference library
+#
+# 1. Instrumented build of llama_jni_bench (-fprofile-generate)
+# 2. Profile run on a connected device against a synthetic GGUF model
+# 3. llvm-profdata merge -> app/src/main/cpp/pgo/<abi>.profdata
+# 4. Optimized APK rebuild with -PllamaPgo=use (ThinLTO + PGO)
+#
+# Usage: ./build-pgo.sh [abi] [gradle task]
+#   abi         arm64-v8a (default) or armeabi-v7a
+#   gradle task assembleRelease (default)
+#
+# The rebuild covers every ABI in abiFilters; an ABI without a profile in
+# pgo/ is built without PGO (CMake warns). Run once per ABI to profile all.
+
+set -e
+
+ABI="${1:-arm64-v8a}"
+TASK="${2:-assembleRelease}"
+API_LEVEL=26
+
+CPP_DIR="app/src/main/cpp"
+BUILD_DIR="build/pgo-$ABI"
+PROFILE_DIR="$CPP_DIR/pgo"
+DEVICE_DIR="/data/local/tmp/smith-pgo"
+
+echo "🔨 GUILD OF SMITHS - PGO Build ($ABI)"
+echo "═══════════════════════════════════════════════"
+
+if [ ! -f "gradlew" ]; then
+    echo "❌ Error: gradlew not found. Run from android/ directory."
+    exit 1
+fi
+
+if [ -z "$ANDROID_NDK_HOME" ] || [ ! -d "$ANDROID_NDK_HOME" ]; then
+    echo "❌ Error: ANDROID_NDK_HOME must point to NDK 25.2.9519653"
+    exit 1
+fi
+
+if ! adb get-state > /dev/null 2>&1; then
+    echo "❌ Error: no device connected. The profile must come from real hardware."
+    exit 1
+fi
+
+LLVM_BIN=$(echo "$ANDROID_NDK_HOME"/toolchains/llvm/prebuilt/*/bin)
+
+# Stage 1: instrumented harness
+echo "📐 Building instrumented llama_jni_bench..."
+cmake -S "$CPP_DIR" -B "$BUILD_DIR" \
+    -DCMAKE_TOOLCHAIN_FILE="$ANDROID_NDK_HOME/build/cmake/android.toolchain.cmake" \
+    -DANDROID_ABI="$ABI" \
+    -DANDROID_PLATFORM="android-$API_LEVEL" \
+    -DANDROID_STL=c++_static \
+    -DCMAKE_BUILD_TYPE=Release \
+    -DLLAMA_JNI_BENCH=ON \
+    -DLLAMA_JNI_PGO=GENERATE
+cmake --build "$BUILD_DIR" --target llama_jni_bench -j"$(nproc)"
+
+# Stage 2: profile run on device
+echo "📱 Collecting profile on device..."
+adb shell "rm -rf $DEVICE_DIR && mkdir -p $DEVICE_DIR"
+adb push "$BUILD_DIR/llama_jni_bench" "$DEVICE_DIR/" > /dev/null
+adb shell "cd $DEVICE_DIR && LLVM_PROFILE_FILE=$DEVICE_DIR/bench-%p.profraw \
+    ./llama_jni_bench --synthetic $DEVICE_DIR/synthetic.gguf --iterations 5 --tokens 96"
+
+rm -rf "$BUILD_DIR/profraw"
+mkdir -p "$BUILD_DIR/profraw"
+adb pull "$DEVICE_DIR/." "$BUILD_DIR/profraw/" > /dev/null
+
+# Stage 3: merge
+echo "🧮 Merging profile..."
+mkdir -p "$PROFILE_DIR"
+"$LLVM_BIN/llvm-profdata" merge -output="$PROFILE_DIR/$ABI.profdata" "$BUILD_DIR"/profraw/*.profraw
+adb shell "rm -rf $DEVICE_DIR"
+
+# Stage 4: optimized rebuild
+echo "🚀 Rebuilding with profile ($TASK)..."
+./gradlew "$TASK" -PllamaPgo=use
+
+echo ""
+echo "✅ PGO build complete"
+echo "   Profile: $PROFILE_DIR/$ABI.profdata (commit it to reuse with -PllamaPgo=use)"
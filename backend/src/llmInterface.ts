@@ -6,6 +6,8 @@
  * Easy to add new providers without changing application code.
  */
 
+import { nativeInference } from './nativeInference';
+
 // ════════════════════════════════════════════════════════════════════
 // TYPES
 // ════════════════════════════════════════════════════════════════════
@@ -14,6 +16,7 @@ export enum LLMProvider {
   OPENAI = 'openai',
   ANTHROPIC = 'anthropic',
   LOCAL = 'local',
+  NATIVE = 'native', // In-process engine addon (gateway host)
   MOCK = 'mock', // For testing
 }
 
@@ -48,6 +51,10 @@ export interface LLMProviderConfig {
   defaultModel?: string;
   maxTokens?: number;
   temperature?: number;
+  /** Wire format of a LOCAL provider: Ollama's /api/generate or OpenAI's /v1/chat/completions */
+  localApi?: 'ollama' | 'openai';
+  /** GGUF model for the NATIVE provider */
+  modelPath?: string;
 }
 
 // ════════════════════════════════════════════════════════════════════
@@ -189,17 +196,19 @@ class AnthropicProvider implements ILLMProvider {
 }
 
 // ════════════════════════════════════════════════════════════════════
-// LOCAL PROVIDER (Ollama compatible)
+// LOCAL PROVIDER (Ollama or OpenAI compatible, e.g. smith_server)
 // ════════════════════════════════════════════════════════════════════
 
 class LocalProvider implements ILLMProvider {
   name = LLMProvider.LOCAL;
   private baseUrl: string;
   private defaultModel: string;
+  private api: 'ollama' | 'openai';
 
   constructor(config: LLMProviderConfig) {
     this.baseUrl = config.baseUrl || process.env.LOCAL_LLM_URL || 'http://localhost:11434';
     this.defaultModel = config.defaultModel || 'llama2';
+    this.api = config.localApi || (process.env.LOCAL_LLM_API === 'openai' ? 'openai' : 'ollama');
   }
 
   isAvailable(): boolean {
@@ -207,6 +216,10 @@ class LocalProvider implements ILLMProvider {
   }
 
   async complete(request: LLMCompletionRequest): Promise<LLMCompletionResponse> {
+    if (this.api === 'openai') {
+      return this.completeOpenAI(request);
+    }
+
     const startTime = Date.now();
     const model = request.model || this.defaultModel;
 
@@ -251,6 +264,95 @@ class LocalProvider implements ILLMProvider {
       latencyMs,
     };
   }
+
+  /**
+   * Chat completion against an OpenAI-compatible local server. The server
+   * formats the chat itself, so messages are sent as-is.
+   */
+  private async completeOpenAI(request: LLMCompletionRequest): Promise<LLMCompletionResponse> {
+    const startTime = Date.now();
+    const model = request.model || this.defaultModel;
+
+    const response = await fetch(`${this.baseUrl}/v1/chat/completions`, {
+      method: 'POST',
+      headers: {
+        'Content-Type': 'application/json',
+      },
+      body: JSON.stringify({
+        model,
+        messages: request.messages,
+        max_tokens: request.maxTokens || 1000,
+        temperature: request.temperature ?? 0.7,
+      }),
+    });
+
+    if (!response.ok) {
+      const error = await response.text();
+      throw new Error(`Local LLM error: ${error}`);
+    }
+
+    const data = await response.json() as any;
+    const latencyMs = Date.now() - startTime;
+
+    return {
+      content: data.choices[0]?.message?.content || '',
+      model: data.model || model,
+      provider: LLMProvider.LOCAL,
+      usage: {
+        promptTokens: data.usage?.prompt_tokens || 0,
+        completionTokens: data.usage?.completion_tokens || 0,
+        totalTokens: data.usage?.total_tokens || 0,
+      },
+      latencyMs,
+    };
+  }
+}
+
+// ════════════════════════════════════════════════════════════════════
+// NATIVE PROVIDER (in-process engine addon)
+// ════════════════════════════════════════════════════════════════════
+
+class NativeProvider implements ILLMProvider {
+  name = LLMProvider.NATIVE;
+  private modelPath: string;
+
+  constructor(config: LLMProviderConfig) {
+    this.modelPath = config.modelPath || process.env.SMITH_MODEL_PATH || '';
+  }
+
+  isAvailable(): boolean {
+    return nativeInference.isSupported() && !!this.modelPath;
+  }
+
+  async complete(request: LLMCompletionRequest): Promise<LLMCompletionResponse> {
+    const startTime = Date.now();
+
+    if (!await nativeInference.loadModel(this.modelPath)) {
+      throw new Error(`Native LLM error: cannot load ${this.modelPath}`);
+    }
+
+    // ChatML, as the app's on-device models expect
+    const prompt = request.messages
+      .map(m => `<|im_start|>${m.role}\n${m.content}<|im_end|>\n`)
+      .join('') + '<|im_start|>assistant\n';
+
+    const result = await nativeInference.generate(prompt, {
+      maxTokens: request.maxTokens || 1000,
+      temperature: request.temperature ?? 0.7,
+    });
+
+    return {
+      content: result.text.trim(),
+      model: request.model || this.modelPath.split('/').pop() || 'native',
+      provider: LLMProvider.NATIVE,
+      usage: {
+        promptTokens: result.stats.promptTokens,
+        completionTokens: result.stats.generated,
+        totalTokens: result.stats.promptTokens + result.stats.generated,
+      },
+      latencyMs: Date.now() - startTime,
+    };
+  }
 }
 
 // ════════════════════════════════════════════════════════════════════
@@ -323,6 +425,9 @@ class LLMManager {
       case LLMProvider.LOCAL:
         provider = new LocalProvider(config);
         break;
+      case LLMProvider.NATIVE:
+        provider = new NativeProvider(config);
+        break;
       case LLMProvider.MOCK:
         provider = new MockProvider();
         break;
@@ -466,4 +571,21 @@ if (process.env.ANTHROPIC_API_KEY) {
   });
 }
 
+// Gateway host with the engine addon and a model on disk
+if (process.env.SMITH_MODEL_PATH) {
+  llm.configureProvider({
+    provider: LLMProvider.NATIVE,
+    modelPath: process.env.SMITH_MODEL_PATH,
+  });
+}
+
+// Offline laptops and gateway boxes: a local server such as smith_server
+if (process.env.LOCAL_LLM_URL) {
+  llm.configureProvider({
+    provider: LLMProvider.LOCAL,
+    baseUrl: process.env.LOCAL_LLM_URL,
+    defaultModel: process.env.LOCAL_LLM_MODEL,
+  });
+}
+
 console.log('[LLM] Interface initialized. Available providers:', llm.getAvailableProviders());
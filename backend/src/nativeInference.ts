@@ -0,0 +1,287 @@
+/**
+ * Native Inference (gateway host)
+ *
+ * Promise wrapper over smith_node.node, the Node-API build of the Android
+ * app's inference engine. The gateway runs the same scheduler, prefix
+ * cache and batching in-process, so local models answer without a
+ * network round-trip.
+ *
+ * The addon is optional. Set SMITH_NODE_ADDON to its path, or copy it to
+ * backend/native/smith_node.node. Without it isSupported() is false and
+ * callers fall back to the other LLM providers.
+ */
+
+import path from 'path';
+
+// ════════════════════════════════════════════════════════════════════
+// TYPES
+// ════════════════════════════════════════════════════════════════════
+
+/** Scheduling class; higher values preempt lower ones (matches the engine). */
+export enum InferencePriority {
+  IDLE = 0,
+  BACKGROUND = 1,
+  NORMAL = 2,
+  INTERACTIVE = 3,
+}
+
+export interface GenerationStats {
+  promptTokens: number;
+  prefixReused: number;
+  restored: number;
+  generated: number;
+  tokenizeUs: number;
+  prefillUs: number;
+  decodeUs: number;
+}
+
+export interface NativeGeneration {
+  text: string;
+  stats: GenerationStats;
+}
+
+export interface BatchItemResult {
+  ok: boolean;
+  text: string;
+  error: string;
+  promptTokens: number;
+  prefixTokens: number;
+  generatedTokens: number;
+  firstTokenUs: number;
+  latencyUs: number;
+}
+
+export interface GenerateOptions {
+  maxTokens?: number;
+  temperature?: number;
+  priority?: InferencePriority;
+  /** Resume after a crash from the last checkpoint under this key */
+  checkpointKey?: string;
+  /** Receives output as it is produced */
+  onText?: (chunk: string) => void;
+  signal?: AbortSignal;
+}
+
+interface EngineEvent {
+  type: 'text' | 'complete' | 'error' | 'batch' | 'embeddings';
+  id: number;
+  text?: string;
+  stats?: GenerationStats;
+  error?: string;
+  items?: BatchItemResult[];
+  dim?: number;
+  vectors?: Float32Array;
+}
+
+interface NativeAddon {
+  open(onEvent: (event: EngineEvent) => void): void;
+  close(): void;
+  loadModel(modelPath: string, nCtx: number, nThreads: number): Promise<boolean>;
+  unloadModel(): Promise<void>;
+  isLoaded(): boolean;
+  modelInfo(): { vocab: number; ctx: number; embd: number } | null;
+  setCheckpointDir(dir: string): void;
+  generate(id: number, prompt: string, maxTokens: number, temperature: number,
+           stream: boolean, priority: number, checkpointKey: string | null): boolean;
+  generateBatch(id: number, prompts: string[], maxTokens: number, temperature: number,
+                priority: number): boolean;
+  warm(id: number, prompt: string, priority: number): boolean;
+  embed(id: number, texts: string[], priority: number): boolean;
+  cancel(id: number): void;
+  cancelAll(): void;
+}
+
+interface PendingRequest {
+  onEvent: (event: EngineEvent) => void;
+  reject: (error: Error) => void;
+}
+
+// ════════════════════════════════════════════════════════════════════
+// NATIVE INFERENCE
+// ════════════════════════════════════════════════════════════════════
+
+class NativeInference {
+  private addon: NativeAddon | null = null;
+  private pending: Map<number, PendingRequest> = new Map();
+  private nextId = 1;
+  private loading: Promise<boolean> | null = null;
+  private modelPath = '';
+
+  constructor() {
+    const addonPath = process.env.SMITH_NODE_ADDON ||
+      path.join(__dirname, '..', 'native', 'smith_node.node');
+    try {
+      this.addon = require(addonPath) as NativeAddon;
+      this.addon.open(event => this.dispatch(event));
+      console.log(`[NativeInference] Engine addon loaded from ${addonPath}`);
+    } catch {
+      this.addon = null;
+    }
+  }
+
+  isSupported(): boolean {
+    return this.addon !== null;
+  }
+
+  isLoaded(): boolean {
+    return this.addon?.isLoaded() ?? false;
+  }
+
+  /**
+   * Load a GGUF model. Repeated calls for the same path share one load.
+   */
+  loadModel(modelPath: string, options?: { contextSize?: number; threads?: number }): Promise<boolean> {
+    const addon = this.requireAddon();
+    if (this.loading && this.modelPath === modelPath) {
+      return this.loading;
+    }
+    this.modelPath = modelPath;
+    // A failed or rejected load is not cached, so the next call retries
+    const loading: Promise<boolean> = addon.loadModel(modelPath, options?.contextSize ?? 4096, options?.threads ?? 4)
+      .then(ok => {
+        if (!ok && this.loading === loading) this.loading = null;
+        console.log(`[NativeInference] ${ok ? 'Loaded' : 'Failed to load'} ${modelPath}`);
+        return ok;
+      })
+      .catch(err => {
+        if (this.loading === loading) this.loading = null;
+        throw err;
+      });
+    this.loading = loading;
+    return loading;
+  }
+
+  async unloadModel(): Promise<void> {
+    this.loading = null;
+    this.modelPath = '';
+    await this.addon?.unloadModel();
+  }
+
+  /** Generation checkpoints go here; empty disables them. */
+  setCheckpointDir(dir: string): void {
+    this.requireAddon().setCheckpointDir(dir);
+  }
+
+  generate(prompt: string, options: GenerateOptions = {}): Promise<NativeGeneration> {
+    const addon = this.requireAddon();
+    return this.submit<NativeGeneration>(options.signal, (event, resolve) => {
+      if (event.type === 'text') {
+        options.onText?.(event.text ?? '');
+      } else if (event.type === 'complete') {
+        resolve({ text: event.text ?? '', stats: event.stats! });
+      }
+    }, id => addon.generate(
+      id,
+      prompt,
+      options.maxTokens ?? 256,
+      options.temperature ?? 0.7,
+      !!options.onText,
+      options.priority ?? InferencePriority.NORMAL,
+      options.checkpointKey ?? null,
+    ));
+  }
+
+  /** Run many prompts as parallel sequences; results are in prompt order. */
+  generateBatch(prompts: string[], options: GenerateOptions = {}): Promise<BatchItemResult[]> {
+    const addon = this.requireAddon();
+    return this.submit<BatchItemResult[]>(options.signal, (event, resolve) => {
+      if (event.type === 'batch') resolve(event.items ?? []);
+    }, id => addon.generateBatch(
+      id,
+      prompts,
+      options.maxTokens ?? 256,
+      options.temperature ?? 0.7,
+      options.priority ?? InferencePriority.BACKGROUND,
+    ));
+  }
+
+  /** Prefill a prompt into the prefix cache so later prompts sharing it start faster. */
+  warm(prompt: string, priority: InferencePriority = InferencePriority.IDLE): Promise<void> {
+    const addon = this.requireAddon();
+    return this.submit<void>(undefined, (event, resolve) => {
+      if (event.type === 'complete') resolve();
+    }, id => addon.warm(id, prompt, priority));
+  }
+
+  /** One L2-normalized vector per text. */
+  embed(texts: string[], priority: InferencePriority = InferencePriority.NORMAL): Promise<Float32Array[]> {
+    const addon = this.requireAddon();
+    return this.submit<Float32Array[]>(undefined, (event, resolve) => {
+      if (event.type !== 'embeddings') return;
+      const dim = event.dim ?? 0;
+      const vectors = event.vectors ?? new Float32Array(0);
+      resolve(texts.map((_, i) => vectors.subarray(i * dim, (i + 1) * dim)));
+    }, id => addon.embed(id, texts, priority));
+  }
+
+  cancelAll(): void {
+    this.addon?.cancelAll();
+  }
+
+  /** Stop the engine; outstanding requests are rejected. */
+  close(): void {
+    this.addon?.close();
+    for (const request of this.pending.values()) {
+      request.reject(new Error('Native inference closed'));
+    }
+    this.pending.clear();
+    this.loading = null;
+  }
+
+  // ════════════════════════════════════════════════════════════════════
+  // INTERNALS
+  // ════════════════════════════════════════════════════════════════════
+
+  private requireAddon(): NativeAddon {
+    if (!this.addon) {
+      throw new Error('Native inference addon not available');
+    }
+    return this.addon;
+  }
+
+  private submit<T>(
+    signal: AbortSignal | undefined,
+    onEvent: (event: EngineEvent, resolve: (value: T) => void) => void,
+    start: (id: number) => boolean,
+  ): Promise<T> {
+    const id = this.nextId++;
+    return new Promise<T>((resolve, reject) => {
+      if (signal?.aborted) {
+        reject(new Error('Aborted'));
+        return;
+      }
+      const onAbort = () => this.addon?.cancel(id);
+      const settle = () => {
+        this.pending.delete(id);
+        signal?.removeEventListener('abort', onAbort);
+      };
+      this.pending.set(id, {
+        onEvent: event => {
+          if (event.type === 'error') {
+            settle();
+            reject(new Error(event.error || 'Native inference failed'));
+            return;
+          }
+          onEvent(event, value => {
+            settle();
+            resolve(value);
+          });
+        },
+        reject,
+      });
+      signal?.addEventListener('abort', onAbort);
+
+      if (!start(id)) {
+        settle();
+        reject(new Error('Native engine is not running'));
+      }
+    });
+  }
+
+  private dispatch(event: EngineEvent): void {
+    this.pending.get(event.id)?.onEvent(event);
+  }
+}
+
+// Export singleton instance
+export const nativeInference = new NativeInference();